@@ -0,0 +1,338 @@
+/*
+ * netlink-private/addr.h	Inline Address Storage
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+#ifndef NETLINK_ADDR_PRIV_H_
+#define NETLINK_ADDR_PRIV_H_
+
+#include <stddef.h>
+#include <netlink-private/types.h>
+#include <netlink-private/hash.h>
+#include <netlink/errno.h>
+#include <netlink/attr.h>
+#include <netlink/addr.h>
+
+/*
+ * Helpers for struct nl_inline_addr. Parsers store addresses with
+ * nl_inline_addr_set_attr(), which does not allocate for addresses of
+ * up to NL_ADDR_INLINE_LEN bytes. Getters returning a struct nl_addr use
+ * nl_inline_addr_get(), which builds the address on first use and keeps
+ * it, so the returned pointer stays owned by the object as before.
+ * Compare, hash, dump and message construction work on the stored bytes.
+ *
+ * Getters may run concurrently on an object shared read-only between
+ * threads. The address built on first use is therefore published with
+ * a single atomic store, and the inline bytes are kept unchanged. Once
+ * ia_addr is set it takes precedence, both describe the same address.
+ *
+ * Addresses built here are passed through nl_addr_intern(), so they
+ * must be unshared with nl_inline_addr_unshare() before modification.
+ */
+
+static inline int nl_inline_addr_isset(const struct nl_inline_addr *ia)
+{
+	return ia->ia_addr || ia->ia_inline;
+}
+
+static inline int nl_inline_addr_family(const struct nl_inline_addr *ia)
+{
+	return ia->ia_addr ? ia->ia_addr->a_family : ia->ia_family;
+}
+
+static inline unsigned int nl_inline_addr_len(const struct nl_inline_addr *ia)
+{
+	return ia->ia_addr ? ia->ia_addr->a_len : ia->ia_len;
+}
+
+static inline unsigned int
+nl_inline_addr_prefixlen(const struct nl_inline_addr *ia)
+{
+	return ia->ia_addr ? ia->ia_addr->a_prefixlen : ia->ia_prefixlen;
+}
+
+static inline const void *
+nl_inline_addr_binary(const struct nl_inline_addr *ia)
+{
+	return ia->ia_addr ? (const void *) ia->ia_addr->a_addr :
+			     (const void *) ia->ia_data;
+}
+
+/* Same as nl_addr_iszero() */
+static inline int nl_inline_addr_iszero(const struct nl_inline_addr *ia)
+{
+	const unsigned char *p = nl_inline_addr_binary(ia);
+	unsigned int i;
+
+	for (i = 0; i < nl_inline_addr_len(ia); i++)
+		if (p[i])
+			return 0;
+
+	return 1;
+}
+
+static inline void nl_inline_addr_release(struct nl_inline_addr *ia)
+{
+	nl_addr_put(ia->ia_addr);
+	ia->ia_addr = NULL;
+	ia->ia_inline = 0;
+}
+
+/* Stores a copy of the address */
+static inline int nl_inline_addr_set_data(struct nl_inline_addr *ia,
+					  int family, const void *data,
+					  size_t len, unsigned int prefixlen)
+{
+	nl_inline_addr_release(ia);
+
+	if (len > NL_ADDR_INLINE_LEN || prefixlen > UINT8_MAX ||
+	    family < 0 || family > UINT8_MAX) {
+		if (!(ia->ia_addr = nl_addr_build(family, data, len)))
+			return -NLE_NOMEM;
+		ia->ia_addr->a_prefixlen = prefixlen;
+		ia->ia_addr = nl_addr_intern(ia->ia_addr);
+		return 0;
+	}
+
+	ia->ia_inline = 1;
+	ia->ia_family = family;
+	ia->ia_len = len;
+	ia->ia_prefixlen = prefixlen;
+	if (len)
+		memcpy(ia->ia_data, data, len);
+
+	return 0;
+}
+
+/* Counterpart of nl_addr_alloc_attr() */
+static inline int nl_inline_addr_set_attr(struct nl_inline_addr *ia,
+					  const struct nlattr *nla, int family)
+{
+	size_t len = nla_len(nla);
+
+	return nl_inline_addr_set_data(ia, family, nla_data(nla), len,
+				       family == AF_MPLS ? 20 : len * 8);
+}
+
+/* Holds a reference to an address provided by the application */
+static inline void nl_inline_addr_set(struct nl_inline_addr *ia,
+				      struct nl_addr *addr)
+{
+	if (addr)
+		nl_addr_get(addr);
+	nl_inline_addr_release(ia);
+	ia->ia_addr = addr;
+}
+
+static inline struct nl_addr *nl_inline_addr_get(struct nl_inline_addr *ia)
+{
+	struct nl_addr *addr, *cur = NULL;
+
+	addr = __atomic_load_n(&ia->ia_addr, __ATOMIC_ACQUIRE);
+	if (addr || !ia->ia_inline)
+		return addr;
+
+	if (!(addr = nl_addr_build(ia->ia_family, ia->ia_data, ia->ia_len)))
+		return NULL;
+	addr->a_prefixlen = ia->ia_prefixlen;
+	addr = nl_addr_intern(addr);
+
+	/* Another reader may have built the address in the meantime */
+	if (!__atomic_compare_exchange_n(&ia->ia_addr, &cur, addr, 0,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		nl_addr_put(addr);
+		addr = cur;
+	}
+
+	return addr;
+}
+
+/* Interned addresses are immutable and can be shared by the copy */
+static inline struct nl_addr *nl_addr_clone_shared(struct nl_addr *addr)
+{
+	if (nl_addr_interned(addr))
+		return nl_addr_get(addr);
+
+	return nl_addr_clone(addr);
+}
+
+/* Replaces an interned address with a private copy */
+static inline int nl_inline_addr_unshare(struct nl_inline_addr *ia)
+{
+	struct nl_addr *copy;
+
+	if (!ia->ia_addr || !nl_addr_interned(ia->ia_addr))
+		return 0;
+
+	if (!(copy = nl_addr_clone(ia->ia_addr)))
+		return -NLE_NOMEM;
+
+	nl_addr_put(ia->ia_addr);
+	ia->ia_addr = copy;
+
+	return 0;
+}
+
+/* Same as nl_addr_guess_family() for an address of the given length */
+static inline int nl_addr_guess_family_len(unsigned int len)
+{
+	switch (len) {
+	case 4:
+		return AF_INET;
+	case 6:
+		return AF_LLC;
+	case 16:
+		return AF_INET6;
+	default:
+		return AF_UNSPEC;
+	}
+}
+
+static inline int nl_inline_addr_set_prefixlen(struct nl_inline_addr *ia,
+					       unsigned int prefixlen)
+{
+	if (!ia->ia_addr && prefixlen <= UINT8_MAX) {
+		ia->ia_prefixlen = prefixlen;
+		return 0;
+	}
+
+	if (!nl_inline_addr_get(ia) || nl_inline_addr_unshare(ia) < 0)
+		return -NLE_NOMEM;
+
+	nl_addr_set_prefixlen(ia->ia_addr, prefixlen);
+	return 0;
+}
+
+/* Copies src into dst, small addresses end up inline in dst */
+static inline int nl_inline_addr_clone(struct nl_inline_addr *dst,
+				       const struct nl_inline_addr *src)
+{
+	dst->ia_addr = NULL;
+	dst->ia_inline = 0;
+
+	if (!nl_inline_addr_isset(src))
+		return 0;
+
+	return nl_inline_addr_set_data(dst, nl_inline_addr_family(src),
+				       nl_inline_addr_binary(src),
+				       nl_inline_addr_len(src),
+				       nl_inline_addr_prefixlen(src));
+}
+
+/* Same ordering as nl_addr_cmp(), unset sorts like NULL */
+static inline int nl_inline_addr_cmp(const struct nl_inline_addr *a,
+				     const struct nl_inline_addr *b)
+{
+	unsigned int len;
+	int d;
+
+	if (a->ia_addr && a->ia_addr == b->ia_addr)
+		return 0;
+
+	if (!nl_inline_addr_isset(a) || !nl_inline_addr_isset(b))
+		return nl_inline_addr_isset(a) - nl_inline_addr_isset(b);
+
+	d = nl_inline_addr_family(a) - nl_inline_addr_family(b);
+	if (d)
+		return d;
+
+	len = nl_inline_addr_len(a);
+	d = len - nl_inline_addr_len(b);
+	if (d || !len)
+		return d;
+
+	d = memcmp(nl_inline_addr_binary(a), nl_inline_addr_binary(b), len);
+	if (d)
+		return d;
+
+	return nl_inline_addr_prefixlen(a) - nl_inline_addr_prefixlen(b);
+}
+
+/* Same as nl_addr_cmp() against an application provided address */
+static inline int nl_inline_addr_cmp_addr(const struct nl_inline_addr *a,
+					  const struct nl_addr *b)
+{
+	struct nl_inline_addr tmp = {
+		.ia_addr = (struct nl_addr *) b,
+	};
+
+	return nl_inline_addr_cmp(a, &tmp);
+}
+
+/* Same as nl_addr_cmp_prefix(), both addresses must be set */
+static inline int nl_inline_addr_cmp_prefix(const struct nl_inline_addr *a,
+					    const struct nl_inline_addr *b)
+{
+	const unsigned char *pa = nl_inline_addr_binary(a);
+	const unsigned char *pb = nl_inline_addr_binary(b);
+	unsigned int len, bytes;
+	int d;
+
+	d = nl_inline_addr_family(a) - nl_inline_addr_family(b);
+	if (d)
+		return d;
+
+	len = nl_inline_addr_prefixlen(a);
+	if (nl_inline_addr_prefixlen(b) < len)
+		len = nl_inline_addr_prefixlen(b);
+	bytes = len / 8;
+
+	d = memcmp(pa, pb, bytes);
+	if (d == 0 && (len % 8) != 0) {
+		int mask = (0xFF00 >> (len % 8)) & 0xFF;
+
+		d = (pa[bytes] & mask) - (pb[bytes] & mask);
+	}
+
+	return d;
+}
+
+/* Hashes like nl_hasher_addr() */
+static inline void nl_inline_addr_hash(struct nl_hasher *h,
+				       const struct nl_inline_addr *ia)
+{
+	unsigned int len = nl_inline_addr_len(ia);
+
+	if (!nl_inline_addr_isset(ia))
+		len = 0;
+
+	nl_hasher_u32(h, len);
+	if (len)
+		nl_hasher_bytes(h, nl_inline_addr_binary(ia), len);
+}
+
+static inline int nl_inline_addr_put(struct nl_msg *msg, int attrtype,
+				     const struct nl_inline_addr *ia)
+{
+	return nla_put(msg, attrtype, nl_inline_addr_len(ia),
+		       nl_inline_addr_binary(ia));
+}
+
+/* nl_addr2str() without building a struct nl_addr on the heap */
+static inline char *nl_inline_addr2str(const struct nl_inline_addr *ia,
+				       char *buf, size_t size)
+{
+	union {
+		struct nl_addr	addr;
+		char		buf[sizeof(struct nl_addr) + NL_ADDR_INLINE_LEN];
+	} tmp;
+
+	if (ia->ia_addr || !ia->ia_inline)
+		return nl_addr2str(ia->ia_addr, buf, size);
+
+	tmp.addr.a_family = ia->ia_family;
+	tmp.addr.a_maxsize = NL_ADDR_INLINE_LEN;
+	tmp.addr.a_len = ia->ia_len;
+	tmp.addr.a_prefixlen = ia->ia_prefixlen;
+	tmp.addr.a_refcnt = 1;
+	memcpy(tmp.buf + offsetof(struct nl_addr, a_addr), ia->ia_data,
+	       ia->ia_len);
+
+	return nl_addr2str(&tmp.addr, buf, size);
+}
+
+#endif
@@ -173,7 +173,7 @@ struct nl_cache_ops
 	/** Netlink protocol */
 	int			co_protocol;
 
-	/** cache object hash size **/
+	/** initial cache object hash size, grows on demand **/
 	int			co_hash_size;
 
 	/** cache flags */
@@ -240,9 +240,20 @@ struct nl_cache_ops
 				  change_func_t change_cb, change_func_v2_t change_cb_v2,
 				  void *data);
 
-	void (*reserved_1)(void);
-	void (*reserved_2)(void);
-	void (*reserved_3)(void);
+	/**
+	 * Called after an object has been added to a cache and before an
+	 * object is removed from a cache. Allows the cache type to
+	 * maintain secondary indexes in nl_cache::c_priv.
+	 */
+	void  (*co_obj_added)(struct nl_cache *, struct nl_object *);
+	void  (*co_obj_removed)(struct nl_cache *, struct nl_object *);
+
+	/**
+	 * Called when a cache is freed, after all objects have been
+	 * removed. Must release nl_cache::c_priv.
+	 */
+	void  (*co_free_priv)(struct nl_cache *);
+
 	void (*reserved_4)(void);
 	void (*reserved_5)(void);
 	void (*reserved_6)(void);
@@ -0,0 +1,119 @@
+/*
+ * netlink-private/hash.h	Streaming Hash for Object Keys
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+#ifndef NETLINK_HASH_PRIV_H_
+#define NETLINK_HASH_PRIV_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <netlink/addr.h>
+
+/*
+ * Streaming hasher used by the oo_keygen() implementations. The identity
+ * attributes of an object are fed in one at a time, so no key struct
+ * has to be assembled or allocated. Each 32 bit word is mixed in with
+ * the MurmurHash3 round function, byte strings are consumed a word at
+ * a time.
+ *
+ *	struct nl_hasher h;
+ *
+ *	nl_hasher_init(&h, 0);
+ *	nl_hasher_u32(&h, link->l_index);
+ *	nl_hasher_u32(&h, link->l_family);
+ *	*hashkey = nl_hasher_final(&h) % table_sz;
+ */
+struct nl_hasher
+{
+	uint32_t	h_hash;
+	uint32_t	h_len;
+};
+
+static inline uint32_t __nl_hasher_rotl(uint32_t x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static inline void __nl_hasher_mix(struct nl_hasher *h, uint32_t k)
+{
+	k *= 0xcc9e2d51;
+	k = __nl_hasher_rotl(k, 15);
+	k *= 0x1b873593;
+
+	h->h_hash ^= k;
+	h->h_hash = __nl_hasher_rotl(h->h_hash, 13);
+	h->h_hash = h->h_hash * 5 + 0xe6546b64;
+}
+
+static inline void nl_hasher_init(struct nl_hasher *h, uint32_t seed)
+{
+	h->h_hash = seed;
+	h->h_len = 0;
+}
+
+static inline void nl_hasher_u32(struct nl_hasher *h, uint32_t v)
+{
+	__nl_hasher_mix(h, v);
+	h->h_len += sizeof(v);
+}
+
+static inline void nl_hasher_u64(struct nl_hasher *h, uint64_t v)
+{
+	nl_hasher_u32(h, (uint32_t) v);
+	nl_hasher_u32(h, (uint32_t) (v >> 32));
+}
+
+static inline void nl_hasher_bytes(struct nl_hasher *h, const void *data,
+				   size_t len)
+{
+	const unsigned char *p = data;
+	uint32_t k;
+
+	for (; len >= sizeof(k); p += sizeof(k), len -= sizeof(k)) {
+		memcpy(&k, p, sizeof(k));
+		nl_hasher_u32(h, k);
+	}
+
+	if (len) {
+		k = 0;
+		memcpy(&k, p, len);
+		__nl_hasher_mix(h, k);
+		h->h_len += len;
+	}
+}
+
+/* Hashes the length and binary address, NULL hashes like an empty address */
+static inline void nl_hasher_addr(struct nl_hasher *h,
+				  const struct nl_addr *addr)
+{
+	unsigned int len = addr ? nl_addr_get_len(addr) : 0;
+
+	nl_hasher_u32(h, len);
+	if (len)
+		nl_hasher_bytes(h, nl_addr_get_binary_addr(addr), len);
+}
+
+static inline void nl_hasher_str(struct nl_hasher *h, const char *s)
+{
+	nl_hasher_bytes(h, s, strlen(s));
+}
+
+static inline uint32_t nl_hasher_final(struct nl_hasher *h)
+{
+	uint32_t x = h->h_hash ^ h->h_len;
+
+	x ^= x >> 16;
+	x *= 0x85ebca6b;
+	x ^= x >> 13;
+	x *= 0xc2b2ae35;
+	x ^= x >> 16;
+
+	return x;
+}
+
+#endif
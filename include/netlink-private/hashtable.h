@@ -0,0 +1,45 @@
+/*
+ * netlink-private/hashtable.h	Hashtable Internals
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+#ifndef NETLINK_HASHTABLE_PRIV_H_
+#define NETLINK_HASHTABLE_PRIV_H_
+
+#include <netlink/hashtable.h>
+
+/* Slot of the open addressing array, obj is NULL for free slots */
+typedef struct nl_hash_entry {
+	uint32_t		key;
+	struct nl_object *	obj;
+} nl_hash_entry_t;
+
+/*
+ * nl_hash_table_alloc() returns the public head embedded in this struct
+ * so that the layout of nl_hash_table_t stays unchanged. The head is
+ * kept empty, `size` is 0 and `nodes` is NULL, so code walking the
+ * former chained buckets finds no entries.
+ */
+struct nl_hash_table_priv {
+	nl_hash_table_t		head;
+	int			size;
+	nl_hash_entry_t *	entries;
+	int			count;
+	int			min_size;
+
+	/* Table being migrated to `entries` after a resize */
+	int			old_size;
+	int			rehash_pos;
+	nl_hash_entry_t *	old_entries;
+};
+
+static inline struct nl_hash_table_priv *nl_hash_table_priv(nl_hash_table_t *ht)
+{
+	return (struct nl_hash_table_priv *) ht;
+}
+
+#endif
@@ -177,6 +177,19 @@ static inline int nl_cb_call(struct nl_cb *cb, enum nl_cb_type type, struct nl_m
 
 extern int nl_cache_parse(struct nl_cache_ops *, struct sockaddr_nl *,
 			  struct nlmsghdr *, struct nl_parser_param *);
+extern int __nl_cache_resync(struct nl_sock *, struct nl_cache *,
+			     change_func_t, change_func_v2_t, void *);
+
+extern int _nl_msgtype_map_add(struct nl_msgtype_map *,
+			       struct nl_cache_ops *, int);
+extern struct nl_msgtype_map_entry *
+_nl_msgtype_map_lookup(const struct nl_msgtype_map *, int, int);
+extern void _nl_msgtype_map_clear(struct nl_msgtype_map *);
+
+extern struct nl_recvbuf *_nl_recvbuf_alloc(unsigned char *, size_t);
+extern void _nl_recvbuf_get(struct nl_recvbuf *);
+extern void _nl_recvbuf_put(struct nl_recvbuf *);
+extern struct nl_msg *_nlmsg_view(struct nl_recvbuf *, struct nlmsghdr *);
 
 
 static inline void rtnl_copy_ratespec(struct rtnl_ratespec *dst,
@@ -204,6 +217,16 @@ static inline const char *nl_cache_name(struct nl_cache *cache)
 	return cache->c_ops ? cache->c_ops->co_name : "unknown";
 }
 
+/* Dump filter to pass on to the kernel, requires strict checking */
+static inline struct nl_object *_nl_cache_dump_filter(struct nl_cache *cache,
+						      struct nl_sock *sk)
+{
+	if (!(sk->s_flags & NL_SOCK_STRICT_CHK))
+		return NULL;
+
+	return cache->c_dump_filter;
+}
+
 #define GENL_FAMILY(id, name) \
 	{ \
 		{ id, NL_ACT_UNSPEC, name }, \
@@ -178,6 +178,9 @@ extern "C" {
  * @{
  */
 
+struct nl_index_node;
+struct nl_hasher;
+
 /**
  * Common Object Header
  *
@@ -191,7 +194,8 @@ extern "C" {
 	struct nl_list_head	ce_list;	\
 	int			ce_msgtype;	\
 	int			ce_flags;	\
-	uint64_t		ce_mask;
+	uint64_t		ce_mask;	\
+	struct nl_index_node *	ce_index;
 
 struct nl_object
 {
@@ -351,6 +355,21 @@ struct nl_object_ops
 	 */
 	int   (*oo_update)(struct nl_object *, struct nl_object *);
 
+	/**
+	 * Optional: Attributes modified by update function
+	 *
+	 * Stores the attributes of the first object which oo_update()
+	 * would modify when merging the second object into it and
+	 * returns 0, or returns a negative error code if oo_update() is
+	 * going to refuse the merge. A merge modifying no attribute at
+	 * all is valid. Must be cheap since it is called for every update
+	 * of a cached object, so the cache only saves the old state when
+	 * a merge actually happens. Any attribute not returned must
+	 * remain untouched by oo_update().
+	 */
+	int (*oo_update_attrs)(struct nl_object *, struct nl_object *,
+			       uint64_t *);
+
 	/**
 	 * Hash Key generator function
 	 *
@@ -361,12 +380,36 @@ struct nl_object_ops
 	 */
 	void   (*oo_keygen)(struct nl_object *, uint32_t *, uint32_t);
 
+	/**
+	 * Attributes hashed by oo_keygen()
+	 *
+	 * Only needed by types without identity attributes, for which
+	 * nl_object_identical() compares the attributes present in both
+	 * objects. Such types hash attributes that every object received
+	 * from the kernel carries. A needle lacking any of them may be
+	 * identical to an object stored under a different key, so
+	 * nl_cache_search() and nl_cache_find() scan the cache instead.
+	 */
+	uint64_t	oo_keygen_attrs;
+
 	char *(*oo_attrs2str)(int, char *, size_t);
 
 	/**
 	 * Get key attributes by family function
 	 */
 	uint32_t   (*oo_id_attrs_get)(struct nl_object *);
+
+	/**
+	 * Attribute hash function
+	 *
+	 * Feeds the attributes listed in the bitmask into the hasher.
+	 * Used by secondary cache indexes, see nl_cache_add_index().
+	 * Only attributes which oo_compare() matches by plain equality,
+	 * also in LOOSE_COMPARISON mode, may be hashed, all others
+	 * must be ignored.
+	 */
+	void   (*oo_hash_attrs)(struct nl_object *, uint64_t,
+				struct nl_hasher *);
 };
 
 /** @} */
@@ -0,0 +1,40 @@
+#ifndef NETLINK_NEXTHOP_PRIV_H_
+#define	NETLINK_NEXTHOP_PRIV_H_
+
+#define NH_ATTR_FLAGS   0x000001
+#define NH_ATTR_WEIGHT  0x000002
+#define NH_ATTR_IFINDEX 0x000004
+#define NH_ATTR_GATEWAY 0x000008
+#define NH_ATTR_REALMS  0x000010
+#define NH_ATTR_NEWDST  0x000020
+#define NH_ATTR_VIA     0x000040
+#define NH_ATTR_ENCAP   0x000080
+
+struct nl_msg;
+struct nlattr;
+struct rtnl_route;
+struct rtnl_nexthop;
+struct rtnl_nh_array;
+
+/*
+ * Nexthops in a struct rtnl_nh_array are set up with
+ * rtnl_route_nh_array_init() and freed with rtnl_route_nh_free() like
+ * any other nexthop.
+ */
+struct rtnl_nh_array *rtnl_route_nh_array_alloc(unsigned int n);
+struct rtnl_nexthop *rtnl_route_nh_array_init(struct rtnl_nh_array *array,
+					      unsigned int i);
+void rtnl_route_nh_array_put(struct rtnl_nh_array *array);
+
+void rtnl_route_nh_init(struct rtnl_nexthop *nh);
+int rtnl_route_nh_copy(struct rtnl_nexthop *dst, struct rtnl_nexthop *src);
+void rtnl_route_nh_release(struct rtnl_nexthop *nh);
+
+int rtnl_route_nh_set_gateway_attr(struct rtnl_nexthop *nh,
+				   struct nlattr *attr, int family);
+int rtnl_route_nh_put_gateway(struct nl_msg *msg, struct rtnl_nexthop *nh);
+
+void rtnl_route_free_nexthops(struct rtnl_route *route);
+int rtnl_route_clone_nexthops(struct rtnl_route *dst, struct rtnl_route *src);
+
+#endif
@@ -20,6 +20,8 @@
 extern "C" {
 #endif
 
+struct nl_hasher;
+
 /**
  * Traffic control object operations
  * @ingroup tc
@@ -113,6 +115,10 @@ extern void			rtnl_tc_dump_stats(struct nl_object *,
 extern uint64_t			rtnl_tc_compare(struct nl_object *,
 						struct nl_object *,
 						uint64_t, int);
+extern void			rtnl_tc_keygen(struct nl_object *, uint32_t *,
+					       uint32_t);
+extern void			rtnl_tc_hash_attrs(struct nl_object *, uint64_t,
+						   struct nl_hasher *);
 
 void *                          rtnl_tc_data_peek(struct rtnl_tc *tc);
 extern void *			rtnl_tc_data(struct rtnl_tc *);
@@ -24,6 +24,10 @@ uint32_t _nl_socket_set_local_port_no_release(struct nl_sock *sk, int generate_o
 void _nl_socket_used_ports_release_all(const uint32_t *used_ports);
 void _nl_socket_used_ports_set(uint32_t *used_ports, uint32_t port);
 
+void _nl_socket_recvq_flush(struct nl_sock *sk);
+int _nl_socket_discard(struct nl_sock *sk);
+void _nl_socket_requests_free(struct nl_sock *sk);
+
 #ifdef __cplusplus
 }
 #endif
@@ -39,6 +39,9 @@
 #define NL_MSG_PEEK		(1<<3)
 #define NL_MSG_PEEK_EXPLICIT	(1<<4)
 #define NL_NO_AUTO_ACK		(1<<5)
+#define NL_MSG_ZEROCOPY		(1<<6)
+#define NL_SOCK_STRICT_CHK	(1<<7)
+#define NL_SOCK_OVERRUN		(1<<8)
 
 #define NL_MSG_CRED_PRESENT 1
 
@@ -78,6 +81,37 @@ struct nl_cb
 	enum nl_cb_type		cb_active;
 };
 
+struct nl_recvq_entry
+{
+	struct nl_recvbuf *	re_buf;
+	struct sockaddr_nl	re_addr;
+	int			re_len;
+};
+
+struct nl_recvq
+{
+	struct nl_recvq_entry *	rq_entries;
+	struct mmsghdr *	rq_mmsg;
+	struct iovec *		rq_iov;
+	unsigned int		rq_size;
+	unsigned int		rq_count;
+	unsigned int		rq_next;
+	size_t			rq_bufsize;
+};
+
+struct nl_seqtbl_entry
+{
+	uint32_t		se_seq;
+	void *			se_data;
+};
+
+struct nl_seqtbl
+{
+	struct nl_seqtbl_entry *st_entries;
+	unsigned int		st_size;
+	unsigned int		st_count;
+};
+
 struct nl_sock
 {
 	struct sockaddr_nl	s_local;
@@ -89,6 +123,24 @@ struct nl_sock
 	int			s_flags;
 	struct nl_cb *		s_cb;
 	size_t			s_bufsize;
+	struct nl_recvbuf *	s_rbuf;
+	struct nl_recvq		s_recvq;
+	struct nl_seqtbl	s_requests;
+};
+
+struct nl_request
+{
+	uint32_t		nr_seq;
+	nl_recvmsg_msg_cb_t	nr_reply;
+	nl_request_done_cb_t	nr_done;
+	void *			nr_arg;
+};
+
+struct nl_msg_batch
+{
+	struct nl_msg **	mb_msgs;
+	unsigned int		mb_nmsgs;
+	unsigned int		mb_size;
 };
 
 struct nl_cache
@@ -101,6 +153,56 @@ struct nl_cache
 	unsigned int		c_flags;
 	struct nl_hash_table *	hashtable;
 	struct nl_cache_ops *   c_ops;
+	struct nl_object *	c_dump_filter;
+	/** Private data of the cache type, see nl_cache_ops::co_obj_added */
+	void *			c_priv;
+	struct nl_cache_index *	c_indexes;
+};
+
+/* Entry of an object in a secondary cache index */
+struct nl_index_node
+{
+	struct nl_object *	in_obj;
+	struct nl_cache_index *	in_index;
+	struct nl_index_node *	in_next;
+	struct nl_index_node **	in_pprev;
+	/* Next entry of the same object in another index */
+	struct nl_index_node *	in_obj_next;
+	uint32_t		in_key;
+};
+
+struct nl_cache_index
+{
+	uint64_t		ci_attrs;
+	struct nl_index_node **	ci_buckets;
+	unsigned int		ci_size;
+	unsigned int		ci_count;
+	struct nl_cache_index *	ci_next;
+};
+
+/* Message type to cache operations mapping, see _nl_msgtype_map_add() */
+struct nl_msgtype_map_entry
+{
+	uint32_t		me_key;
+	int			me_index;
+	struct nl_cache_ops *	me_ops;
+};
+
+struct nl_msgtype_map
+{
+	struct nl_msgtype_map_entry *mm_slots;
+	unsigned int		mm_nslots;
+	unsigned int		mm_nentries;
+};
+
+/* Changes to one object coalesced by the cache manager */
+struct nl_pending_event
+{
+	struct nl_object *	pe_old;		/* state before the window */
+	struct nl_object *	pe_cur;		/* latest (or deleted) state */
+	uint64_t		pe_diff;
+	uint32_t		pe_hash;
+	int			pe_exists;
 };
 
 struct nl_cache_assoc
@@ -109,8 +211,21 @@ struct nl_cache_assoc
 	change_func_t		ca_change;
 	change_func_v2_t	ca_change_v2;
 	void *			ca_change_data;
+
+	/* Event coalescing, see nl_cache_mngr_set_coalesce() */
+	unsigned int		ca_window;
+	unsigned int		ca_max_events;
+	unsigned int		ca_nevents;
+	uint64_t		ca_window_start;
+	struct nl_pending_event *ca_pending;
+	unsigned int		ca_npending;
+	unsigned int		ca_pending_size;
+	uint32_t *		ca_pending_idx;
+	unsigned int		ca_pending_nslots;
 };
 
+struct nl_mngr_thread;
+
 struct nl_cache_mngr
 {
 	int			cm_protocol;
@@ -119,6 +234,9 @@ struct nl_cache_mngr
 	struct nl_sock *	cm_sock;
 	struct nl_sock *	cm_sync_sock;
 	struct nl_cache_assoc *	cm_assocs;
+	unsigned int		cm_noverruns;
+	struct nl_msgtype_map	cm_dispatch;
+	struct nl_mngr_thread *	cm_thread;
 };
 
 struct nl_parser_param;
@@ -141,9 +259,36 @@ struct nl_addr
 	unsigned int		a_len;
 	int			a_prefixlen;
 	int			a_refcnt;
+	int			a_interned;
 	char			a_addr[0];
 };
 
+#define NL_ADDR_INLINE_LEN	16
+
+/*
+ * Address embedded in an object, see netlink-private/addr.h. Addresses of
+ * up to NL_ADDR_INLINE_LEN bytes parsed from messages are kept in ia_data.
+ * ia_addr is only allocated if a getter has to hand out a struct nl_addr,
+ * for longer addresses, or to hold an address set by the application.
+ * Once ia_addr is set it is authoritative.
+ */
+struct nl_inline_addr
+{
+	struct nl_addr *	ia_addr;
+	uint8_t			ia_inline;
+	uint8_t			ia_family;
+	uint8_t			ia_len;
+	uint8_t			ia_prefixlen;
+	uint8_t			ia_data[NL_ADDR_INLINE_LEN];
+};
+
+struct nl_recvbuf
+{
+	unsigned char *		rb_data;
+	size_t			rb_size;
+	int			rb_refcnt;
+};
+
 struct nl_msg
 {
 	int			nm_protocol;
@@ -154,6 +299,10 @@ struct nl_msg
 	struct nlmsghdr *	nm_nlh;
 	size_t			nm_size;
 	int			nm_refcnt;
+	/** Receive buffer nm_nlh points into, NULL if nm_nlh is owned */
+	struct nl_recvbuf *	nm_rbuf;
+	/** Size class of nm_nlh if allocated from the slab, otherwise -1 */
+	int			nm_slab;
 };
 
 struct rtnl_link_map
@@ -204,8 +353,8 @@ struct rtnl_link
 	uint32_t			l_txqlen;
 	uint32_t			l_weight;
 	uint32_t			l_master;
-	struct nl_addr *		l_addr;
-	struct nl_addr *		l_bcast;
+	struct nl_inline_addr		l_addr;
+	struct nl_inline_addr		l_bcast;
 	char				l_qdisc[IFQDISCSIZ];
 	struct rtnl_link_map		l_map;
 	uint64_t			l_stats[RTNL_LINK_STATS_MAX+1];
@@ -236,6 +385,8 @@ struct rtnl_link
 	int				l_ns_fd;
 	pid_t				l_ns_pid;
 	struct rtnl_link_vf *		l_vf_list;
+	/* Next link in the name index chain of the cache */
+	struct rtnl_link *		l_name_next;
 };
 
 struct rtnl_ncacheinfo
@@ -255,8 +406,8 @@ struct rtnl_neigh
 	uint16_t	n_state;
 	uint8_t		n_flags;
 	uint8_t		n_type;
-	struct nl_addr *n_lladdr;
-	struct nl_addr *n_dst;
+	struct nl_inline_addr n_lladdr;
+	struct nl_inline_addr n_dst;
 	uint32_t	n_probes;
 	struct rtnl_ncacheinfo n_cacheinfo;
 	uint32_t                n_state_mask;
@@ -333,11 +484,11 @@ struct rtnl_addr
 	uint32_t	a_flags;
 	uint32_t	a_ifindex;
 
-	struct nl_addr *a_peer;
-	struct nl_addr *a_local;
-	struct nl_addr *a_bcast;
-	struct nl_addr *a_anycast;
-	struct nl_addr *a_multicast;
+	struct nl_inline_addr a_peer;
+	struct nl_inline_addr a_local;
+	struct nl_inline_addr a_bcast;
+	struct nl_inline_addr a_anycast;
+	struct nl_inline_addr a_multicast;
 
 	struct rtnl_addr_cacheinfo a_cacheinfo;
 
@@ -353,6 +504,8 @@ struct rtnl_nh_encap
 	void *priv;    /* private data for encap type */
 };
 
+struct rtnl_nh_array;
+
 struct rtnl_nexthop
 {
 	uint8_t			rtnh_flags;
@@ -360,15 +513,29 @@ struct rtnl_nexthop
 	uint8_t			rtnh_weight;
 	/* 1 byte spare */
 	uint32_t		rtnh_ifindex;
-	struct nl_addr *	rtnh_gateway;
 	uint32_t		ce_mask; /* HACK to support attr macros */
 	struct nl_list_head	rtnh_list;
+	/* Block holding the nexthop, NULL if allocated separately */
+	struct rtnl_nh_array *	rtnh_array;
 	uint32_t		rtnh_realms;
+	struct nl_inline_addr	rtnh_gateway;
 	struct nl_addr *	rtnh_newdst;
 	struct nl_addr *	rtnh_via;
 	struct rtnl_nh_encap *	rtnh_encap;
 };
 
+/*
+ * Nexthops of a route allocated in one block. The block is freed once
+ * the route and every nexthop in it have been freed, so a nexthop
+ * removed from the route stays valid on its own.
+ */
+struct rtnl_nh_array
+{
+	/* Held by the route and by each nexthop not freed yet */
+	int			na_refcnt;
+	struct rtnl_nexthop	na_nh[];
+};
+
 struct rtnl_route
 {
 	NLHDR_COMMON
@@ -383,18 +550,50 @@ struct rtnl_route
 	uint8_t			rt_nmetrics;
 	uint8_t			rt_ttl_propagate;
 	uint32_t		rt_flags;
-	struct nl_addr *	rt_dst;
-	struct nl_addr *	rt_src;
+	struct nl_inline_addr	rt_dst;
+	struct nl_inline_addr	rt_src;
 	uint32_t		rt_table;
 	uint32_t		rt_iif;
 	uint32_t		rt_prio;
 	uint32_t		rt_metrics[RTAX_MAX];
 	uint32_t		rt_metrics_mask;
 	uint32_t		rt_nr_nh;
-	struct nl_addr *	rt_pref_src;
+	struct nl_inline_addr	rt_pref_src;
 	struct nl_list_head	rt_nexthops;
+	/* Nexthops parsed or cloned into the route */
+	struct rtnl_nh_array *	rt_nh_array;
+	/* Number of leading rt_nexthops entries stored in order in rt_nh_array */
+	uint32_t		rt_nh_inline;
 	struct rtnl_rtcacheinfo	rt_cacheinfo;
 	uint32_t		rt_flag_mask;
+	uint32_t		rt_nhid;
+};
+
+struct rtnl_nh_group_entry
+{
+	uint32_t		nhe_id;
+	uint16_t		nhe_weight;
+};
+
+struct rtnl_nh
+{
+	NLHDR_COMMON
+
+	uint8_t			nh_family;
+	uint8_t			nh_scope;
+	uint8_t			nh_protocol;
+	uint16_t		nh_group_type;
+	uint16_t		nh_res_buckets;
+	uint32_t		nh_flags;
+	uint32_t		nh_id;
+	uint32_t		nh_oif;
+	struct nl_addr *	nh_gateway;
+	uint32_t		nh_group_size;
+	struct rtnl_nh_group_entry *nh_group;
+	/* Resilient group timers in clock ticks */
+	uint32_t		nh_res_idle_timer;
+	uint32_t		nh_res_unbalanced_timer;
+	uint64_t		nh_res_unbalanced_time;
 };
 
 struct rtnl_rule
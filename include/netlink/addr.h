@@ -34,6 +34,11 @@ extern struct nl_addr *	nl_addr_get(struct nl_addr *);
 extern void		nl_addr_put(struct nl_addr *);
 extern int		nl_addr_shared(const struct nl_addr *);
 
+/* Interning */
+extern void		nl_addr_intern_enable(int);
+extern struct nl_addr *	nl_addr_intern(struct nl_addr *);
+extern int		nl_addr_interned(const struct nl_addr *);
+
 extern int		nl_addr_cmp(const struct nl_addr *,
 				    const struct nl_addr *);
 extern int		nl_addr_cmp_prefix(const struct nl_addr *,
@@ -53,6 +53,9 @@ extern struct nl_object *	nl_cache_get_first(struct nl_cache *);
 extern struct nl_object *	nl_cache_get_last(struct nl_cache *);
 extern struct nl_object *	nl_cache_get_next(struct nl_object *);
 extern struct nl_object *	nl_cache_get_prev(struct nl_object *);
+extern int			nl_cache_set_dump_filter(struct nl_cache *,
+							 struct nl_object *);
+extern struct nl_object *	nl_cache_get_dump_filter(struct nl_cache *);
 
 extern struct nl_cache *	nl_cache_alloc(struct nl_cache_ops *);
 extern int			nl_cache_alloc_and_fill(struct nl_cache_ops *,
@@ -105,6 +108,8 @@ extern struct nl_object *	nl_cache_search(struct nl_cache *,
 extern struct nl_object *nl_cache_find(struct nl_cache *,
 				       struct nl_object *);
 extern void			nl_cache_mark_all(struct nl_cache *);
+extern int			nl_cache_add_index(struct nl_cache *,
+						   uint64_t);
 
 /* Dumping */
 extern void			nl_cache_dump(struct nl_cache *,
@@ -163,10 +168,19 @@ extern int			nl_cache_mngr_add_cache(struct nl_cache_mngr *mngr,
 extern int			nl_cache_mngr_add_cache_v2(struct nl_cache_mngr *mngr,
 							   struct nl_cache *cache,
 							   change_func_v2_t cb, void *data);
+extern int			nl_cache_mngr_set_coalesce(struct nl_cache_mngr *,
+							   struct nl_cache *,
+							   unsigned int,
+							   unsigned int);
 extern int			nl_cache_mngr_get_fd(struct nl_cache_mngr *);
 extern int			nl_cache_mngr_poll(struct nl_cache_mngr *,
 						   int);
 extern int			nl_cache_mngr_data_ready(struct nl_cache_mngr *);
+extern int			nl_cache_mngr_get_timeout(struct nl_cache_mngr *);
+extern int			nl_cache_mngr_flush(struct nl_cache_mngr *);
+extern int			nl_cache_mngr_start_thread(struct nl_cache_mngr *,
+							   unsigned int);
+extern void			nl_cache_mngr_stop_thread(struct nl_cache_mngr *);
 extern void			nl_cache_mngr_info(struct nl_cache_mngr *,
 						   struct nl_dump_params *);
 extern void			nl_cache_mngr_free(struct nl_cache_mngr *);
@@ -29,6 +29,7 @@ struct ucred;
 struct nl_cb;
 struct nl_sock;
 struct nl_msg;
+struct nl_request;
 
 /**
  * @name Callback Typedefs
@@ -53,6 +54,16 @@ typedef int (*nl_recvmsg_msg_cb_t)(struct nl_msg *msg, void *arg);
 typedef int (*nl_recvmsg_err_cb_t)(struct sockaddr_nl *nla,
 				   struct nlmsgerr *nlerr, void *arg);
 
+/**
+ * Completion callback of an asynchronous request
+ * @ingroup cb
+ * @arg req		request handle
+ * @arg error		0 on success or a negative error code
+ * @arg arg		argument passed on through caller
+ */
+typedef void (*nl_request_done_cb_t)(struct nl_request *req, int error,
+				     void *arg);
+
 /** @} */
 
 /**
@@ -19,6 +19,7 @@
 extern "C" {
 #endif
 
+/* Chained hashtable node, no longer used by the hashtable itself */
 typedef struct nl_hash_node {
     uint32_t			key;
     uint32_t			key_size;
@@ -26,14 +27,19 @@ typedef struct nl_hash_node {
     struct nl_hash_node *	next;
 } nl_hash_node_t;
 
+/* Kept for compatibility only, the table contents are private. Tables
+ * returned by nl_hash_table_alloc() have a size of 0 and no nodes. */
 typedef struct nl_hash_table {
     int 			size;
     nl_hash_node_t **		nodes;
 } nl_hash_table_t;
 
-/* Default hash table size */
+/* Default hash table size (historic, tables now grow on demand) */
 #define NL_MAX_HASH_ENTRIES 1024
 
+/* Minimum and default initial hash table size */
+#define NL_MIN_HASH_ENTRIES 16
+
 /* Access Functions */
 extern nl_hash_table_t *	nl_hash_table_alloc(int size);
 extern void 			nl_hash_table_free(nl_hash_table_t *ht);
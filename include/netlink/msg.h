@@ -48,6 +48,7 @@ struct nlmsghdr;
 struct nl_msg;
 struct nl_tree;
 struct ucred;
+struct nlmsgerr;
 
 extern int			nlmsg_size(int);
 extern int			nlmsg_total_size(int);
@@ -109,6 +110,10 @@ extern int		  nl_msg_parse(struct nl_msg *,
 
 extern void		nl_msg_dump(struct nl_msg *, FILE *);
 
+extern const char *	  nlmsg_ext_ack_msg(const struct nlmsgerr *);
+extern int		  nlmsg_ext_ack_offset(const struct nlmsgerr *);
+extern struct nlattr *	  nlmsg_ext_ack_attr(const struct nlmsgerr *);
+
 /**
  * @name Iterators
  * @{
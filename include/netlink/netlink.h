@@ -44,6 +44,8 @@ struct nl_cache_ops;
 struct nl_parser_param;
 struct nl_object;
 struct nl_sock;
+struct nl_msg_batch;
+struct nl_request;
 
 extern int nl_debug;
 extern struct nl_dump_params nl_debug_dp;
@@ -70,6 +72,33 @@ extern int			nl_send_sync(struct nl_sock *, struct nl_msg *);
 extern int			nl_send_simple(struct nl_sock *, int, int,
 					       void *, size_t);
 
+/* Batched Send */
+extern struct nl_msg_batch *	nl_msg_batch_alloc(void);
+extern void			nl_msg_batch_free(struct nl_msg_batch *);
+extern int			nl_msg_batch_add(struct nl_sock *,
+						 struct nl_msg_batch *,
+						 struct nl_msg *);
+extern unsigned int		nl_msg_batch_count(struct nl_msg_batch *);
+extern void			nl_msg_batch_clear(struct nl_msg_batch *);
+extern int			nl_send_batch(struct nl_sock *,
+					      struct nl_msg_batch *);
+extern int			nl_send_pipelined(struct nl_sock *,
+						  struct nl_msg **,
+						  unsigned int,
+						  unsigned int, int *);
+
+/* Asynchronous Requests */
+extern int			nl_request_submit(struct nl_sock *,
+						  struct nl_msg *,
+						  nl_recvmsg_msg_cb_t,
+						  nl_request_done_cb_t,
+						  void *,
+						  struct nl_request **);
+extern void			nl_request_cancel(struct nl_sock *,
+						  struct nl_request *);
+extern unsigned int		nl_request_pending(struct nl_sock *);
+extern int			nl_process_ready(struct nl_sock *);
+
 /* Receive */
 extern int			nl_recv(struct nl_sock *,
 					struct sockaddr_nl *, unsigned char **,
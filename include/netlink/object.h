@@ -67,6 +67,7 @@ extern const char *		nl_object_get_type(const struct nl_object *);
 extern int			nl_object_get_msgtype(const struct nl_object *);
 struct nl_object_ops *		nl_object_get_ops(const struct nl_object *);
 uint32_t			nl_object_get_id_attrs(struct nl_object *obj);
+extern uint64_t			nl_object_get_attrs(const struct nl_object *);
 
 
 static inline void *		nl_object_priv(struct nl_object *obj)
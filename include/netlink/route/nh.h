@@ -0,0 +1,82 @@
+/*
+ * netlink/route/nh.h		Nexthop Objects
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+#ifndef NETLINK_ROUTE_NH_H_
+#define NETLINK_ROUTE_NH_H_
+
+#include <netlink/netlink.h>
+#include <netlink/cache.h>
+#include <netlink/addr.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct rtnl_nh;
+
+extern struct rtnl_nh *	rtnl_nh_alloc(void);
+extern void		rtnl_nh_put(struct rtnl_nh *);
+
+extern int		rtnl_nh_alloc_cache(struct nl_sock *, int,
+					    struct nl_cache **);
+extern struct rtnl_nh *	rtnl_nh_get(struct nl_cache *, uint32_t);
+
+extern int		rtnl_nh_build_add_request(struct rtnl_nh *, int,
+						  struct nl_msg **);
+extern int		rtnl_nh_add(struct nl_sock *, struct rtnl_nh *, int);
+extern int		rtnl_nh_build_delete_request(struct rtnl_nh *, int,
+						     struct nl_msg **);
+extern int		rtnl_nh_delete(struct nl_sock *, struct rtnl_nh *, int);
+
+extern void		rtnl_nh_set_id(struct rtnl_nh *, uint32_t);
+extern uint32_t		rtnl_nh_get_id(struct rtnl_nh *);
+extern void		rtnl_nh_set_family(struct rtnl_nh *, int);
+extern int		rtnl_nh_get_family(struct rtnl_nh *);
+extern void		rtnl_nh_set_protocol(struct rtnl_nh *, uint8_t);
+extern uint8_t		rtnl_nh_get_protocol(struct rtnl_nh *);
+extern void		rtnl_nh_set_flags(struct rtnl_nh *, uint32_t);
+extern uint32_t		rtnl_nh_get_flags(struct rtnl_nh *);
+extern void		rtnl_nh_set_oif(struct rtnl_nh *, int);
+extern int		rtnl_nh_get_oif(struct rtnl_nh *);
+extern int		rtnl_nh_set_gateway(struct rtnl_nh *, struct nl_addr *);
+extern struct nl_addr *	rtnl_nh_get_gateway(struct rtnl_nh *);
+extern void		rtnl_nh_set_blackhole(struct rtnl_nh *, int);
+extern int		rtnl_nh_get_blackhole(struct rtnl_nh *);
+extern void		rtnl_nh_set_fdb(struct rtnl_nh *, int);
+extern int		rtnl_nh_get_fdb(struct rtnl_nh *);
+
+extern int		rtnl_nh_add_group_entry(struct rtnl_nh *, uint32_t,
+						unsigned int);
+extern void		rtnl_nh_clear_group(struct rtnl_nh *);
+extern int		rtnl_nh_get_group_size(struct rtnl_nh *);
+extern int		rtnl_nh_get_group_entry(struct rtnl_nh *, int,
+						uint32_t *, unsigned int *);
+extern void		rtnl_nh_set_group_type(struct rtnl_nh *, int);
+extern int		rtnl_nh_get_group_type(struct rtnl_nh *);
+
+extern void		rtnl_nh_set_res_buckets(struct rtnl_nh *, uint16_t);
+extern int		rtnl_nh_get_res_buckets(struct rtnl_nh *, uint16_t *);
+extern void		rtnl_nh_set_res_idle_timer(struct rtnl_nh *, uint32_t);
+extern int		rtnl_nh_get_res_idle_timer(struct rtnl_nh *,
+						   uint32_t *);
+extern void		rtnl_nh_set_res_unbalanced_timer(struct rtnl_nh *,
+							 uint32_t);
+extern int		rtnl_nh_get_res_unbalanced_timer(struct rtnl_nh *,
+							 uint32_t *);
+extern int		rtnl_nh_get_res_unbalanced_time(struct rtnl_nh *,
+							uint64_t *);
+
+extern char *		rtnl_nh_group_type2str(int, char *, size_t);
+extern int		rtnl_nh_str2group_type(const char *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
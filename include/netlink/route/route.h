@@ -44,6 +44,7 @@ extern "C" {
 #define ROUTE_ATTR_REALMS    0x010000
 #define ROUTE_ATTR_CACHEINFO 0x020000
 #define ROUTE_ATTR_TTL_PROPAGATE 0x040000
+#define ROUTE_ATTR_NHID      0x080000
 /** @endcond */
 
 /**
@@ -82,6 +83,8 @@ extern int	rtnl_route_build_msg(struct nl_msg *, struct rtnl_route *);
 
 extern int	rtnl_route_lookup(struct nl_sock *sk, struct nl_addr *dst,
 				  struct rtnl_route **result);
+extern struct rtnl_route *rtnl_route_cache_lpm(struct nl_cache *, uint32_t,
+					       struct nl_addr *);
 
 extern int	rtnl_route_build_add_request(struct rtnl_route *, int,
 					     struct nl_msg **);
@@ -122,6 +125,8 @@ extern int	rtnl_route_get_src_len(struct rtnl_route *);
 extern void	rtnl_route_set_ttl_propagate(struct rtnl_route *route,
 					     uint8_t ttl_prop);
 extern int	rtnl_route_get_ttl_propagate(struct rtnl_route *route);
+extern void	rtnl_route_set_nhid(struct rtnl_route *, uint32_t);
+extern uint32_t	rtnl_route_get_nhid(struct rtnl_route *);
 
 extern void	rtnl_route_add_nexthop(struct rtnl_route *,
 				       struct rtnl_nexthop *);
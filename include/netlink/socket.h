@@ -19,6 +19,9 @@
 extern "C" {
 #endif
 
+/** Maximum number of datagrams read per system call in batch mode */
+#define NL_RECV_BATCH_MAX	1024
+
 extern struct nl_sock *	nl_socket_alloc(void);
 extern struct nl_sock *	nl_socket_alloc_cb(struct nl_cb *);
 extern void		nl_socket_free(struct nl_sock *);
@@ -53,6 +56,9 @@ extern int		nl_socket_set_msg_buf_size(struct nl_sock *, size_t);
 extern size_t		nl_socket_get_msg_buf_size(struct nl_sock *);
 extern int		nl_socket_set_passcred(struct nl_sock *, int);
 extern int		nl_socket_recv_pktinfo(struct nl_sock *, int);
+extern int		nl_socket_set_cap_ack(struct nl_sock *, int);
+extern int		nl_socket_set_ext_ack(struct nl_sock *, int);
+extern int		nl_socket_set_strict_chk(struct nl_sock *, int);
 
 extern void		nl_socket_disable_seq_check(struct nl_sock *);
 extern unsigned int	nl_socket_use_seq(struct nl_sock *);
@@ -64,6 +70,10 @@ extern int              nl_socket_set_fd(struct nl_sock *sk, int protocol, int f
 extern int		nl_socket_set_nonblocking(const struct nl_sock *);
 extern void		nl_socket_enable_msg_peek(struct nl_sock *);
 extern void		nl_socket_disable_msg_peek(struct nl_sock *);
+extern int		nl_socket_set_recv_batch(struct nl_sock *, unsigned int);
+extern unsigned int	nl_socket_get_recv_batch(const struct nl_sock *);
+extern void		nl_socket_enable_msg_zerocopy(struct nl_sock *);
+extern void		nl_socket_disable_msg_zerocopy(struct nl_sock *);
 
 #ifdef __cplusplus
 }
@@ -33,6 +33,7 @@
 #include <netlink/utils.h>
 #include <netlink/addr.h>
 #include <netlink-private/route/mpls.h>
+#include <netlink-private/hash.h>
 #include <linux/socket.h>
 
 /* All this DECnet stuff is stolen from iproute2, thanks to whoever wrote
@@ -155,6 +156,99 @@ static inline int dnet_pton(const char *src, char *addrbuf)
 	return 1;
 }
 
+/*
+ * Intern pool, an open addressing hash table with linear probing. The
+ * pool does not hold a reference of its own, an interned address is
+ * removed from the pool when its last reference is given back. The
+ * reference counter of interned addresses is only modified while
+ * holding intern_lock since they are shared between objects which may
+ * be owned by different threads.
+ */
+#define INTERN_MIN_SLOTS	64
+
+static NL_LOCK(intern_lock);
+static int intern_enabled;
+static struct nl_addr **intern_slots;
+static unsigned int intern_nslots;
+static unsigned int intern_used;
+
+static uint32_t intern_hash(const struct nl_addr *addr)
+{
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, addr->a_family);
+	nl_hasher_u32(&h, addr->a_prefixlen);
+	nl_hasher_addr(&h, addr);
+
+	return nl_hasher_final(&h);
+}
+
+static int intern_equal(const struct nl_addr *a, const struct nl_addr *b)
+{
+	return a->a_family == b->a_family &&
+	       a->a_prefixlen == b->a_prefixlen &&
+	       a->a_len == b->a_len &&
+	       !memcmp(a->a_addr, b->a_addr, a->a_len);
+}
+
+static int intern_resize(unsigned int nslots)
+{
+	struct nl_addr **slots;
+	unsigned int i, j;
+
+	slots = calloc(nslots, sizeof(*slots));
+	if (!slots)
+		return -NLE_NOMEM;
+
+	for (i = 0; i < intern_nslots; i++) {
+		if (!intern_slots[i])
+			continue;
+
+		j = intern_hash(intern_slots[i]) & (nslots - 1);
+		while (slots[j])
+			j = (j + 1) & (nslots - 1);
+		slots[j] = intern_slots[i];
+	}
+
+	free(intern_slots);
+	intern_slots = slots;
+	intern_nslots = nslots;
+
+	return 0;
+}
+
+/* Called with intern_lock held */
+static void intern_remove(struct nl_addr *addr)
+{
+	unsigned int i, j, k;
+
+	i = intern_hash(addr) & (intern_nslots - 1);
+	while (intern_slots[i] != addr) {
+		if (!intern_slots[i])
+			BUG();
+		i = (i + 1) & (intern_nslots - 1);
+	}
+
+	/* Shift back entries of the probe sequence to close the gap */
+	j = i;
+	for (;;) {
+		j = (j + 1) & (intern_nslots - 1);
+		if (!intern_slots[j])
+			break;
+
+		k = intern_hash(intern_slots[j]) & (intern_nslots - 1);
+		if ((j > i && (k <= i || k > j)) ||
+		    (j < i && (k <= i && k > j))) {
+			intern_slots[i] = intern_slots[j];
+			i = j;
+		}
+	}
+
+	intern_slots[i] = NULL;
+	intern_used--;
+}
+
 static void addr_destroy(struct nl_addr *addr)
 {
 	if (!addr)
@@ -523,7 +617,12 @@ struct nl_addr *nl_addr_clone(const struct nl_addr *addr)
  */
 struct nl_addr *nl_addr_get(struct nl_addr *addr)
 {
-	addr->a_refcnt++;
+	if (addr->a_interned) {
+		nl_lock(&intern_lock);
+		addr->a_refcnt++;
+		nl_unlock(&intern_lock);
+	} else
+		addr->a_refcnt++;
 
 	return addr;
 }
@@ -542,6 +641,20 @@ void nl_addr_put(struct nl_addr *addr)
 	if (!addr)
 		return;
 
+	if (addr->a_interned) {
+		nl_lock(&intern_lock);
+		if (addr->a_refcnt == 1)
+			intern_remove(addr);
+		else {
+			addr->a_refcnt--;
+			addr = NULL;
+		}
+		nl_unlock(&intern_lock);
+
+		addr_destroy(addr);
+		return;
+	}
+
 	if (addr->a_refcnt == 1)
 		addr_destroy(addr);
 	else
@@ -561,6 +674,116 @@ int nl_addr_shared(const struct nl_addr *addr)
 
 /** @} */
 
+/**
+ * @name Interning
+ *
+ * Caches frequently hold many objects referring to the same address,
+ * e.g. the same gateway in thousands of routes. With interning enabled,
+ * the object parsers share a single reference counted address between
+ * all objects carrying the same value, which reduces memory usage and
+ * lets nl_addr_cmp() succeed on pointer equality.
+ *
+ * Interned addresses are shared and must be treated as immutable,
+ * setters refuse or ignore changes to them. Applications which modify
+ * addresses returned by object getters must not enable interning.
+ *
+ * @{
+ */
+
+/**
+ * Enable or disable interning of addresses
+ * @arg enable		Non-zero to enable interning
+ *
+ * Interning is disabled by default. Disabling it again does not affect
+ * addresses which have already been interned.
+ *
+ * @see nl_addr_intern()
+ */
+void nl_addr_intern_enable(int enable)
+{
+	__atomic_store_n(&intern_enabled, !!enable, __ATOMIC_RELEASE);
+}
+
+/**
+ * Return shared reference to an address of equal value
+ * @arg addr		Abstract address
+ *
+ * Looks up an interned address equal to \p addr in family, prefix
+ * length and binary address. If one is found, the reference to \p addr
+ * is given back and a new reference to the interned address is returned.
+ * Otherwise \p addr itself becomes the interned address, unless it is
+ * shared already.
+ *
+ * If interning is disabled, \p addr is returned unmodified.
+ *
+ * @see nl_addr_intern_enable()
+ *
+ * @return Abstract address to be used in place of \p addr.
+ */
+struct nl_addr *nl_addr_intern(struct nl_addr *addr)
+{
+	struct nl_addr *found;
+	uint32_t hash;
+	unsigned int i;
+
+	if (!addr || addr->a_interned ||
+	    !__atomic_load_n(&intern_enabled, __ATOMIC_ACQUIRE))
+		return addr;
+
+	nl_lock(&intern_lock);
+
+	hash = intern_hash(addr);
+
+	if (intern_nslots) {
+		i = hash & (intern_nslots - 1);
+		while ((found = intern_slots[i])) {
+			if (intern_equal(found, addr)) {
+				found->a_refcnt++;
+				nl_unlock(&intern_lock);
+				nl_addr_put(addr);
+				return found;
+			}
+			i = (i + 1) & (intern_nslots - 1);
+		}
+	}
+
+	/* Someone else holds a reference and may still modify it */
+	if (addr->a_refcnt > 1)
+		goto out;
+
+	/* Keep the load factor below 1/2 */
+	if (2 * (intern_used + 1) > intern_nslots &&
+	    intern_resize(intern_nslots ? 2 * intern_nslots :
+					  INTERN_MIN_SLOTS) < 0)
+		goto out;
+
+	i = hash & (intern_nslots - 1);
+	while (intern_slots[i])
+		i = (i + 1) & (intern_nslots - 1);
+
+	intern_slots[i] = addr;
+	intern_used++;
+	addr->a_interned = 1;
+
+out:
+	nl_unlock(&intern_lock);
+
+	return addr;
+}
+
+/**
+ * Check whether an abstract address is interned
+ * @arg addr		Abstract address
+ *
+ * @return Non-zero if the address is interned and thus immutable.
+ */
+int nl_addr_interned(const struct nl_addr *addr)
+{
+	return addr->a_interned;
+}
+
+/** @} */
+
 /**
  * @name Miscellaneous
  * @{
@@ -876,10 +1099,18 @@ int nl_addr_resolve(const struct nl_addr *addr, char *host, size_t hostlen)
  * @arg addr		Abstract address object
  * @arg family		Address family
  *
+ * Interned addresses are immutable, the change is ignored for them.
+ *
  * @see nl_addr_get_family()
  */
 void nl_addr_set_family(struct nl_addr *addr, int family)
 {
+	if (addr->a_interned) {
+		NL_DBG(1, "Ignoring family change of interned address %p\n",
+		       addr);
+		return;
+	}
+
 	addr->a_family = family;
 }
 
@@ -918,6 +1149,9 @@ int nl_addr_get_family(const struct nl_addr *addr)
  */
 int nl_addr_set_binary_addr(struct nl_addr *addr, const void *buf, size_t len)
 {
+	if (addr->a_interned)
+		return -NLE_IMMUTABLE;
+
 	if (len > addr->a_maxsize)
 		return -NLE_RANGE;
 
@@ -961,10 +1195,18 @@ unsigned int nl_addr_get_len(const struct nl_addr *addr)
  * @arg addr		Abstract address object
  * @arg prefixlen	New prefix length
  *
+ * Interned addresses are immutable, the change is ignored for them.
+ *
  * @see nl_addr_get_prefixlen()
  */
 void nl_addr_set_prefixlen(struct nl_addr *addr, int prefixlen)
 {
+	if (addr->a_interned) {
+		NL_DBG(1, "Ignoring prefix length change of interned "
+			  "address %p\n", addr);
+		return;
+	}
+
 	addr->a_prefixlen = prefixlen;
 }
 
@@ -439,22 +439,9 @@ int nla_strcmp(const struct nlattr *nla, const char *str)
  * @{
  */
 
-/**
- * Reserve space for a attribute.
- * @arg msg		Netlink Message.
- * @arg attrtype	Attribute Type.
- * @arg attrlen		Length of payload.
- *
- * Reserves room for a attribute in the specified netlink message and
- * fills in the attribute header (type, length). Returns NULL if there
- * is unsuficient space for the attribute.
- *
- * Any padding between payload and the start of the next attribute is
- * zeroed out.
- *
- * @return Pointer to start of attribute or NULL on failure.
- */
-struct nlattr *nla_reserve(struct nl_msg *msg, int attrtype, int attrlen)
+/** @cond SKIP */
+static struct nlattr *__nla_reserve(struct nl_msg *msg, int attrtype,
+				    int attrlen)
 {
 	struct nlattr *nla;
 	int tlen;
@@ -483,6 +470,32 @@ struct nlattr *nla_reserve(struct nl_msg *msg, int attrtype, int attrlen)
 
 	return nla;
 }
+/** @endcond */
+
+/**
+ * Reserve space for a attribute.
+ * @arg msg		Netlink Message.
+ * @arg attrtype	Attribute Type.
+ * @arg attrlen		Length of payload.
+ *
+ * Reserves room for a attribute in the specified netlink message and
+ * fills in the attribute header (type, length). Returns NULL if there
+ * is unsuficient space for the attribute.
+ *
+ * The payload and any padding between payload and the start of the
+ * next attribute are zeroed out.
+ *
+ * @return Pointer to start of attribute or NULL on failure.
+ */
+struct nlattr *nla_reserve(struct nl_msg *msg, int attrtype, int attrlen)
+{
+	struct nlattr *nla;
+
+	if ((nla = __nla_reserve(msg, attrtype, attrlen)))
+		memset(nla_data(nla), 0, attrlen);
+
+	return nla;
+}
 
 /**
  * Add a unspecific attribute to netlink message.
@@ -502,7 +515,7 @@ int nla_put(struct nl_msg *msg, int attrtype, int datalen, const void *data)
 {
 	struct nlattr *nla;
 
-	nla = nla_reserve(msg, attrtype, datalen);
+	nla = __nla_reserve(msg, attrtype, datalen);
 	if (!nla) {
 		if (datalen < 0)
 			return -NLE_INVAL;
@@ -51,6 +51,7 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/hash.h>
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
 #include <netlink/object.h>
@@ -165,6 +166,49 @@ struct nl_object *nl_cache_get_prev(struct nl_object *obj)
 				     struct nl_object, ce_list);
 }
 
+/**
+ * Restrict the content of a cache to objects matching a filter
+ * @arg cache		Cache
+ * @arg filter		Filter object or NULL to remove the filter
+ *
+ * Objects not matching the filter are no longer added to the cache when
+ * it is refilled or resynchronized. If the socket used for the update
+ * has strict checking enabled (see nl_socket_set_strict_chk()), the
+ * identifying attributes of the filter object supported by the cache
+ * type are passed on to the kernel within the dump request, so that
+ * only matching objects are dumped in the first place. Objects already
+ * in the cache are only affected by the next refill or resync.
+ *
+ * @return 0 on success or a negative error code.
+ */
+int nl_cache_set_dump_filter(struct nl_cache *cache, struct nl_object *filter)
+{
+	if (filter && cache->c_ops &&
+	    cache->c_ops->co_obj_ops != filter->ce_ops)
+		return -NLE_OBJ_MISMATCH;
+
+	if (filter)
+		nl_object_get(filter);
+
+	nl_object_put(cache->c_dump_filter);
+	cache->c_dump_filter = filter;
+
+	return 0;
+}
+
+/**
+ * Return the dump filter of a cache
+ * @arg cache		Cache
+ *
+ * @see nl_cache_set_dump_filter()
+ *
+ * @return Filter object or NULL if no filter is set.
+ */
+struct nl_object *nl_cache_get_dump_filter(struct nl_cache *cache)
+{
+	return cache->c_dump_filter;
+}
+
 /** @} */
 
 /**
@@ -197,7 +241,9 @@ struct nl_cache *nl_cache_alloc(struct nl_cache_ops *ops)
 	/*
 	 * If object type provides a hash keygen
 	 * functions, allocate a hash table for the
-	 * cache objects for faster lookups
+	 * cache objects for faster lookups. The
+	 * table grows with the number of objects,
+	 * co_hash_size only sets its initial size.
 	 */
 	if (ops->co_obj_ops->oo_keygen) {
 		int hashtable_size;
@@ -205,7 +251,7 @@ struct nl_cache *nl_cache_alloc(struct nl_cache_ops *ops)
 		if (ops->co_hash_size)
 			hashtable_size = ops->co_hash_size;
 		else
-			hashtable_size = NL_MAX_HASH_ENTRIES;
+			hashtable_size = NL_MIN_HASH_ENTRIES;
 
 		cache->hashtable = nl_hash_table_alloc(hashtable_size);
 	}
@@ -347,6 +393,8 @@ struct nl_cache *nl_cache_clone(struct nl_cache *cache)
 
 	NL_DBG(2, "Cloning %p into %p\n", cache, clone);
 
+	nl_cache_set_dump_filter(clone, cache->c_dump_filter);
+
 	nl_list_for_each_entry(obj, &cache->c_items, ce_list)
 		nl_cache_add(clone, obj);
 
@@ -376,11 +424,24 @@ void nl_cache_clear(struct nl_cache *cache)
 
 static void __nl_cache_free(struct nl_cache *cache)
 {
+	struct nl_cache_index *idx;
+
 	nl_cache_clear(cache);
 
 	if (cache->hashtable)
 		nl_hash_table_free(cache->hashtable);
 
+	while ((idx = cache->c_indexes)) {
+		cache->c_indexes = idx->ci_next;
+		free(idx->ci_buckets);
+		free(idx);
+	}
+
+	if (cache->c_ops->co_free_priv)
+		cache->c_ops->co_free_priv(cache);
+
+	nl_object_put(cache->c_dump_filter);
+
 	NL_DBG(2, "Freeing cache %p <%s>...\n", cache, nl_cache_name(cache));
 	free(cache);
 }
@@ -432,6 +493,152 @@ void nl_cache_put(struct nl_cache *cache)
  * @{
  */
 
+/*
+ * Secondary indexes hash the attributes they cover through oo_hash_attrs()
+ * and chain all objects of the cache with the same key in one bucket.
+ * Every object links its index entries through ce_index so it can be
+ * unindexed without walking the buckets.
+ */
+static uint32_t cache_index_key(struct nl_cache_index *idx,
+				struct nl_object *obj)
+{
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	obj->ce_ops->oo_hash_attrs(obj, idx->ci_attrs, &h);
+
+	return nl_hasher_final(&h);
+}
+
+static void cache_index_link(struct nl_cache_index *idx,
+			     struct nl_index_node *node)
+{
+	struct nl_index_node **head;
+
+	head = &idx->ci_buckets[node->in_key & (idx->ci_size - 1)];
+	node->in_next = *head;
+	if (*head)
+		(*head)->in_pprev = &node->in_next;
+	node->in_pprev = head;
+	*head = node;
+}
+
+static void cache_index_unlink(struct nl_index_node *node)
+{
+	*node->in_pprev = node->in_next;
+	if (node->in_next)
+		node->in_next->in_pprev = node->in_pprev;
+}
+
+static void cache_index_grow(struct nl_cache_index *idx)
+{
+	struct nl_index_node **old = idx->ci_buckets, *node;
+	unsigned int i, old_size = idx->ci_size;
+
+	idx->ci_buckets = calloc(old_size * 2, sizeof(*idx->ci_buckets));
+	if (!idx->ci_buckets) {
+		/* Keep the current buckets, chains just get longer */
+		idx->ci_buckets = old;
+		return;
+	}
+	idx->ci_size = old_size * 2;
+
+	for (i = 0; i < old_size; i++) {
+		while ((node = old[i])) {
+			old[i] = node->in_next;
+			cache_index_link(idx, node);
+		}
+	}
+
+	free(old);
+}
+
+static int cache_index_insert(struct nl_cache_index *idx,
+			      struct nl_object *obj)
+{
+	struct nl_index_node *node;
+
+	node = calloc(1, sizeof(*node));
+	if (!node)
+		return -NLE_NOMEM;
+
+	if (idx->ci_count >= idx->ci_size)
+		cache_index_grow(idx);
+
+	node->in_obj = obj;
+	node->in_index = idx;
+	node->in_key = cache_index_key(idx, obj);
+	cache_index_link(idx, node);
+	idx->ci_count++;
+
+	node->in_obj_next = obj->ce_index;
+	obj->ce_index = node;
+
+	return 0;
+}
+
+static void cache_unindex_obj(struct nl_object *obj)
+{
+	struct nl_index_node *node, *next;
+
+	for (node = obj->ce_index; node; node = next) {
+		next = node->in_obj_next;
+		cache_index_unlink(node);
+		node->in_index->ci_count--;
+		free(node);
+	}
+
+	obj->ce_index = NULL;
+}
+
+static int cache_index_obj(struct nl_cache *cache, struct nl_object *obj)
+{
+	struct nl_cache_index *idx;
+	int err;
+
+	for (idx = cache->c_indexes; idx; idx = idx->ci_next) {
+		err = cache_index_insert(idx, obj);
+		if (err < 0) {
+			cache_unindex_obj(obj);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+/* Rehash the index entries of an object after it has been updated in place */
+static void cache_reindex_obj(struct nl_object *obj)
+{
+	struct nl_index_node *node;
+
+	for (node = obj->ce_index; node; node = node->in_obj_next) {
+		cache_index_unlink(node);
+		node->in_key = cache_index_key(node->in_index, obj);
+		cache_index_link(node->in_index, node);
+	}
+}
+
+/* Returns the index covering most of the attributes set in the filter */
+static struct nl_cache_index *cache_index_lookup(struct nl_cache *cache,
+						 struct nl_object *filter)
+{
+	struct nl_cache_index *idx, *best = NULL;
+
+	if (filter->ce_ops != cache->c_ops->co_obj_ops)
+		return NULL;
+
+	for (idx = cache->c_indexes; idx; idx = idx->ci_next) {
+		if (idx->ci_attrs & ~filter->ce_mask)
+			continue;
+
+		if (!best || (idx->ci_attrs & best->ci_attrs) == best->ci_attrs)
+			best = idx;
+	}
+
+	return best;
+}
+
 static int __cache_add(struct nl_cache *cache, struct nl_object *obj)
 {
 	int ret;
@@ -446,9 +653,20 @@ static int __cache_add(struct nl_cache *cache, struct nl_object *obj)
 		}
 	}
 
+	ret = cache_index_obj(cache, obj);
+	if (ret < 0) {
+		if (cache->hashtable)
+			nl_hash_table_del(cache->hashtable, obj);
+		obj->ce_cache = NULL;
+		return ret;
+	}
+
 	nl_list_add_tail(&obj->ce_list, &cache->c_items);
 	cache->c_nitems++;
 
+	if (cache->c_ops->co_obj_added)
+		cache->c_ops->co_obj_added(cache, obj);
+
 	NL_DBG(3, "Added object %p to cache %p <%s>, nitems %d\n",
 	       obj, cache, nl_cache_name(cache), cache->c_nitems);
 
@@ -564,6 +782,11 @@ void nl_cache_remove(struct nl_object *obj)
 			       obj, cache, nl_cache_name(cache));
 	}
 
+	cache_unindex_obj(obj);
+
+	if (cache->c_ops->co_obj_removed)
+		cache->c_ops->co_obj_removed(cache, obj);
+
 	nl_list_del(&obj->ce_list);
 	obj->ce_cache = NULL;
 	nl_object_put(obj);
@@ -575,6 +798,103 @@ void nl_cache_remove(struct nl_object *obj)
 
 /** @} */
 
+/**
+ * @name Secondary Indexes
+ * @{
+ */
+
+/**
+ * Index cache on a set of attributes
+ * @arg cache		Cache
+ * @arg attrs		bitmask of object attributes to index on
+ *
+ * Adds a secondary index on the attributes in \p attrs to the cache,
+ * e.g. neighbours by interface index or classes by parent handle. The
+ * mask is most easily taken from an example object with
+ * nl_object_get_attrs().
+ * The index is kept up to date as objects are added, removed or
+ * updated and lives as long as the cache itself.
+ *
+ * nl_cache_find() and nl_cache_foreach_filter() consult the index
+ * whenever all of its attributes are set in the filter and only
+ * compare the objects sharing the filter's key instead of the whole
+ * cache. In that case the order in which objects are visited is
+ * unspecified.
+ *
+ * Attributes the object type cannot hash are ignored by the index,
+ * lookups remain correct but narrow the search down less.
+ *
+ * @return 0 on success or a negative error code.
+ * @retval -NLE_OPNOTSUPP Object type does not support attribute hashing.
+ * @retval -NLE_EXIST An index on the same attributes exists already.
+ */
+int nl_cache_add_index(struct nl_cache *cache, uint64_t attrs)
+{
+	struct nl_cache_index *idx;
+	struct nl_object *obj;
+	unsigned int size = NL_MIN_HASH_ENTRIES;
+	int err;
+
+	if (cache->c_ops == NULL)
+		BUG();
+
+	if (!attrs)
+		return -NLE_INVAL;
+
+	if (!cache->c_ops->co_obj_ops->oo_hash_attrs)
+		return -NLE_OPNOTSUPP;
+
+	for (idx = cache->c_indexes; idx; idx = idx->ci_next)
+		if (idx->ci_attrs == attrs)
+			return -NLE_EXIST;
+
+	while (size < cache->c_nitems)
+		size <<= 1;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return -NLE_NOMEM;
+
+	idx->ci_buckets = calloc(size, sizeof(*idx->ci_buckets));
+	if (!idx->ci_buckets) {
+		free(idx);
+		return -NLE_NOMEM;
+	}
+	idx->ci_size = size;
+	idx->ci_attrs = attrs;
+
+	nl_list_for_each_entry(obj, &cache->c_items, ce_list) {
+		err = cache_index_insert(idx, obj);
+		if (err < 0)
+			goto errout;
+	}
+
+	idx->ci_next = cache->c_indexes;
+	cache->c_indexes = idx;
+
+	NL_DBG(2, "Added index 0x%" PRIx64 " to cache %p <%s>\n",
+	       attrs, cache, nl_cache_name(cache));
+
+	return 0;
+
+errout:
+	/* The entries of the new index are the first in each object's list */
+	nl_list_for_each_entry(obj, &cache->c_items, ce_list) {
+		struct nl_index_node *node = obj->ce_index;
+
+		if (!node || node->in_index != idx)
+			break;
+
+		obj->ce_index = node->in_obj_next;
+		free(node);
+	}
+
+	free(idx->ci_buckets);
+	free(idx);
+
+	return err;
+}
+
 /**
  * @name Synchronization
  * @{
@@ -716,9 +1036,14 @@ static int pickup_checkdup_cb(struct nl_object *c, struct nl_parser_param *p)
 	struct nl_cache *cache = (struct nl_cache *)p->pp_arg;
 	struct nl_object *old;
 
+	if (cache->c_dump_filter &&
+	    !nl_object_match_filter(c, cache->c_dump_filter))
+		return 0;
+
 	old = nl_cache_search(cache, c);
 	if (old) {
 		if (nl_object_update(old, c) == 0) {
+			cache_reindex_obj(old);
 			nl_object_put(old);
 			return 0;
 		}
@@ -733,8 +1058,31 @@ static int pickup_checkdup_cb(struct nl_object *c, struct nl_parser_param *p)
 static int pickup_cb(struct nl_object *c, struct nl_parser_param *p)
 {
 	struct nl_cache *cache = p->pp_arg;
+	int err;
 
-	return nl_cache_add(cache, c);
+	if (cache->c_dump_filter &&
+	    !nl_object_match_filter(c, cache->c_dump_filter))
+		return 0;
+
+	/*
+	 * Types without identity attributes may dump objects which are
+	 * identical to an object already in the hashtable, keep the first
+	 * one instead of failing the whole dump. For all other types a
+	 * duplicate points to incomplete identity attributes.
+	 */
+	err = nl_cache_add(cache, c);
+	if (err == -NLE_EXIST) {
+		if (cache->c_ops->co_obj_ops->oo_keygen_attrs)
+			NL_DBG(2, "Skipping duplicate object %p in cache "
+				  "%p <%s>\n", c, cache, nl_cache_name(cache));
+		else
+			NL_DBG(1, "Warning: dump of cache %p <%s> contains "
+				  "duplicate key, skipping object %p\n",
+			       cache, nl_cache_name(cache), c);
+		return 0;
+	}
+
+	return err;
 }
 
 static int __nl_cache_pickup(struct nl_sock *sk, struct nl_cache *cache,
@@ -784,29 +1132,58 @@ int nl_cache_pickup(struct nl_sock *sk, struct nl_cache *cache)
 	return __nl_cache_pickup(sk, cache, 0);
 }
 
+/*
+ * Stores the attributes of old which an update with obj would modify,
+ * returns a negative error code if the object type is not going to
+ * merge them.
+ */
+static int cache_update_attrs(struct nl_object *old, struct nl_object *obj,
+			      uint64_t *attrs)
+{
+	struct nl_object_ops *ops = old->ce_ops;
+
+	if (!ops->oo_update)
+		return -NLE_OPNOTSUPP;
+
+	if (!ops->oo_update_attrs) {
+		*attrs = UINT64_MAX;
+		return 0;
+	}
+
+	return ops->oo_update_attrs(old, obj, attrs);
+}
+
 static int cache_include(struct nl_cache *cache, struct nl_object *obj,
 			 struct nl_msgtype *type, change_func_t cb,
 			 change_func_v2_t cb_v2, void *data)
 {
 	struct nl_object *old;
 	struct nl_object *clone = NULL;
-	uint64_t diff = 0;
+	uint64_t attrs, diff = 0;
+	int merge;
 
 	switch (type->mt_act) {
 	case NL_ACT_NEW:
 	case NL_ACT_DEL:
 		old = nl_cache_search(cache, obj);
 		if (old) {
-			if (cb_v2 && old->ce_ops->oo_update) {
-				clone = nl_object_clone(old);
-				diff = nl_object_diff64(old, obj);
-			}
 			/*
 			 * Some objects types might support merging the new
 			 * object with the old existing cache object.
-			 * Handle them first.
+			 * Handle them first. The state of the old object
+			 * is only saved for the change callback if a merge
+			 * is going to happen, and only the attributes the
+			 * merge touches are compared.
 			 */
-			if (nl_object_update(old, obj) == 0) {
+			merge = cache_update_attrs(old, obj, &attrs) == 0;
+			if (merge && cb_v2) {
+				clone = nl_object_clone(old);
+				diff = old->ce_ops->oo_compare(old, obj,
+							       attrs, 0);
+			}
+
+			if (merge && nl_object_update(old, obj) == 0) {
+				cache_reindex_obj(old);
 				if (cb_v2) {
 					cb_v2(cache, clone, obj, diff,
 					      NL_ACT_CHANGE, data);
@@ -902,6 +1279,10 @@ int nl_cache_include_v2(struct nl_cache *cache, struct nl_object *obj,
 static int resync_cb(struct nl_object *c, struct nl_parser_param *p)
 {
 	struct nl_cache_assoc *ca = p->pp_arg;
+	struct nl_object *filter = ca->ca_cache->c_dump_filter;
+
+	if (filter && !nl_object_match_filter(c, filter))
+		return 0;
 
 	if (ca->ca_change_v2)
 		return nl_cache_include_v2(ca->ca_cache, c, ca->ca_change_v2,
@@ -913,12 +1294,21 @@ static int resync_cb(struct nl_object *c, struct nl_parser_param *p)
 
 int nl_cache_resync(struct nl_sock *sk, struct nl_cache *cache,
 		    change_func_t change_cb, void *data)
+{
+	return __nl_cache_resync(sk, cache, change_cb, NULL, data);
+}
+
+/** @cond SKIP */
+int __nl_cache_resync(struct nl_sock *sk, struct nl_cache *cache,
+		      change_func_t change_cb, change_func_v2_t change_cb_v2,
+		      void *data)
 {
 	struct nl_object *obj, *next;
 	struct nl_af_group *grp;
 	struct nl_cache_assoc ca = {
 		.ca_cache = cache,
 		.ca_change = change_cb,
+		.ca_change_v2 = change_cb_v2,
 		.ca_change_data = data,
 	};
 	struct nl_parser_param p = {
@@ -961,7 +1351,10 @@ restart:
 		if (nl_object_is_marked(obj)) {
 			nl_object_get(obj);
 			nl_cache_remove(obj);
-			if (change_cb)
+			if (change_cb_v2)
+				change_cb_v2(cache, obj, NULL, 0, NL_ACT_DEL,
+					     data);
+			else if (change_cb)
 				change_cb(cache, obj, NL_ACT_DEL, data);
 			nl_object_put(obj);
 		}
@@ -973,6 +1366,7 @@ restart:
 errout:
 	return err;
 }
+/** @endcond */
 
 /** @} */
 
@@ -1082,6 +1476,14 @@ restart:
  * @name Utillities
  * @{
  */
+static int cache_fast_lookup_ok(struct nl_cache *cache,
+				struct nl_object *needle)
+{
+	uint64_t attrs = cache->c_ops->co_obj_ops->oo_keygen_attrs;
+
+	return cache->hashtable && (needle->ce_mask & attrs) == attrs;
+}
+
 static struct nl_object *__cache_fast_lookup(struct nl_cache *cache,
 					     struct nl_object *needle)
 {
@@ -1116,7 +1518,7 @@ struct nl_object *nl_cache_search(struct nl_cache *cache,
 {
 	struct nl_object *obj;
 
-	if (cache->hashtable)
+	if (cache_fast_lookup_ok(cache, needle))
 		return __cache_fast_lookup(cache, needle);
 
 	nl_list_for_each_entry(obj, &cache->c_items, ce_list) {
@@ -1137,7 +1539,9 @@ struct nl_object *nl_cache_search(struct nl_cache *cache,
  * Searches the cache for an object which matches the object filter.
  * If the filter attributes matches the object type id attributes,
  * and the cache supports hash lookups, a faster hashtable lookup
- * is used to return the object. Else, function nl_object_match_filter() is
+ * is used to return the object. If the filter covers a secondary
+ * index, see nl_cache_add_index(), only the objects sharing its key
+ * are considered. Else, function nl_object_match_filter() is
  * used to determine if the objects match. If a matching object is
  * found, the reference counter is incremented and the object is returned.
  *
@@ -1149,15 +1553,33 @@ struct nl_object *nl_cache_search(struct nl_cache *cache,
 struct nl_object *nl_cache_find(struct nl_cache *cache,
 				struct nl_object *filter)
 {
+	struct nl_cache_index *idx;
+	struct nl_index_node *node;
 	struct nl_object *obj;
+	uint32_t key;
 
 	if (cache->c_ops == NULL)
 		BUG();
 
 	if ((nl_object_get_id_attrs(filter) == filter->ce_mask)
-		&& cache->hashtable)
+		&& cache_fast_lookup_ok(cache, filter))
 		return __cache_fast_lookup(cache, filter);
 
+	idx = cache_index_lookup(cache, filter);
+	if (idx) {
+		key = cache_index_key(idx, filter);
+		node = idx->ci_buckets[key & (idx->ci_size - 1)];
+		for (; node; node = node->in_next) {
+			if (node->in_key == key &&
+			    nl_object_match_filter(node->in_obj, filter)) {
+				nl_object_get(node->in_obj);
+				return node->in_obj;
+			}
+		}
+
+		return NULL;
+	}
+
 	nl_list_for_each_entry(obj, &cache->c_items, ce_list) {
 		if (nl_object_match_filter(obj, filter)) {
 			nl_object_get(obj);
@@ -1269,6 +1691,58 @@ void nl_cache_foreach(struct nl_cache *cache,
 	nl_cache_foreach_filter(cache, NULL, cb, arg);
 }
 
+/*
+ * Visit the objects matching the filter through a secondary index. The
+ * matches are collected first since the callback may modify the cache.
+ * Returns a negative error code if no index applies.
+ */
+static int cache_foreach_index(struct nl_cache *cache, struct nl_object *filter,
+			       void (*cb)(struct nl_object *, void *),
+			       void *arg)
+{
+	struct nl_cache_index *idx;
+	struct nl_index_node *node, *head;
+	struct nl_object **objs;
+	unsigned int i, n = 0;
+	uint32_t key;
+
+	idx = cache_index_lookup(cache, filter);
+	if (!idx)
+		return -NLE_OBJ_NOTFOUND;
+
+	key = cache_index_key(idx, filter);
+	head = idx->ci_buckets[key & (idx->ci_size - 1)];
+
+	for (node = head; node; node = node->in_next)
+		if (node->in_key == key)
+			n++;
+
+	if (!n)
+		return 0;
+
+	objs = malloc(n * sizeof(*objs));
+	if (!objs)
+		return -NLE_NOMEM;
+
+	for (n = 0, node = head; node; node = node->in_next) {
+		if (node->in_key == key &&
+		    nl_object_match_filter(node->in_obj, filter)) {
+			/* Caller may hold obj for a long time */
+			nl_object_get(node->in_obj);
+			objs[n++] = node->in_obj;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		cb(objs[i], arg);
+		nl_object_put(objs[i]);
+	}
+
+	free(objs);
+
+	return 0;
+}
+
 /**
  * Call a callback on each element of the cache (filtered).
  * @arg cache		cache to iterate on
@@ -1279,6 +1753,9 @@ void nl_cache_foreach(struct nl_cache *cache,
  * Calls a callback function \a cb on each element of the \a cache
  * that matches the \a filter. The argument \a arg is passed on
  * to the callback function.
+ *
+ * If the filter covers a secondary index, see nl_cache_add_index(),
+ * only the objects sharing its key are compared against the filter.
  */
 void nl_cache_foreach_filter(struct nl_cache *cache, struct nl_object *filter,
 			     void (*cb)(struct nl_object *, void *), void *arg)
@@ -1288,6 +1765,9 @@ void nl_cache_foreach_filter(struct nl_cache *cache, struct nl_object *filter,
 	if (cache->c_ops == NULL)
 		BUG();
 
+	if (filter && cache_foreach_index(cache, filter, cb, arg) == 0)
+		return;
+
 	nl_list_for_each_entry_safe(obj, tmp, &cache->c_items, ce_list) {
 		if (filter) {
 			int diff = nl_object_match_filter(obj, filter);
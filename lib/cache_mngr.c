@@ -35,19 +35,336 @@
 
 #include <netlink-private/netlink.h>
 #include <netlink-private/utils.h>
+#include <netlink-private/socket.h>
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
 #include <netlink/utils.h>
 
+#include <sys/eventfd.h>
+
 /** @cond SKIP */
 #define NASSOC_INIT		16
 #define NASSOC_EXPAND		8
+#define NPENDING_INIT		16
+#define RCVBUF_MAX		(16 * 1024 * 1024)
+#define NRING_DEFAULT		1024
+#define NRING_MAX		(1 << 20)
+#define MNGR_EV_OVERRUN		-1
+
+/* Values of t_stop */
+#define MNGR_STOP_DRAIN		1	/* queue what was read, then stop */
+#define MNGR_STOP_ABORT		2
+
+/* Message handed from the manager thread to the application */
+struct nl_mngr_event
+{
+	struct nl_msg *		ev_msg;
+	int			ev_assoc;
+	int			ev_err;
+};
+
+/*
+ * Single producer, single consumer ring. The indices increase freely,
+ * t_head is only written by the manager thread and t_tail only by the
+ * application.
+ */
+struct nl_mngr_thread
+{
+	struct nl_mngr_event *	t_ring;
+	unsigned int		t_size;
+	unsigned int		t_head;
+	unsigned int		t_tail;
+	int			t_waiting;
+	int			t_stop;
+	int			t_done;
+	int			t_paused;	/* until resynced after overrun */
+	int			t_lost;		/* message lost, thread only */
+	int			t_err;		/* thread failed */
+	int			t_event_fd;
+	int			t_wake_fd;
+	struct nl_cb *		t_cb;
+#ifndef DISABLE_PTHREADS
+	pthread_t		t_thread;
+#endif
+};
 /** @endcond */
 
+static uint64_t mngr_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static inline int assoc_coalescing(struct nl_cache_assoc *ca)
+{
+	return ca->ca_window || ca->ca_max_events;
+}
+
+static void pending_index(struct nl_cache_assoc *ca, unsigned int n)
+{
+	unsigned int slot, mask = ca->ca_pending_nslots - 1;
+
+	slot = ca->ca_pending[n].pe_hash & mask;
+	while (ca->ca_pending_idx[slot])
+		slot = (slot + 1) & mask;
+
+	ca->ca_pending_idx[slot] = n + 1;
+}
+
+static struct nl_pending_event *pending_lookup(struct nl_cache_assoc *ca,
+					       struct nl_object *obj,
+					       uint32_t hash)
+{
+	struct nl_pending_event *pe;
+	unsigned int slot, mask = ca->ca_pending_nslots - 1;
+
+	if (!ca->ca_npending)
+		return NULL;
+
+	for (slot = hash & mask; ca->ca_pending_idx[slot];
+	     slot = (slot + 1) & mask) {
+		pe = &ca->ca_pending[ca->ca_pending_idx[slot] - 1];
+		if (pe->pe_hash == hash && nl_object_identical(pe->pe_cur, obj))
+			return pe;
+	}
+
+	return NULL;
+}
+
+static struct nl_pending_event *pending_add(struct nl_cache_assoc *ca,
+					    uint32_t hash)
+{
+	struct nl_pending_event *pe;
+	unsigned int i, size;
+	uint32_t *idx;
+
+	if (ca->ca_npending == ca->ca_pending_size) {
+		size = ca->ca_pending_size ? ca->ca_pending_size * 2
+					   : NPENDING_INIT;
+
+		pe = realloc(ca->ca_pending, size * sizeof(*pe));
+		if (!pe)
+			return NULL;
+		ca->ca_pending = pe;
+
+		/* Index is kept at most half full */
+		idx = calloc(size * 2, sizeof(*idx));
+		if (!idx)
+			return NULL;
+
+		free(ca->ca_pending_idx);
+		ca->ca_pending_idx = idx;
+		ca->ca_pending_nslots = size * 2;
+		ca->ca_pending_size = size;
+
+		for (i = 0; i < ca->ca_npending; i++)
+			pending_index(ca, i);
+	}
+
+	pe = &ca->ca_pending[ca->ca_npending];
+	memset(pe, 0, sizeof(*pe));
+	pe->pe_hash = hash;
+	pending_index(ca, ca->ca_npending++);
+
+	return pe;
+}
+
+static void pending_deliver(struct nl_cache_assoc *ca, struct nl_object *old,
+			    struct nl_object *new, uint64_t diff, int action)
+{
+	struct nl_object *obj = NULL;
+
+	if (ca->ca_change_v2) {
+		ca->ca_change_v2(ca->ca_cache, old, new, diff, action,
+				 ca->ca_change_data);
+	} else if (ca->ca_change) {
+		/*
+		 * Merged updates are recorded with the notification,
+		 * the old style callback is given the cached object.
+		 */
+		if (action == NL_ACT_CHANGE)
+			obj = nl_cache_search(ca->ca_cache, new);
+
+		ca->ca_change(ca->ca_cache, obj ? obj : (new ? new : old),
+			      action, ca->ca_change_data);
+		nl_object_put(obj);
+	}
+}
+
+static int pending_report(struct nl_cache_assoc *ca,
+			  struct nl_pending_event *pe)
+{
+	struct nl_object *cur = NULL;
+	int n = 1;
+
+	/*
+	 * For types merging notifications into the cached object, the
+	 * latest notification may only carry part of the attributes.
+	 * Report the cached object instead.
+	 */
+	if (pe->pe_exists)
+		cur = nl_cache_search(ca->ca_cache, pe->pe_cur);
+	if (!cur) {
+		nl_object_get(pe->pe_cur);
+		cur = pe->pe_cur;
+	}
+
+	if (!pe->pe_old && pe->pe_exists)
+		pending_deliver(ca, NULL, cur, 0, NL_ACT_NEW);
+	else if (pe->pe_old && !pe->pe_exists)
+		pending_deliver(ca, cur, NULL, 0, NL_ACT_DEL);
+	else if (pe->pe_old && pe->pe_diff)
+		pending_deliver(ca, pe->pe_old, cur, pe->pe_diff,
+				NL_ACT_CHANGE);
+	else
+		n = 0;
+
+	nl_object_put(cur);
+
+	return n;
+}
+
+/* Delivers the coalesced events and starts a new window */
+static int pending_flush(struct nl_cache_assoc *ca, int deliver)
+{
+	struct nl_pending_event *pe;
+	unsigned int i;
+	int n = 0;
+
+	for (i = 0; i < ca->ca_npending; i++) {
+		pe = &ca->ca_pending[i];
+
+		if (deliver)
+			n += pending_report(ca, pe);
+
+		nl_object_put(pe->pe_old);
+		nl_object_put(pe->pe_cur);
+	}
+
+	if (ca->ca_npending)
+		memset(ca->ca_pending_idx, 0,
+		       ca->ca_pending_nslots * sizeof(*ca->ca_pending_idx));
+	ca->ca_npending = 0;
+	ca->ca_nevents = 0;
+
+	return n;
+}
+
+/*
+ * Change callback used while coalescing. Records the state of the object
+ * before the window and its latest state, which is only used to find
+ * the cached object and compute differences.
+ */
+static void coalesce_cb(struct nl_cache *cache, struct nl_object *old,
+			struct nl_object *new, uint64_t diff, int action,
+			void *data)
+{
+	struct nl_cache_assoc *ca = data;
+	struct nl_object *obj = new ? new : old;
+	struct nl_pending_event *pe;
+	uint32_t hash;
+
+	if (!ca->ca_nevents++)
+		ca->ca_window_start = mngr_now();
+
+	nl_object_keygen(obj, &hash, UINT32_MAX);
+
+	if (!(pe = pending_lookup(ca, obj, hash))) {
+		if (!(pe = pending_add(ca, hash))) {
+			pending_deliver(ca, old, new, diff, action);
+			return;
+		}
+
+		if (action != NL_ACT_NEW) {
+			nl_object_get(old);
+			pe->pe_old = old;
+		}
+		pe->pe_diff = diff;
+	} else if (action == NL_ACT_NEW && pe->pe_old) {
+		/* Deleted and added again within the window */
+		pe->pe_diff |= nl_object_diff64(pe->pe_old, new);
+	} else
+		pe->pe_diff |= diff;
+
+	nl_object_get(obj);
+	nl_object_put(pe->pe_cur);
+	pe->pe_cur = obj;
+	pe->pe_exists = (action != NL_ACT_DEL);
+}
+
+static int mngr_timeout(struct nl_cache_mngr *mngr, uint64_t now)
+{
+	struct nl_cache_assoc *ca;
+	int i, timeout = -1;
+	uint64_t end;
+
+	for (i = 0; i < mngr->cm_nassocs; i++) {
+		ca = &mngr->cm_assocs[i];
+		if (!ca->ca_cache || !ca->ca_window || !ca->ca_nevents)
+			continue;
+
+		end = ca->ca_window_start + ca->ca_window;
+		if (end <= now)
+			return 0;
+
+		if (timeout < 0 || end - now < (uint64_t) timeout)
+			timeout = end - now;
+	}
+
+	return timeout;
+}
+
+static void mngr_flush_expired(struct nl_cache_mngr *mngr)
+{
+	struct nl_cache_assoc *ca;
+	uint64_t now = 0;
+	int i;
+
+	for (i = 0; i < mngr->cm_nassocs; i++) {
+		ca = &mngr->cm_assocs[i];
+		if (!ca->ca_cache || !ca->ca_window || !ca->ca_nevents)
+			continue;
+
+		if (!now)
+			now = mngr_now();
+
+		if (ca->ca_window_start + ca->ca_window <= now)
+			pending_flush(ca, 1);
+	}
+}
+
+/* Change callbacks to use, events are collected while coalescing */
+static void assoc_callbacks(struct nl_cache_assoc *ca, change_func_t *cb,
+			    change_func_v2_t *cb_v2, void **data)
+{
+	if (assoc_coalescing(ca)) {
+		*cb = NULL;
+		*cb_v2 = coalesce_cb;
+		*data = ca;
+	} else {
+		*cb = ca->ca_change;
+		*cb_v2 = ca->ca_change_v2;
+		*data = ca->ca_change_data;
+	}
+}
+
+static void pending_check(struct nl_cache_assoc *ca)
+{
+	if (ca->ca_max_events && ca->ca_nevents >= ca->ca_max_events)
+		pending_flush(ca, 1);
+}
+
 static int include_cb(struct nl_object *obj, struct nl_parser_param *p)
 {
 	struct nl_cache_assoc *ca = p->pp_arg;
 	struct nl_cache_ops *ops = ca->ca_cache->c_ops;
+	change_func_t cb;
+	change_func_v2_t cb_v2;
+	void *data;
+	int err;
 
 	NL_DBG(2, "Including object %p into cache %p\n", obj, ca->ca_cache);
 #ifdef NL_DEBUG
@@ -59,30 +376,146 @@ static int include_cb(struct nl_object *obj, struct nl_parser_param *p)
 		if (ops->co_event_filter(ca->ca_cache, obj) != NL_OK)
 			return 0;
 
+	if (ca->ca_cache->c_dump_filter &&
+	    !nl_object_match_filter(obj, ca->ca_cache->c_dump_filter))
+		return 0;
+
+	assoc_callbacks(ca, &cb, &cb_v2, &data);
+
 	if (ops->co_include_event)
-		return ops->co_include_event(ca->ca_cache, obj, ca->ca_change,
-					     ca->ca_change_v2,
-					     ca->ca_change_data);
+		err = ops->co_include_event(ca->ca_cache, obj, cb, cb_v2, data);
 	else {
-		if (ca->ca_change_v2)
-			return nl_cache_include_v2(ca->ca_cache, obj, ca->ca_change_v2, ca->ca_change_data);
+		if (cb_v2)
+			err = nl_cache_include_v2(ca->ca_cache, obj, cb_v2, data);
 		else
-			return nl_cache_include(ca->ca_cache, obj, ca->ca_change, ca->ca_change_data);
+			err = nl_cache_include(ca->ca_cache, obj, cb, data);
 	}
 
+	pending_check(ca);
+
+	return err;
 }
 
-static int event_input(struct nl_msg *msg, void *arg)
+/* Doubles the receive buffer of the event socket up to RCVBUF_MAX */
+static void mngr_grow_rcvbuf(struct nl_cache_mngr *mngr)
 {
-	struct nl_cache_mngr *mngr = arg;
-	int protocol = nlmsg_get_proto(msg);
-	int type = nlmsg_hdr(msg)->nlmsg_type;
+	int fd = nl_socket_get_fd(mngr->cm_sock);
+	socklen_t len = sizeof(int);
+	int size;
+
+	/* The kernel reports twice the size set, i.e. the doubled size */
+	if (getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len) < 0 ||
+	    size / 2 >= RCVBUF_MAX)
+		return;
+
+	size = min(size, RCVBUF_MAX);
+
+	/* SO_RCVBUFFORCE ignores rmem_max but requires CAP_NET_ADMIN */
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0 &&
+	    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0) {
+		NL_DBG(2, "Cache manager %p, unable to grow receive buffer: %s\n",
+		       mngr, nl_strerror_l(errno));
+		return;
+	}
+
+	NL_DBG(1, "Cache manager %p, receive buffer grown to %d bytes\n",
+	       mngr, size);
+}
+
+/*
+ * Checks whether err reports notifications dropped because the event
+ * socket ran out of buffer space, and enlarges the buffer if so.
+ */
+static int mngr_check_overrun(struct nl_cache_mngr *mngr, int err)
+{
+	if (err != -NLE_NOMEM || !(mngr->cm_sock->s_flags & NL_SOCK_OVERRUN))
+		return 0;
+
+	mngr->cm_sock->s_flags &= ~NL_SOCK_OVERRUN;
+	mngr_grow_rcvbuf(mngr);
+
+	return 1;
+}
+
+/*
+ * After an overrun the caches can no longer be trusted, so they are
+ * resynced with a full dump, reporting the differences to the change
+ * callbacks.
+ */
+static int mngr_resync(struct nl_cache_mngr *mngr)
+{
+	struct nl_cache_assoc *ca;
+	change_func_t cb;
+	change_func_v2_t cb_v2;
+	void *data;
+	int i, err;
+
+	mngr->cm_noverruns++;
+
+	NL_DBG(1, "Cache manager %p, event socket overrun, resyncing caches\n",
+	       mngr);
+
+	for (i = 0; i < mngr->cm_nassocs; i++) {
+		ca = &mngr->cm_assocs[i];
+		if (!ca->ca_cache)
+			continue;
+
+		assoc_callbacks(ca, &cb, &cb_v2, &data);
+		err = __nl_cache_resync(mngr->cm_sync_sock, ca->ca_cache,
+					cb, cb_v2, data);
+		if (err < 0)
+			return err;
+
+		pending_check(ca);
+	}
+
+	return 0;
+}
+
+/* Returns the index of the cache for messages of this type or -1 */
+static int mngr_associate(struct nl_cache_mngr *mngr, int type)
+{
+	struct nl_msgtype_map_entry *e;
 	struct nl_cache_ops *ops;
 	int i, n;
+
+	if (mngr->cm_dispatch.mm_nslots &&
+	    (e = _nl_msgtype_map_lookup(&mngr->cm_dispatch,
+					mngr->cm_protocol, type)))
+		return e->me_index;
+
+	/* Resolving a generic netlink family id changes its type */
+	for (i = 0; i < mngr->cm_nassocs; i++) {
+		if (mngr->cm_assocs[i].ca_cache) {
+			ops = mngr->cm_assocs[i].ca_cache->c_ops;
+			for (n = 0; ops->co_msgtypes[n].mt_id >= 0; n++)
+				if (ops->co_msgtypes[n].mt_id == type)
+					return i;
+		}
+	}
+
+	return -1;
+}
+
+static int mngr_include_msg(struct nl_cache_mngr *mngr, int i,
+			    struct nl_msg *msg)
+{
+	struct nl_cache_assoc *ca = &mngr->cm_assocs[i];
 	struct nl_parser_param p = {
 		.pp_cb = include_cb,
+		.pp_arg = ca,
 	};
 
+	NL_DBG(2, "Associated message %p to cache %p\n", msg, ca->ca_cache);
+
+	return nl_cache_parse(ca->ca_cache->c_ops, NULL, nlmsg_hdr(msg), &p);
+}
+
+static int event_input(struct nl_msg *msg, void *arg)
+{
+	struct nl_cache_mngr *mngr = arg;
+	int i;
+
 	NL_DBG(2, "Cache manager %p, handling new message %p as event\n",
 	       mngr, msg);
 #ifdef NL_DEBUG
@@ -90,26 +523,299 @@ static int event_input(struct nl_msg *msg, void *arg)
 		nl_msg_dump(msg, stderr);
 #endif
 
-	if (mngr->cm_protocol != protocol)
+	if (mngr->cm_protocol != nlmsg_get_proto(msg))
 		BUG();
 
-	for (i = 0; i < mngr->cm_nassocs; i++) {
-		if (mngr->cm_assocs[i].ca_cache) {
-			ops = mngr->cm_assocs[i].ca_cache->c_ops;
-			for (n = 0; ops->co_msgtypes[n].mt_id >= 0; n++)
-				if (ops->co_msgtypes[n].mt_id == type)
-					goto found;
+	if ((i = mngr_associate(mngr, nlmsg_hdr(msg)->nlmsg_type)) < 0)
+		return NL_SKIP;
+
+	return mngr_include_msg(mngr, i, msg);
+}
+
+#ifndef DISABLE_PTHREADS
+static void mngr_wake(int fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, sizeof(one)) < 0)
+		NL_DBG(4, "Cache manager, eventfd write failed: %s\n",
+		       nl_strerror_l(errno));
+}
+
+static void mngr_wake_clear(int fd)
+{
+	uint64_t cnt;
+
+	if (read(fd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN)
+		NL_DBG(4, "Cache manager, eventfd read failed: %s\n",
+		       nl_strerror_l(errno));
+}
+
+/*
+ * Called by the manager thread, waits for room in the ring if the
+ * application falls behind. Fails with -NLE_INTR if the thread is
+ * being aborted.
+ */
+static int ring_push(struct nl_mngr_thread *t, struct nl_msg *msg,
+		     int assoc, int err)
+{
+	struct nl_mngr_event *ev;
+	struct pollfd fds = {
+		.fd = t->t_wake_fd,
+		.events = POLLIN,
+	};
+	unsigned int tail;
+
+	tail = __atomic_load_n(&t->t_tail, __ATOMIC_ACQUIRE);
+	while (t->t_head - tail == t->t_size) {
+		/* Let the application see what is there before sleeping */
+		mngr_wake(t->t_event_fd);
+
+		__atomic_store_n(&t->t_waiting, 1, __ATOMIC_SEQ_CST);
+		tail = __atomic_load_n(&t->t_tail, __ATOMIC_SEQ_CST);
+		if (t->t_head - tail == t->t_size &&
+		    __atomic_load_n(&t->t_stop, __ATOMIC_ACQUIRE) !=
+		    MNGR_STOP_ABORT) {
+			if (poll(&fds, 1, -1) > 0)
+				mngr_wake_clear(t->t_wake_fd);
+		}
+		__atomic_store_n(&t->t_waiting, 0, __ATOMIC_RELAXED);
+
+		if (__atomic_load_n(&t->t_stop, __ATOMIC_ACQUIRE) ==
+		    MNGR_STOP_ABORT)
+			return -NLE_INTR;
+
+		tail = __atomic_load_n(&t->t_tail, __ATOMIC_ACQUIRE);
+	}
+
+	ev = &t->t_ring[t->t_head & (t->t_size - 1)];
+	ev->ev_msg = msg;
+	ev->ev_assoc = assoc;
+	ev->ev_err = err;
+	__atomic_store_n(&t->t_head, t->t_head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* Called by the application */
+static int ring_pop(struct nl_mngr_thread *t, struct nl_mngr_event *ev)
+{
+	unsigned int head;
+
+	head = __atomic_load_n(&t->t_head, __ATOMIC_ACQUIRE);
+	if (t->t_tail == head)
+		return 0;
+
+	*ev = t->t_ring[t->t_tail & (t->t_size - 1)];
+	__atomic_store_n(&t->t_tail, t->t_tail + 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&t->t_waiting, __ATOMIC_SEQ_CST))
+		mngr_wake(t->t_wake_fd);
+
+	return 1;
+}
+
+/*
+ * Runs in the manager thread. Messages are copied so the application
+ * owns them exclusively, parsing is left to the application since
+ * parsers may look up objects in caches it modifies.
+ */
+static int thread_input(struct nl_msg *msg, void *arg)
+{
+	struct nl_cache_mngr *mngr = arg;
+	struct nl_msg *copy;
+	int i;
+
+	if (mngr->cm_protocol != nlmsg_get_proto(msg))
+		BUG();
+
+	if ((i = mngr_associate(mngr, nlmsg_hdr(msg)->nlmsg_type)) < 0)
+		return NL_SKIP;
+
+	/* Caches can only recover from a lost message by a resync */
+	if (!(copy = nlmsg_convert(nlmsg_hdr(msg)))) {
+		mngr->cm_thread->t_lost = 1;
+		return NL_STOP;
+	}
+
+	if (ring_push(mngr->cm_thread, copy, i, 0) < 0) {
+		nlmsg_free(copy);
+		return NL_STOP;
+	}
+
+	return NL_OK;
+}
+
+static void *mngr_thread(void *arg)
+{
+	struct nl_cache_mngr *mngr = arg;
+	struct nl_mngr_thread *t = mngr->cm_thread;
+	struct pollfd fds[2] = {
+		{ .fd = nl_socket_get_fd(mngr->cm_sock), .events = POLLIN },
+		{ .fd = t->t_wake_fd, .events = POLLIN },
+	};
+	int err = 0, overrun, paused;
+
+	NL_DBG(1, "Cache manager %p, thread started\n", mngr);
+
+	while (!__atomic_load_n(&t->t_stop, __ATOMIC_ACQUIRE)) {
+		/*
+		 * The socket is left alone while paused, the application
+		 * discards what is queued on it before resyncing.
+		 */
+		paused = __atomic_load_n(&t->t_paused, __ATOMIC_ACQUIRE);
+		if (poll(paused ? &fds[1] : fds, paused ? 1 : 2, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			__atomic_store_n(&t->t_err, -nl_syserr2nlerr(errno),
+					 __ATOMIC_RELAXED);
+			NL_DBG(1, "Cache manager %p, thread failed: %s\n",
+			       mngr, nl_strerror_l(errno));
+			break;
 		}
+
+		if (fds[1].revents)
+			mngr_wake_clear(t->t_wake_fd);
+
+		if (paused)
+			continue;
+
+		while (!__atomic_load_n(&t->t_stop, __ATOMIC_ACQUIRE) &&
+		       !t->t_lost &&
+		       (err = nl_recvmsgs_report(mngr->cm_sock, t->t_cb)) > 0)
+			mngr_wake(t->t_event_fd);
+
+		if (__atomic_load_n(&t->t_stop, __ATOMIC_ACQUIRE))
+			break;
+
+		overrun = mngr_check_overrun(mngr, err);
+		if (overrun || t->t_lost) {
+			t->t_lost = 0;
+			__atomic_store_n(&t->t_paused, 1, __ATOMIC_RELEASE);
+			err = ring_push(t, NULL, MNGR_EV_OVERRUN, 0);
+		} else if (err < 0 && err != -NLE_AGAIN)
+			err = ring_push(t, NULL, 0, err);
+		else
+			continue;
+
+		if (err == 0)
+			mngr_wake(t->t_event_fd);
+	}
+
+	NL_DBG(1, "Cache manager %p, thread stopped\n", mngr);
+
+	__atomic_store_n(&t->t_done, 1, __ATOMIC_RELEASE);
+	mngr_wake(t->t_event_fd);
+
+	return NULL;
+}
+
+/* Processes the messages queued by the manager thread */
+static int mngr_consume(struct nl_cache_mngr *mngr)
+{
+	struct nl_mngr_thread *t = mngr->cm_thread;
+	struct nl_mngr_event ev;
+	int err = 0, failed = 0, n = 0;
+
+	/* Anything queued from now on signals again */
+	mngr_wake_clear(t->t_event_fd);
+
+	while (ring_pop(t, &ev)) {
+		if (ev.ev_msg) {
+			err = mngr_include_msg(mngr, ev.ev_assoc, ev.ev_msg);
+			nlmsg_free(ev.ev_msg);
+			n++;
+		} else if (ev.ev_assoc == MNGR_EV_OVERRUN) {
+			/*
+			 * The thread stopped reading at the overrun, what
+			 * is still queued on the socket predates the dump.
+			 */
+			_nl_socket_discard(mngr->cm_sock);
+			err = mngr_resync(mngr);
+			__atomic_store_n(&t->t_paused, 0, __ATOMIC_RELEASE);
+			mngr_wake(t->t_wake_fd);
+		} else
+			err = ev.ev_err;
+
+		if (err < 0)
+			break;
 	}
 
-	return NL_SKIP;
+	/* A failed thread is reported until it is stopped */
+	if (__atomic_load_n(&t->t_done, __ATOMIC_ACQUIRE))
+		failed = __atomic_load_n(&t->t_err, __ATOMIC_RELAXED);
+	if (err >= 0)
+		err = failed;
+
+	/* Keep the descriptor readable for what is left */
+	if (err < 0 && (failed || t->t_tail !=
+			__atomic_load_n(&t->t_head, __ATOMIC_ACQUIRE)))
+		mngr_wake(t->t_event_fd);
 
-found:
-	NL_DBG(2, "Associated message %p to cache %p\n",
-	       msg, mngr->cm_assocs[i].ca_cache);
-	p.pp_arg = &mngr->cm_assocs[i];
+	mngr_flush_expired(mngr);
 
-	return nl_cache_parse(ops, NULL, nlmsg_hdr(msg), &p);
+	return err < 0 ? err : n;
+}
+
+static void mngr_thread_free(struct nl_cache_mngr *mngr, int deliver)
+{
+	struct nl_mngr_thread *t = mngr->cm_thread;
+	struct nl_mngr_event ev;
+	struct pollfd fds = {
+		.fd = t->t_event_fd,
+		.events = POLLIN,
+	};
+
+	__atomic_store_n(&t->t_stop, deliver ? MNGR_STOP_DRAIN
+					     : MNGR_STOP_ABORT,
+			 __ATOMIC_RELEASE);
+	mngr_wake(t->t_wake_fd);
+
+	/* The thread may be waiting for room to queue what it has read */
+	while (deliver && !__atomic_load_n(&t->t_done, __ATOMIC_ACQUIRE)) {
+		if (poll(&fds, 1, -1) > 0)
+			mngr_consume(mngr);
+	}
+
+	pthread_join(t->t_thread, NULL);
+
+	if (deliver)
+		mngr_consume(mngr);
+
+	while (ring_pop(t, &ev))
+		nlmsg_free(ev.ev_msg);
+
+	close(t->t_event_fd);
+	close(t->t_wake_fd);
+	nl_cb_put(t->t_cb);
+	free(t->t_ring);
+	free(t);
+	mngr->cm_thread = NULL;
+}
+#endif
+
+/*
+ * Maps message types to the managed caches, so events are dispatched
+ * without scanning the caches. Caches added first take precedence.
+ */
+static void mngr_dispatch_rebuild(struct nl_cache_mngr *mngr)
+{
+	struct nl_cache *cache;
+	int i;
+
+	_nl_msgtype_map_clear(&mngr->cm_dispatch);
+
+	for (i = 0; i < mngr->cm_nassocs; i++) {
+		if (!(cache = mngr->cm_assocs[i].ca_cache))
+			continue;
+
+		if (_nl_msgtype_map_add(&mngr->cm_dispatch, cache->c_ops,
+					i) < 0) {
+			/* event_input() scans the caches without a map */
+			_nl_msgtype_map_clear(&mngr->cm_dispatch);
+			return;
+		}
+	}
 }
 
 /**
@@ -307,6 +1013,9 @@ int nl_cache_mngr_add_cache(struct nl_cache_mngr *mngr, struct nl_cache *cache,
 	if (ops->co_groups == NULL)
 		return -NLE_OPNOTSUPP;
 
+	if (mngr->cm_thread)
+		return -NLE_BUSY;
+
 	for (i = 0; i < mngr->cm_nassocs; i++)
 		if (mngr->cm_assocs[i].ca_cache &&
 		    mngr->cm_assocs[i].ca_cache->c_ops == ops)
@@ -347,6 +1056,7 @@ int nl_cache_mngr_add_cache(struct nl_cache_mngr *mngr, struct nl_cache *cache,
 	mngr->cm_assocs[i].ca_cache = cache;
 	mngr->cm_assocs[i].ca_change = cb;
 	mngr->cm_assocs[i].ca_change_data = data;
+	mngr_dispatch_rebuild(mngr);
 
 	if (mngr->cm_flags & NL_AUTO_PROVIDE)
 		nl_cache_mngt_provide(cache);
@@ -398,6 +1108,67 @@ int nl_cache_mngr_add_cache_v2(struct nl_cache_mngr *mngr, struct nl_cache *cach
 	return nl_cache_mngr_set_change_func_v2(mngr, cache, cb, data);
 }
 
+/**
+ * Coalesce change events of a managed cache
+ * @arg mngr		Cache manager.
+ * @arg cache		Cache registered with the manager
+ * @arg window		Maximum time in milliseconds events are held back
+ * @arg max_events	Maximum number of notifications held back
+ *
+ * Instead of calling the change callback for every notification, the
+ * manager keeps the cache up to date but collects the changes and
+ * reports them once \c window milliseconds have passed since the first
+ * notification or \c max_events notifications have been received,
+ * whichever comes first. A limit of 0 is disabled, setting both to 0
+ * disables coalescing and delivers pending events.
+ *
+ * Each object changed in the window is reported once:
+ * - created objects as NL_ACT_NEW with their latest state,
+ * - changed objects as NL_ACT_CHANGE, to change_func_v2 with the state
+ *   before the window and the union of all attribute differences,
+ * - deleted objects as NL_ACT_DEL.
+ *
+ * Objects created and deleted within the same window are not reported.
+ *
+ * Pending events are indexed by the hash key of their object, so only
+ * caches of object types providing a hash key can coalesce events.
+ *
+ * nl_cache_mngr_poll() wakes up when a window expires. Applications
+ * with their own event loop use nl_cache_mngr_get_timeout() and call
+ * nl_cache_mngr_data_ready() when it expires.
+ *
+ * @see nl_cache_mngr_flush()
+ *
+ * @return 0 on success or a negative error code.
+ * @return -NLE_RANGE Cache is not registered
+ * @return -NLE_OPNOTSUPP Objects of the cache do not provide a hash key
+ */
+int nl_cache_mngr_set_coalesce(struct nl_cache_mngr *mngr,
+			       struct nl_cache *cache, unsigned int window,
+			       unsigned int max_events)
+{
+	struct nl_cache_assoc *ca;
+	int i;
+
+	for (i = 0; i < mngr->cm_nassocs; i++)
+		if (mngr->cm_assocs[i].ca_cache == cache)
+			break;
+
+	if (i >= mngr->cm_nassocs)
+		return -NLE_RANGE;
+
+	ca = &mngr->cm_assocs[i];
+	if (!window && !max_events)
+		pending_flush(ca, 1);
+	else if (!cache->c_ops->co_obj_ops->oo_keygen)
+		return -NLE_OPNOTSUPP;
+
+	ca->ca_window = window;
+	ca->ca_max_events = max_events;
+
+	return 0;
+}
+
 /**
  * Add cache to cache manager
  * @arg mngr		Cache manager.
@@ -470,6 +1241,11 @@ errout_free_cache:
  */
 int nl_cache_mngr_get_fd(struct nl_cache_mngr *mngr)
 {
+#ifndef DISABLE_PTHREADS
+	if (mngr->cm_thread)
+		return mngr->cm_thread->t_event_fd;
+#endif
+
 	return nl_socket_get_fd(mngr->cm_sock);
 }
 
@@ -494,12 +1270,17 @@ int nl_cache_mngr_get_fd(struct nl_cache_mngr *mngr)
  */
 int nl_cache_mngr_poll(struct nl_cache_mngr *mngr, int timeout)
 {
-	int ret;
+	int ret, pending;
 	struct pollfd fds = {
-		.fd = nl_socket_get_fd(mngr->cm_sock),
+		.fd = nl_cache_mngr_get_fd(mngr),
 		.events = POLLIN,
 	};
 
+	/* Wake up in time to deliver coalesced events */
+	pending = nl_cache_mngr_get_timeout(mngr);
+	if (pending >= 0 && (timeout < 0 || pending < timeout))
+		timeout = pending;
+
 	NL_DBG(3, "Cache manager %p, poll() fd %d\n", mngr, fds.fd);
 	ret = poll(&fds, 1, timeout);
 	NL_DBG(3, "Cache manager %p, poll() returned %d\n", mngr, ret);
@@ -510,8 +1291,10 @@ int nl_cache_mngr_poll(struct nl_cache_mngr *mngr, int timeout)
 	}
 
 	/* No events, return */
-	if (ret == 0)
+	if (ret == 0) {
+		mngr_flush_expired(mngr);
 		return 0;
+	}
 
 	return nl_cache_mngr_data_ready(mngr);
 }
@@ -527,6 +1310,12 @@ int nl_cache_mngr_poll(struct nl_cache_mngr *mngr, int timeout)
  * The function will process messages until there is no more data to
  * be read from the socket.
  *
+ * If notifications were lost because the socket ran out of receive
+ * buffer space, the receive buffer is enlarged and all managed caches
+ * are resynced, calling the change callbacks for the differences found.
+ * Notifications queued at that point are discarded, the resync covers
+ * them.
+ *
  * @see nl_cache_mngr_poll()
  *
  * @return The number of messages processed or a negative error code.
@@ -536,6 +1325,11 @@ int nl_cache_mngr_data_ready(struct nl_cache_mngr *mngr)
 	int err, nread = 0;
 	struct nl_cb *cb;
 
+#ifndef DISABLE_PTHREADS
+	if (mngr->cm_thread)
+		return mngr_consume(mngr);
+#endif
+
 	NL_DBG(2, "Cache manager %p, reading new data from fd %d\n",
 	       mngr, nl_socket_get_fd(mngr->cm_sock));
 
@@ -545,19 +1339,182 @@ int nl_cache_mngr_data_ready(struct nl_cache_mngr *mngr)
 
 	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, event_input, mngr);
 
+restart:
 	while ((err = nl_recvmsgs_report(mngr->cm_sock, cb)) > 0) {
 		NL_DBG(2, "Cache manager %p, recvmsgs read %d messages\n",
 		       mngr, err);
 		nread += err;
 	}
 
+	if (mngr_check_overrun(mngr, err)) {
+		/*
+		 * Notifications still queued were sent before the dump
+		 * and would be applied on top of the resynced caches.
+		 */
+		_nl_socket_discard(mngr->cm_sock);
+		if ((err = mngr_resync(mngr)) == 0)
+			goto restart;
+	}
+
 	nl_cb_put(cb);
+	mngr_flush_expired(mngr);
 	if (err < 0 && err != -NLE_AGAIN)
 		return err;
 
 	return nread;
 }
 
+/**
+ * Time until coalesced events are due
+ * @arg mngr		Cache manager
+ *
+ * Applications monitoring the socket of a manager with coalescing
+ * caches should wait at most this long and then call
+ * nl_cache_mngr_data_ready() to have the pending events delivered.
+ *
+ * @see nl_cache_mngr_set_coalesce()
+ *
+ * @return Timeout in milliseconds, 0 if events are due or -1 if no
+ *	   events are pending.
+ */
+int nl_cache_mngr_get_timeout(struct nl_cache_mngr *mngr)
+{
+	return mngr_timeout(mngr, mngr_now());
+}
+
+/**
+ * Deliver coalesced events
+ * @arg mngr		Cache manager
+ *
+ * Calls the change callbacks for all events collected so far by caches
+ * with coalescing enabled, regardless of their window.
+ *
+ * @see nl_cache_mngr_set_coalesce()
+ *
+ * @return The number of events delivered.
+ */
+int nl_cache_mngr_flush(struct nl_cache_mngr *mngr)
+{
+	int i, n = 0;
+
+	for (i = 0; i < mngr->cm_nassocs; i++)
+		if (mngr->cm_assocs[i].ca_cache)
+			n += pending_flush(&mngr->cm_assocs[i], 1);
+
+	return n;
+}
+
+/**
+ * Receive event notifications in a separate thread
+ * @arg mngr		Cache manager
+ * @arg size		Maximum number of queued messages, 0 for a default
+ *			(rounded up to a power of two, at most 2^20)
+ *
+ * Starts a thread which reads the notifications from the socket as fast
+ * as possible and queues them for the application, so a slow change
+ * callback does not cause the kernel to drop notifications. The caches
+ * are still only updated, and the change callbacks only called, by
+ * the thread of the application from nl_cache_mngr_data_ready() or
+ * nl_cache_mngr_poll().
+ *
+ * nl_cache_mngr_get_fd() returns a descriptor which becomes readable
+ * when messages are queued. If the queue is full, the thread stops
+ * reading until the application catches up.
+ *
+ * If notifications are lost, the thread stops reading until the
+ * application has resynced the caches as described for
+ * nl_cache_mngr_data_ready(). If the thread fails, every subsequent
+ * call of nl_cache_mngr_data_ready() returns the error. Stopping the
+ * thread makes the manager read from its socket again.
+ *
+ * No caches can be added to the manager while the thread is running.
+ *
+ * @see nl_cache_mngr_stop_thread()
+ *
+ * @return 0 on success or a negative error code.
+ * @return -NLE_EXIST Thread is already running
+ * @return -NLE_INVAL Queue size is too large
+ * @return -NLE_OPNOTSUPP Library was built without thread support
+ */
+int nl_cache_mngr_start_thread(struct nl_cache_mngr *mngr, unsigned int size)
+{
+#ifndef DISABLE_PTHREADS
+	struct nl_mngr_thread *t;
+	unsigned int n;
+	int err = -NLE_NOMEM;
+
+	if (mngr->cm_thread)
+		return -NLE_EXIST;
+
+	if (!size)
+		size = NRING_DEFAULT;
+	else if (size > NRING_MAX)
+		return -NLE_INVAL;
+	for (n = 1; n < size; n <<= 1)
+		;
+
+	if (!(t = calloc(1, sizeof(*t))))
+		return -NLE_NOMEM;
+
+	t->t_size = n;
+	t->t_event_fd = t->t_wake_fd = -1;
+
+	if (!(t->t_ring = calloc(n, sizeof(*t->t_ring))))
+		goto errout;
+
+	if (!(t->t_cb = nl_cb_clone(mngr->cm_sock->s_cb)))
+		goto errout;
+	nl_cb_set(t->t_cb, NL_CB_VALID, NL_CB_CUSTOM, thread_input, mngr);
+
+	t->t_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	t->t_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (t->t_event_fd < 0 || t->t_wake_fd < 0) {
+		err = -nl_syserr2nlerr(errno);
+		goto errout;
+	}
+
+	mngr->cm_thread = t;
+	if ((err = pthread_create(&t->t_thread, NULL, mngr_thread, mngr))) {
+		mngr->cm_thread = NULL;
+		err = -nl_syserr2nlerr(err);
+		goto errout;
+	}
+
+	return 0;
+
+errout:
+	if (t->t_event_fd >= 0)
+		close(t->t_event_fd);
+	if (t->t_wake_fd >= 0)
+		close(t->t_wake_fd);
+	if (t->t_cb)
+		nl_cb_put(t->t_cb);
+	free(t->t_ring);
+	free(t);
+
+	return err;
+#else
+	return -NLE_OPNOTSUPP;
+#endif
+}
+
+/**
+ * Stop receiving event notifications in a separate thread
+ * @arg mngr		Cache manager
+ *
+ * Stops the thread started with nl_cache_mngr_start_thread(). Messages
+ * already read by the thread are processed before returning, calling
+ * the change callbacks. Afterwards, the manager reads from its socket
+ * again.
+ */
+void nl_cache_mngr_stop_thread(struct nl_cache_mngr *mngr)
+{
+#ifndef DISABLE_PTHREADS
+	if (mngr->cm_thread)
+		mngr_thread_free(mngr, 1);
+#endif
+}
+
 /**
  * Print information about cache manager
  * @arg mngr		Cache manager
@@ -578,6 +1535,8 @@ void nl_cache_mngr_info(struct nl_cache_mngr *mngr, struct nl_dump_params *p)
 	nl_dump_line(p, "  .flags    = %#x\n", mngr->cm_flags);
 	nl_dump_line(p, "  .nassocs  = %u\n", mngr->cm_nassocs);
 	nl_dump_line(p, "  .sock     = <%p>\n", mngr->cm_sock);
+	nl_dump_line(p, "  .overruns = %u\n", mngr->cm_noverruns);
+	nl_dump_line(p, "  .threaded = %s\n", mngr->cm_thread ? "yes" : "no");
 
 	for (i = 0; i < mngr->cm_nassocs; i++) {
 		struct nl_cache_assoc *assoc = &mngr->cm_assocs[i];
@@ -587,6 +1546,10 @@ void nl_cache_mngr_info(struct nl_cache_mngr *mngr, struct nl_dump_params *p)
 			nl_dump_line(p, "    .name = %s\n", assoc->ca_cache->c_ops->co_name);
 			nl_dump_line(p, "    .change_func = <%p>\n", assoc->ca_change);
 			nl_dump_line(p, "    .change_data = <%p>\n", assoc->ca_change_data);
+			if (assoc_coalescing(assoc))
+				nl_dump_line(p, "    .coalesce = %ums, %u events, %u pending\n",
+					     assoc->ca_window, assoc->ca_max_events,
+					     assoc->ca_npending);
 			nl_dump_line(p, "    .nitems = %u\n", nl_cache_nitems(assoc->ca_cache));
 			nl_dump_line(p, "    .objects = {\n");
 
@@ -613,6 +1576,11 @@ void nl_cache_mngr_free(struct nl_cache_mngr *mngr)
 	if (!mngr)
 		return;
 
+#ifndef DISABLE_PTHREADS
+	if (mngr->cm_thread)
+		mngr_thread_free(mngr, 0);
+#endif
+
 	if (mngr->cm_sock)
 		nl_close(mngr->cm_sock);
 
@@ -626,12 +1594,16 @@ void nl_cache_mngr_free(struct nl_cache_mngr *mngr)
 
 	for (i = 0; i < mngr->cm_nassocs; i++) {
 		if (mngr->cm_assocs[i].ca_cache) {
+			pending_flush(&mngr->cm_assocs[i], 0);
 			nl_cache_mngt_unprovide(mngr->cm_assocs[i].ca_cache);
 			nl_cache_free(mngr->cm_assocs[i].ca_cache);
 		}
+		free(mngr->cm_assocs[i].ca_pending);
+		free(mngr->cm_assocs[i].ca_pending_idx);
 	}
 
 	free(mngr->cm_assocs);
+	_nl_msgtype_map_clear(&mngr->cm_dispatch);
 
 	NL_DBG(1, "Cache manager %p freed\n", mngr);
 
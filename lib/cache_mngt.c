@@ -27,13 +27,113 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/hash.h>
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
 #include <netlink/utils.h>
 
 static struct nl_cache_ops *cache_ops;
+static struct nl_msgtype_map cache_ops_map;
 static NL_RW_LOCK(cache_ops_lock);
 
+/** @cond SKIP */
+#define MSGTYPE_MAP_MIN		16
+
+static inline uint32_t msgtype_map_key(int protocol, int msgtype)
+{
+	return ((uint32_t) protocol << 16) | (msgtype & 0xffff);
+}
+
+static struct nl_msgtype_map_entry *
+msgtype_map_slot(struct nl_msgtype_map_entry *slots, unsigned int nslots,
+		 uint32_t key)
+{
+	struct nl_hasher h;
+	unsigned int slot, mask = nslots - 1;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, key);
+
+	for (slot = nl_hasher_final(&h) & mask; slots[slot].me_ops;
+	     slot = (slot + 1) & mask)
+		if (slots[slot].me_key == key)
+			break;
+
+	return &slots[slot];
+}
+
+/*
+ * Maps the message types of ops to ops and index. Message types already
+ * mapped keep their association, so the first ops added wins.
+ */
+int _nl_msgtype_map_add(struct nl_msgtype_map *map, struct nl_cache_ops *ops,
+			int index)
+{
+	struct nl_msgtype_map_entry *slots, *e;
+	unsigned int i, n, nslots;
+
+	for (n = 0; ops->co_msgtypes[n].mt_id >= 0; n++)
+		;
+
+	/* Keep the table at most half full */
+	if ((map->mm_nentries + n) * 2 > map->mm_nslots) {
+		nslots = map->mm_nslots ? map->mm_nslots : MSGTYPE_MAP_MIN;
+		while ((map->mm_nentries + n) * 2 > nslots)
+			nslots *= 2;
+
+		if (!(slots = calloc(nslots, sizeof(*slots))))
+			return -NLE_NOMEM;
+
+		for (i = 0; i < map->mm_nslots; i++) {
+			e = &map->mm_slots[i];
+			if (e->me_ops)
+				*msgtype_map_slot(slots, nslots, e->me_key) = *e;
+		}
+
+		free(map->mm_slots);
+		map->mm_slots = slots;
+		map->mm_nslots = nslots;
+	}
+
+	for (i = 0; i < n; i++) {
+		uint32_t key = msgtype_map_key(ops->co_protocol,
+					       ops->co_msgtypes[i].mt_id);
+
+		e = msgtype_map_slot(map->mm_slots, map->mm_nslots, key);
+		if (e->me_ops)
+			continue;
+
+		e->me_key = key;
+		e->me_index = index;
+		e->me_ops = ops;
+		map->mm_nentries++;
+	}
+
+	return 0;
+}
+
+struct nl_msgtype_map_entry *
+_nl_msgtype_map_lookup(const struct nl_msgtype_map *map, int protocol,
+		       int msgtype)
+{
+	struct nl_msgtype_map_entry *e;
+
+	if (!map->mm_nslots)
+		return NULL;
+
+	e = msgtype_map_slot(map->mm_slots, map->mm_nslots,
+			     msgtype_map_key(protocol, msgtype));
+
+	return e->me_ops ? e : NULL;
+}
+
+void _nl_msgtype_map_clear(struct nl_msgtype_map *map)
+{
+	free(map->mm_slots);
+	memset(map, 0, sizeof(*map));
+}
+/** @endcond */
+
 /**
  * @name Cache Operations Sets
  * @{
@@ -109,11 +209,37 @@ struct nl_cache_ops *nl_cache_ops_lookup_safe(const char *name)
 	return ops;
 }
 
+/* Must hold cache_ops_lock for writing */
+static void cache_ops_map_rebuild(void)
+{
+	struct nl_cache_ops *ops;
+
+	_nl_msgtype_map_clear(&cache_ops_map);
+
+	for (ops = cache_ops; ops; ops = ops->co_next) {
+		if (_nl_msgtype_map_add(&cache_ops_map, ops, 0) < 0) {
+			/* Lookups walk the list without a map */
+			_nl_msgtype_map_clear(&cache_ops_map);
+			return;
+		}
+	}
+}
+
 static struct nl_cache_ops *__cache_ops_associate(int protocol, int msgtype)
 {
-	int i;
+	struct nl_msgtype_map_entry *e;
 	struct nl_cache_ops *ops;
+	int i;
+
+	if (cache_ops_map.mm_nslots &&
+	    (e = _nl_msgtype_map_lookup(&cache_ops_map, protocol, msgtype)))
+		return e->me_ops;
 
+	/*
+	 * Not mapped, or the map could not be built. Generic netlink
+	 * families get their message type assigned when their id is
+	 * resolved, after registration, so misses walk the list.
+	 */
 	for (ops = cache_ops; ops; ops = ops->co_next) {
 		if (ops->co_protocol != protocol)
 			continue;
@@ -267,6 +393,7 @@ int nl_cache_mngt_register(struct nl_cache_ops *ops)
 	ops->co_refcnt = 0;
 	ops->co_next = cache_ops;
 	cache_ops = ops;
+	cache_ops_map_rebuild();
 	nl_write_unlock(&cache_ops_lock);
 
 	NL_DBG(1, "Registered cache operations %s\n", ops->co_name);
@@ -309,6 +436,7 @@ int nl_cache_mngt_unregister(struct nl_cache_ops *ops)
 	NL_DBG(1, "Unregistered cache operations %s\n", ops->co_name);
 
 	*tp = t->co_next;
+	cache_ops_map_rebuild();
 errout:
 	nl_write_unlock(&cache_ops_lock);
 
@@ -82,8 +82,10 @@ static int nl_error_handler_verbose(struct sockaddr_nl *who,
 {
 	FILE *ofd = arg ? arg : stderr;
 
-	fprintf(ofd, "-- Error received: %s\n-- Original message: ",
-		nl_strerror_l(-e->error));
+	fprintf(ofd, "-- Error received: %s\n", nl_strerror_l(-e->error));
+	if (nlmsg_ext_ack_msg(e))
+		fprintf(ofd, "-- Extended ACK: %s\n", nlmsg_ext_ack_msg(e));
+	fprintf(ofd, "-- Original message: ");
 	print_header_content(ofd, &e->msg);
 	fprintf(ofd, "\n");
 
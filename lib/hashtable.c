@@ -9,11 +9,12 @@
  *
  * Copyright (c) 2012 Cumulus Networks, Inc
  */
+#include <stdint.h>
 #include <string.h>
 #include <netlink-private/netlink.h>
 #include <netlink/object.h>
 #include <netlink/hash.h>
-#include <netlink/hashtable.h>
+#include <netlink-private/hashtable.h>
 
 /**
  * @ingroup core_types
@@ -21,56 +22,250 @@
  * @{
  */
 
+/** @cond SKIP */
+/*
+ * Each entry stores the full key next to the object pointer, so probing
+ * only calls nl_object_identical() on key matches and resizing does not
+ * call the keygen function again. Objects without keygen all share key 0.
+ */
+#define NL_HASH_KEY_RANGE	UINT32_MAX
+
+/* Upper bound on the number of slots */
+#define NL_HASH_MAX_SIZE	(1 << 30)
+
+/*
+ * Number of occupied old slots migrated on each add or delete while
+ * resizing, up to 16 times as many free slots are skipped in
+ * addition.
+ */
+#define NL_HASH_REHASH_STEP	4
+
+/*
+ * Marks slots of the old table that have been migrated or deleted
+ * during a resize. The current table never contains deleted markers,
+ * removals shift the rest of the probe sequence back instead.
+ */
+static char hash_deleted_marker;
+#define NL_HASH_DELETED		((struct nl_object *) &hash_deleted_marker)
+
+static inline int hash_table_full(int count, int size)
+{
+	/* Keep the load factor at or below 3/4 */
+	return count > size - (size >> 2);
+}
+
+static int hash_table_roundup(int size)
+{
+	int n = NL_MIN_HASH_ENTRIES;
+
+	while (n < size && n < NL_HASH_MAX_SIZE)
+		n <<= 1;
+
+	return n;
+}
+
+static uint32_t hash_table_key(struct nl_object *obj)
+{
+	uint32_t key;
+
+	nl_object_keygen(obj, &key, NL_HASH_KEY_RANGE);
+
+	return key;
+}
+
+static nl_hash_entry_t *hash_probe(nl_hash_entry_t *entries, int size,
+				   uint32_t key, struct nl_object *obj)
+{
+	unsigned int i, mask = size - 1;
+
+	for (i = key & mask; entries[i].obj; i = (i + 1) & mask) {
+		if (   entries[i].key == key
+		    && entries[i].obj != NL_HASH_DELETED
+		    && nl_object_identical(entries[i].obj, obj))
+			return &entries[i];
+	}
+
+	return NULL;
+}
+
+static void hash_insert(nl_hash_entry_t *entries, int size, uint32_t key,
+			struct nl_object *obj)
+{
+	unsigned int i, mask = size - 1;
+
+	for (i = key & mask; entries[i].obj; i = (i + 1) & mask)
+		;
+
+	entries[i].key = key;
+	entries[i].obj = obj;
+}
+
+static void hash_remove(nl_hash_entry_t *entries, int size,
+			nl_hash_entry_t *e)
+{
+	unsigned int i, j, k, mask = size - 1;
+
+	i = e - entries;
+
+	/* Shift subsequent entries of the probe sequence back into the
+	 * hole unless this would move them in front of their home slot. */
+	for (j = (i + 1) & mask; entries[j].obj; j = (j + 1) & mask) {
+		k = entries[j].key & mask;
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			entries[i] = entries[j];
+			i = j;
+		}
+	}
+
+	entries[i].obj = NULL;
+}
+
+static void hash_table_rehash(struct nl_hash_table_priv *ht, int nslots)
+{
+	int empty_visits = nslots * 16;
+
+	if (!ht->old_entries)
+		return;
+
+	while (nslots > 0 && ht->rehash_pos < ht->old_size) {
+		nl_hash_entry_t *e = &ht->old_entries[ht->rehash_pos++];
+
+		if (!e->obj || e->obj == NL_HASH_DELETED) {
+			if (--empty_visits == 0)
+				break;
+			continue;
+		}
+
+		hash_insert(ht->entries, ht->size, e->key, e->obj);
+		e->obj = NL_HASH_DELETED;
+		nslots--;
+	}
+
+	if (ht->rehash_pos == ht->old_size) {
+		NL_DBG(4, "hashtable %p: finished resize %d -> %d\n",
+		       ht, ht->old_size, ht->size);
+
+		free(ht->old_entries);
+		ht->old_entries = NULL;
+		ht->old_size = 0;
+		ht->rehash_pos = 0;
+	}
+}
+
+/*
+ * Start moving all entries to a table of @size slots. The move itself
+ * is spread over subsequent operations, see hash_table_rehash().
+ */
+static void hash_table_resize(struct nl_hash_table_priv *ht, int size)
+{
+	nl_hash_entry_t *entries;
+
+	/* Finish a pending resize first */
+	if (ht->old_entries)
+		hash_table_rehash(ht, ht->old_size);
+
+	if (size == ht->size)
+		return;
+
+	/* Failing to resize is not fatal, probe sequences just get longer */
+	if (!(entries = calloc(size, sizeof(*entries))))
+		return;
+
+	NL_DBG(4, "hashtable %p: resizing %d -> %d (%d entries)\n",
+	       ht, ht->size, size, ht->count);
+
+	ht->old_entries = ht->entries;
+	ht->old_size = ht->size;
+	ht->rehash_pos = 0;
+	ht->entries = entries;
+	ht->size = size;
+}
+
+static nl_hash_entry_t *hash_table_find(struct nl_hash_table_priv *ht,
+					uint32_t key, struct nl_object *obj,
+					nl_hash_entry_t **table, int *size)
+{
+	nl_hash_entry_t *e;
+
+	if ((e = hash_probe(ht->entries, ht->size, key, obj))) {
+		*table = ht->entries;
+		*size = ht->size;
+	} else if (   ht->old_entries
+		   && (e = hash_probe(ht->old_entries, ht->old_size, key, obj))) {
+		*table = ht->old_entries;
+		*size = ht->old_size;
+	}
+
+	return e;
+}
+/** @endcond */
+
 /**
  * Allocate hashtable
- * @arg size		Size of hashtable in number of elements
+ * @arg size		Initial size of hashtable in number of elements
+ *
+ * The hashtable is a single array of slots, each holding the object and
+ * its full hash key, resolving collisions by linear probing. The size
+ * is rounded up to the next power of two of at least
+ * NL_MIN_HASH_ENTRIES. The hashtable doubles once it is more than 3/4
+ * full and halves again once it is less than 1/8 full. The entries are
+ * moved to the resized array a few at a time by the following add and
+ * delete operations so that no single operation has to rehash the whole
+ * table. Lookups never modify the hashtable.
  *
  * @return Allocated hashtable or NULL.
  */
 nl_hash_table_t *nl_hash_table_alloc(int size)
 {
-	nl_hash_table_t *ht;
+	struct nl_hash_table_priv *ht;
 
 	ht = calloc(1, sizeof (*ht));
 	if (!ht)
 		goto errout;
 
-	ht->nodes = calloc(size, sizeof (*ht->nodes));
-	if (!ht->nodes) {
+	size = hash_table_roundup(size);
+
+	ht->entries = calloc(size, sizeof (*ht->entries));
+	if (!ht->entries) {
 		free(ht);
 		goto errout;
 	}
 
 	ht->size = size;
+	ht->min_size = size;
 
-	return ht;
+	return &ht->head;
 errout:
 	return NULL;
 }
 
+static void hash_entries_free(nl_hash_entry_t *entries, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++) {
+		if (entries[i].obj && entries[i].obj != NL_HASH_DELETED)
+			nl_object_put(entries[i].obj);
+	}
+
+	free(entries);
+}
+
 /**
  * Free hashtable including all nodes
  * @arg ht		Hashtable
  *
  * @note Reference counter of all objects in the hashtable will be decremented.
  */
-void nl_hash_table_free(nl_hash_table_t *ht)
+void nl_hash_table_free(nl_hash_table_t *hashtable)
 {
-	int i;
+	struct nl_hash_table_priv *ht = nl_hash_table_priv(hashtable);
 
-	for(i = 0; i < ht->size; i++) {
-	    nl_hash_node_t *node = ht->nodes[i];
-	    nl_hash_node_t *saved_node;
+	hash_entries_free(ht->entries, ht->size);
 
-	    while (node) {
-		   saved_node = node;
-		   node = node->next;
-		   nl_object_put(saved_node->obj);
-		   free(saved_node);
-	    }
-	}
+	if (ht->old_entries)
+		hash_entries_free(ht->old_entries, ht->old_size);
 
-	free(ht->nodes);
 	free(ht);
 }
 
@@ -79,27 +274,23 @@ void nl_hash_table_free(nl_hash_table_t *ht)
  * @arg ht		Hashtable
  * @arg	obj		Object to lookup
  *
- * Generates hashkey for `obj` and traverses the corresponding chain calling
- * `nl_object_identical()` on each trying to find a match.
+ * Generates hashkey for `obj` and probes the table for an entry with the
+ * same key, calling `nl_object_identical()` only on entries whose key
+ * matches. The hashtable is not modified, lookups may run concurrently
+ * as long as no objects are added or removed at the same time.
  *
  * @return Pointer to object if match was found or NULL.
  */
-struct nl_object* nl_hash_table_lookup(nl_hash_table_t *ht,
+struct nl_object* nl_hash_table_lookup(nl_hash_table_t *hashtable,
 				       struct nl_object *obj)
 {
-	nl_hash_node_t *node;
-	uint32_t key_hash;
+	struct nl_hash_table_priv *ht = nl_hash_table_priv(hashtable);
+	nl_hash_entry_t *e, *table;
+	int size;
 
-	nl_object_keygen(obj, &key_hash, ht->size);
-	node = ht->nodes[key_hash];
+	e = hash_table_find(ht, hash_table_key(obj), obj, &table, &size);
 
-	while (node) {
-	       if (nl_object_identical(node->obj, obj))
-		   return node->obj;
-	       node = node->next;
-	}
-
-	return NULL;
+	return e ? e->obj : NULL;
 }
 
 /**
@@ -108,41 +299,44 @@ struct nl_object* nl_hash_table_lookup(nl_hash_table_t *ht,
  * @arg obj		Object to add
  *
  * Adds `obj` to the hashtable. Object type must support hashing, otherwise all
- * objects will be added to the chain `0`.
+ * objects will share the same key and lookups degrade to a linear scan.
  *
  * @note The reference counter of the object is incremented.
  *
  * @return 0 on success or a negative error code
  * @retval -NLE_EXIST Identical object already present in hashtable
  */
-int nl_hash_table_add(nl_hash_table_t *ht, struct nl_object *obj)
+int nl_hash_table_add(nl_hash_table_t *hashtable, struct nl_object *obj)
 {
-	nl_hash_node_t *node;
+	struct nl_hash_table_priv *ht = nl_hash_table_priv(hashtable);
+	nl_hash_entry_t *table;
 	uint32_t key_hash;
+	int size;
 
-	nl_object_keygen(obj, &key_hash, ht->size);
-	node = ht->nodes[key_hash];
+	hash_table_rehash(ht, NL_HASH_REHASH_STEP);
 
-	while (node) {
-	       if (nl_object_identical(node->obj, obj)) {
-		   NL_DBG(2, "Warning: Add to hashtable found duplicate...\n");
-		   return -NLE_EXIST;
-	       }
-	       node = node->next;
+	key_hash = hash_table_key(obj);
+
+	if (hash_table_find(ht, key_hash, obj, &table, &size)) {
+		NL_DBG(2, "Warning: Add to hashtable found duplicate...\n");
+		return -NLE_EXIST;
+	}
+
+	if (hash_table_full(ht->count + 1, ht->size)) {
+		if (ht->size < NL_HASH_MAX_SIZE)
+			hash_table_resize(ht, ht->size << 1);
+
+		/* At least one free slot must remain to terminate probing */
+		if (ht->count + 1 >= ht->size)
+			return -NLE_NOMEM;
 	}
 
 	NL_DBG (5, "adding cache entry of obj %p in table %p, with hash 0x%x\n",
 		obj, ht, key_hash);
 
-	node = malloc(sizeof(nl_hash_node_t));
-	if (!node)
-		return -NLE_NOMEM;
 	nl_object_get(obj);
-	node->obj = obj;
-	node->key = key_hash;
-	node->key_size = sizeof(uint32_t);
-	node->next = ht->nodes[key_hash];
-	ht->nodes[key_hash] = node;
+	hash_insert(ht->entries, ht->size, key_hash, obj);
+	ht->count++;
 
 	return 0;
 }
@@ -159,35 +353,34 @@ int nl_hash_table_add(nl_hash_table_t *ht, struct nl_object *obj)
  * @return 0 on success or a negative error code.
  * @retval -NLE_OBJ_NOTFOUND Object not present in hashtable.
  */
-int nl_hash_table_del(nl_hash_table_t *ht, struct nl_object *obj)
+int nl_hash_table_del(nl_hash_table_t *hashtable, struct nl_object *obj)
 {
-	nl_hash_node_t *node, *prev;
+	struct nl_hash_table_priv *ht = nl_hash_table_priv(hashtable);
+	nl_hash_entry_t *e, *table;
 	uint32_t key_hash;
+	int size;
 
-	nl_object_keygen(obj, &key_hash, ht->size);
-	prev = node = ht->nodes[key_hash];
+	hash_table_rehash(ht, NL_HASH_REHASH_STEP);
 
-	while (node) {
-	       if (nl_object_identical(node->obj, obj)) {
-		   nl_object_put(obj);
+	key_hash = hash_table_key(obj);
 
-		   NL_DBG (5, "deleting cache entry of obj %p in table %p, with"
-			   " hash 0x%x\n", obj, ht, key_hash);
+	if (!(e = hash_table_find(ht, key_hash, obj, &table, &size)))
+		return -NLE_OBJ_NOTFOUND;
 
-	           if (node == ht->nodes[key_hash])
-		       ht->nodes[key_hash] = node->next;
-	           else
-		       prev->next = node->next;
+	nl_object_put(obj);
 
-	           free(node);
+	NL_DBG (5, "deleting cache entry of obj %p in table %p, with"
+		" hash 0x%x\n", obj, ht, key_hash);
 
-	           return 0;
-		}
-		prev = node;
-		node = node->next;
-	}
+	if (table == ht->old_entries)
+		e->obj = NL_HASH_DELETED;
+	else
+		hash_remove(table, size, e);
 
-	return -NLE_OBJ_NOTFOUND;
+	if (--ht->count < (ht->size >> 3) && ht->size > ht->min_size)
+		hash_table_resize(ht, ht->size >> 1);
+
+	return 0;
 }
 
 uint32_t nl_hash(void *k, size_t length, uint32_t initval)
@@ -11,7 +11,7 @@
  */
 
 #include <netlink-private/netlink.h>
-#include <netlink/hashtable.h>
+#include <netlink-private/hash.h>
 #include <netlink/idiag/msg.h>
 #include <netlink/idiag/meminfo.h>
 #include <netlink/idiag/vegasinfo.h>
@@ -902,37 +902,20 @@ static void idiagnl_keygen(struct nl_object *obj, uint32_t *hashkey,
         uint32_t table_sz)
 {
 	struct idiagnl_msg *msg = (struct idiagnl_msg *)obj;
-	unsigned int key_sz;
-	struct idiagnl_hash_key {
-		uint8_t	family;
-		uint32_t src_hash;
-		uint32_t dst_hash;
-		uint16_t sport;
-		uint16_t dport;
-	} __attribute__((packed)) key;
-
-	key_sz = sizeof(key);
-	key.family = msg->idiag_family;
-	key.src_hash = 0;
-	key.dst_hash = 0;
-	key.sport = msg->idiag_sport;
-	key.dport = msg->idiag_dport;
-
-	if (msg->idiag_src) {
-		key.src_hash = nl_hash (nl_addr_get_binary_addr(msg->idiag_src),
-		                        nl_addr_get_len(msg->idiag_src), 0);
-	}
-	if (msg->idiag_dst) {
-		key.dst_hash = nl_hash (nl_addr_get_binary_addr(msg->idiag_dst),
-		                        nl_addr_get_len(msg->idiag_dst), 0);
-	}
+	struct nl_hasher h;
 
-	*hashkey = nl_hash(&key, key_sz, 0) % table_sz;
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, msg->idiag_family);
+	nl_hasher_u32(&h, msg->idiag_sport);
+	nl_hasher_u32(&h, msg->idiag_dport);
+	nl_hasher_addr(&h, msg->idiag_src);
+	nl_hasher_addr(&h, msg->idiag_dst);
 
-	NL_DBG(5, "idiagnl %p key (fam %d src_hash %d dst_hash %d sport %d dport %d) keysz %d, hash 0x%x\n",
-	       msg, key.family, key.src_hash, key.dst_hash, key.sport, key.dport, key_sz, *hashkey);
+	*hashkey = nl_hasher_final(&h) % table_sz;
 
-	return;
+	NL_DBG(5, "idiagnl %p key (fam %d sport %d dport %d) hash 0x%x\n",
+	       msg, msg->idiag_family, msg->idiag_sport, msg->idiag_dport,
+	       *hashkey);
 }
 
 /** @cond SKIP */
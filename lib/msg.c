@@ -37,9 +37,170 @@
 
 static size_t default_msg_size;
 
+/** @cond SKIP */
+/*
+ * Message buffers of up to a page and the struct nl_msg objects are
+ * recycled through per-thread free lists. A freed object stores the
+ * pointer to the next free object in its first bytes.
+ */
+#define NL_MSG_SLAB_CLASSES	3
+#define NL_MSG_SLAB_OBJ		NL_MSG_SLAB_CLASSES
+#define NL_MSG_SLAB_DEPTH	64
+
+struct nl_msg_slab
+{
+	void *		ms_free[NL_MSG_SLAB_CLASSES + 1];
+	unsigned int	ms_nfree[NL_MSG_SLAB_CLASSES + 1];
+};
+
+static size_t slab_size[NL_MSG_SLAB_CLASSES + 1] = {
+	256, 1024, 0, sizeof(struct nl_msg),
+};
+
+static void slab_release(struct nl_msg_slab *slab)
+{
+	int i;
+
+	for (i = 0; i <= NL_MSG_SLAB_CLASSES; i++) {
+		while (slab->ms_free[i]) {
+			void *next = *(void **) slab->ms_free[i];
+
+			free(slab->ms_free[i]);
+			slab->ms_free[i] = next;
+		}
+		slab->ms_nfree[i] = 0;
+	}
+}
+
+#ifndef DISABLE_PTHREADS
+static pthread_key_t slab_key;
+static int slab_key_valid;
+
+static void slab_destroy(void *arg)
+{
+	slab_release(arg);
+	free(arg);
+}
+
+static struct nl_msg_slab *slab_get(void)
+{
+	struct nl_msg_slab *slab;
+
+	if (!slab_key_valid)
+		return NULL;
+
+	if (!(slab = pthread_getspecific(slab_key))) {
+		slab = calloc(1, sizeof(*slab));
+		if (slab && pthread_setspecific(slab_key, slab) != 0) {
+			free(slab);
+			slab = NULL;
+		}
+	}
+
+	return slab;
+}
+#else
+static struct nl_msg_slab slab_global;
+
+static struct nl_msg_slab *slab_get(void)
+{
+	return &slab_global;
+}
+#endif
+
+static void *slab_alloc(int cls)
+{
+	struct nl_msg_slab *slab = slab_get();
+	void *obj;
+
+	if (slab && (obj = slab->ms_free[cls])) {
+		slab->ms_free[cls] = *(void **) obj;
+		slab->ms_nfree[cls]--;
+		return obj;
+	}
+
+	return malloc(slab_size[cls]);
+}
+
+static void slab_free(int cls, void *obj)
+{
+	struct nl_msg_slab *slab = slab_get();
+
+	if (slab && slab->ms_nfree[cls] < NL_MSG_SLAB_DEPTH) {
+		*(void **) obj = slab->ms_free[cls];
+		slab->ms_free[cls] = obj;
+		slab->ms_nfree[cls]++;
+	} else
+		free(obj);
+}
+
+/* Smallest size class holding len bytes or -1 */
+static int slab_class(size_t len)
+{
+	int i;
+
+	for (i = 0; i < NL_MSG_SLAB_CLASSES; i++)
+		if (len <= slab_size[i])
+			return i;
+
+	return -1;
+}
+
+static struct nl_msg *msg_obj_alloc(void)
+{
+	struct nl_msg *nm;
+
+	if (!(nm = slab_alloc(NL_MSG_SLAB_OBJ)))
+		return NULL;
+
+	memset(nm, 0, sizeof(*nm));
+	nm->nm_refcnt = 1;
+	nm->nm_protocol = -1;
+	nm->nm_slab = -1;
+
+	return nm;
+}
+
+static void msg_payload_free(struct nl_msg *nm)
+{
+	if (nm->nm_rbuf)
+		_nl_recvbuf_put(nm->nm_rbuf);
+	else if (nm->nm_slab >= 0)
+		slab_free(nm->nm_slab, nm->nm_nlh);
+	else
+		free(nm->nm_nlh);
+}
+/** @endcond */
+
 static void __init init_msg_size(void)
 {
 	default_msg_size = getpagesize();
+	slab_size[NL_MSG_SLAB_CLASSES - 1] = max_t(size_t, getpagesize(),
+						   slab_size[NL_MSG_SLAB_CLASSES - 2]);
+#ifndef DISABLE_PTHREADS
+	slab_key_valid = !pthread_key_create(&slab_key, slab_destroy);
+#endif
+}
+
+static void __exit exit_msg_slab(void)
+{
+#ifndef DISABLE_PTHREADS
+	struct nl_msg_slab *slab;
+
+	if (!slab_key_valid)
+		return;
+
+	/* The key destructor does not run for the main thread, free lists
+	 * of other threads are released on thread exit */
+	slab_key_valid = 0;
+	if ((slab = pthread_getspecific(slab_key))) {
+		pthread_setspecific(slab_key, NULL);
+		slab_destroy(slab);
+	}
+	pthread_key_delete(slab_key);
+#else
+	slab_release(&slab_global);
+#endif
 }
 
 /**
@@ -267,26 +428,29 @@ static struct nl_msg *__nlmsg_alloc(size_t len)
 	if (len < sizeof(struct nlmsghdr))
 		len = sizeof(struct nlmsghdr);
 
-	nm = calloc(1, sizeof(*nm));
+	nm = msg_obj_alloc();
 	if (!nm)
-		goto errout;
+		return NULL;
 
-	nm->nm_refcnt = 1;
+	/* Only the header is cleared, nlmsg_reserve() and nla_reserve()
+	 * clear the room they hand out. */
+	if ((nm->nm_slab = slab_class(len)) >= 0)
+		nm->nm_nlh = slab_alloc(nm->nm_slab);
+	else
+		nm->nm_nlh = malloc(len);
 
-	nm->nm_nlh = calloc(1, len);
-	if (!nm->nm_nlh)
-		goto errout;
+	if (!nm->nm_nlh) {
+		slab_free(NL_MSG_SLAB_OBJ, nm);
+		return NULL;
+	}
 
-	nm->nm_protocol = -1;
+	memset(nm->nm_nlh, 0, sizeof(struct nlmsghdr));
 	nm->nm_size = len;
 	nm->nm_nlh->nlmsg_len = nlmsg_total_size(0);
 
 	NL_DBG(2, "msg %p: Allocated new message, maxlen=%zu\n", nm, len);
 
 	return nm;
-errout:
-	free(nm);
-	return NULL;
 }
 
 /**
@@ -396,19 +560,72 @@ struct nl_msg *nlmsg_convert(struct nlmsghdr *hdr)
 	return nm;
 }
 
-/**
- * Reserve room for additional data in a netlink message
- * @arg n		netlink message
- * @arg len		length of additional data to reserve room for
- * @arg pad		number of bytes to align data to
- *
- * Reserves room for additional data at the tail of the an
- * existing netlink message. Eventual padding required will
- * be zeroed out.
- *
- * @return Pointer to start of additional data tailroom or NULL.
+/** @cond SKIP */
+struct nl_recvbuf *_nl_recvbuf_alloc(unsigned char *data, size_t size)
+{
+	struct nl_recvbuf *rb;
+
+	rb = calloc(1, sizeof(*rb));
+	if (!rb)
+		return NULL;
+
+	rb->rb_data = data;
+	rb->rb_size = size;
+	rb->rb_refcnt = 1;
+
+	return rb;
+}
+
+void _nl_recvbuf_get(struct nl_recvbuf *rb)
+{
+	rb->rb_refcnt++;
+}
+
+void _nl_recvbuf_put(struct nl_recvbuf *rb)
+{
+	if (!rb)
+		return;
+
+	rb->rb_refcnt--;
+
+	if (rb->rb_refcnt < 0)
+		BUG();
+
+	if (rb->rb_refcnt <= 0) {
+		free(rb->rb_data);
+		free(rb);
+	}
+}
+
+/*
+ * Create a message referencing a netlink message inside a shared receive
+ * buffer instead of copying it. The message holds a reference on the
+ * buffer which is released again by nlmsg_free(). The maximum size is
+ * limited to the message itself so the message can't be extended into
+ * the neighbouring message in the buffer.
  */
-void *nlmsg_reserve(struct nl_msg *n, size_t len, int pad)
+struct nl_msg *_nlmsg_view(struct nl_recvbuf *rb, struct nlmsghdr *hdr)
+{
+	struct nl_msg *nm;
+
+	nm = msg_obj_alloc();
+	if (!nm)
+		return NULL;
+
+	nm->nm_nlh = hdr;
+	nm->nm_size = hdr->nlmsg_len;
+	nm->nm_rbuf = rb;
+	_nl_recvbuf_get(rb);
+
+	NL_DBG(2, "msg %p: Allocated new message view into buffer %p\n",
+	       nm, rb);
+
+	return nm;
+}
+/** @endcond */
+
+/** @cond SKIP */
+static void *__nlmsg_reserve(struct nl_msg *n, size_t len, int pad)
 {
 	char *buf = (char *) n->nm_nlh;
 	size_t nlmsg_len = n->nm_nlh->nlmsg_len;
@@ -433,6 +650,29 @@ void *nlmsg_reserve(struct nl_msg *n, size_t len, int pad)
 
 	return buf;
 }
+/** @endcond */
+
+/**
+ * Reserve room for additional data in a netlink message
+ * @arg n		netlink message
+ * @arg len		length of additional data to reserve room for
+ * @arg pad		number of bytes to align data to
+ *
+ * Reserves room for additional data at the tail of the an
+ * existing netlink message. The reserved room and eventual
+ * padding required will be zeroed out.
+ *
+ * @return Pointer to start of additional data tailroom or NULL.
+ */
+void *nlmsg_reserve(struct nl_msg *n, size_t len, int pad)
+{
+	void *buf;
+
+	if ((buf = __nlmsg_reserve(n, len, pad)))
+		memset(buf, 0, len);
+
+	return buf;
+}
 
 /**
  * Append data to tail of a netlink message
@@ -450,7 +690,7 @@ int nlmsg_append(struct nl_msg *n, void *data, size_t len, int pad)
 {
 	void *tmp;
 
-	tmp = nlmsg_reserve(n, len, pad);
+	tmp = __nlmsg_reserve(n, len, pad);
 	if (tmp == NULL)
 		return -NLE_NOMEM;
 
@@ -481,9 +721,25 @@ int nlmsg_expand(struct nl_msg *n, size_t newlen)
 	if (newlen <= n->nm_size)
 		return -NLE_INVAL;
 
-	tmp = realloc(n->nm_nlh, newlen);
-	if (tmp == NULL)
-		return -NLE_NOMEM;
+	if (n->nm_rbuf) {
+		/* Message is a view into a receive buffer, detach it */
+		tmp = malloc(newlen);
+		if (tmp == NULL)
+			return -NLE_NOMEM;
+
+		memcpy(tmp, n->nm_nlh, n->nm_nlh->nlmsg_len);
+		_nl_recvbuf_put(n->nm_rbuf);
+		n->nm_rbuf = NULL;
+	} else if (n->nm_slab >= 0 && newlen <= slab_size[n->nm_slab]) {
+		/* Slab buffer is large enough already */
+		tmp = n->nm_nlh;
+	} else {
+		tmp = realloc(n->nm_nlh, newlen);
+		if (tmp == NULL)
+			return -NLE_NOMEM;
+
+		n->nm_slab = -1;
+	}
 
 	n->nm_nlh = tmp;
 	n->nm_size = newlen;
@@ -575,9 +831,9 @@ void nlmsg_free(struct nl_msg *msg)
 		BUG();
 
 	if (msg->nm_refcnt <= 0) {
-		free(msg->nm_nlh);
+		msg_payload_free(msg);
 		NL_DBG(2, "msg %p: Freed\n", msg);
-		free(msg);
+		slab_free(NL_MSG_SLAB_OBJ, msg);
 	}
 }
 
@@ -691,6 +947,8 @@ char *nl_nlmsg_flags2str(int flags, char *buf, size_t len)
 	PRINT_FLAG(EXCL);
 	PRINT_FLAG(CREATE);
 	PRINT_FLAG(APPEND);
+	PRINT_FLAG(CAPPED);
+	PRINT_FLAG(ACK_TLVS);
 
 	if (flags) {
 		char s[32];
@@ -704,6 +962,124 @@ char *nl_nlmsg_flags2str(int flags, char *buf, size_t len)
 
 /** @} */
 
+/**
+ * @name Extended ACK
+ *
+ * If extended ACK reporting has been enabled with nl_socket_set_ext_ack(),
+ * the kernel appends additional attributes to ACK and error messages.
+ * The functions below retrieve them from a `struct nlmsgerr` as handed to
+ * the error callback or as found in the payload of an ACK message.
+ * @{
+ */
+
+/** @cond SKIP */
+static struct nlattr *ext_ack_attrs(const struct nlmsgerr *e, int *len)
+{
+	const struct nlmsghdr *nlh;
+	size_t off, payload = sizeof(*e);
+
+	nlh = (const struct nlmsghdr *) ((const char *) e - NLMSG_HDRLEN);
+	if (!(nlh->nlmsg_flags & NLM_F_ACK_TLVS))
+		return NULL;
+
+	/* The original request is echoed unless capped */
+	if (!(nlh->nlmsg_flags & NLM_F_CAPPED) &&
+	    e->msg.nlmsg_len > NLMSG_HDRLEN)
+		payload += e->msg.nlmsg_len - NLMSG_HDRLEN;
+
+	off = NLMSG_HDRLEN + NLMSG_ALIGN(payload);
+	if (off >= nlh->nlmsg_len)
+		return NULL;
+
+	*len = nlh->nlmsg_len - off;
+
+	return (struct nlattr *) ((char *) nlh + off);
+}
+/** @endcond */
+
+/**
+ * Return error message reported in extended ACK
+ * @arg e		Netlink error message header
+ *
+ * @pre \p e must point into a received ACK or error message.
+ *
+ * @return Human readable error message or NULL if not available.
+ */
+const char *nlmsg_ext_ack_msg(const struct nlmsgerr *e)
+{
+	struct nlattr *attrs, *nla;
+	int len;
+
+	if (!(attrs = ext_ack_attrs(e, &len)))
+		return NULL;
+
+	nla = nla_find(attrs, len, NLMSGERR_ATTR_MSG);
+	if (!nla || nla_len(nla) < 1 ||
+	    ((char *) nla_data(nla))[nla_len(nla) - 1] != '\0')
+		return NULL;
+
+	return nla_data(nla);
+}
+
+/**
+ * Return offset of invalid attribute reported in extended ACK
+ * @arg e		Netlink error message header
+ *
+ * The offset is relative to the start of the netlink message header of
+ * the original request.
+ *
+ * @pre \p e must point into a received ACK or error message.
+ *
+ * @return Offset or a negative error code.
+ * @retval -NLE_NOATTR Extended ACK does not report an invalid attribute.
+ */
+int nlmsg_ext_ack_offset(const struct nlmsgerr *e)
+{
+	struct nlattr *attrs, *nla;
+	int len;
+
+	if (!(attrs = ext_ack_attrs(e, &len)))
+		return -NLE_NOATTR;
+
+	nla = nla_find(attrs, len, NLMSGERR_ATTR_OFFS);
+	if (!nla || nla_len(nla) < sizeof(uint32_t) ||
+	    nla_get_u32(nla) > INT_MAX)
+		return -NLE_NOATTR;
+
+	return nla_get_u32(nla);
+}
+
+/**
+ * Return invalid attribute of original request reported in extended ACK
+ * @arg e		Netlink error message header
+ *
+ * Only available if the original request is included in the error
+ * message, i.e. if capped ACKs are disabled.
+ *
+ * @pre \p e must point into a received error message.
+ *
+ * @see nlmsg_ext_ack_offset()
+ *
+ * @return Attribute within the echoed request or NULL if not available.
+ */
+struct nlattr *nlmsg_ext_ack_attr(const struct nlmsgerr *e)
+{
+	const struct nlmsghdr *nlh;
+	int off;
+
+	nlh = (const struct nlmsghdr *) ((const char *) e - NLMSG_HDRLEN);
+	if (nlh->nlmsg_flags & NLM_F_CAPPED)
+		return NULL;
+
+	if ((off = nlmsg_ext_ack_offset(e)) < NLMSG_HDRLEN ||
+	    off + NLA_HDRLEN > e->msg.nlmsg_len)
+		return NULL;
+
+	return (struct nlattr *) ((char *) &e->msg + off);
+}
+
+/** @} */
+
 /**
  * @name Direct Parsing
  * @{
@@ -20,6 +20,7 @@
 #include <netlink-private/netlink.h>
 #include <netlink/netfilter/nfnl.h>
 #include <netlink/netfilter/ct.h>
+#include <netlink-private/hash.h>
 
 /** @cond SKIP */
 #define CT_ATTR_FAMILY		(1UL << 0)
@@ -298,6 +299,39 @@ static void ct_dump_stats(struct nl_object *a, struct nl_dump_params *p)
 	}
 }
 
+static void ct_keygen(struct nl_object *obj, uint32_t *hashkey,
+		      uint32_t table_sz)
+{
+	struct nfnl_ct *ct = (struct nfnl_ct *) obj;
+	struct nfnl_ct_dir *orig = &ct->ct_orig;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, ((uint32_t) ct->ct_family << 8) | ct->ct_proto);
+	nl_hasher_addr(&h, orig->src);
+	nl_hasher_addr(&h, orig->dst);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "ct %p key (fam %d proto %d) hash 0x%x\n",
+	       ct, ct->ct_family, ct->ct_proto, *hashkey);
+}
+
+static void ct_hash_attrs(struct nl_object *obj, uint64_t attrs,
+			  struct nl_hasher *h)
+{
+	struct nfnl_ct *ct = (struct nfnl_ct *) obj;
+
+	if (attrs & CT_ATTR_FAMILY)
+		nl_hasher_u32(h, ct->ct_family);
+	if (attrs & CT_ATTR_PROTO)
+		nl_hasher_u32(h, ct->ct_proto);
+	if (attrs & CT_ATTR_MARK)
+		nl_hasher_u32(h, ct->ct_mark);
+	if (attrs & CT_ATTR_ID)
+		nl_hasher_u32(h, ct->ct_id);
+}
+
 static uint64_t ct_compare(struct nl_object *_a, struct nl_object *_b,
 			   uint64_t attrs, int flags)
 {
@@ -845,6 +879,10 @@ struct nl_object_ops ct_obj_ops = {
 	    [NL_DUMP_STATS]	= ct_dump_stats,
 	},
 	.oo_compare		= ct_compare,
+	.oo_keygen		= ct_keygen,
+	.oo_keygen_attrs	= CT_ATTR_FAMILY | CT_ATTR_PROTO |
+				  CT_ATTR_ORIG_SRC | CT_ATTR_ORIG_DST,
+	.oo_hash_attrs		= ct_hash_attrs,
 	.oo_attrs2str		= ct_attrs2str,
 };
 
@@ -22,6 +22,7 @@
 #include <netlink-private/netlink.h>
 #include <netlink/netfilter/nfnl.h>
 #include <netlink/netfilter/exp.h>
+#include <netlink-private/hash.h>
 
 // The 32-bit attribute mask in the common object header isn't
 // big enough to handle all attributes of an expectation.  So
@@ -302,6 +303,25 @@ static int exp_cmp_l4proto_icmp (union nfnl_exp_protodata *a, union nfnl_exp_pro
 	return d;
 }
 
+static void exp_keygen(struct nl_object *obj, uint32_t *hashkey,
+		       uint32_t table_sz)
+{
+	struct nfnl_exp *exp = (struct nfnl_exp *) obj;
+	struct nfnl_exp_dir *expect = &exp->exp_expect;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, ((uint32_t) exp->exp_family << 8) |
+			  expect->proto.l4protonum);
+	nl_hasher_addr(&h, expect->src);
+	nl_hasher_addr(&h, expect->dst);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "exp %p key (fam %d proto %d) hash 0x%x\n",
+	       exp, exp->exp_family, expect->proto.l4protonum, *hashkey);
+}
+
 static uint64_t exp_compare(struct nl_object *_a, struct nl_object *_b,
 			    uint64_t attrs, int flags)
 {
@@ -883,6 +903,9 @@ struct nl_object_ops exp_obj_ops = {
 		[NL_DUMP_DETAILS]	= exp_dump_details,
 	},
 	.oo_compare	= exp_compare,
+	.oo_keygen	= exp_keygen,
+	.oo_keygen_attrs = EXP_ATTR_FAMILY | EXP_ATTR_EXPECT_L4PROTO_NUM |
+			  EXP_ATTR_EXPECT_IP_SRC | EXP_ATTR_EXPECT_IP_DST,
 	.oo_attrs2str	= exp_attrs2str,
 };
 
@@ -35,6 +35,7 @@
 #include <netlink/msg.h>
 #include <netlink/attr.h>
 #include <linux/socket.h>
+#include <sys/uio.h>
 
 /**
  * @defgroup core_types Data Types
@@ -235,6 +236,9 @@ void nl_close(struct nl_sock *sk)
 		sk->s_fd = -1;
 	}
 
+	_nl_socket_recvq_flush(sk);
+
+	sk->s_flags &= ~NL_SOCK_STRICT_CHK;
 	sk->s_proto = 0;
 }
 
@@ -604,64 +608,343 @@ errout:
 /** @} */
 
 /**
- * @name Receive
+ * @name Batched Send
  * @{
  */
 
+/** @cond SKIP */
+#define NL_MSG_BATCH_INIT	32
+/** @endcond */
+
 /**
- * Receive data from netlink socket
+ * Allocate a message batch
+ *
+ * A message batch collects complete Netlink messages in order to transmit
+ * them with as few system calls as possible using nl_send_batch().
+ *
+ * @see nl_msg_batch_add()
+ * @see nl_send_batch()
+ *
+ * @return Newly allocated message batch or NULL.
+ */
+struct nl_msg_batch *nl_msg_batch_alloc(void)
+{
+	return calloc(1, sizeof(struct nl_msg_batch));
+}
+
+/**
+ * Release all messages queued in a message batch
+ * @arg batch		Message batch
+ */
+void nl_msg_batch_clear(struct nl_msg_batch *batch)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->mb_nmsgs; i++)
+		nlmsg_free(batch->mb_msgs[i]);
+
+	batch->mb_nmsgs = 0;
+}
+
+/**
+ * Free a message batch
+ * @arg batch		Message batch
+ *
+ * Releases all messages still queued in the batch without sending them.
+ */
+void nl_msg_batch_free(struct nl_msg_batch *batch)
+{
+	if (!batch)
+		return;
+
+	nl_msg_batch_clear(batch);
+	free(batch->mb_msgs);
+	free(batch);
+}
+
+/**
+ * Return number of messages queued in a message batch
+ * @arg batch		Message batch
+ */
+unsigned int nl_msg_batch_count(struct nl_msg_batch *batch)
+{
+	return batch->mb_nmsgs;
+}
+
+/**
+ * Finalize a Netlink message and add it to a message batch
  * @arg sk		Netlink socket (required)
- * @arg nla		Netlink socket structure to hold address of peer (required)
- * @arg buf		Destination pointer for message content (required)
- * @arg creds		Destination pointer for credentials (optional)
+ * @arg batch		Message batch (required)
+ * @arg msg		Netlink message (required)
  *
- * Receives data from a connected netlink socket using recvmsg() and returns
- * the number of bytes read. The read data is stored in a newly allocated
- * buffer that is assigned to \c *buf. The peer's netlink address will be
- * stored in \c *nla.
+ * Finalizes the message by passing it to `nl_complete_msg()`, thus
+ * assigning the next sequence number of the socket to it, and queues
+ * it for transmission by nl_send_batch(). The batch acquires its own
+ * reference to the message, the caller may free the message right away.
  *
- * This function blocks until data is available to be read unless the socket
- * has been put into non-blocking mode using nl_socket_set_nonblocking() in
- * which case this function will return immediately with a return value of
- * -NLA_AGAIN (versions before 3.2.22 returned instead 0, in which case you
- * should check first clear errno and then check for errno EAGAIN).
+ * @return 0 on success or a negative error code.
+ */
+int nl_msg_batch_add(struct nl_sock *sk, struct nl_msg_batch *batch,
+		     struct nl_msg *msg)
+{
+	if (batch->mb_nmsgs >= batch->mb_size) {
+		struct nl_msg **msgs;
+		unsigned int size;
+
+		size = batch->mb_size ? batch->mb_size * 2 : NL_MSG_BATCH_INIT;
+		msgs = realloc(batch->mb_msgs, size * sizeof(*msgs));
+		if (!msgs)
+			return -NLE_NOMEM;
+
+		batch->mb_msgs = msgs;
+		batch->mb_size = size;
+	}
+
+	nl_complete_msg(sk, msg);
+	nlmsg_get(msg);
+	batch->mb_msgs[batch->mb_nmsgs++] = msg;
+
+	return 0;
+}
+
+/* Release the first n messages of the batch */
+static void batch_drop(struct nl_msg_batch *batch, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		nlmsg_free(batch->mb_msgs[i]);
+
+	memmove(batch->mb_msgs, batch->mb_msgs + n,
+		(batch->mb_nmsgs - n) * sizeof(*batch->mb_msgs));
+	batch->mb_nmsgs -= n;
+}
+
+/*
+ * Maximum length of a single datagram as accepted by the kernel, which
+ * rejects datagrams exceeding the send buffer minus 32 bytes.
+ */
+static size_t batch_max_len(struct nl_sock *sk)
+{
+	socklen_t len = sizeof(int);
+	int sndbuf;
+
+	if (getsockopt(sk->s_fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, &len) < 0 ||
+	    sndbuf <= 32)
+		return getpagesize();
+
+	return sndbuf - 32;
+}
+
+#ifdef HAVE_SENDMMSG
+#define BATCH_DGRAM(dgrams, i)	(&(dgrams)[i].msg_hdr)
+#else
+#define BATCH_DGRAM(dgrams, i)	(&(dgrams)[i])
+#endif
+
+/**
+ * Transmit all messages of a message batch
+ * @arg sk		Netlink socket (required)
+ * @arg batch		Message batch (required)
  *
- * The buffer size used when reading from the netlink socket and thus limiting
- * the maximum size of a netlink message that can be read defaults to the size
- * of a memory page (getpagesize()). The buffer size can be modified on a per
- * socket level using the function nl_socket_set_msg_buf_size().
+ * Packs the messages queued in the batch back to back into as few
+ * datagrams as possible, each limited by the send buffer size of the
+ * socket, and transmits them in order. If available, all datagrams are
+ * handed to the kernel with a single sendmmsg() system call. Messages
+ * are referenced in place, no payload is copied.
  *
- * If message peeking is enabled using nl_socket_enable_msg_peek() the size of
- * the message to be read will be determined using the MSG_PEEK flag prior to
- * performing the actual read. This leads to an additional recvmsg() call for
- * every read operation which has performance implications and is not
- * recommended for high throughput protocols.
+ * Successfully transmitted messages are released from the batch. On
+ * failure, the messages not yet transmitted remain queued in the batch
+ * so the operation can be retried.
  *
- * An eventual interruption of the recvmsg() system call is automatically
- * handled by retrying the operation.
+ * The datagrams are addressed to the peer of the socket. Destination
+ * addresses and credentials set in individual messages are ignored.
+ * If auto-ACK mode is enabled, the kernel will send an ACK or error
+ * message for every message of the batch, in order. ACKs exceeding the
+ * receive buffer of the socket are dropped by the kernel, large batches
+ * therefore require a sufficiently large receive buffer.
  *
- * If receiving of credentials has been enabled using the function
- * nl_socket_set_passcred(), this function will allocate a new struct ucred
- * filled with the received credentials and assign it to \c *creds. The caller
- * is responsible for freeing the buffer.
+ * @par Overwriting Capability:
+ * If transmission has been overwritten with nl_cb_overwrite_send(),
+ * every message is passed to nl_send() individually.
  *
- * @note The caller is responsible to free the returned data buffer and if
- *       enabled, the credentials buffer.
+ * @callback This function triggers the `NL_CB_MSG_OUT` callback for
+ *           every message before anything is transmitted. If the callback
+ *           returns `NL_SKIP`, the message is left out and released from
+ *           the batch without being transmitted. If it returns `NL_STOP`,
+ *           only the messages preceding it are transmitted, the message and
+ *           all messages following it remain queued in the batch. A negative
+ *           error code returned by the callback aborts the operation before
+ *           anything is transmitted and is passed on to the caller.
  *
- * @see nl_socket_set_nonblocking()
- * @see nl_socket_set_msg_buf_size()
- * @see nl_socket_enable_msg_peek()
- * @see nl_socket_set_passcred()
+ * @note Skipped messages are never acknowledged by the kernel.
  *
- * @return Number of bytes read, 0 on EOF, 0 on no data event (non-blocking
- *         mode), or a negative error code.
+ * @see nl_msg_batch_add()
+ *
+ * @return Number of messages transmitted or a negative error code.
+ * @retval -NLE_MSGSIZE A single message exceeds the send buffer size
  */
-int nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
-	    unsigned char **buf, struct ucred **creds)
+int nl_send_batch(struct nl_sock *sk, struct nl_msg_batch *batch)
+{
+	static char pad[NLMSG_ALIGNTO];
+	struct nl_cb *cb = sk->s_cb;
+#ifdef HAVE_SENDMMSG
+	struct mmsghdr *dgrams = NULL;
+#else
+	struct msghdr *dgrams = NULL;
+#endif
+	struct iovec *iov = NULL;
+	unsigned int *first = NULL;
+	unsigned int i, niov = 0, ndgrams = 0, sent = 0;
+	size_t maxlen, dlen = 0;
+	int ret, err = 0, npacked = 0, nmsgs = batch->mb_nmsgs;
+
+	if (batch->mb_nmsgs == 0)
+		return 0;
+
+	if (cb->cb_send_ow) {
+		for (i = 0; i < batch->mb_nmsgs; i++) {
+			if ((err = nl_send(sk, batch->mb_msgs[i])) < 0) {
+				batch_drop(batch, i);
+				return err;
+			}
+		}
+
+		nl_msg_batch_clear(batch);
+		return nmsgs;
+	}
+
+	if (sk->s_fd < 0)
+		return -NLE_BAD_SOCK;
+
+	maxlen = batch_max_len(sk);
+
+	/* Worst case is one datagram and a padding iovec per message */
+	dgrams = calloc(batch->mb_nmsgs, sizeof(*dgrams));
+	iov = calloc(batch->mb_nmsgs * 2, sizeof(*iov));
+	first = calloc(batch->mb_nmsgs + 1, sizeof(*first));
+	if (!dgrams || !iov || !first) {
+		err = -NLE_NOMEM;
+		goto errout;
+	}
+
+	for (i = 0; i < batch->mb_nmsgs; i++) {
+		struct nl_msg *msg = batch->mb_msgs[i];
+		struct nlmsghdr *nlh = nlmsg_hdr(msg);
+		size_t len = NLMSG_ALIGN(nlh->nlmsg_len);
+		struct msghdr *hdr;
+
+		if (len > maxlen) {
+			err = -NLE_MSGSIZE;
+			goto errout;
+		}
+
+		nlmsg_set_src(msg, &sk->s_local);
+		if (cb->cb_set[NL_CB_MSG_OUT]) {
+			ret = nl_cb_call(cb, NL_CB_MSG_OUT, msg);
+			if (ret == NL_SKIP)
+				continue;
+			else if (ret == NL_STOP)
+				break;
+			else if (ret < 0) {
+				err = ret;
+				goto errout;
+			}
+		}
+
+		if (ndgrams == 0 || dlen + len > maxlen ||
+		    BATCH_DGRAM(dgrams, ndgrams - 1)->msg_iovlen + 2 > UIO_MAXIOV) {
+			hdr = BATCH_DGRAM(dgrams, ndgrams);
+			hdr->msg_name = (void *) &sk->s_peer;
+			hdr->msg_namelen = sizeof(struct sockaddr_nl);
+			hdr->msg_iov = &iov[niov];
+			first[ndgrams++] = i;
+			dlen = 0;
+		}
+
+		hdr = BATCH_DGRAM(dgrams, ndgrams - 1);
+
+		iov[niov].iov_base = nlh;
+		iov[niov++].iov_len = nlh->nlmsg_len;
+		hdr->msg_iovlen++;
+
+		if (len > nlh->nlmsg_len) {
+			iov[niov].iov_base = pad;
+			iov[niov++].iov_len = len - nlh->nlmsg_len;
+			hdr->msg_iovlen++;
+		}
+
+		dlen += len;
+		npacked++;
+	}
+	first[ndgrams] = i;
+
+	while (sent < ndgrams) {
+#ifdef HAVE_SENDMMSG
+		ret = sendmmsg(sk->s_fd, dgrams + sent, ndgrams - sent, 0);
+#else
+		ret = sendmsg(sk->s_fd, &dgrams[sent], 0) < 0 ? -1 : 1;
+#endif
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			NL_DBG(4, "nl_send_batch(%p): sending failed with %d (%s)\n",
+				sk, errno, nl_strerror_l(errno));
+			err = -nl_syserr2nlerr(errno);
+			break;
+		}
+
+		sent += ret;
+	}
+
+	NL_DBG(4, "nl_send_batch(%p): sent %u of %u datagrams carrying %d messages\n",
+	       sk, sent, ndgrams, npacked);
+
+	batch_drop(batch, first[sent]);
+	if (!err)
+		err = npacked;
+
+errout:
+	free(dgrams);
+	free(iov);
+	free(first);
+
+	return err;
+}
+
+#undef BATCH_DGRAM
+
+/** @} */
+
+/**
+ * @name Receive
+ * @{
+ */
+
+static size_t recv_bufsize(struct nl_sock *sk)
+{
+	static size_t page_size = 0;
+
+	if (sk->s_bufsize)
+		return sk->s_bufsize;
+
+	if (page_size == 0)
+		page_size = getpagesize() * 4;
+
+	return page_size;
+}
+
+/*
+ * Receive a datagram into *buf of size *size. The buffer is allocated if
+ * *buf is NULL and grown as needed, *buf and *size are updated to reflect
+ * the buffer in use. The buffer remains owned by the caller on failure.
+ */
+static int __nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+		     unsigned char **buf, size_t *size, struct ucred **creds)
 {
 	ssize_t n;
 	int flags = 0;
-	static int page_size = 0;
 	struct iovec iov;
 	struct msghdr msg = {
 		.msg_name = (void *) nla,
@@ -670,26 +953,30 @@ int nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
 		.msg_iovlen = 1,
 	};
 	struct ucred* tmpcreds = NULL;
+	size_t bufsize;
 	int retval = 0;
 
-	if (!buf || !nla)
-		return -NLE_INVAL;
-
 	if (   (sk->s_flags & NL_MSG_PEEK)
 	    || (!(sk->s_flags & NL_MSG_PEEK_EXPLICIT) && sk->s_bufsize == 0))
 		flags |= MSG_PEEK | MSG_TRUNC;
 
-	if (page_size == 0)
-		page_size = getpagesize() * 4;
-
-	iov.iov_len = sk->s_bufsize ? sk->s_bufsize : page_size;
-	iov.iov_base = malloc(iov.iov_len);
+	bufsize = recv_bufsize(sk);
+	if (*buf == NULL || *size < bufsize) {
+		void *tmp;
 
-	if (!iov.iov_base) {
-		retval = -NLE_NOMEM;
-		goto abort;
+		bufsize = max(bufsize, *size);
+		tmp = realloc(*buf, bufsize);
+		if (!tmp) {
+			retval = -NLE_NOMEM;
+			goto abort;
+		}
+		*buf = tmp;
+		*size = bufsize;
 	}
 
+	iov.iov_base = *buf;
+	iov.iov_len = *size;
+
 	if (creds && (sk->s_flags & NL_SOCK_PASSCRED)) {
 		msg.msg_controllen = CMSG_SPACE(sizeof(struct ucred));
 		msg.msg_control = malloc(msg.msg_controllen);
@@ -711,6 +998,10 @@ retry:
 			goto retry;
 		}
 
+		/* Notifications were dropped, see nl_cache_mngr_data_ready() */
+		if (errno == ENOBUFS)
+			sk->s_flags |= NL_SOCK_OVERRUN;
+
 		NL_DBG(4, "recvmsg(%p): nl_recv() failed with %d (%s)\n",
 			sk, errno, nl_strerror_l(errno));
 		retval = -nl_syserr2nlerr(errno);
@@ -755,6 +1046,8 @@ retry:
 			goto abort;
 		}
 		iov.iov_base = tmp;
+		*buf = tmp;
+		*size = iov.iov_len;
 		flags = 0;
 		goto retry;
 	}
@@ -793,12 +1086,9 @@ abort:
 	free(msg.msg_control);
 
 	if (retval <= 0) {
-		free(iov.iov_base);
-		iov.iov_base = NULL;
 		free(tmpcreds);
 		tmpcreds = NULL;
-	} else
-		*buf = iov.iov_base;
+	}
 
 	if (creds)
 		*creds = tmpcreds;
@@ -806,32 +1096,270 @@ abort:
 	return retval;
 }
 
-/** @cond SKIP */
-#define NL_CB_CALL(cb, type, msg) \
-do { \
-	err = nl_cb_call(cb, type, msg); \
-	switch (err) { \
-	case NL_OK: \
-		err = 0; \
-		break; \
-	case NL_SKIP: \
-		goto skip; \
-	case NL_STOP: \
-		goto stop; \
-	default: \
-		goto out; \
-	} \
-} while (0)
-/** @endcond */
-
-static int recvmsgs(struct nl_sock *sk, struct nl_cb *cb)
+/**
+ * Receive data from netlink socket
+ * @arg sk		Netlink socket (required)
+ * @arg nla		Netlink socket structure to hold address of peer (required)
+ * @arg buf		Destination pointer for message content (required)
+ * @arg creds		Destination pointer for credentials (optional)
+ *
+ * Receives data from a connected netlink socket using recvmsg() and returns
+ * the number of bytes read. The read data is stored in a newly allocated
+ * buffer that is assigned to \c *buf. The peer's netlink address will be
+ * stored in \c *nla.
+ *
+ * This function blocks until data is available to be read unless the socket
+ * has been put into non-blocking mode using nl_socket_set_nonblocking() in
+ * which case this function will return immediately with a return value of
+ * -NLA_AGAIN (versions before 3.2.22 returned instead 0, in which case you
+ * should check first clear errno and then check for errno EAGAIN).
+ *
+ * The buffer size used when reading from the netlink socket and thus limiting
+ * the maximum size of a netlink message that can be read defaults to the size
+ * of a memory page (getpagesize()). The buffer size can be modified on a per
+ * socket level using the function nl_socket_set_msg_buf_size().
+ *
+ * If message peeking is enabled using nl_socket_enable_msg_peek() the size of
+ * the message to be read will be determined using the MSG_PEEK flag prior to
+ * performing the actual read. This leads to an additional recvmsg() call for
+ * every read operation which has performance implications and is not
+ * recommended for high throughput protocols.
+ *
+ * An eventual interruption of the recvmsg() system call is automatically
+ * handled by retrying the operation.
+ *
+ * If receiving of credentials has been enabled using the function
+ * nl_socket_set_passcred(), this function will allocate a new struct ucred
+ * filled with the received credentials and assign it to \c *creds. The caller
+ * is responsible for freeing the buffer.
+ *
+ * @note The caller is responsible to free the returned data buffer and if
+ *       enabled, the credentials buffer.
+ *
+ * @see nl_socket_set_nonblocking()
+ * @see nl_socket_set_msg_buf_size()
+ * @see nl_socket_enable_msg_peek()
+ * @see nl_socket_set_passcred()
+ *
+ * @return Number of bytes read, 0 on EOF, 0 on no data event (non-blocking
+ *         mode), or a negative error code.
+ */
+int nl_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+	    unsigned char **buf, struct ucred **creds)
 {
-	int n, err = 0, multipart = 0, interrupted = 0, nrecv = 0;
-	unsigned char *buf = NULL;
-	struct nlmsghdr *hdr;
+	unsigned char *data = NULL;
+	size_t size = 0;
+	int n;
 
-	/*
-	nla is passed on to not only to nl_recv() but may also be passed
+	if (!buf || !nla)
+		return -NLE_INVAL;
+
+	n = __nl_recv(sk, nla, &data, &size, creds);
+	if (n <= 0)
+		free(data);
+	else
+		*buf = data;
+
+	return n;
+}
+
+#ifdef HAVE_RECVMMSG
+/*
+ * Read up to rq_size datagrams with a single recvmmsg() call into the
+ * receive queue of the socket. Buffers still referenced by messages
+ * received in zero-copy mode are replaced, all other buffers are reused.
+ * Truncated datagrams are recorded as -NLE_MSG_TRUNC and cause the
+ * buffers to grow to the observed size for subsequent reads.
+ */
+static int recvq_fill(struct nl_sock *sk)
+{
+	struct nl_recvq *q = &sk->s_recvq;
+	size_t bufsize = max(recv_bufsize(sk), q->rq_bufsize);
+	unsigned int i;
+	int n;
+
+	for (i = 0; i < q->rq_size; i++) {
+		struct nl_recvq_entry *e = &q->rq_entries[i];
+		struct nl_recvbuf *rb = e->re_buf;
+
+		if (!rb || rb->rb_refcnt > 1) {
+			rb = _nl_recvbuf_alloc(NULL, 0);
+			if (!rb)
+				return -NLE_NOMEM;
+
+			_nl_recvbuf_put(e->re_buf);
+			e->re_buf = rb;
+		}
+
+		if (!rb->rb_data || rb->rb_size < bufsize) {
+			void *tmp;
+
+			tmp = realloc(rb->rb_data, bufsize);
+			if (!tmp)
+				return -NLE_NOMEM;
+
+			rb->rb_data = tmp;
+			rb->rb_size = bufsize;
+		}
+
+		q->rq_iov[i].iov_base = rb->rb_data;
+		q->rq_iov[i].iov_len = rb->rb_size;
+
+		memset(&q->rq_mmsg[i], 0, sizeof(q->rq_mmsg[i]));
+		q->rq_mmsg[i].msg_hdr.msg_name = &e->re_addr;
+		q->rq_mmsg[i].msg_hdr.msg_namelen = sizeof(e->re_addr);
+		q->rq_mmsg[i].msg_hdr.msg_iov = &q->rq_iov[i];
+		q->rq_mmsg[i].msg_hdr.msg_iovlen = 1;
+	}
+
+retry:
+	n = recvmmsg(sk->s_fd, q->rq_mmsg, q->rq_size,
+		     MSG_WAITFORONE | MSG_TRUNC, NULL);
+	if (n < 0) {
+		if (errno == EINTR) {
+			NL_DBG(3, "recvmmsg() returned EINTR, retrying\n");
+			goto retry;
+		}
+
+		if (errno == ENOBUFS)
+			sk->s_flags |= NL_SOCK_OVERRUN;
+
+		NL_DBG(4, "recvmmsg(%p): failed with %d (%s)\n",
+			sk, errno, nl_strerror_l(errno));
+		return -nl_syserr2nlerr(errno);
+	}
+
+	for (i = 0; i < n; i++) {
+		struct nl_recvq_entry *e = &q->rq_entries[i];
+		struct msghdr *hdr = &q->rq_mmsg[i].msg_hdr;
+		unsigned int len = q->rq_mmsg[i].msg_len;
+
+		if (len > q->rq_iov[i].iov_len || (hdr->msg_flags & MSG_TRUNC)) {
+			NL_DBG(4, "recvmmsg(%p): datagram of %u bytes truncated\n",
+			       sk, len);
+			q->rq_bufsize = max_t(size_t, q->rq_bufsize, len);
+			e->re_len = -NLE_MSG_TRUNC;
+		} else if (hdr->msg_namelen != sizeof(struct sockaddr_nl))
+			e->re_len = -NLE_NOADDR;
+		else
+			e->re_len = len;
+	}
+
+	NL_DBG(3, "recvmmsg(%p): Read %d datagrams\n", sk, n);
+
+	q->rq_count = n;
+	q->rq_next = 0;
+
+	return n;
+}
+
+static int nl_recv_batch(struct nl_sock *sk, struct sockaddr_nl *nla,
+			 struct nl_recvbuf **result, struct ucred **creds)
+{
+	struct nl_recvq *q = &sk->s_recvq;
+	struct nl_recvq_entry *e;
+	int err;
+
+	if (creds)
+		*creds = NULL;
+
+	if (q->rq_next >= q->rq_count) {
+		q->rq_count = q->rq_next = 0;
+
+		err = recvq_fill(sk);
+		if (err <= 0)
+			return err;
+	}
+
+	e = &q->rq_entries[q->rq_next++];
+	if (e->re_len <= 0)
+		return e->re_len;
+
+	memcpy(nla, &e->re_addr, sizeof(*nla));
+	_nl_recvbuf_get(e->re_buf);
+	*result = e->re_buf;
+
+	return e->re_len;
+}
+
+/* Datagrams read by recvmmsg() but not yet processed */
+static int recvq_pending(struct nl_sock *sk)
+{
+	return sk->s_recvq.rq_next < sk->s_recvq.rq_count;
+}
+#else
+static int recvq_pending(struct nl_sock *sk)
+{
+	return 0;
+}
+#endif
+
+/*
+ * Receive a datagram into the receive buffer of the socket. The buffer is
+ * reused for subsequent reads as long as no message received in zero-copy
+ * mode is referencing it anymore. A replacement buffer inherits the size
+ * the previous buffer has grown to. Returns a new reference to the buffer
+ * in *result on success.
+ */
+static int nl_recv_rbuf(struct nl_sock *sk, struct sockaddr_nl *nla,
+			struct nl_recvbuf **result, struct ucred **creds)
+{
+	struct nl_recvbuf *rb = sk->s_rbuf;
+	int n;
+
+#ifdef HAVE_RECVMMSG
+	/* Credentials are only received in single datagram mode */
+	if (sk->s_recvq.rq_size > 1 &&
+	    !(creds && (sk->s_flags & NL_SOCK_PASSCRED)))
+		return nl_recv_batch(sk, nla, result, creds);
+#endif
+
+	if (!rb || rb->rb_refcnt > 1) {
+		rb = _nl_recvbuf_alloc(NULL, rb ? rb->rb_size : 0);
+		if (!rb)
+			return -NLE_NOMEM;
+
+		_nl_recvbuf_put(sk->s_rbuf);
+		sk->s_rbuf = rb;
+	}
+
+	n = __nl_recv(sk, nla, &rb->rb_data, &rb->rb_size, creds);
+	if (n <= 0)
+		return n;
+
+	_nl_recvbuf_get(rb);
+	*result = rb;
+
+	return n;
+}
+
+/** @cond SKIP */
+#define NL_CB_CALL(cb, type, msg) \
+do { \
+	err = nl_cb_call(cb, type, msg); \
+	switch (err) { \
+	case NL_OK: \
+		err = 0; \
+		break; \
+	case NL_SKIP: \
+		goto skip; \
+	case NL_STOP: \
+		goto stop; \
+	default: \
+		goto out; \
+	} \
+} while (0)
+/** @endcond */
+
+static int recvmsgs(struct nl_sock *sk, struct nl_cb *cb)
+{
+	int n, err = 0, multipart = 0, interrupted = 0, truncated = 0, nrecv = 0;
+	unsigned char *buf = NULL;
+	struct nl_recvbuf *rbuf = NULL;
+	struct nlmsghdr *hdr;
+
+	/*
+	nla is passed on to not only to nl_recv() but may also be passed
 	to a function pointer provided by the caller which may or may not
 	initialize the variable. Thomas Graf.
 	*/
@@ -844,19 +1372,43 @@ continue_reading:
 	if (cb->cb_recv_ow)
 		n = cb->cb_recv_ow(sk, &nla, &buf, &creds);
 	else
-		n = nl_recv(sk, &nla, &buf, &creds);
+		n = nl_recv_rbuf(sk, &nla, &rbuf, &creds);
+
+	/* A truncated datagram of a batch is lost, the datagrams read
+	 * along with it are still processed and the loss is reported
+	 * afterwards. */
+	if (n == -NLE_MSG_TRUNC && !cb->cb_recv_ow && recvq_pending(sk)) {
+		truncated = 1;
+		goto continue_reading;
+	}
 
 	if (n <= 0)
 		return n;
 
 	NL_DBG(3, "recvmsgs(%p): Read %d bytes\n", sk, n);
 
-	hdr = (struct nlmsghdr *) buf;
+	/* In zero-copy mode the messages handed to the callbacks reference
+	 * the receive buffer directly, the buffer is released once the last
+	 * message referencing it has been freed. */
+	if (!rbuf && (sk->s_flags & NL_MSG_ZEROCOPY)) {
+		rbuf = _nl_recvbuf_alloc(buf, n);
+		if (!rbuf) {
+			err = -NLE_NOMEM;
+			goto out;
+		}
+		buf = NULL;
+	}
+
+	hdr = (struct nlmsghdr *) (rbuf ? rbuf->rb_data : buf);
+
 	while (nlmsg_ok(hdr, n)) {
 		NL_DBG(3, "recvmsgs(%p): Processing valid message...\n", sk);
 
 		nlmsg_free(msg);
-		msg = nlmsg_convert(hdr);
+		if (sk->s_flags & NL_MSG_ZEROCOPY)
+			msg = _nlmsg_view(rbuf, hdr);
+		else
+			msg = nlmsg_convert(hdr);
 		if (!msg) {
 			err = -NLE_NOMEM;
 			goto out;
@@ -980,6 +1532,9 @@ continue_reading:
 			} else if (e->error) {
 				NL_DBG(4, "recvmsgs(%p): RTNETLINK responded with %d (%s)\n",
 					sk, -e->error, nl_strerror_l(-e->error));
+				if (nlmsg_ext_ack_msg(e))
+					NL_DBG(4, "recvmsgs(%p): Extended ACK: %s\n",
+					       sk, nlmsg_ext_ack_msg(e));
 
 				/* Error message reported back from kernel. */
 				if (cb->cb_err) {
@@ -1013,8 +1568,10 @@ skip:
 
 	nlmsg_free(msg);
 	free(buf);
+	_nl_recvbuf_put(rbuf);
 	free(creds);
 	buf = NULL;
+	rbuf = NULL;
 	msg = NULL;
 	creds = NULL;
 
@@ -1022,15 +1579,23 @@ skip:
 		/* Multipart message not yet complete, continue reading */
 		goto continue_reading;
 	}
+
+	/* Datagrams queued in user space are invisible to poll(), process
+	 * all datagrams of a batch before returning. */
+	if (!cb->cb_recv_ow && recvq_pending(sk))
+		goto continue_reading;
 stop:
 	err = 0;
 out:
 	nlmsg_free(msg);
 	free(buf);
+	_nl_recvbuf_put(rbuf);
 	free(creds);
 
 	if (interrupted)
 		err = -NLE_DUMP_INTR;
+	else if (truncated && err >= 0)
+		err = -NLE_MSG_TRUNC;
 
 	if (!err)
 		err = nrecv;
@@ -1229,6 +1794,516 @@ errout:
 
 /** @} */
 
+/**
+ * @name Pipelined Requests
+ * @{
+ */
+
+/** @cond SKIP */
+#define NL_SEQTBL_MIN	16
+
+/*
+ * Sequence numbers of outstanding requests are mostly consecutive, the
+ * low bits therefore serve as hash and collisions are resolved by linear
+ * probing.
+ */
+static inline unsigned int seqtbl_slot(struct nl_seqtbl *tbl, uint32_t seq)
+{
+	return seq & (tbl->st_size - 1);
+}
+
+static void seqtbl_free(struct nl_seqtbl *tbl)
+{
+	free(tbl->st_entries);
+	tbl->st_entries = NULL;
+	tbl->st_size = 0;
+	tbl->st_count = 0;
+}
+
+static int seqtbl_resize(struct nl_seqtbl *tbl, unsigned int size)
+{
+	struct nl_seqtbl_entry *old = tbl->st_entries;
+	unsigned int i, oldsize = tbl->st_size;
+
+	tbl->st_entries = calloc(size, sizeof(*tbl->st_entries));
+	if (!tbl->st_entries) {
+		tbl->st_entries = old;
+		return -NLE_NOMEM;
+	}
+
+	tbl->st_size = size;
+
+	for (i = 0; i < oldsize; i++) {
+		unsigned int n;
+
+		if (!old[i].se_data)
+			continue;
+
+		n = seqtbl_slot(tbl, old[i].se_seq);
+		while (tbl->st_entries[n].se_data)
+			n = (n + 1) & (size - 1);
+
+		tbl->st_entries[n] = old[i];
+	}
+
+	free(old);
+
+	return 0;
+}
+
+static int seqtbl_insert(struct nl_seqtbl *tbl, uint32_t seq, void *data)
+{
+	unsigned int n;
+	int err;
+
+	if ((tbl->st_count + 1) * 2 > tbl->st_size) {
+		err = seqtbl_resize(tbl, tbl->st_size ? tbl->st_size * 2
+						      : NL_SEQTBL_MIN);
+		if (err < 0)
+			return err;
+	}
+
+	n = seqtbl_slot(tbl, seq);
+	while (tbl->st_entries[n].se_data) {
+		if (tbl->st_entries[n].se_seq == seq)
+			return -NLE_EXIST;
+		n = (n + 1) & (tbl->st_size - 1);
+	}
+
+	tbl->st_entries[n].se_seq = seq;
+	tbl->st_entries[n].se_data = data;
+	tbl->st_count++;
+
+	return 0;
+}
+
+static void *seqtbl_lookup(struct nl_seqtbl *tbl, uint32_t seq)
+{
+	unsigned int n;
+
+	if (!tbl->st_count)
+		return NULL;
+
+	n = seqtbl_slot(tbl, seq);
+	while (tbl->st_entries[n].se_data) {
+		if (tbl->st_entries[n].se_seq == seq)
+			return tbl->st_entries[n].se_data;
+		n = (n + 1) & (tbl->st_size - 1);
+	}
+
+	return NULL;
+}
+
+static void *seqtbl_remove(struct nl_seqtbl *tbl, uint32_t seq)
+{
+	unsigned int i, j, k, mask = tbl->st_size - 1;
+	void *data;
+
+	if (!tbl->st_count)
+		return NULL;
+
+	i = seqtbl_slot(tbl, seq);
+	while (tbl->st_entries[i].se_seq != seq) {
+		if (!tbl->st_entries[i].se_data)
+			return NULL;
+		i = (i + 1) & mask;
+	}
+
+	if (!(data = tbl->st_entries[i].se_data))
+		return NULL;
+
+	/* Shift subsequent entries of the probe sequence back into the
+	 * hole unless this would move them in front of their home slot. */
+	for (j = (i + 1) & mask; tbl->st_entries[j].se_data; j = (j + 1) & mask) {
+		k = seqtbl_slot(tbl, tbl->st_entries[j].se_seq);
+		if (((j - k) & mask) >= ((j - i) & mask)) {
+			tbl->st_entries[i] = tbl->st_entries[j];
+			i = j;
+		}
+	}
+
+	tbl->st_entries[i].se_data = NULL;
+	tbl->st_count--;
+
+	return data;
+}
+
+struct pipeline_param
+{
+	struct nl_seqtbl	pp_tbl;
+	unsigned int		pp_failed;
+};
+
+static void pipeline_complete(struct pipeline_param *pp, uint32_t seq,
+			      int error)
+{
+	int *result;
+
+	if (!(result = seqtbl_remove(&pp->pp_tbl, seq))) {
+		NL_DBG(3, "pipeline: No request pending for sequence number %u\n",
+		       seq);
+		return;
+	}
+
+	*result = error;
+	if (error)
+		pp->pp_failed++;
+}
+
+static int pipeline_seq_check(struct nl_msg *msg, void *arg)
+{
+	/* Replies are matched against the completion table instead */
+	return NL_OK;
+}
+
+static int pipeline_ack(struct nl_msg *msg, void *arg)
+{
+	pipeline_complete(arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+
+	return NL_OK;
+}
+
+static int pipeline_error(struct sockaddr_nl *nla, struct nlmsgerr *e,
+			  void *arg)
+{
+	pipeline_complete(arg, e->msg.nlmsg_seq, -nl_syserr2nlerr(e->error));
+
+	return NL_SKIP;
+}
+/** @endcond */
+
+/**
+ * Transmit requests while keeping multiple requests in flight
+ * @arg sk		Netlink socket (required)
+ * @arg msgs		Array of Netlink messages (required)
+ * @arg nmsgs		Number of messages in array
+ * @arg window		Maximum number of requests in flight
+ * @arg results		Array receiving the result of every request (required)
+ *
+ * Transmits all messages, each finalized with nl_complete_msg() and
+ * with an ACK requested, but does not wait for a request to be
+ * acknowledged before transmitting the next one. Instead, up to \p window
+ * requests are kept outstanding at any time and ACKs and error messages
+ * are matched to their originating request by sequence number as they
+ * arrive, regardless of their order. The result of the request
+ * \p msgs[i] is stored in \p results[i], 0 if it was acknowledged or the
+ * negative error code reported by the kernel. Messages are transmitted
+ * in batches with nl_send_batch().
+ *
+ * Replies other than ACKs and error messages, e.g. as requested with
+ * `NLM_F_ECHO`, are passed to the callbacks configured in the socket.
+ * Requests must not be dump requests. Since the kernel drops ACKs
+ * exceeding the receive buffer of the socket, the window should not
+ * exceed the number of ACKs fitting into the receive buffer.
+ *
+ * @pre The netlink socket must be in blocking state.
+ *
+ * @note If the function fails, all requests not yet completed are marked
+ *       with the returned error code in \p results. ACKs of such requests
+ *       may still arrive later on.
+ *
+ * @return Number of failed requests or a negative error code.
+ */
+int nl_send_pipelined(struct nl_sock *sk, struct nl_msg **msgs,
+		      unsigned int nmsgs, unsigned int window, int *results)
+{
+	struct pipeline_param pp = { .pp_failed = 0 };
+	struct nl_msg_batch *batch;
+	struct nl_cb *cb;
+	unsigned int i, next = 0;
+	int err = 0;
+
+	if (window == 0)
+		return -NLE_INVAL;
+
+	if (nmsgs == 0)
+		return 0;
+
+	cb = nl_cb_clone(sk->s_cb);
+	batch = nl_msg_batch_alloc();
+	if (!cb || !batch) {
+		err = -NLE_NOMEM;
+		goto errout;
+	}
+
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, pipeline_seq_check, &pp);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, pipeline_ack, &pp);
+	nl_cb_err(cb, NL_CB_CUSTOM, pipeline_error, &pp);
+
+	while (next < nmsgs || pp.pp_tbl.st_count > 0) {
+		while (next < nmsgs && pp.pp_tbl.st_count < window) {
+			struct nl_msg *msg = msgs[next];
+
+			if ((err = nl_msg_batch_add(sk, batch, msg)) < 0)
+				goto errout;
+
+			nlmsg_hdr(msg)->nlmsg_flags |= NLM_F_ACK;
+
+			err = seqtbl_insert(&pp.pp_tbl, nlmsg_hdr(msg)->nlmsg_seq,
+					    &results[next]);
+			if (err < 0)
+				goto errout;
+
+			next++;
+		}
+
+		if (nl_msg_batch_count(batch) > 0 &&
+		    (err = nl_send_batch(sk, batch)) < 0)
+			goto errout;
+
+		if ((err = nl_recvmsgs(sk, cb)) < 0)
+			goto errout;
+	}
+
+	err = pp.pp_failed;
+
+errout:
+	if (err < 0) {
+		for (i = 0; i < pp.pp_tbl.st_size; i++) {
+			int *result = pp.pp_tbl.st_entries[i].se_data;
+
+			if (result)
+				*result = err;
+		}
+
+		for (i = next; i < nmsgs; i++)
+			results[i] = err;
+	}
+
+	/* Every request completed is accounted for by recvmsgs() already,
+	 * resynchronize for requests lost on failure. */
+	sk->s_seq_expect = sk->s_seq_next;
+
+	seqtbl_free(&pp.pp_tbl);
+	nl_msg_batch_free(batch);
+	nl_cb_put(cb);
+
+	return err;
+}
+
+/** @} */
+
+/**
+ * @name Asynchronous Requests
+ *
+ * Requests submitted with nl_request_submit() are transmitted right away
+ * but their replies are processed later on, whenever the application's
+ * event loop reports the socket file descriptor as readable and calls
+ * nl_process_ready(). Any number of requests may be outstanding at the
+ * same time, replies are matched to their request by sequence number.
+ *
+ * @code
+ * nl_socket_set_nonblocking(sk);
+ * nl_request_submit(sk, msg, parse_reply, request_done, arg, NULL);
+ *
+ * // event loop, e.g. epoll_wait() on nl_socket_get_fd(sk)
+ * nl_process_ready(sk);
+ * @endcode
+ * @{
+ */
+
+/** @cond SKIP */
+void _nl_socket_requests_free(struct nl_sock *sk)
+{
+	unsigned int i;
+
+	for (i = 0; i < sk->s_requests.st_size; i++)
+		free(sk->s_requests.st_entries[i].se_data);
+
+	seqtbl_free(&sk->s_requests);
+}
+
+static void request_complete(struct nl_sock *sk, uint32_t seq, int error)
+{
+	struct nl_request *req;
+
+	if (!(req = seqtbl_remove(&sk->s_requests, seq)))
+		return;
+
+	NL_DBG(3, "nl_process_ready(%p): Request %u completed with %d\n",
+	       sk, seq, error);
+
+	if (req->nr_done)
+		req->nr_done(req, error, req->nr_arg);
+
+	free(req);
+}
+
+static int request_reply(struct nl_msg *msg, void *arg)
+{
+	struct nl_sock *sk = arg;
+	struct nl_request *req;
+
+	req = seqtbl_lookup(&sk->s_requests, nlmsg_hdr(msg)->nlmsg_seq);
+	if (req) {
+		if (req->nr_reply)
+			return req->nr_reply(msg, req->nr_arg);
+		return NL_OK;
+	}
+
+	/* Not a reply to a pending request, e.g. a notification */
+	if (sk->s_cb->cb_set[NL_CB_VALID])
+		return nl_cb_call(sk->s_cb, NL_CB_VALID, msg);
+
+	return NL_OK;
+}
+
+static int request_ack(struct nl_msg *msg, void *arg)
+{
+	request_complete(arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+
+	return NL_OK;
+}
+
+static int request_error(struct sockaddr_nl *nla, struct nlmsgerr *e,
+			 void *arg)
+{
+	request_complete(arg, e->msg.nlmsg_seq, -nl_syserr2nlerr(e->error));
+
+	return NL_SKIP;
+}
+/** @endcond */
+
+/**
+ * Submit an asynchronous request
+ * @arg sk		Netlink socket (required)
+ * @arg msg		Netlink message (required)
+ * @arg reply		Callback for every reply message (optional)
+ * @arg done		Callback invoked once the request completed (optional)
+ * @arg arg		Argument passed on to the callbacks
+ * @arg result		Result pointer to return the request handle (optional)
+ *
+ * Finalizes the message with nl_complete_msg(), requests an ACK and
+ * transmits it without waiting for the reply. Reply messages of the
+ * request are passed to \p reply, the request is completed by an ACK,
+ * an error message or, for dump requests, by the end of the dump,
+ * upon which \p done is called with 0 or the negative error code
+ * reported by the kernel. Callbacks are only invoked from within
+ * nl_process_ready().
+ *
+ * The request handle remains valid until the request has been
+ * completed or cancelled. The caller keeps its reference to the message.
+ *
+ * @note The kernel processes only one dump request per socket at a time,
+ *       further dump requests fail with -NLE_BUSY until the dump in
+ *       progress has been completed.
+ *
+ * @see nl_process_ready()
+ * @see nl_request_cancel()
+ *
+ * @return 0 on success or a negative error code.
+ */
+int nl_request_submit(struct nl_sock *sk, struct nl_msg *msg,
+		      nl_recvmsg_msg_cb_t reply, nl_request_done_cb_t done,
+		      void *arg, struct nl_request **result)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	struct nl_request *req;
+	int err;
+
+	req = calloc(1, sizeof(*req));
+	if (!req)
+		return -NLE_NOMEM;
+
+	nl_complete_msg(sk, msg);
+	nlh->nlmsg_flags |= NLM_F_ACK;
+
+	req->nr_seq = nlh->nlmsg_seq;
+	req->nr_reply = reply;
+	req->nr_done = done;
+	req->nr_arg = arg;
+
+	if ((err = seqtbl_insert(&sk->s_requests, req->nr_seq, req)) < 0)
+		goto errout;
+
+	if ((err = nl_send(sk, msg)) < 0) {
+		seqtbl_remove(&sk->s_requests, req->nr_seq);
+		goto errout;
+	}
+
+	if (result)
+		*result = req;
+
+	return 0;
+
+errout:
+	free(req);
+	return err;
+}
+
+/**
+ * Cancel an asynchronous request
+ * @arg sk		Netlink socket
+ * @arg req		Request handle
+ *
+ * Releases the request without invoking its callbacks. Replies arriving
+ * for the request later on are treated as unsolicited messages. Has no
+ * effect if called for a request from within its completion callback.
+ */
+void nl_request_cancel(struct nl_sock *sk, struct nl_request *req)
+{
+	if (seqtbl_lookup(&sk->s_requests, req->nr_seq) != req)
+		return;
+
+	seqtbl_remove(&sk->s_requests, req->nr_seq);
+	free(req);
+}
+
+/**
+ * Return number of outstanding asynchronous requests
+ * @arg sk		Netlink socket
+ */
+unsigned int nl_request_pending(struct nl_sock *sk)
+{
+	return sk->s_requests.st_count;
+}
+
+/**
+ * Process all messages available on a netlink socket
+ * @arg sk		Netlink socket
+ * @pre The netlink socket must be in non-blocking state.
+ *
+ * Reads and processes all messages waiting in the socket and invokes
+ * the callbacks of the asynchronous requests they belong to. Messages
+ * not belonging to an outstanding request, e.g. notifications, are
+ * handed to the `NL_CB_VALID` callback configured in the socket.
+ *
+ * This function is meant to be called whenever the socket file
+ * descriptor (see nl_socket_get_fd()) becomes readable.
+ *
+ * @see nl_request_submit()
+ *
+ * @return Number of messages processed or a negative error code.
+ */
+int nl_process_ready(struct nl_sock *sk)
+{
+	struct nl_cb *cb;
+	int n, nread = 0;
+
+	cb = nl_cb_clone(sk->s_cb);
+	if (!cb)
+		return -NLE_NOMEM;
+
+	/* Replies are matched against outstanding requests instead */
+	nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, pipeline_seq_check, NULL);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, request_reply, sk);
+	nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, request_ack, sk);
+	nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, request_ack, sk);
+	nl_cb_err(cb, NL_CB_CUSTOM, request_error, sk);
+
+	while ((n = nl_recvmsgs_report(sk, cb)) > 0)
+		nread += n;
+
+	nl_cb_put(cb);
+
+	if (n < 0 && n != -NLE_AGAIN)
+		return n;
+
+	return nread;
+}
+
+/** @} */
+
 /**
  * @name Deprecated
  * @{
@@ -565,6 +565,20 @@ uint32_t nl_object_get_id_attrs(struct nl_object *obj)
 	return id_attrs;
 }
 
+/**
+ * Return mask of attributes set in object
+ * @arg obj		object
+ *
+ * The mask can be used to describe a set of attributes by example,
+ * e.g. for nl_cache_add_index().
+ *
+ * @return attribute mask
+ */
+uint64_t nl_object_get_attrs(const struct nl_object *obj)
+{
+	return obj->ce_mask;
+}
+
 /** @} */
 
 /** @} */
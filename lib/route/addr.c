@@ -108,12 +108,14 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
 #include <netlink/netlink.h>
 #include <netlink/route/rtnl.h>
 #include <netlink/route/addr.h>
 #include <netlink/route/route.h>
 #include <netlink/route/link.h>
 #include <netlink/utils.h>
+#include <netlink-private/hash.h>
 
 /** @cond SKIP */
 #define ADDR_ATTR_FAMILY	0x0001
@@ -148,11 +150,11 @@ static void addr_free_data(struct nl_object *obj)
 	if (!addr)
 		return;
 
-	nl_addr_put(addr->a_peer);
-	nl_addr_put(addr->a_local);
-	nl_addr_put(addr->a_bcast);
-	nl_addr_put(addr->a_multicast);
-	nl_addr_put(addr->a_anycast);
+	nl_inline_addr_release(&addr->a_peer);
+	nl_inline_addr_release(&addr->a_local);
+	nl_inline_addr_release(&addr->a_bcast);
+	nl_inline_addr_release(&addr->a_multicast);
+	nl_inline_addr_release(&addr->a_anycast);
 	rtnl_link_put(addr->a_link);
 }
 
@@ -160,33 +162,27 @@ static int addr_clone(struct nl_object *_dst, struct nl_object *_src)
 {
 	struct rtnl_addr *dst = nl_object_priv(_dst);
 	struct rtnl_addr *src = nl_object_priv(_src);
+	int err;
 
 	if (src->a_link) {
 		nl_object_get(OBJ_CAST(src->a_link));
 		dst->a_link = src->a_link;
 	}
 
-	if (src->a_peer)
-		if (!(dst->a_peer = nl_addr_clone(src->a_peer)))
-			return -NLE_NOMEM;
-	
-	if (src->a_local)
-		if (!(dst->a_local = nl_addr_clone(src->a_local)))
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->a_peer, &src->a_peer)) < 0)
+		return err;
 
-	if (src->a_bcast)
-		if (!(dst->a_bcast = nl_addr_clone(src->a_bcast)))
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->a_local, &src->a_local)) < 0)
+		return err;
 
-	if (src->a_multicast)
-		if (!(dst->a_multicast = nl_addr_clone(src->a_multicast)))
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->a_bcast, &src->a_bcast)) < 0)
+		return err;
 
-	if (src->a_anycast)
-		if (!(dst->a_anycast = nl_addr_clone(src->a_anycast)))
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->a_multicast,
+					&src->a_multicast)) < 0)
+		return err;
 
-	return 0;
+	return nl_inline_addr_clone(&dst->a_anycast, &src->a_anycast);
 }
 
 static struct nla_policy addr_policy[IFA_MAX+1] = {
@@ -205,7 +201,7 @@ static int addr_msg_parser(struct nl_cache_ops *ops, struct sockaddr_nl *who,
 	struct nlattr *tb[IFA_MAX+1];
 	int err, family;
 	struct nl_cache *link_cache;
-	struct nl_addr *plen_addr = NULL;
+	struct nl_inline_addr *plen_addr = NULL;
 
 	addr = rtnl_addr_alloc();
 	if (!addr)
@@ -256,93 +252,100 @@ static int addr_msg_parser(struct nl_cache_ops *ops, struct sockaddr_nl *who,
 		/* for IPv4/AF_INET, kernel always sets IFA_LOCAL and IFA_ADDRESS, unless it
 		 * is effectively 0.0.0.0. */
 		if (tb[IFA_LOCAL])
-			addr->a_local = nl_addr_alloc_attr(tb[IFA_LOCAL], family);
+			err = nl_inline_addr_set_attr(&addr->a_local,
+						      tb[IFA_LOCAL], family);
 		else
-			addr->a_local = nl_addr_build(family, &null, sizeof (null));
-		if (!addr->a_local)
-			goto errout_nomem;
+			err = nl_inline_addr_set_data(&addr->a_local, family,
+						      &null, sizeof(null),
+						      8 * sizeof(null));
+		if (err < 0)
+			goto errout;
 		addr->ce_mask |= ADDR_ATTR_LOCAL;
 
 		if (tb[IFA_ADDRESS])
-			addr->a_peer = nl_addr_alloc_attr(tb[IFA_ADDRESS], family);
+			err = nl_inline_addr_set_attr(&addr->a_peer,
+						      tb[IFA_ADDRESS], family);
 		else
-			addr->a_peer = nl_addr_build(family, &null, sizeof (null));
-		if (!addr->a_peer)
-			goto errout_nomem;
+			err = nl_inline_addr_set_data(&addr->a_peer, family,
+						      &null, sizeof(null),
+						      8 * sizeof(null));
+		if (err < 0)
+			goto errout;
 
-		if (!nl_addr_cmp (addr->a_local, addr->a_peer)) {
+		if (!nl_inline_addr_cmp(&addr->a_local, &addr->a_peer)) {
 			/* having IFA_ADDRESS equal to IFA_LOCAL does not really mean
 			 * there is no peer. It means the peer is equal to the local address,
 			 * which is the case for "normal" addresses.
 			 *
 			 * Still, clear the peer and pretend it is unset for backward
 			 * compatibility. */
-			nl_addr_put(addr->a_peer);
-			addr->a_peer = NULL;
+			nl_inline_addr_release(&addr->a_peer);
 		} else
 			addr->ce_mask |= ADDR_ATTR_PEER;
 
-		plen_addr = addr->a_local;
+		plen_addr = &addr->a_local;
 	} else {
 		if (tb[IFA_LOCAL]) {
-			addr->a_local = nl_addr_alloc_attr(tb[IFA_LOCAL], family);
-			if (!addr->a_local)
-				goto errout_nomem;
+			err = nl_inline_addr_set_attr(&addr->a_local,
+						      tb[IFA_LOCAL], family);
+			if (err < 0)
+				goto errout;
 			addr->ce_mask |= ADDR_ATTR_LOCAL;
-			plen_addr = addr->a_local;
+			plen_addr = &addr->a_local;
 		}
 
 		if (tb[IFA_ADDRESS]) {
-			struct nl_addr *a;
-
-			a = nl_addr_alloc_attr(tb[IFA_ADDRESS], family);
-			if (!a)
-				goto errout_nomem;
-
 			/* IPv6 sends the local address as IFA_ADDRESS with
 			 * no IFA_LOCAL, IPv4 sends both IFA_LOCAL and IFA_ADDRESS
 			 * with IFA_ADDRESS being the peer address if they differ */
-			if (!tb[IFA_LOCAL] || !nl_addr_cmp(a, addr->a_local)) {
-				nl_addr_put(addr->a_local);
-				addr->a_local = a;
+			if (!tb[IFA_LOCAL] ||
+			    !nla_memcmp(tb[IFA_ADDRESS], nla_data(tb[IFA_LOCAL]),
+					nla_len(tb[IFA_LOCAL]))) {
+				plen_addr = &addr->a_local;
 				addr->ce_mask |= ADDR_ATTR_LOCAL;
 			} else {
-				addr->a_peer = a;
+				plen_addr = &addr->a_peer;
 				addr->ce_mask |= ADDR_ATTR_PEER;
 			}
 
-			plen_addr = a;
+			err = nl_inline_addr_set_attr(plen_addr,
+						      tb[IFA_ADDRESS], family);
+			if (err < 0)
+				goto errout;
 		}
 	}
 
-	if (plen_addr)
-		nl_addr_set_prefixlen(plen_addr, addr->a_prefixlen);
+	if (plen_addr &&
+	    (err = nl_inline_addr_set_prefixlen(plen_addr,
+						addr->a_prefixlen)) < 0)
+		goto errout;
 
 	/* IPv4 only */
 	if (tb[IFA_BROADCAST]) {
-		addr->a_bcast = nl_addr_alloc_attr(tb[IFA_BROADCAST], family);
-		if (!addr->a_bcast)
-			goto errout_nomem;
+		err = nl_inline_addr_set_attr(&addr->a_bcast,
+					      tb[IFA_BROADCAST], family);
+		if (err < 0)
+			goto errout;
 
 		addr->ce_mask |= ADDR_ATTR_BROADCAST;
 	}
 
 	/* IPv6 only */
 	if (tb[IFA_MULTICAST]) {
-		addr->a_multicast = nl_addr_alloc_attr(tb[IFA_MULTICAST],
-						       family);
-		if (!addr->a_multicast)
-			goto errout_nomem;
+		err = nl_inline_addr_set_attr(&addr->a_multicast,
+					      tb[IFA_MULTICAST], family);
+		if (err < 0)
+			goto errout;
 
 		addr->ce_mask |= ADDR_ATTR_MULTICAST;
 	}
 
 	/* IPv6 only */
 	if (tb[IFA_ANYCAST]) {
-		addr->a_anycast = nl_addr_alloc_attr(tb[IFA_ANYCAST],
-						       family);
-		if (!addr->a_anycast)
-			goto errout_nomem;
+		err = nl_inline_addr_set_attr(&addr->a_anycast,
+					      tb[IFA_ANYCAST], family);
+		if (err < 0)
+			goto errout;
 
 		addr->ce_mask |= ADDR_ATTR_ANYCAST;
 	}
@@ -363,15 +366,26 @@ errout:
 	rtnl_addr_put(addr);
 
 	return err;
-
-errout_nomem:
-	err = -NLE_NOMEM;
-	goto errout;
 }
 
 static int addr_request_update(struct nl_cache *cache, struct nl_sock *sk)
 {
-	return nl_rtgen_request(sk, RTM_GETADDR, AF_UNSPEC, NLM_F_DUMP);
+	struct rtnl_addr *filter;
+	struct ifaddrmsg hdr = {
+		.ifa_family = AF_UNSPEC,
+	};
+
+	filter = (struct rtnl_addr *) _nl_cache_dump_filter(cache, sk);
+	if (!filter)
+		return nl_rtgen_request(sk, RTM_GETADDR, AF_UNSPEC, NLM_F_DUMP);
+
+	/* Strict checking requires a complete ifaddrmsg header */
+	if (filter->ce_mask & ADDR_ATTR_FAMILY)
+		hdr.ifa_family = filter->a_family;
+	if (filter->ce_mask & ADDR_ATTR_IFINDEX)
+		hdr.ifa_index = filter->a_ifindex;
+
+	return nl_send_simple(sk, RTM_GETADDR, NLM_F_DUMP, &hdr, sizeof(hdr));
 }
 
 static void addr_dump_line(struct nl_object *obj, struct nl_dump_params *p)
@@ -384,13 +398,13 @@ static void addr_dump_line(struct nl_object *obj, struct nl_dump_params *p)
 
 	if (addr->ce_mask & ADDR_ATTR_LOCAL)
 		nl_dump_line(p, "%s",
-			nl_addr2str(addr->a_local, buf, sizeof(buf)));
+			nl_inline_addr2str(&addr->a_local, buf, sizeof(buf)));
 	else
 		nl_dump_line(p, "none");
 
 	if (addr->ce_mask & ADDR_ATTR_PEER)
 		nl_dump(p, " peer %s",
-			nl_addr2str(addr->a_peer, buf, sizeof(buf)));
+			nl_inline_addr2str(&addr->a_peer, buf, sizeof(buf)));
 
 	nl_dump(p, " %s ", nl_af2str(addr->a_family, buf, sizeof(buf)));
 
@@ -430,17 +444,17 @@ static void addr_dump_details(struct nl_object *obj, struct nl_dump_params *p)
 
 		if (addr->ce_mask & ADDR_ATTR_BROADCAST)
 			nl_dump(p, " broadcast %s",
-				nl_addr2str(addr->a_bcast, buf, sizeof(buf)));
+				nl_inline_addr2str(&addr->a_bcast, buf, sizeof(buf)));
 
 		if (addr->ce_mask & ADDR_ATTR_MULTICAST)
 			nl_dump(p, " multicast %s",
-				nl_addr2str(addr->a_multicast, buf,
-					      sizeof(buf)));
+				nl_inline_addr2str(&addr->a_multicast, buf,
+						   sizeof(buf)));
 
 		if (addr->ce_mask & ADDR_ATTR_ANYCAST)
 			nl_dump(p, " anycast %s",
-				nl_addr2str(addr->a_anycast, buf,
-					      sizeof(buf)));
+				nl_inline_addr2str(&addr->a_anycast, buf,
+						   sizeof(buf)));
 
 		nl_dump(p, "\n");
 	}
@@ -482,7 +496,7 @@ static uint32_t addr_id_attrs_get(struct nl_object *obj)
 	case AF_INET:
 		rv = (ADDR_ATTR_FAMILY | ADDR_ATTR_IFINDEX |
 		      ADDR_ATTR_LOCAL | ADDR_ATTR_PREFIXLEN);
-		if (addr->a_peer)
+		if (nl_inline_addr_isset(&addr->a_peer))
 			rv |= ADDR_ATTR_PEER;
 		return rv;
 	case AF_INET6:
@@ -494,6 +508,23 @@ static uint32_t addr_id_attrs_get(struct nl_object *obj)
 	}
 }
 
+static void addr_keygen(struct nl_object *obj, uint32_t *hashkey,
+			uint32_t table_sz)
+{
+	struct rtnl_addr *addr = (struct rtnl_addr *) obj;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, addr->a_family);
+	nl_hasher_u32(&h, addr->a_ifindex);
+	nl_inline_addr_hash(&h, &addr->a_local);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "addr %p key (fam %d dev %d) hash 0x%x\n",
+	       addr, addr->a_family, addr->a_ifindex, *hashkey);
+}
+
 static uint64_t addr_compare(struct nl_object *_a, struct nl_object *_b,
 			     uint64_t attrs, int flags)
 {
@@ -511,21 +542,25 @@ static uint64_t addr_compare(struct nl_object *_a, struct nl_object *_b,
 		if (   (flags & ID_COMPARISON)
 		    && a->a_family == AF_INET
 		    && b->a_family == AF_INET
-		    && a->a_peer
-		    && b->a_peer
+		    && nl_inline_addr_isset(&a->a_peer)
+		    && nl_inline_addr_isset(&b->a_peer)
 		    && a->a_prefixlen == b->a_prefixlen) {
 			/* when comparing two IPv4 addresses for id-equality, the network part
 			 * of the PEER address shall be compared.
 			 */
-			diff |= ADDR_DIFF(PEER, nl_addr_cmp_prefix(a->a_peer, b->a_peer));
+			diff |= ADDR_DIFF(PEER, nl_inline_addr_cmp_prefix(&a->a_peer,
+								    &b->a_peer));
 		} else
-			diff |= ADDR_DIFF(PEER, nl_addr_cmp(a->a_peer, b->a_peer));
+			diff |= ADDR_DIFF(PEER, nl_inline_addr_cmp(&a->a_peer,
+								     &b->a_peer));
 	}
-	diff |= ADDR_DIFF(LOCAL,	nl_addr_cmp(a->a_local, b->a_local));
-	diff |= ADDR_DIFF(MULTICAST,	nl_addr_cmp(a->a_multicast,
-						    b->a_multicast));
-	diff |= ADDR_DIFF(BROADCAST,	nl_addr_cmp(a->a_bcast, b->a_bcast));
-	diff |= ADDR_DIFF(ANYCAST,	nl_addr_cmp(a->a_anycast, b->a_anycast));
+	diff |= ADDR_DIFF(LOCAL,	nl_inline_addr_cmp(&a->a_local, &b->a_local));
+	diff |= ADDR_DIFF(MULTICAST,	nl_inline_addr_cmp(&a->a_multicast,
+							   &b->a_multicast));
+	diff |= ADDR_DIFF(BROADCAST,	nl_inline_addr_cmp(&a->a_bcast,
+						   &b->a_bcast));
+	diff |= ADDR_DIFF(ANYCAST,	nl_inline_addr_cmp(&a->a_anycast,
+						   &b->a_anycast));
 	diff |= ADDR_DIFF(CACHEINFO,    memcmp(&a->a_cacheinfo, &b->a_cacheinfo,
 	                                       sizeof (a->a_cacheinfo)));
 
@@ -614,7 +649,7 @@ struct rtnl_addr *rtnl_addr_get(struct nl_cache *cache, int ifindex,
 			continue;
 
 		if (a->ce_mask & ADDR_ATTR_LOCAL &&
-		    !nl_addr_cmp(a->a_local, addr)) {
+		    !nl_inline_addr_cmp_addr(&a->a_local, addr)) {
 			nl_object_get((struct nl_object *) a);
 			return a;
 		}
@@ -642,7 +677,7 @@ static int build_addr_msg(struct rtnl_addr *tmpl, int cmd, int flags,
 		/* compatibility hack */
 		if (tmpl->a_family == AF_INET &&
 		    tmpl->ce_mask & ADDR_ATTR_LOCAL &&
-		    *((char *) nl_addr_get_binary_addr(tmpl->a_local)) == 127)
+		    *((char *) nl_inline_addr_binary(&tmpl->a_local)) == 127)
 			am.ifa_scope = RT_SCOPE_HOST;
 		else
 			am.ifa_scope = RT_SCOPE_UNIVERSE;
@@ -655,13 +690,16 @@ static int build_addr_msg(struct rtnl_addr *tmpl, int cmd, int flags,
 	if (nlmsg_append(msg, &am, sizeof(am), NLMSG_ALIGNTO) < 0)
 		goto nla_put_failure;
 
-	if (tmpl->ce_mask & ADDR_ATTR_LOCAL)
-		NLA_PUT_ADDR(msg, IFA_LOCAL, tmpl->a_local);
+	if ((tmpl->ce_mask & ADDR_ATTR_LOCAL) &&
+	    nl_inline_addr_put(msg, IFA_LOCAL, &tmpl->a_local) < 0)
+		goto nla_put_failure;
 
-	if (tmpl->ce_mask & ADDR_ATTR_PEER)
-		NLA_PUT_ADDR(msg, IFA_ADDRESS, tmpl->a_peer);
-	else if (tmpl->ce_mask & ADDR_ATTR_LOCAL)
-		NLA_PUT_ADDR(msg, IFA_ADDRESS, tmpl->a_local);
+	if (tmpl->ce_mask & ADDR_ATTR_PEER) {
+		if (nl_inline_addr_put(msg, IFA_ADDRESS, &tmpl->a_peer) < 0)
+			goto nla_put_failure;
+	} else if ((tmpl->ce_mask & ADDR_ATTR_LOCAL) &&
+		   nl_inline_addr_put(msg, IFA_ADDRESS, &tmpl->a_local) < 0)
+		goto nla_put_failure;
 
 	if (tmpl->ce_mask & ADDR_ATTR_ALIAS)
 		NLA_PUT_STRING(msg, IFA_ALIAS, tmpl->a_alias);
@@ -669,8 +707,9 @@ static int build_addr_msg(struct rtnl_addr *tmpl, int cmd, int flags,
 	if (tmpl->ce_mask & ADDR_ATTR_LABEL)
 		NLA_PUT_STRING(msg, IFA_LABEL, tmpl->a_label);
 
-	if (tmpl->ce_mask & ADDR_ATTR_BROADCAST)
-		NLA_PUT_ADDR(msg, IFA_BROADCAST, tmpl->a_bcast);
+	if ((tmpl->ce_mask & ADDR_ATTR_BROADCAST) &&
+	    nl_inline_addr_put(msg, IFA_BROADCAST, &tmpl->a_bcast) < 0)
+		goto nla_put_failure;
 
 	if (tmpl->ce_mask & ADDR_ATTR_CACHEINFO) {
 		struct ifa_cacheinfo ca = {
@@ -963,10 +1002,10 @@ void rtnl_addr_set_prefixlen(struct rtnl_addr *addr, int prefixlen)
 	 * The prefix length always applies to the peer address if
 	 * a peer address is present.
 	 */
-	if (addr->a_peer)
-		nl_addr_set_prefixlen(addr->a_peer, prefixlen);
-	else if (addr->a_local)
-		nl_addr_set_prefixlen(addr->a_local, prefixlen);
+	if (nl_inline_addr_isset(&addr->a_peer))
+		nl_inline_addr_set_prefixlen(&addr->a_peer, prefixlen);
+	else if (nl_inline_addr_isset(&addr->a_local))
+		nl_inline_addr_set_prefixlen(&addr->a_local, prefixlen);
 }
 
 int rtnl_addr_get_prefixlen(struct rtnl_addr *addr)
@@ -1004,8 +1043,9 @@ unsigned int rtnl_addr_get_flags(struct rtnl_addr *addr)
 	return addr->a_flags;
 }
 
-static inline int __assign_addr(struct rtnl_addr *addr, struct nl_addr **pos,
-			        struct nl_addr *new, int flag)
+static inline int __assign_addr(struct rtnl_addr *addr,
+				struct nl_inline_addr *pos,
+				struct nl_addr *new, int flag)
 {
 	if (new) {
 		if (addr->ce_mask & ADDR_ATTR_FAMILY) {
@@ -1014,16 +1054,10 @@ static inline int __assign_addr(struct rtnl_addr *addr, struct nl_addr **pos,
 		} else
 			addr->a_family = new->a_family;
 
-		if (*pos)
-			nl_addr_put(*pos);
-
-		*pos = nl_addr_get(new);
+		nl_inline_addr_set(pos, new);
 		addr->ce_mask |= (flag | ADDR_ATTR_FAMILY);
 	} else {
-		if (*pos)
-			nl_addr_put(*pos);
-
-		*pos = NULL;
+		nl_inline_addr_release(pos);
 		addr->ce_mask &= ~flag;
 	}
 
@@ -1052,7 +1086,7 @@ int rtnl_addr_set_local(struct rtnl_addr *addr, struct nl_addr *local)
 
 struct nl_addr *rtnl_addr_get_local(struct rtnl_addr *addr)
 {
-	return addr->a_local;
+	return nl_inline_addr_get(&addr->a_local);
 }
 
 int rtnl_addr_set_peer(struct rtnl_addr *addr, struct nl_addr *peer)
@@ -1073,7 +1107,7 @@ int rtnl_addr_set_peer(struct rtnl_addr *addr, struct nl_addr *peer)
 
 struct nl_addr *rtnl_addr_get_peer(struct rtnl_addr *addr)
 {
-	return addr->a_peer;
+	return nl_inline_addr_get(&addr->a_peer);
 }
 
 int rtnl_addr_set_broadcast(struct rtnl_addr *addr, struct nl_addr *bcast)
@@ -1086,7 +1120,7 @@ int rtnl_addr_set_broadcast(struct rtnl_addr *addr, struct nl_addr *bcast)
 
 struct nl_addr *rtnl_addr_get_broadcast(struct rtnl_addr *addr)
 {
-	return addr->a_bcast;
+	return nl_inline_addr_get(&addr->a_bcast);
 }
 
 int rtnl_addr_set_multicast(struct rtnl_addr *addr, struct nl_addr *multicast)
@@ -1100,7 +1134,7 @@ int rtnl_addr_set_multicast(struct rtnl_addr *addr, struct nl_addr *multicast)
 
 struct nl_addr *rtnl_addr_get_multicast(struct rtnl_addr *addr)
 {
-	return addr->a_multicast;
+	return nl_inline_addr_get(&addr->a_multicast);
 }
 
 int rtnl_addr_set_anycast(struct rtnl_addr *addr, struct nl_addr *anycast)
@@ -1114,7 +1148,7 @@ int rtnl_addr_set_anycast(struct rtnl_addr *addr, struct nl_addr *anycast)
 
 struct nl_addr *rtnl_addr_get_anycast(struct rtnl_addr *addr)
 {
-	return addr->a_anycast;
+	return nl_inline_addr_get(&addr->a_anycast);
 }
 
 uint32_t rtnl_addr_get_valid_lifetime(struct rtnl_addr *addr)
@@ -1200,6 +1234,7 @@ static struct nl_object_ops addr_obj_ops = {
 	},
 	.oo_compare		= addr_compare,
 	.oo_attrs2str		= addr_attrs2str,
+	.oo_keygen		= addr_keygen,
 	.oo_id_attrs_get	= addr_id_attrs_get,
 	.oo_id_attrs		= (ADDR_ATTR_FAMILY | ADDR_ATTR_IFINDEX |
 				   ADDR_ATTR_LOCAL | ADDR_ATTR_PREFIXLEN),
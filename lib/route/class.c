@@ -473,6 +473,8 @@ static struct nl_object_ops class_obj_ops = {
 	    [NL_DUMP_STATS]	= rtnl_tc_dump_stats,
 	},
 	.oo_compare		= rtnl_tc_compare,
+	.oo_keygen		= rtnl_tc_keygen,
+	.oo_hash_attrs		= rtnl_tc_hash_attrs,
 	.oo_id_attrs		= (TCA_ATTR_IFINDEX | TCA_ATTR_HANDLE),
 };
 
@@ -23,6 +23,7 @@
 #include <netlink-private/route/tc-api.h>
 #include <netlink/route/classifier.h>
 #include <netlink/route/link.h>
+#include <netlink-private/hash.h>
 
 /** @cond SKIP */
 #define CLS_ATTR_PRIO		(TCA_ATTR_MAX << 1)
@@ -505,6 +506,67 @@ static struct rtnl_tc_type_ops cls_ops = {
 	},
 };
 
+static uint64_t cls_compare(struct nl_object *_a, struct nl_object *_b,
+			    uint64_t attrs, int flags)
+{
+	struct rtnl_cls *a = (struct rtnl_cls *) _a;
+	struct rtnl_cls *b = (struct rtnl_cls *) _b;
+	uint64_t diff;
+
+	diff = rtnl_tc_compare(_a, _b, attrs, flags);
+
+#define CLS_DIFF(ATTR, EXPR) ATTR_DIFF(attrs, CLS_ATTR_##ATTR, a, b, EXPR)
+
+	diff |= CLS_DIFF(PRIO,		a->c_prio != b->c_prio);
+	diff |= CLS_DIFF(PROTOCOL,	a->c_protocol != b->c_protocol);
+
+#undef CLS_DIFF
+
+	return diff;
+}
+
+/*
+ * Several classifiers on the same parent may share a handle, the kernel
+ * tells them apart by priority and protocol.
+ */
+static uint32_t cls_id_attrs_get(struct nl_object *obj)
+{
+	return cls_obj_ops.oo_id_attrs |
+	       (obj->ce_mask & (CLS_ATTR_PRIO | CLS_ATTR_PROTOCOL));
+}
+
+static void cls_keygen(struct nl_object *obj, uint32_t *hashkey,
+		       uint32_t table_sz)
+{
+	struct rtnl_cls *cls = (struct rtnl_cls *) obj;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, cls->c_ifindex);
+	nl_hasher_u32(&h, cls->c_parent);
+	nl_hasher_u32(&h, cls->c_handle);
+	nl_hasher_u32(&h, ((uint32_t) cls->c_prio << 16) | cls->c_protocol);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "cls %p key (dev %d parent 0x%x handle 0x%x prio %d) "
+	       "hash 0x%x\n", cls, cls->c_ifindex, cls->c_parent,
+	       cls->c_handle, cls->c_prio, *hashkey);
+}
+
+static void cls_hash_attrs(struct nl_object *obj, uint64_t attrs,
+			   struct nl_hasher *h)
+{
+	struct rtnl_cls *cls = (struct rtnl_cls *) obj;
+
+	rtnl_tc_hash_attrs(obj, attrs, h);
+
+	if (attrs & CLS_ATTR_PRIO)
+		nl_hasher_u32(h, cls->c_prio);
+	if (attrs & CLS_ATTR_PROTOCOL)
+		nl_hasher_u32(h, cls->c_protocol);
+}
+
 static struct nl_cache_ops rtnl_cls_ops = {
 	.co_name		= "route/cls",
 	.co_hdrsize		= sizeof(struct tcmsg),
@@ -531,8 +593,12 @@ static struct nl_object_ops cls_obj_ops = {
 	    [NL_DUMP_DETAILS]	= rtnl_tc_dump_details,
 	    [NL_DUMP_STATS]	= rtnl_tc_dump_stats,
 	},
-	.oo_compare		= rtnl_tc_compare,
-	.oo_id_attrs		= (TCA_ATTR_IFINDEX | TCA_ATTR_HANDLE),
+	.oo_compare		= cls_compare,
+	.oo_keygen		= cls_keygen,
+	.oo_hash_attrs		= cls_hash_attrs,
+	.oo_id_attrs_get	= cls_id_attrs_get,
+	.oo_id_attrs		= (TCA_ATTR_IFINDEX | TCA_ATTR_HANDLE |
+				   TCA_ATTR_PARENT),
 };
 
 static void __init cls_init(void)
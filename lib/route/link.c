@@ -20,11 +20,13 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
 #include <netlink/netlink.h>
 #include <netlink/attr.h>
 #include <netlink/utils.h>
 #include <netlink/object.h>
 #include <netlink/hashtable.h>
+#include <netlink-private/hash.h>
 #include <netlink/data.h>
 #include <netlink/route/rtnl.h>
 #include <netlink/route/link.h>
@@ -288,8 +290,8 @@ static void link_free_data(struct nl_object *c)
 		/* proto info af reference */
 		rtnl_link_af_ops_put(link->l_af_ops);
 
-		nl_addr_put(link->l_addr);
-		nl_addr_put(link->l_bcast);
+		nl_inline_addr_release(&link->l_addr);
+		nl_inline_addr_release(&link->l_bcast);
 
 		free(link->l_ifalias);
 		free(link->l_info_kind);
@@ -311,13 +313,11 @@ static int link_clone(struct nl_object *_dst, struct nl_object *_src)
 	struct rtnl_link *src = nl_object_priv(_src);
 	int err;
 
-	if (src->l_addr)
-		if (!(dst->l_addr = nl_addr_clone(src->l_addr)))
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->l_addr, &src->l_addr)) < 0)
+		return err;
 
-	if (src->l_bcast)
-		if (!(dst->l_bcast = nl_addr_clone(src->l_bcast)))
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->l_bcast, &src->l_bcast)) < 0)
+		return err;
 
 	if (src->l_ifalias)
 		if (!(dst->l_ifalias = strdup(src->l_ifalias)))
@@ -398,6 +398,8 @@ static struct nla_policy link_info_policy[IFLA_INFO_MAX+1] = {
 
 int rtnl_link_info_parse(struct rtnl_link *link, struct nlattr **tb)
 {
+	int err;
+
 	if (tb[IFLA_IFNAME] == NULL)
 		return -NLE_MISSING_ATTR;
 
@@ -503,21 +505,18 @@ int rtnl_link_info_parse(struct rtnl_link *link, struct nlattr **tb)
 	}
 
 	if (tb[IFLA_ADDRESS]) {
-		link->l_addr = nl_addr_alloc_attr(tb[IFLA_ADDRESS], AF_UNSPEC);
-		if (link->l_addr == NULL)
-			return -NLE_NOMEM;
-		nl_addr_set_family(link->l_addr,
-				   nl_addr_guess_family(link->l_addr));
+		err = nl_inline_addr_set_attr(&link->l_addr, tb[IFLA_ADDRESS],
+			nl_addr_guess_family_len(nla_len(tb[IFLA_ADDRESS])));
+		if (err < 0)
+			return err;
 		link->ce_mask |= LINK_ATTR_ADDR;
 	}
 
 	if (tb[IFLA_BROADCAST]) {
-		link->l_bcast = nl_addr_alloc_attr(tb[IFLA_BROADCAST],
-						   AF_UNSPEC);
-		if (link->l_bcast == NULL)
-			return -NLE_NOMEM;
-		nl_addr_set_family(link->l_bcast,
-				   nl_addr_guess_family(link->l_bcast));
+		err = nl_inline_addr_set_attr(&link->l_bcast, tb[IFLA_BROADCAST],
+			nl_addr_guess_family_len(nla_len(tb[IFLA_BROADCAST])));
+		if (err < 0)
+			return err;
 		link->ce_mask |= LINK_ATTR_BRD;
 	}
 
@@ -854,8 +853,10 @@ static void link_dump_line(struct nl_object *obj, struct nl_dump_params *p)
 	nl_dump_line(p, "%s %s ", link->l_name,
 		     nl_llproto2str(link->l_arptype, buf, sizeof(buf)));
 
-	if (link->l_addr && !nl_addr_iszero(link->l_addr))
-		nl_dump(p, "%s ", nl_addr2str(link->l_addr, buf, sizeof(buf)));
+	if (nl_inline_addr_isset(&link->l_addr) &&
+	    !nl_inline_addr_iszero(&link->l_addr))
+		nl_dump(p, "%s ",
+			nl_inline_addr2str(&link->l_addr, buf, sizeof(buf)));
 
 	if (link->ce_mask & LINK_ATTR_MASTER) {
 		if (cache) {
@@ -934,8 +935,8 @@ static void link_dump_details(struct nl_object *obj, struct nl_dump_params *p)
 		nl_dump(p, "rxq %u ", link->l_num_rx_queues);
 
 	if (link->ce_mask & LINK_ATTR_BRD)
-		nl_dump(p, "brd %s ", nl_addr2str(link->l_bcast, buf,
-						   sizeof(buf)));
+		nl_dump(p, "brd %s ", nl_inline_addr2str(&link->l_bcast, buf,
+							  sizeof(buf)));
 
 	if ((link->ce_mask & LINK_ATTR_OPERSTATE) &&
 	    link->l_operstate != IF_OPER_UNKNOWN) {
@@ -1085,22 +1086,291 @@ static void link_keygen(struct nl_object *obj, uint32_t *hashkey,
         uint32_t table_sz)
 {
 	struct rtnl_link *link = (struct rtnl_link *) obj;
-	unsigned int lkey_sz;
-	struct link_hash_key {
-		uint32_t	l_index;
-		uint32_t	l_family;
-	} __attribute__((packed)) lkey;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, link->l_index);
+	nl_hasher_u32(&h, link->l_family);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "link %p key (dev %d fam %d) hash 0x%x\n",
+	       link, link->l_index, link->l_family, *hashkey);
+}
+
+/*
+ * Secondary indexes of link caches, kept in nl_cache::c_priv. Links are
+ * found by ifindex in a dense array and by name in a hash table chained
+ * through rtnl_link::l_name_next.
+ *
+ * A slot of the ifindex array holds the first link added with that
+ * ifindex, later links with the same ifindex (of another family) are
+ * counted in li_dups. The array only grows up to a size proportional to
+ * the number of links, links beyond it are counted in li_overflow and
+ * found by walking the cache.
+ */
+struct link_index
+{
+	struct rtnl_link **	li_byindex;
+	unsigned int		li_nindex;
+	unsigned int		li_dups;
+	unsigned int		li_overflow;
+	struct rtnl_link **	li_byname;
+	unsigned int		li_nnames;
+	unsigned int		li_count;
+};
+
+#define LINK_INDEX_MIN		64
+#define LINK_NAMES_MIN		16
+
+static uint32_t link_name_hash(const char *name)
+{
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_str(&h, name);
+
+	return nl_hasher_final(&h);
+}
+
+static void link_index_place(struct link_index *li, struct rtnl_link *link)
+{
+	if (link->l_index >= li->li_nindex)
+		li->li_overflow++;
+	else if (li->li_byindex[link->l_index])
+		li->li_dups++;
+	else
+		li->li_byindex[link->l_index] = link;
+}
+
+/*
+ * Returns 1 if all links of the cache, including a link just added to
+ * the list, have been placed again.
+ */
+static int link_index_grow(struct nl_cache *cache, struct link_index *li,
+			   uint32_t ifindex)
+{
+	struct rtnl_link **byindex, *link;
+	unsigned int n, max;
+
+	max = 8 * li->li_count + LINK_INDEX_MIN;
+	if (ifindex >= max)
+		return 0;
+
+	for (n = li->li_nindex ? : LINK_INDEX_MIN; n <= ifindex; n <<= 1)
+		;
+	n = min_t(unsigned int, n, max);
+
+	byindex = realloc(li->li_byindex, n * sizeof(*byindex));
+	if (!byindex)
+		return 0;
+
+	memset(byindex + li->li_nindex, 0,
+	       (n - li->li_nindex) * sizeof(*byindex));
+	li->li_byindex = byindex;
+	li->li_nindex = n;
+
+	if (!li->li_overflow)
+		return 0;
+
+	/* Some links beyond the old size may fit now, place all again */
+	memset(byindex, 0, n * sizeof(*byindex));
+	li->li_dups = li->li_overflow = 0;
+	nl_list_for_each_entry(link, &cache->c_items, ce_list) {
+		if (link->l_name_next == link)
+			li->li_overflow++;
+		else
+			link_index_place(li, link);
+	}
+
+	return 1;
+}
+
+static void link_names_resize(struct link_index *li, unsigned int n)
+{
+	struct rtnl_link **byname, *link, *next;
+	unsigned int i;
+
+	if (!(byname = calloc(n, sizeof(*byname))))
+		return;
+
+	for (i = 0; i < li->li_nnames; i++) {
+		for (link = li->li_byname[i]; link; link = next) {
+			uint32_t b = link_name_hash(link->l_name) & (n - 1);
+
+			next = link->l_name_next;
+			link->l_name_next = byname[b];
+			byname[b] = link;
+		}
+	}
+
+	free(li->li_byname);
+	li->li_byname = byname;
+	li->li_nnames = n;
+}
+
+static void link_obj_added(struct nl_cache *cache, struct nl_object *obj)
+{
+	struct rtnl_link *link = (struct rtnl_link *) obj;
+	struct link_index *li = cache->c_priv;
+	uint32_t b;
+
+	if (!li) {
+		if (!(li = calloc(1, sizeof(*li))))
+			goto unindexed;
+		cache->c_priv = li;
+	}
 
-	lkey_sz = sizeof(lkey);
-	lkey.l_index = link->l_index;
-	lkey.l_family = link->l_family;
+	if (li->li_count >= li->li_nnames)
+		link_names_resize(li, li->li_nnames ? li->li_nnames << 1 :
+						      LINK_NAMES_MIN);
+	if (!li->li_nnames)
+		goto unindexed;
 
-	*hashkey = nl_hash(&lkey, lkey_sz, 0) % table_sz;
+	li->li_count++;
 
-	NL_DBG(5, "link %p key (dev %d fam %d) keysz %d, hash 0x%x\n",
-	       link, lkey.l_index, lkey.l_family, lkey_sz, *hashkey);
+	b = link_name_hash(link->l_name) & (li->li_nnames - 1);
+	link->l_name_next = li->li_byname[b];
+	li->li_byname[b] = link;
 
+	if (   link->l_index >= li->li_nindex
+	    && link_index_grow(cache, li, link->l_index))
+		return;
+
+	link_index_place(li, link);
 	return;
+
+unindexed:
+	/* Lookups fall back to walking the cache */
+	link->l_name_next = link;
+	if (li)
+		li->li_overflow++;
+	else
+		NL_DBG(1, "link cache %p: unable to index link %p\n",
+		       cache, link);
+}
+
+static void link_obj_removed(struct nl_cache *cache, struct nl_object *obj)
+{
+	struct rtnl_link *link = (struct rtnl_link *) obj, *l, **pp;
+	struct link_index *li = cache->c_priv;
+	unsigned int i, b;
+
+	if (!li)
+		return;
+
+	if (link->l_name_next == link) {
+		link->l_name_next = NULL;
+		li->li_overflow--;
+		return;
+	}
+
+	/* The name should not have changed, fall back to all chains */
+	b = link_name_hash(link->l_name) & (li->li_nnames - 1);
+	for (i = 0; i <= li->li_nnames; i++) {
+		for (pp = &li->li_byname[b]; *pp; pp = &(*pp)->l_name_next) {
+			if (*pp == link) {
+				*pp = link->l_name_next;
+				goto unlinked;
+			}
+		}
+		b = i;
+	}
+unlinked:
+	link->l_name_next = NULL;
+	li->li_count--;
+
+	if (link->l_index >= li->li_nindex)
+		li->li_overflow--;
+	else if (li->li_byindex[link->l_index] != link)
+		li->li_dups--;
+	else {
+		li->li_byindex[link->l_index] = NULL;
+		if (!li->li_dups)
+			return;
+
+		nl_list_for_each_entry(l, &cache->c_items, ce_list) {
+			if (l != link && l->l_index == link->l_index &&
+			    l->l_name_next != l) {
+				li->li_byindex[link->l_index] = l;
+				li->li_dups--;
+				break;
+			}
+		}
+	}
+}
+
+/* Returns the cache whose indexes contain the link, if any */
+static struct nl_cache *link_indexed_cache(struct rtnl_link *link)
+{
+	struct nl_cache *cache = link->ce_cache;
+
+	if (   cache && cache->c_priv
+	    && (   cache->c_ops == &rtnl_link_ops
+		|| cache->c_ops == &rtnl_link_bridge_ops))
+		return cache;
+
+	return NULL;
+}
+
+static void link_free_priv(struct nl_cache *cache)
+{
+	struct link_index *li = cache->c_priv;
+
+	if (li) {
+		free(li->li_byindex);
+		free(li->li_byname);
+		free(li);
+		cache->c_priv = NULL;
+	}
+}
+
+static struct rtnl_link *link_index_get(struct nl_cache *cache, int ifindex)
+{
+	struct link_index *li = cache->c_priv;
+	struct rtnl_link *link;
+
+	if (li && ifindex >= 0 && (unsigned int) ifindex < li->li_nindex) {
+		if ((link = li->li_byindex[ifindex]))
+			return link;
+		/* Unindexed links are counted as overflow */
+		if (!li->li_overflow)
+			return NULL;
+	} else if (li && !li->li_overflow)
+		return NULL;
+
+	nl_list_for_each_entry(link, &cache->c_items, ce_list) {
+		if (link->l_index == ifindex)
+			return link;
+	}
+
+	return NULL;
+}
+
+static struct rtnl_link *link_index_get_by_name(struct nl_cache *cache,
+						const char *name)
+{
+	struct link_index *li = cache->c_priv;
+	struct rtnl_link *link;
+
+	if (li && li->li_nnames) {
+		uint32_t b = link_name_hash(name) & (li->li_nnames - 1);
+
+		for (link = li->li_byname[b]; link; link = link->l_name_next) {
+			if (!strcmp(name, link->l_name))
+				return link;
+		}
+
+		if (!li->li_overflow)
+			return NULL;
+	}
+
+	nl_list_for_each_entry(link, &cache->c_items, ce_list) {
+		if (!strcmp(name, link->l_name))
+			return link;
+	}
+
+	return NULL;
 }
 
 static uint64_t link_compare(struct nl_object *_a, struct nl_object *_b,
@@ -1124,8 +1394,8 @@ static uint64_t link_compare(struct nl_object *_a, struct nl_object *_b,
 	diff |= LINK_DIFF(LINKMODE,	a->l_linkmode != b->l_linkmode);
 	diff |= LINK_DIFF(QDISC,	strcmp(a->l_qdisc, b->l_qdisc));
 	diff |= LINK_DIFF(IFNAME,	strcmp(a->l_name, b->l_name));
-	diff |= LINK_DIFF(ADDR,		nl_addr_cmp(a->l_addr, b->l_addr));
-	diff |= LINK_DIFF(BRD,		nl_addr_cmp(a->l_bcast, b->l_bcast));
+	diff |= LINK_DIFF(ADDR,		nl_inline_addr_cmp(&a->l_addr, &b->l_addr));
+	diff |= LINK_DIFF(BRD,		nl_inline_addr_cmp(&a->l_bcast, &b->l_bcast));
 	diff |= LINK_DIFF(IFALIAS,	strcmp(a->l_ifalias, b->l_ifalias));
 	diff |= LINK_DIFF(NUM_VF,	a->l_num_vf != b->l_num_vf);
 	diff |= LINK_DIFF(PROMISCUITY,	a->l_promiscuity != b->l_promiscuity);
@@ -1313,14 +1583,10 @@ struct rtnl_link *rtnl_link_get(struct nl_cache *cache, int ifindex)
 	    cache->c_ops != &rtnl_link_bridge_ops)
 		return NULL;
 
-	nl_list_for_each_entry(link, &cache->c_items, ce_list) {
-		if (link->l_index == ifindex) {
-			nl_object_get((struct nl_object *) link);
-			return link;
-		}
-	}
+	if ((link = link_index_get(cache, ifindex)))
+		nl_object_get((struct nl_object *) link);
 
-	return NULL;
+	return link;
 }
 
 /**
@@ -1347,14 +1613,10 @@ struct rtnl_link *rtnl_link_get_by_name(struct nl_cache *cache,
 	    cache->c_ops != &rtnl_link_bridge_ops)
 		return NULL;
 
-	nl_list_for_each_entry(link, &cache->c_items, ce_list) {
-		if (!strcmp(name, link->l_name)) {
-			nl_object_get((struct nl_object *) link);
-			return link;
-		}
-	}
+	if ((link = link_index_get_by_name(cache, name)))
+		nl_object_get((struct nl_object *) link);
 
-	return NULL;
+	return link;
 }
 
 static int __rtnl_link_build_get_request(int ifindex, const char *name,
@@ -1394,14 +1656,39 @@ nla_put_failure:
 static int link_request_update(struct nl_cache *cache, struct nl_sock *sk)
 {
 	int family = cache->c_iarg1;
+	struct rtnl_link *filter;
 	struct nl_msg *msg;
 	int err;
 
+	filter = (struct rtnl_link *) _nl_cache_dump_filter(cache, sk);
+	if (filter && family == AF_UNSPEC && (filter->ce_mask & LINK_ATTR_FAMILY))
+		family = filter->l_family;
+
 	err = __rtnl_link_build_get_request(0, NULL, &msg, NLM_F_DUMP, family);
 	if (err)
 		return err;
 
+	/* Kernel side filtering, link dumps can't be filtered by ifindex */
+	if (filter) {
+		err = -NLE_MSGSIZE;
+
+		if (filter->ce_mask & LINK_ATTR_MASTER)
+			NLA_PUT_U32(msg, IFLA_MASTER, filter->l_master);
+
+		if ((filter->ce_mask & LINK_ATTR_LINKINFO) && filter->l_info_kind) {
+			struct nlattr *info;
+
+			if (!(info = nla_nest_start(msg, IFLA_LINKINFO)))
+				goto nla_put_failure;
+
+			NLA_PUT_STRING(msg, IFLA_INFO_KIND, filter->l_info_kind);
+			nla_nest_end(msg, info);
+		}
+	}
+
 	err = nl_send_auto(sk, msg);
+
+nla_put_failure:
 	nlmsg_free(msg);
 	return err;
 }
@@ -1547,11 +1834,13 @@ int rtnl_link_name2i(struct nl_cache *cache, const char *name)
 
 int rtnl_link_fill_info(struct nl_msg *msg, struct rtnl_link *link)
 {
-	if (link->ce_mask & LINK_ATTR_ADDR)
-		NLA_PUT_ADDR(msg, IFLA_ADDRESS, link->l_addr);
+	if ((link->ce_mask & LINK_ATTR_ADDR) &&
+	    nl_inline_addr_put(msg, IFLA_ADDRESS, &link->l_addr) < 0)
+		goto nla_put_failure;
 
-	if (link->ce_mask & LINK_ATTR_BRD)
-		NLA_PUT_ADDR(msg, IFLA_BROADCAST, link->l_bcast);
+	if ((link->ce_mask & LINK_ATTR_BRD) &&
+	    nl_inline_addr_put(msg, IFLA_BROADCAST, &link->l_bcast) < 0)
+		goto nla_put_failure;
 
 	if (link->ce_mask & LINK_ATTR_MTU)
 		NLA_PUT_U32(msg, IFLA_MTU, link->l_mtu);
@@ -2052,8 +2341,17 @@ void rtnl_link_put(struct rtnl_link *link)
  */
 void rtnl_link_set_name(struct rtnl_link *link, const char *name)
 {
+	struct nl_cache *cache = link_indexed_cache(link);
+
+	/* A cached link has to be indexed under its new name */
+	if (cache)
+		link_obj_removed(cache, (struct nl_object *) link);
+
 	strncpy(link->l_name, name, sizeof(link->l_name) - 1);
 	link->ce_mask |= LINK_ATTR_IFNAME;
+
+	if (cache)
+		link_obj_added(cache, (struct nl_object *) link);
 }
 
 /**
@@ -2091,14 +2389,11 @@ uint32_t rtnl_link_get_group(struct rtnl_link *link)
 	return link->l_group;
 }
 
-static inline void __assign_addr(struct rtnl_link *link, struct nl_addr **pos,
+static inline void __assign_addr(struct rtnl_link *link,
+				 struct nl_inline_addr *pos,
 				 struct nl_addr *new, int flag)
 {
-	if (*pos)
-		nl_addr_put(*pos);
-
-	nl_addr_get(new);
-	*pos = new;
+	nl_inline_addr_set(pos, new);
 
 	link->ce_mask |= flag;
 }
@@ -2130,7 +2425,8 @@ void rtnl_link_set_addr(struct rtnl_link *link, struct nl_addr *addr)
  */
 struct nl_addr *rtnl_link_get_addr(struct rtnl_link *link)
 {
-	return link->ce_mask & LINK_ATTR_ADDR ? link->l_addr : NULL;
+	return link->ce_mask & LINK_ATTR_ADDR ?
+		nl_inline_addr_get(&link->l_addr) : NULL;
 }
 
 /**
@@ -2161,7 +2457,8 @@ void rtnl_link_set_broadcast(struct rtnl_link *link, struct nl_addr *addr)
  */
 struct nl_addr *rtnl_link_get_broadcast(struct rtnl_link *link)
 {
-	return link->ce_mask & LINK_ATTR_BRD ? link->l_bcast : NULL;
+	return link->ce_mask & LINK_ATTR_BRD ?
+		nl_inline_addr_get(&link->l_bcast) : NULL;
 }
 
 /**
@@ -2280,8 +2577,22 @@ unsigned int rtnl_link_get_arptype(struct rtnl_link *link)
  */
 void rtnl_link_set_ifindex(struct rtnl_link *link, int ifindex)
 {
+	struct nl_cache *cache = link_indexed_cache(link);
+	nl_hash_table_t *ht = link->ce_cache ? link->ce_cache->hashtable : NULL;
+
+	/* A cached link has to be indexed and hashed under its new ifindex */
+	if (cache)
+		link_obj_removed(cache, (struct nl_object *) link);
+	if (ht)
+		nl_hash_table_del(ht, (struct nl_object *) link);
+
 	link->l_index = ifindex;
 	link->ce_mask |= LINK_ATTR_IFINDEX;
+
+	if (ht)
+		nl_hash_table_add(ht, (struct nl_object *) link);
+	if (cache)
+		link_obj_added(cache, (struct nl_object *) link);
 }
 
 
@@ -3324,6 +3635,9 @@ static struct nl_cache_ops rtnl_link_ops = {
 	.co_groups		= link_groups,
 	.co_request_update	= link_request_update,
 	.co_msg_parser		= link_msg_parser,
+	.co_obj_added		= link_obj_added,
+	.co_obj_removed		= link_obj_removed,
+	.co_free_priv		= link_free_priv,
 	.co_obj_ops		= &link_obj_ops,
 };
 
@@ -3346,6 +3660,9 @@ static struct nl_cache_ops rtnl_link_bridge_ops = {
 	.co_groups		= link_bridge_groups,
 	.co_request_update	= link_request_update,
 	.co_msg_parser		= link_bridge_msg_parser,
+	.co_obj_added		= link_obj_added,
+	.co_obj_removed		= link_obj_removed,
+	.co_free_priv		= link_free_priv,
 	.co_obj_ops		= &link_obj_ops,
 };
 
@@ -8,6 +8,7 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
 #include <netlink/netlink.h>
 #include <netlink/utils.h>
 #include <netlink/hashtable.h>
@@ -154,7 +155,7 @@ static struct rtnl_mgrp *mgrp_clone(struct rtnl_mgrp *src)
 	mgrp->proto = src->proto;
 	mgrp->vid = src->vid;
 	mgrp->num_mgport = src->num_mgport;
-	mgrp->addr = nl_addr_clone(src->addr);
+	mgrp->addr = nl_addr_clone_shared(src->addr);
 	if (!mgrp->addr) {
 	        free(mgrp);
 		return NULL;
@@ -505,23 +506,26 @@ static int mdb_msg_parser(struct nl_cache_ops *ops, struct sockaddr_nl *who,
 				switch (mgrp->proto) {
 				case ETH_P_IP:
 					family = AF_INET;
-					mgrp->addr = nl_addr_build(family,
-								   (unsigned char *)&bm->addr.u,
-								   sizeof(__be32));
+					mgrp->addr = nl_addr_intern(
+						nl_addr_build(family,
+							      (unsigned char *)&bm->addr.u,
+							      sizeof(__be32)));
 					break;
 
 				case ETH_P_IPV6:
 					family = AF_INET6;
-					mgrp->addr = nl_addr_build(family,
-								   (unsigned char *)&bm->addr.u,
-								   sizeof(struct in6_addr));
+					mgrp->addr = nl_addr_intern(
+						nl_addr_build(family,
+							      (unsigned char *)&bm->addr.u,
+							      sizeof(struct in6_addr)));
 					break;
 
 				case ETH_P_ALL:
 					family = AF_LLC;
-					mgrp->addr = nl_addr_build(family,
-								   (unsigned char *)&bm->addr.u,
-								   ETH_ALEN);
+					mgrp->addr = nl_addr_intern(
+						nl_addr_build(family,
+							      (unsigned char *)&bm->addr.u,
+							      ETH_ALEN));
 					break;
 
 				default:
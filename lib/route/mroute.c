@@ -17,6 +17,8 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
+#include <netlink-private/route/nexthop.h>
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
 #include <netlink/utils.h>
@@ -116,7 +118,7 @@ struct rtnl_route *rtnl_mroute_get_by_dst(struct nl_cache *cache,
 		return NULL;
 
 	nl_list_for_each_entry(mr, &cache->c_items, ce_list) {
-		if (0 == nl_addr_cmp(mr->rt_dst, addr)) {
+		if (0 == nl_inline_addr_cmp_addr(&mr->rt_dst, addr)) {
 			nl_object_get((struct nl_object *) mr);
 			return mr;
 		}
@@ -144,14 +146,14 @@ static int build_mroute_msg(struct rtnl_route *route, int cmd, int flags,
 	if (!(msg = nlmsg_alloc_simple(cmd, flags)))
 		return -NLE_NOMEM;
 
-	if (route->rt_dst == NULL) {
+	if (!nl_inline_addr_isset(&route->rt_dst)) {
 		err = -NLE_MISSING_ATTR;
 		goto nla_put_failure;
 	}
 
-	rtmsg.rtm_dst_len = nl_addr_get_prefixlen(route->rt_dst);
-	if (route->rt_src)
-		rtmsg.rtm_src_len = nl_addr_get_prefixlen(route->rt_src);
+	rtmsg.rtm_dst_len = nl_inline_addr_prefixlen(&route->rt_dst);
+	if (nl_inline_addr_isset(&route->rt_src))
+		rtmsg.rtm_src_len = nl_inline_addr_prefixlen(&route->rt_src);
 
 	if (!(route->ce_mask & ROUTE_ATTR_SCOPE))
 		rtmsg.rtm_scope = rtnl_route_guess_scope(route);
@@ -172,11 +174,13 @@ static int build_mroute_msg(struct rtnl_route *route, int cmd, int flags,
 	if (route->rt_family != AF_MPLS)
 		NLA_PUT_U32(msg, RTA_TABLE, route->rt_table);
 
-	if (nl_addr_get_len(route->rt_dst))
-		NLA_PUT_ADDR(msg, RTA_DST, route->rt_dst);
+	if (nl_inline_addr_len(&route->rt_dst) &&
+	    nl_inline_addr_put(msg, RTA_DST, &route->rt_dst) < 0)
+		goto nla_put_failure;
 
-	if (route->ce_mask & ROUTE_ATTR_SRC)
-		NLA_PUT_ADDR(msg, RTA_SRC, route->rt_src);
+	if ((route->ce_mask & ROUTE_ATTR_SRC) &&
+	    nl_inline_addr_put(msg, RTA_SRC, &route->rt_src) < 0)
+		goto nla_put_failure;
 
 	if (route->ce_mask & ROUTE_ATTR_IIF)
 		NLA_PUT_U32(msg, RTA_IIF, route->rt_iif);
@@ -185,8 +189,8 @@ static int build_mroute_msg(struct rtnl_route *route, int cmd, int flags,
 		struct rtnl_nexthop *nh;
 
 		nh = rtnl_route_nexthop_n(route, 0);
-		if (nh->rtnh_gateway)
-			NLA_PUT_ADDR(msg, RTA_GATEWAY, nh->rtnh_gateway);
+		if (rtnl_route_nh_put_gateway(msg, nh) < 0)
+			goto nla_put_failure;
 		if (nh->rtnh_ifindex)
 			NLA_PUT_U32(msg, RTA_OIF, nh->rtnh_ifindex);
 		if (nh->rtnh_realms)
@@ -216,9 +220,8 @@ static int build_mroute_msg(struct rtnl_route *route, int cmd, int flags,
 			rtnh->rtnh_hops = nh->rtnh_weight;
 			rtnh->rtnh_ifindex = nh->rtnh_ifindex;
 
-			if (nh->rtnh_gateway)
-				NLA_PUT_ADDR(msg, RTA_GATEWAY,
-					     nh->rtnh_gateway);
+			if (rtnl_route_nh_put_gateway(msg, nh) < 0)
+				goto nla_put_failure;
 
 			if (nh->rtnh_newdst)
 				NLA_PUT_ADDR(msg, RTA_NEWDST, nh->rtnh_newdst);
@@ -322,47 +325,29 @@ static void mroute_constructor(struct nl_object *c)
 static void mroute_free_data(struct nl_object *c)
 {
 	struct rtnl_route *r = (struct rtnl_route *) c;
-	struct rtnl_nexthop *nh, *tmp;
 
 	if (r == NULL)
 		return;
 
-	nl_addr_put(r->rt_dst);
-	nl_addr_put(r->rt_src);
+	nl_inline_addr_release(&r->rt_dst);
+	nl_inline_addr_release(&r->rt_src);
 
-	nl_list_for_each_entry_safe(nh, tmp, &r->rt_nexthops, rtnh_list) {
-		rtnl_route_remove_nexthop(r, nh);
-		rtnl_route_nh_free(nh);
-	}
+	rtnl_route_free_nexthops(r);
 }
 
 static int mroute_clone(struct nl_object *_dst, struct nl_object *_src)
 {
 	struct rtnl_route *dst = (struct rtnl_route *) _dst;
 	struct rtnl_route *src = (struct rtnl_route *) _src;
-	struct rtnl_nexthop *nh, *new;
-
-	if (src->rt_dst)
-		if (!(dst->rt_dst = nl_addr_clone(src->rt_dst)))
-			return -NLE_NOMEM;
-
-	if (src->rt_src)
-		if (!(dst->rt_src = nl_addr_clone(src->rt_src)))
-			return -NLE_NOMEM;
-
-	/* Will be inc'ed again while adding the nexthops of the source */
-	dst->rt_nr_nh = 0;
+	int err;
 
-	nl_init_list_head(&dst->rt_nexthops);
-	nl_list_for_each_entry(nh, &src->rt_nexthops, rtnh_list) {
-		new = rtnl_route_nh_clone(nh);
-		if (!new)
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->rt_dst, &src->rt_dst)) < 0)
+		return err;
 
-		rtnl_route_add_nexthop(dst, new);
-	}
+	if ((err = nl_inline_addr_clone(&dst->rt_src, &src->rt_src)) < 0)
+		return err;
 
-	return 0;
+	return rtnl_route_clone_nexthops(dst, src);
 }
 
 static uint64_t mroute_compare(struct nl_object *_a, struct nl_object *_b,
@@ -382,8 +367,8 @@ static uint64_t mroute_compare(struct nl_object *_a, struct nl_object *_b,
 	diff |= ROUTE_DIFF(PROTOCOL,	a->rt_protocol != b->rt_protocol);
 	diff |= ROUTE_DIFF(SCOPE,	a->rt_scope != b->rt_scope);
 	diff |= ROUTE_DIFF(TYPE,	a->rt_type != b->rt_type);
-	diff |= ROUTE_DIFF(DST,		nl_addr_cmp(a->rt_dst, b->rt_dst));
-	diff |= ROUTE_DIFF(SRC,		nl_addr_cmp(a->rt_src, b->rt_src));
+	diff |= ROUTE_DIFF(DST,		nl_inline_addr_cmp(&a->rt_dst, &b->rt_dst));
+	diff |= ROUTE_DIFF(SRC,		nl_inline_addr_cmp(&a->rt_src, &b->rt_src));
 	diff |= ROUTE_DIFF(IIF,		a->rt_iif != b->rt_iif);
 
 	if (flags & LOOSE_COMPARISON) {
@@ -453,31 +438,19 @@ nh_mismatch:
 static int mroute_parse_addr(struct rtnl_route *mr, struct nlattr *attr,
 			      struct rtmsg *rtm, int src)
 {
-	struct nl_addr *addr = NULL;
-	int err = -NLE_NOMEM;
+	struct nl_inline_addr *ia = src ? &mr->rt_src : &mr->rt_dst;
+	int err;
 
-	if (attr) {
-		if (!(addr = nl_addr_alloc_attr(attr, mr->rt_family)))
-			goto errout;
-	} else {
-		if (!(addr = nl_addr_alloc(0)))
-			goto errout;
-		nl_addr_set_family(addr, mr->rt_family);
-	}
+	err = nl_inline_addr_set_data(ia, mr->rt_family,
+				      attr ? nla_data(attr) : NULL,
+				      attr ? nla_len(attr) : 0,
+				      src ? rtm->rtm_src_len : rtm->rtm_dst_len);
+	if (err < 0)
+		return err;
 
-	if (src) {
-		nl_addr_set_prefixlen(addr, rtm->rtm_src_len);
-		rtnl_route_set_src(mr, addr);
-	} else {
-		nl_addr_set_prefixlen(addr, rtm->rtm_dst_len);
-		rtnl_route_set_dst(mr, addr);
-	}
+	mr->ce_mask |= src ? ROUTE_ATTR_SRC : ROUTE_ATTR_DST;
 
-	nl_addr_put(addr);
 	return 0;
-
- errout:
-	return err;
 }
 
 static int rtnl_mroute_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
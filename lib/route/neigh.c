@@ -151,13 +151,14 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
 #include <netlink/netlink.h>
 #include <netlink/utils.h>
 #include <netlink/hashtable.h>
 #include <netlink/route/rtnl.h>
 #include <netlink/route/neighbour.h>
 #include <netlink/route/link.h>
-#include <netlink/hashtable.h>
+#include <netlink-private/hash.h>
 
 /** @cond SKIP */
 #define NEIGH_ATTR_FLAGS        0x01
@@ -184,83 +185,73 @@ static void neigh_free_data(struct nl_object *c)
 	if (!neigh)
 		return;
 
-	nl_addr_put(neigh->n_lladdr);
-	nl_addr_put(neigh->n_dst);
+	nl_inline_addr_release(&neigh->n_lladdr);
+	nl_inline_addr_release(&neigh->n_dst);
 }
 
 static int neigh_clone(struct nl_object *_dst, struct nl_object *_src)
 {
 	struct rtnl_neigh *dst = nl_object_priv(_dst);
 	struct rtnl_neigh *src = nl_object_priv(_src);
+	int err;
 
-	if (src->n_lladdr)
-		if (!(dst->n_lladdr = nl_addr_clone(src->n_lladdr)))
-			return -NLE_NOMEM;
-
-	if (src->n_dst)
-		if (!(dst->n_dst = nl_addr_clone(src->n_dst)))
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->n_lladdr, &src->n_lladdr)) < 0)
+		return err;
 
-	return 0;
+	return nl_inline_addr_clone(&dst->n_dst, &src->n_dst);
 }
 
 static void neigh_keygen(struct nl_object *obj, uint32_t *hashkey,
 			 uint32_t table_sz)
 {
 	struct rtnl_neigh *neigh = (struct rtnl_neigh *) obj;
-	unsigned int nkey_sz;
-	struct nl_addr *addr = NULL;
-	struct neigh_hash_key {
-		uint32_t	n_family;
-		uint32_t	n_ifindex;
-		uint16_t	n_vlan;
-		char		n_addr[0];
-	} __attribute__((packed)) *nkey;
+	struct nl_inline_addr *addr;
+	struct nl_hasher h;
+	uint32_t ifindex;
 #ifdef NL_DEBUG
 	char buf[INET6_ADDRSTRLEN+5];
 #endif
 
 	if (neigh->n_family == AF_BRIDGE) {
-		if (neigh->n_lladdr)
-			addr = neigh->n_lladdr;
-	} else if (neigh->n_dst) {
-		addr = neigh->n_dst;
-	}
-
-	nkey_sz = sizeof(*nkey);
-	if (addr)
-		nkey_sz += nl_addr_get_len(addr);
-
-	nkey = calloc(1, nkey_sz);
-	if (!nkey) {
-		*hashkey = 0;
-		return;
-	}
-	nkey->n_family = neigh->n_family;
-	if (neigh->n_family == AF_BRIDGE) {
-		nkey->n_vlan = neigh->n_vlan;
+		addr = &neigh->n_lladdr;
 		if (neigh->n_flags & NTF_SELF)
-			nkey->n_ifindex = neigh->n_ifindex;
+			ifindex = neigh->n_ifindex;
 		else
-			nkey->n_ifindex = neigh->n_master;
-	} else
-		nkey->n_ifindex = neigh->n_ifindex;
+			ifindex = neigh->n_master;
+	} else {
+		addr = &neigh->n_dst;
+		ifindex = neigh->n_ifindex;
+	}
 
-	if (addr)
-		memcpy(nkey->n_addr,
-			nl_addr_get_binary_addr(addr),
-			nl_addr_get_len(addr));
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, neigh->n_family);
+	nl_hasher_u32(&h, ifindex);
+	if (neigh->n_family == AF_BRIDGE)
+		nl_hasher_u32(&h, neigh->n_vlan);
+	nl_inline_addr_hash(&h, addr);
 
-	*hashkey = nl_hash(nkey, nkey_sz, 0) % table_sz;
+	*hashkey = nl_hasher_final(&h) % table_sz;
 
-	NL_DBG(5, "neigh %p key (fam %d dev %d addr %s) keysz %d hash 0x%x\n",
-		neigh, nkey->n_family, nkey->n_ifindex,
-		nl_addr2str(addr, buf, sizeof(buf)),
-		nkey_sz, *hashkey);
+	NL_DBG(5, "neigh %p key (fam %d dev %d addr %s) hash 0x%x\n",
+		neigh, neigh->n_family, ifindex,
+		nl_inline_addr2str(addr, buf, sizeof(buf)), *hashkey);
+}
 
-	free(nkey);
+static void neigh_hash_attrs(struct nl_object *obj, uint64_t attrs,
+			     struct nl_hasher *h)
+{
+	struct rtnl_neigh *neigh = (struct rtnl_neigh *) obj;
 
-	return;
+	if (attrs & NEIGH_ATTR_IFINDEX)
+		nl_hasher_u32(h, neigh->n_ifindex);
+	if (attrs & NEIGH_ATTR_FAMILY)
+		nl_hasher_u32(h, neigh->n_family);
+	if (attrs & NEIGH_ATTR_TYPE)
+		nl_hasher_u32(h, neigh->n_type);
+	if (attrs & NEIGH_ATTR_MASTER)
+		nl_hasher_u32(h, neigh->n_master);
+	if (attrs & NEIGH_ATTR_VLAN)
+		nl_hasher_u32(h, neigh->n_vlan);
 }
 
 static uint64_t neigh_compare(struct nl_object *_a, struct nl_object *_b,
@@ -275,8 +266,8 @@ static uint64_t neigh_compare(struct nl_object *_a, struct nl_object *_b,
 	diff |= NEIGH_DIFF(IFINDEX,	a->n_ifindex != b->n_ifindex);
 	diff |= NEIGH_DIFF(FAMILY,	a->n_family != b->n_family);
 	diff |= NEIGH_DIFF(TYPE,	a->n_type != b->n_type);
-	diff |= NEIGH_DIFF(LLADDR,	nl_addr_cmp(a->n_lladdr, b->n_lladdr));
-	diff |= NEIGH_DIFF(DST,		nl_addr_cmp(a->n_dst, b->n_dst));
+	diff |= NEIGH_DIFF(LLADDR,	nl_inline_addr_cmp(&a->n_lladdr, &b->n_lladdr));
+	diff |= NEIGH_DIFF(DST,		nl_inline_addr_cmp(&a->n_dst, &b->n_dst));
 	diff |= NEIGH_DIFF(MASTER,	a->n_master != b->n_master);
 	diff |= NEIGH_DIFF(VLAN,	a->n_vlan != b->n_vlan);
 
@@ -383,24 +374,18 @@ int rtnl_neigh_parse(struct nlmsghdr *n, struct rtnl_neigh **result)
 			   NEIGH_ATTR_TYPE);
 
 	if (tb[NDA_LLADDR]) {
-		neigh->n_lladdr = nl_addr_alloc_attr(tb[NDA_LLADDR], AF_UNSPEC);
-		if (!neigh->n_lladdr) {
-			err = -NLE_NOMEM;
+		err = nl_inline_addr_set_attr(&neigh->n_lladdr, tb[NDA_LLADDR],
+				nl_addr_guess_family_len(nla_len(tb[NDA_LLADDR])));
+		if (err < 0)
 			goto errout;
-		}
-		nl_addr_set_family(neigh->n_lladdr,
-				   nl_addr_guess_family(neigh->n_lladdr));
 		neigh->ce_mask |= NEIGH_ATTR_LLADDR;
 	}
 
 	if (tb[NDA_DST]) {
-		neigh->n_dst = nl_addr_alloc_attr(tb[NDA_DST], AF_UNSPEC);
-		if (!neigh->n_dst) {
-			err = -NLE_NOMEM;
+		err = nl_inline_addr_set_attr(&neigh->n_dst, tb[NDA_DST],
+				nl_addr_guess_family_len(nla_len(tb[NDA_DST])));
+		if (err < 0)
 			goto errout;
-		}
-		nl_addr_set_family(neigh->n_dst,
-				   nl_addr_guess_family(neigh->n_dst));
 		neigh->ce_mask |= NEIGH_ATTR_DST;
 	}
 
@@ -468,10 +453,50 @@ errout:
  * XXX: Also add support for caching entries from a given brport, send
  *      as .ifi_index.
  */
+static int neigh_request_filtered(struct nl_cache *c, struct nl_sock *h,
+				  struct rtnl_neigh *filter)
+{
+	struct ndmsg hdr = {
+		.ndm_family = c->c_iarg1,
+	};
+	struct nl_msg *msg;
+	int err = -NLE_MSGSIZE;
+
+	if (hdr.ndm_family == AF_UNSPEC && (filter->ce_mask & NEIGH_ATTR_FAMILY))
+		hdr.ndm_family = filter->n_family;
+
+	msg = nlmsg_alloc_simple(RTM_GETNEIGH, NLM_F_DUMP);
+	if (!msg)
+		return -NLE_NOMEM;
+
+	/* Strict checking requires a complete ndmsg header, the kernel
+	 * filters by interface and master attributes only */
+	if (nlmsg_append(msg, &hdr, sizeof(hdr), NLMSG_ALIGNTO) < 0)
+		goto nla_put_failure;
+
+	if (filter->ce_mask & NEIGH_ATTR_IFINDEX)
+		NLA_PUT_U32(msg, NDA_IFINDEX, filter->n_ifindex);
+	if (filter->ce_mask & NEIGH_ATTR_MASTER)
+		NLA_PUT_U32(msg, NDA_MASTER, filter->n_master);
+
+	err = nl_send_auto(h, msg);
+	if (err > 0)
+		err = 0;
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return err;
+}
+
 static int neigh_request_update(struct nl_cache *c, struct nl_sock *h)
 {
 	int family = c->c_iarg1;
 	struct ifinfomsg hdr = {.ifi_family = family};
+	struct rtnl_neigh *filter;
+
+	filter = (struct rtnl_neigh *) _nl_cache_dump_filter(c, h);
+	if (filter)
+		return neigh_request_filtered(c, h, filter);
 
 	if (family == AF_UNSPEC) {
 		return nl_send_simple(h, RTM_GETNEIGH, NLM_F_DUMP, &hdr, sizeof(hdr));
@@ -514,7 +539,7 @@ static void neigh_dump_line(struct nl_object *a, struct nl_dump_params *p)
 		nl_dump_line(p, "%s ", nl_af2str(n->n_family, buf, sizeof(buf)));
 
 	if (n->ce_mask & NEIGH_ATTR_DST)
-		nl_dump_line(p, "%s ", nl_addr2str(n->n_dst, dst, sizeof(dst)));
+		nl_dump_line(p, "%s ", nl_inline_addr2str(&n->n_dst, dst, sizeof(dst)));
 
 	if (link_cache)
 		nl_dump(p, "dev %s ",
@@ -525,7 +550,7 @@ static void neigh_dump_line(struct nl_object *a, struct nl_dump_params *p)
 
 	if (n->ce_mask & NEIGH_ATTR_LLADDR)
 		nl_dump(p, "lladdr %s ",
-			nl_addr2str(n->n_lladdr, lladdr, sizeof(lladdr)));
+			nl_inline_addr2str(&n->n_lladdr, lladdr, sizeof(lladdr)));
 
 	if (n->ce_mask & NEIGH_ATTR_VLAN)
 		nl_dump(p, "vlan %d ", n->n_vlan);
@@ -659,7 +684,7 @@ struct rtnl_neigh * rtnl_neigh_get(struct nl_cache *cache, int ifindex,
 	nl_list_for_each_entry(neigh, &cache->c_items, ce_list) {
 		if (neigh->n_ifindex == ifindex &&
 		    neigh->n_family == dst->a_family &&
-		    !nl_addr_cmp(neigh->n_dst, dst)) {
+		    !nl_inline_addr_cmp_addr(&neigh->n_dst, dst)) {
 			nl_object_get((struct nl_object *) neigh);
 			return neigh;
 		}
@@ -685,7 +710,8 @@ struct rtnl_neigh * rtnl_neigh_get_by_vlan(struct nl_cache *cache, int ifindex,
 	nl_list_for_each_entry(neigh, &cache->c_items, ce_list) {
 		if (neigh->n_ifindex == ifindex &&
 		    neigh->n_vlan == vlan &&
-		    neigh->n_lladdr && !nl_addr_cmp(neigh->n_lladdr, lladdr)) {
+		    nl_inline_addr_isset(&neigh->n_lladdr) &&
+		    !nl_inline_addr_cmp_addr(&neigh->n_lladdr, lladdr)) {
 			nl_object_get((struct nl_object *) neigh);
 			return neigh;
 		}
@@ -713,7 +739,7 @@ static int build_neigh_msg(struct rtnl_neigh *tmpl, int cmd, int flags,
 	if (tmpl->n_family != AF_BRIDGE) {
 		if (!(tmpl->ce_mask & NEIGH_ATTR_DST))
 			return -NLE_MISSING_ATTR;
-		nhdr.ndm_family = nl_addr_get_family(tmpl->n_dst);
+		nhdr.ndm_family = nl_inline_addr_family(&tmpl->n_dst);
 	}
 	else
 		nhdr.ndm_family = AF_BRIDGE;
@@ -731,11 +757,13 @@ static int build_neigh_msg(struct rtnl_neigh *tmpl, int cmd, int flags,
 	if (nlmsg_append(msg, &nhdr, sizeof(nhdr), NLMSG_ALIGNTO) < 0)
 		goto nla_put_failure;
 
-	if (tmpl->n_family != AF_BRIDGE)
-		NLA_PUT_ADDR(msg, NDA_DST, tmpl->n_dst);
+	if (tmpl->n_family != AF_BRIDGE &&
+	    nl_inline_addr_put(msg, NDA_DST, &tmpl->n_dst) < 0)
+		goto nla_put_failure;
 
-	if (tmpl->ce_mask & NEIGH_ATTR_LLADDR)
-		NLA_PUT_ADDR(msg, NDA_LLADDR, tmpl->n_lladdr);
+	if ((tmpl->ce_mask & NEIGH_ATTR_LLADDR) &&
+	    nl_inline_addr_put(msg, NDA_LLADDR, &tmpl->n_lladdr) < 0)
+		goto nla_put_failure;
 
 	if (tmpl->ce_mask & NEIGH_ATTR_VLAN)
 		NLA_PUT_U16(msg, NDA_VLAN, tmpl->n_vlan);
@@ -1001,8 +1029,9 @@ int rtnl_neigh_get_ifindex(struct rtnl_neigh *neigh)
 	return neigh->n_ifindex;
 }
 
-static inline int __assign_addr(struct rtnl_neigh *neigh, struct nl_addr **pos,
-			        struct nl_addr *new, int flag, int nocheck)
+static inline int __assign_addr(struct rtnl_neigh *neigh,
+				struct nl_inline_addr *pos,
+				struct nl_addr *new, int flag, int nocheck)
 {
 	if (!nocheck) {
 		if (neigh->ce_mask & NEIGH_ATTR_FAMILY) {
@@ -1014,11 +1043,7 @@ static inline int __assign_addr(struct rtnl_neigh *neigh, struct nl_addr **pos,
 		}
 	}
 
-	if (*pos)
-		nl_addr_put(*pos);
-
-	nl_addr_get(new);
-	*pos = new;
+	nl_inline_addr_set(pos, new);
 
 	neigh->ce_mask |= flag;
 
@@ -1033,7 +1058,7 @@ void rtnl_neigh_set_lladdr(struct rtnl_neigh *neigh, struct nl_addr *addr)
 struct nl_addr *rtnl_neigh_get_lladdr(struct rtnl_neigh *neigh)
 {
 	if (neigh->ce_mask & NEIGH_ATTR_LLADDR)
-		return neigh->n_lladdr;
+		return nl_inline_addr_get(&neigh->n_lladdr);
 	else
 		return NULL;
 }
@@ -1047,7 +1072,7 @@ int rtnl_neigh_set_dst(struct rtnl_neigh *neigh, struct nl_addr *addr)
 struct nl_addr *rtnl_neigh_get_dst(struct rtnl_neigh *neigh)
 {
 	if (neigh->ce_mask & NEIGH_ATTR_DST)
-		return neigh->n_dst;
+		return nl_inline_addr_get(&neigh->n_dst);
 	else
 		return NULL;
 }
@@ -1115,6 +1140,7 @@ static struct nl_object_ops neigh_obj_ops = {
 	},
 	.oo_compare		= neigh_compare,
 	.oo_keygen		= neigh_keygen,
+	.oo_hash_attrs		= neigh_hash_attrs,
 	.oo_attrs2str		= neigh_attrs2str,
 	.oo_id_attrs		= (NEIGH_ATTR_IFINDEX | NEIGH_ATTR_DST | NEIGH_ATTR_FAMILY),
 	.oo_id_attrs_get	= neigh_id_attrs_get
@@ -24,7 +24,7 @@
 #include <netlink/route/netconf.h>
 #include <linux/netconf.h>
 #include <linux/socket.h>
-#include <netlink/hashtable.h>
+#include <netlink-private/hash.h>
 
 /** @cond SKIP */
 #define NETCONF_ATTR_FAMILY		0x0001
@@ -81,16 +81,6 @@ static struct rtnl_netconf *rtnl_netconf_alloc(void)
 	return (struct rtnl_netconf *) nl_object_alloc(&netconf_obj_ops);
 }
 
-static int netconf_clone(struct nl_object *_dst, struct nl_object *_src)
-{
-	struct rtnl_netconf *dst = nl_object_priv(_dst);
-	struct rtnl_netconf *src = nl_object_priv(_src);
-
-	*dst = *src;
-
-	return 0;
-}
-
 static int netconf_msg_parser(struct nl_cache_ops *ops, struct sockaddr_nl *who,
 			      struct nlmsghdr *nlh, struct nl_parser_param *pp)
 {
@@ -283,20 +273,16 @@ static void netconf_keygen(struct nl_object *obj, uint32_t *hashkey,
 			   uint32_t table_sz)
 {
 	struct rtnl_netconf *nc = (struct rtnl_netconf *) obj;
-	unsigned int nckey_sz;
-	struct nc_hash_key {
-		int        nc_family;
-		int        nc_index;
-	} __attribute__((packed)) nckey;
+	struct nl_hasher h;
 
-	nckey_sz = sizeof(nckey);
-	nckey.nc_family = nc->family;
-	nckey.nc_index = nc->ifindex;
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, nc->family);
+	nl_hasher_u32(&h, nc->ifindex);
 
-	*hashkey = nl_hash(&nckey, nckey_sz, 0) % table_sz;
+	*hashkey = nl_hasher_final(&h) % table_sz;
 
-	NL_DBG(5, "netconf %p key (dev %d fam %d) keysz %d, hash 0x%x\n",
-	       nc, nckey.nc_index, nckey.nc_family, nckey_sz, *hashkey);
+	NL_DBG(5, "netconf %p key (dev %d fam %d) hash 0x%x\n",
+	       nc, nc->ifindex, nc->family, *hashkey);
 }
 
 static uint64_t netconf_compare(struct nl_object *_a, struct nl_object *_b,
@@ -323,6 +309,27 @@ static uint64_t netconf_compare(struct nl_object *_a, struct nl_object *_b,
 	return diff;
 }
 
+#define NETCONF_UPDATE_ATTRS	(NETCONF_ATTR_RP_FILTER | NETCONF_ATTR_FWDING | \
+				 NETCONF_ATTR_MC_FWDING | \
+				 NETCONF_ATTR_PROXY_NEIGH | \
+				 NETCONF_ATTR_IGNORE_RT_LINKDWN)
+
+static int netconf_update_attrs(struct nl_object *old_obj,
+				struct nl_object *new_obj, uint64_t *attrs)
+{
+	struct rtnl_netconf *new_nc = (struct rtnl_netconf *) new_obj;
+	struct rtnl_netconf *old_nc = (struct rtnl_netconf *) old_obj;
+
+	if (new_obj->ce_msgtype != RTM_NEWNETCONF ||
+	    new_nc->family != old_nc->family ||
+	    new_nc->ifindex != old_nc->ifindex)
+		return -NLE_OPNOTSUPP;
+
+	/* Notifications without any value still merge, as a no-op */
+	*attrs = new_nc->ce_mask & NETCONF_UPDATE_ATTRS;
+	return 0;
+}
+
 static int netconf_update(struct nl_object *old_obj, struct nl_object *new_obj)
 {
 	struct rtnl_netconf *new_nc = (struct rtnl_netconf *) new_obj;
@@ -535,7 +542,6 @@ int rtnl_netconf_get_input(struct rtnl_netconf *nc, int *val)
 static struct nl_object_ops netconf_obj_ops = {
 	.oo_name		= "route/netconf",
 	.oo_size		= sizeof(struct rtnl_netconf),
-	.oo_clone		= netconf_clone,
 	.oo_dump = {
 	    [NL_DUMP_LINE] 	= netconf_dump_line,
 	    [NL_DUMP_DETAILS] 	= netconf_dump_line,
@@ -543,6 +549,7 @@ static struct nl_object_ops netconf_obj_ops = {
 	.oo_compare		= netconf_compare,
 	.oo_keygen		= netconf_keygen,
 	.oo_update		= netconf_update,
+	.oo_update_attrs	= netconf_update_attrs,
 	.oo_attrs2str		= netconf_attrs2str,
 	.oo_id_attrs		= (NETCONF_ATTR_FAMILY      |
 				   NETCONF_ATTR_IFINDEX)
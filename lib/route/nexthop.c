@@ -17,28 +17,56 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
 #include <netlink-private/route/nexthop-encap.h>
+#include <netlink-private/route/nexthop.h>
 #include <netlink/netlink.h>
 #include <netlink/utils.h>
 #include <netlink/route/rtnl.h>
 #include <netlink/route/route.h>
 
-/** @cond SKIP */
-#define NH_ATTR_FLAGS   0x000001
-#define NH_ATTR_WEIGHT  0x000002
-#define NH_ATTR_IFINDEX 0x000004
-#define NH_ATTR_GATEWAY 0x000008
-#define NH_ATTR_REALMS  0x000010
-#define NH_ATTR_NEWDST  0x000020
-#define NH_ATTR_VIA     0x000040
-#define NH_ATTR_ENCAP   0x000080
-/** @endcond */
-
 /**
  * @name Allocation/Freeing
  * @{
  */
 
+void rtnl_route_nh_init(struct rtnl_nexthop *nh)
+{
+	memset(nh, 0, sizeof(*nh));
+	nl_init_list_head(&nh->rtnh_list);
+}
+
+struct rtnl_nh_array *rtnl_route_nh_array_alloc(unsigned int n)
+{
+	struct rtnl_nh_array *array;
+
+	array = calloc(1, sizeof(*array) + n * sizeof(array->na_nh[0]));
+	if (!array)
+		return NULL;
+
+	array->na_refcnt = 1;
+
+	return array;
+}
+
+struct rtnl_nexthop *rtnl_route_nh_array_init(struct rtnl_nh_array *array,
+					      unsigned int i)
+{
+	struct rtnl_nexthop *nh = &array->na_nh[i];
+
+	rtnl_route_nh_init(nh);
+	nh->rtnh_array = array;
+	array->na_refcnt++;
+
+	return nh;
+}
+
+void rtnl_route_nh_array_put(struct rtnl_nh_array *array)
+{
+	if (array && --array->na_refcnt == 0)
+		free(array);
+}
+
 struct rtnl_nexthop *rtnl_route_nh_alloc(void)
 {
 	struct rtnl_nexthop *nh;
@@ -52,6 +80,38 @@ struct rtnl_nexthop *rtnl_route_nh_alloc(void)
 	return nh;
 }
 
+/* Copies all attributes of src into the initialized nexthop dst */
+int rtnl_route_nh_copy(struct rtnl_nexthop *dst, struct rtnl_nexthop *src)
+{
+	dst->rtnh_flags = src->rtnh_flags;
+	dst->rtnh_flag_mask = src->rtnh_flag_mask;
+	dst->rtnh_weight = src->rtnh_weight;
+	dst->rtnh_ifindex = src->rtnh_ifindex;
+	dst->rtnh_realms = src->rtnh_realms;
+	dst->ce_mask = src->ce_mask;
+
+	if (nl_inline_addr_clone(&dst->rtnh_gateway, &src->rtnh_gateway) < 0)
+		goto errout;
+
+	if (src->rtnh_newdst) {
+		dst->rtnh_newdst = nl_addr_clone_shared(src->rtnh_newdst);
+		if (!dst->rtnh_newdst)
+			goto errout;
+	}
+
+	if (src->rtnh_via) {
+		dst->rtnh_via = nl_addr_clone_shared(src->rtnh_via);
+		if (!dst->rtnh_via)
+			goto errout;
+	}
+
+	return 0;
+
+errout:
+	rtnl_route_nh_release(dst);
+	return -NLE_NOMEM;
+}
+
 struct rtnl_nexthop *rtnl_route_nh_clone(struct rtnl_nexthop *src)
 {
 	struct rtnl_nexthop *nh;
@@ -60,54 +120,48 @@ struct rtnl_nexthop *rtnl_route_nh_clone(struct rtnl_nexthop *src)
 	if (!nh)
 		return NULL;
 
-	nh->rtnh_flags = src->rtnh_flags;
-	nh->rtnh_flag_mask = src->rtnh_flag_mask;
-	nh->rtnh_weight = src->rtnh_weight;
-	nh->rtnh_ifindex = src->rtnh_ifindex;
-	nh->ce_mask = src->ce_mask;
-
-	if (src->rtnh_gateway) {
-		nh->rtnh_gateway = nl_addr_clone(src->rtnh_gateway);
-		if (!nh->rtnh_gateway) {
-			free(nh);
-			return NULL;
-		}
-	}
-
-	if (src->rtnh_newdst) {
-		nh->rtnh_newdst = nl_addr_clone(src->rtnh_newdst);
-		if (!nh->rtnh_newdst) {
-			nl_addr_put(nh->rtnh_gateway);
-			free(nh);
-			return NULL;
-		}
-	}
-
-	if (src->rtnh_via) {
-		nh->rtnh_via = nl_addr_clone(src->rtnh_via);
-		if (!nh->rtnh_via) {
-			nl_addr_put(nh->rtnh_gateway);
-			nl_addr_put(nh->rtnh_newdst);
-			free(nh);
-			return NULL;
-		}
+	if (rtnl_route_nh_copy(nh, src) < 0) {
+		free(nh);
+		return NULL;
 	}
 
 	return nh;
 }
 
-void rtnl_route_nh_free(struct rtnl_nexthop *nh)
+/* Frees the attributes of a nexthop but not the nexthop itself */
+void rtnl_route_nh_release(struct rtnl_nexthop *nh)
 {
-	nl_addr_put(nh->rtnh_gateway);
+	nl_inline_addr_release(&nh->rtnh_gateway);
 	nl_addr_put(nh->rtnh_newdst);
 	nl_addr_put(nh->rtnh_via);
+	nh->rtnh_newdst = nh->rtnh_via = NULL;
+
 	if (nh->rtnh_encap) {
 		if (nh->rtnh_encap->ops && nh->rtnh_encap->ops->destructor)
 			nh->rtnh_encap->ops->destructor(nh->rtnh_encap->priv);
 		free(nh->rtnh_encap->priv);
 		free(nh->rtnh_encap);
+		nh->rtnh_encap = NULL;
 	}
-	free(nh);
+}
+
+/**
+ * Free nexthop
+ * @arg nh		Nexthop
+ *
+ * Nexthops received from the kernel share one allocation per route,
+ * which is released once the route and all of its nexthops are freed.
+ * A nexthop removed with rtnl_route_remove_nexthop() therefore remains
+ * valid, also after freeing the route or adding it to another route,
+ * until it is freed with this function.
+ */
+void rtnl_route_nh_free(struct rtnl_nexthop *nh)
+{
+	rtnl_route_nh_release(nh);
+	if (nh->rtnh_array)
+		rtnl_route_nh_array_put(nh->rtnh_array);
+	else
+		free(nh);
 }
 
 /** @} */
@@ -122,8 +176,8 @@ int rtnl_route_nh_compare(struct rtnl_nexthop *a, struct rtnl_nexthop *b,
 	diff |= NH_DIFF(IFINDEX,	a->rtnh_ifindex != b->rtnh_ifindex);
 	diff |= NH_DIFF(WEIGHT,		a->rtnh_weight != b->rtnh_weight);
 	diff |= NH_DIFF(REALMS,		a->rtnh_realms != b->rtnh_realms);
-	diff |= NH_DIFF(GATEWAY,	nl_addr_cmp(a->rtnh_gateway,
-						    b->rtnh_gateway));
+	diff |= NH_DIFF(GATEWAY,	nl_inline_addr_cmp(&a->rtnh_gateway,
+							   &b->rtnh_gateway));
 	diff |= NH_DIFF(NEWDST,		nl_addr_cmp(a->rtnh_newdst,
 						    b->rtnh_newdst));
 	diff |= NH_DIFF(VIA,		nl_addr_cmp(a->rtnh_via,
@@ -163,8 +217,8 @@ static void nh_dump_line(struct rtnl_nexthop *nh, struct nl_dump_params *dp)
 			nl_addr2str(nh->rtnh_via, buf, sizeof(buf)));
 
 	if (nh->ce_mask & NH_ATTR_GATEWAY)
-		nl_dump(dp, " %s", nl_addr2str(nh->rtnh_gateway,
-						   buf, sizeof(buf)));
+		nl_dump(dp, " %s", nl_inline_addr2str(&nh->rtnh_gateway,
+						       buf, sizeof(buf)));
 
 	if(nh->ce_mask & NH_ATTR_IFINDEX) {
 		if (link_cache) {
@@ -203,8 +257,9 @@ static void nh_dump_details(struct rtnl_nexthop *nh, struct nl_dump_params *dp)
 			nl_addr2str(nh->rtnh_via, buf, sizeof(buf)));
 
 	if (nh->ce_mask & NH_ATTR_GATEWAY)
-		nl_dump(dp, " via %s", nl_addr2str(nh->rtnh_gateway,
-						   buf, sizeof(buf)));
+		nl_dump(dp, " via %s",
+			nl_inline_addr2str(&nh->rtnh_gateway,
+					   buf, sizeof(buf)));
 
 	if(nh->ce_mask & NH_ATTR_IFINDEX) {
 		if (link_cache) {
@@ -298,23 +353,41 @@ int rtnl_route_nh_get_ifindex(struct rtnl_nexthop *nh)
 /* FIXME: Convert to return an int */
 void rtnl_route_nh_set_gateway(struct rtnl_nexthop *nh, struct nl_addr *addr)
 {
-	struct nl_addr *old = nh->rtnh_gateway;
+	nl_inline_addr_set(&nh->rtnh_gateway, addr);
 
-	if (addr) {
-		nh->rtnh_gateway = nl_addr_get(addr);
+	if (addr)
 		nh->ce_mask |= NH_ATTR_GATEWAY;
-	} else {
+	else
 		nh->ce_mask &= ~NH_ATTR_GATEWAY;
-		nh->rtnh_gateway = NULL;
-	}
+}
 
-	if (old)
-		nl_addr_put(old);
+/* Sets the gateway from a binary address as found in RTA_GATEWAY */
+int rtnl_route_nh_set_gateway_attr(struct rtnl_nexthop *nh,
+				   struct nlattr *attr, int family)
+{
+	int err;
+
+	if ((err = nl_inline_addr_set_attr(&nh->rtnh_gateway, attr, family)) < 0)
+		return err;
+
+	nh->ce_mask |= NH_ATTR_GATEWAY;
+	return 0;
+}
+
+int rtnl_route_nh_put_gateway(struct nl_msg *msg, struct rtnl_nexthop *nh)
+{
+	if (!(nh->ce_mask & NH_ATTR_GATEWAY))
+		return 0;
+
+	return nl_inline_addr_put(msg, RTA_GATEWAY, &nh->rtnh_gateway);
 }
 
 struct nl_addr *rtnl_route_nh_get_gateway(struct rtnl_nexthop *nh)
 {
-	return nh->rtnh_gateway;
+	if (!(nh->ce_mask & NH_ATTR_GATEWAY))
+		return NULL;
+
+	return nl_inline_addr_get(&nh->rtnh_gateway);
 }
 
 void rtnl_route_nh_set_flags(struct rtnl_nexthop *nh, unsigned int flags)
@@ -0,0 +1,1165 @@
+/* SPDX-License-Identifier: LGPL-2.1-only */
+/*
+ * lib/route/nh.c	Nexthop Objects
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+/**
+ * @ingroup rtnl
+ * @defgroup nh Nexthop Objects
+ * @brief
+ *
+ * Nexthop objects are created and deleted independently of routes
+ * (RTM_NEWNEXTHOP, RTM_DELNEXTHOP). Routes refer to them by their
+ * identifier, see rtnl_route_set_nhid(). A nexthop object is either a
+ * single nexthop with a gateway and/or an outgoing interface, or a group
+ * of other nexthop objects. Groups are of type NEXTHOP_GRP_TYPE_MPATH
+ * (hash-threshold) or NEXTHOP_GRP_TYPE_RES (resilient hashing).
+ *
+ * Changing the gateway of a nexthop object changes the gateway of all
+ * routes referring to it with a single request.
+ *
+ * @code
+ * struct nl_cache *cache;
+ * struct rtnl_nh *nh;
+ *
+ * rtnl_nh_alloc_cache(sk, AF_UNSPEC, &cache);
+ *
+ * if ((nh = rtnl_nh_get(cache, rtnl_route_get_nhid(route)))) {
+ *	...
+ *	rtnl_nh_put(nh);
+ * }
+ * @endcode
+ * @{
+ */
+
+#include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
+#include <netlink-private/hash.h>
+#include <netlink/netlink.h>
+#include <netlink/utils.h>
+#include <netlink/route/rtnl.h>
+#include <netlink/route/link.h>
+#include <netlink/route/route.h>
+#include <netlink/route/nexthop.h>
+#include <netlink/route/nh.h>
+#include <linux/nexthop.h>
+
+/** @cond SKIP */
+#define NHO_ATTR_ID			0x000001
+#define NHO_ATTR_FAMILY			0x000002
+#define NHO_ATTR_SCOPE			0x000004
+#define NHO_ATTR_PROTOCOL		0x000008
+#define NHO_ATTR_FLAGS			0x000010
+#define NHO_ATTR_OIF			0x000020
+#define NHO_ATTR_GATEWAY		0x000040
+#define NHO_ATTR_BLACKHOLE		0x000080
+#define NHO_ATTR_FDB			0x000100
+#define NHO_ATTR_GROUP			0x000200
+#define NHO_ATTR_GROUP_TYPE		0x000400
+#define NHO_ATTR_RES_BUCKETS		0x000800
+#define NHO_ATTR_RES_IDLE_TIMER		0x001000
+#define NHO_ATTR_RES_UNBALANCED_TIMER	0x002000
+#define NHO_ATTR_RES_UNBALANCED_TIME	0x004000
+
+/* Maximum weight of a group member, the kernel stores weight - 1 in a u8 */
+#define NH_GROUP_WEIGHT_MAX		256
+
+static struct nl_cache_ops rtnl_nh_ops;
+static struct nl_object_ops nh_obj_ops;
+/** @endcond */
+
+static void nh_free_data(struct nl_object *c)
+{
+	struct rtnl_nh *nh = nl_object_priv(c);
+
+	if (!nh)
+		return;
+
+	nl_addr_put(nh->nh_gateway);
+	free(nh->nh_group);
+}
+
+static int nh_clone(struct nl_object *_dst, struct nl_object *_src)
+{
+	struct rtnl_nh *dst = nl_object_priv(_dst);
+	struct rtnl_nh *src = nl_object_priv(_src);
+
+	dst->nh_gateway = NULL;
+	dst->nh_group = NULL;
+
+	if (src->nh_gateway)
+		if (!(dst->nh_gateway = nl_addr_clone_shared(src->nh_gateway)))
+			return -NLE_NOMEM;
+
+	if (src->nh_group_size) {
+		dst->nh_group = calloc(src->nh_group_size,
+				       sizeof(*dst->nh_group));
+		if (!dst->nh_group)
+			return -NLE_NOMEM;
+
+		memcpy(dst->nh_group, src->nh_group,
+		       src->nh_group_size * sizeof(*dst->nh_group));
+	}
+
+	return 0;
+}
+
+static struct nla_policy nh_policy[NHA_MAX+1] = {
+	[NHA_ID]		= { .type = NLA_U32 },
+	[NHA_GROUP]		= { .minlen = sizeof(struct nexthop_grp) },
+	[NHA_GROUP_TYPE]	= { .type = NLA_U16 },
+	[NHA_BLACKHOLE]		= { .type = NLA_FLAG },
+	[NHA_OIF]		= { .type = NLA_U32 },
+	[NHA_FDB]		= { .type = NLA_FLAG },
+	[NHA_RES_GROUP]		= { .type = NLA_NESTED },
+};
+
+static struct nla_policy nh_res_group_policy[NHA_RES_GROUP_MAX+1] = {
+	[NHA_RES_GROUP_BUCKETS]		= { .type = NLA_U16 },
+	[NHA_RES_GROUP_IDLE_TIMER]	= { .type = NLA_U32 },
+	[NHA_RES_GROUP_UNBALANCED_TIMER] = { .type = NLA_U32 },
+	[NHA_RES_GROUP_UNBALANCED_TIME]	= { .type = NLA_U64 },
+};
+
+static int nh_parse_group(struct rtnl_nh *nh, struct nlattr *attr)
+{
+	struct nexthop_grp *grp = nla_data(attr);
+	int i, n = nla_len(attr) / sizeof(*grp);
+
+	nh->nh_group = calloc(n, sizeof(*nh->nh_group));
+	if (!nh->nh_group)
+		return -NLE_NOMEM;
+
+	for (i = 0; i < n; i++) {
+		nh->nh_group[i].nhe_id = grp[i].id;
+		nh->nh_group[i].nhe_weight = grp[i].weight + 1;
+	}
+
+	nh->nh_group_size = n;
+	nh->ce_mask |= NHO_ATTR_GROUP;
+
+	return 0;
+}
+
+static int nh_parse_res_group(struct rtnl_nh *nh, struct nlattr *attr)
+{
+	struct nlattr *tb[NHA_RES_GROUP_MAX+1];
+	int err;
+
+	err = nla_parse_nested(tb, NHA_RES_GROUP_MAX, attr,
+			       nh_res_group_policy);
+	if (err < 0)
+		return err;
+
+	if (tb[NHA_RES_GROUP_BUCKETS]) {
+		nh->nh_res_buckets = nla_get_u16(tb[NHA_RES_GROUP_BUCKETS]);
+		nh->ce_mask |= NHO_ATTR_RES_BUCKETS;
+	}
+
+	if (tb[NHA_RES_GROUP_IDLE_TIMER]) {
+		nh->nh_res_idle_timer =
+			nla_get_u32(tb[NHA_RES_GROUP_IDLE_TIMER]);
+		nh->ce_mask |= NHO_ATTR_RES_IDLE_TIMER;
+	}
+
+	if (tb[NHA_RES_GROUP_UNBALANCED_TIMER]) {
+		nh->nh_res_unbalanced_timer =
+			nla_get_u32(tb[NHA_RES_GROUP_UNBALANCED_TIMER]);
+		nh->ce_mask |= NHO_ATTR_RES_UNBALANCED_TIMER;
+	}
+
+	if (tb[NHA_RES_GROUP_UNBALANCED_TIME]) {
+		nh->nh_res_unbalanced_time =
+			nla_get_u64(tb[NHA_RES_GROUP_UNBALANCED_TIME]);
+		nh->ce_mask |= NHO_ATTR_RES_UNBALANCED_TIME;
+	}
+
+	return 0;
+}
+
+static int nh_msg_parser(struct nl_cache_ops *ops, struct sockaddr_nl *who,
+			 struct nlmsghdr *n, struct nl_parser_param *pp)
+{
+	struct rtnl_nh *nh;
+	struct nhmsg *nhm;
+	struct nlattr *tb[NHA_MAX+1];
+	int err;
+
+	nh = rtnl_nh_alloc();
+	if (!nh)
+		return -NLE_NOMEM;
+
+	nh->ce_msgtype = n->nlmsg_type;
+	nhm = nlmsg_data(n);
+
+	err = nlmsg_parse(n, sizeof(*nhm), tb, NHA_MAX, nh_policy);
+	if (err < 0)
+		goto errout;
+
+	nh->nh_family = nhm->nh_family;
+	nh->nh_scope = nhm->nh_scope;
+	nh->nh_protocol = nhm->nh_protocol;
+	nh->nh_flags = nhm->nh_flags;
+	nh->ce_mask = (NHO_ATTR_FAMILY | NHO_ATTR_SCOPE | NHO_ATTR_PROTOCOL |
+		       NHO_ATTR_FLAGS);
+
+	if (tb[NHA_ID]) {
+		nh->nh_id = nla_get_u32(tb[NHA_ID]);
+		nh->ce_mask |= NHO_ATTR_ID;
+	}
+
+	if (tb[NHA_GROUP] && (err = nh_parse_group(nh, tb[NHA_GROUP])) < 0)
+		goto errout;
+
+	if (tb[NHA_GROUP_TYPE]) {
+		nh->nh_group_type = nla_get_u16(tb[NHA_GROUP_TYPE]);
+		nh->ce_mask |= NHO_ATTR_GROUP_TYPE;
+	}
+
+	if (tb[NHA_RES_GROUP] &&
+	    (err = nh_parse_res_group(nh, tb[NHA_RES_GROUP])) < 0)
+		goto errout;
+
+	if (tb[NHA_BLACKHOLE])
+		nh->ce_mask |= NHO_ATTR_BLACKHOLE;
+
+	if (tb[NHA_FDB])
+		nh->ce_mask |= NHO_ATTR_FDB;
+
+	if (tb[NHA_OIF]) {
+		nh->nh_oif = nla_get_u32(tb[NHA_OIF]);
+		nh->ce_mask |= NHO_ATTR_OIF;
+	}
+
+	if (tb[NHA_GATEWAY]) {
+		nh->nh_gateway = nl_addr_intern(
+				nl_addr_alloc_attr(tb[NHA_GATEWAY],
+						   nh->nh_family));
+		if (!nh->nh_gateway) {
+			err = -NLE_NOMEM;
+			goto errout;
+		}
+		nh->ce_mask |= NHO_ATTR_GATEWAY;
+	}
+
+	err = pp->pp_cb((struct nl_object *) nh, pp);
+errout:
+	rtnl_nh_put(nh);
+	return err;
+}
+
+static int nh_request_update(struct nl_cache *c, struct nl_sock *h)
+{
+	struct nhmsg nhm = {
+		.nh_family = c->c_iarg1,
+	};
+	struct rtnl_nh *filter;
+	struct nl_msg *msg;
+	int err = -NLE_MSGSIZE;
+
+	filter = (struct rtnl_nh *) _nl_cache_dump_filter(c, h);
+	if (!filter)
+		return nl_send_simple(h, RTM_GETNEXTHOP, NLM_F_DUMP, &nhm,
+				      sizeof(nhm));
+
+	/* The kernel filters by family, outgoing interface and by
+	 * nexthop kind, all other header fields must be zero. */
+	if (nhm.nh_family == AF_UNSPEC && (filter->ce_mask & NHO_ATTR_FAMILY))
+		nhm.nh_family = filter->nh_family;
+
+	msg = nlmsg_alloc_simple(RTM_GETNEXTHOP, NLM_F_DUMP);
+	if (!msg)
+		return -NLE_NOMEM;
+
+	if (nlmsg_append(msg, &nhm, sizeof(nhm), NLMSG_ALIGNTO) < 0)
+		goto nla_put_failure;
+
+	if (filter->ce_mask & NHO_ATTR_OIF)
+		NLA_PUT_U32(msg, NHA_OIF, filter->nh_oif);
+
+	if (filter->ce_mask & NHO_ATTR_GROUP)
+		NLA_PUT_FLAG(msg, NHA_GROUPS);
+
+	if (filter->ce_mask & NHO_ATTR_FDB)
+		NLA_PUT_FLAG(msg, NHA_FDB);
+
+	err = nl_send_auto(h, msg);
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return err;
+}
+
+static void nh_dump_line(struct nl_object *o, struct nl_dump_params *p)
+{
+	struct rtnl_nh *nh = (struct rtnl_nh *) o;
+	struct nl_cache *link_cache;
+	char buf[128];
+	uint32_t i;
+
+	link_cache = nl_cache_mngt_require_safe("route/link");
+
+	nl_dump_line(p, "id %u ", nh->nh_id);
+
+	if (nh->ce_mask & NHO_ATTR_GROUP) {
+		nl_dump(p, "group ");
+		for (i = 0; i < nh->nh_group_size; i++) {
+			nl_dump(p, "%s%u", i ? "/" : "",
+				nh->nh_group[i].nhe_id);
+			if (nh->nh_group[i].nhe_weight > 1)
+				nl_dump(p, ",%u", nh->nh_group[i].nhe_weight);
+		}
+		nl_dump(p, " ");
+
+		if (nh->ce_mask & NHO_ATTR_GROUP_TYPE)
+			nl_dump(p, "type %s ",
+				rtnl_nh_group_type2str(nh->nh_group_type,
+						       buf, sizeof(buf)));
+	} else
+		nl_dump(p, "%s ", nl_af2str(nh->nh_family, buf, sizeof(buf)));
+
+	if (nh->ce_mask & NHO_ATTR_GATEWAY)
+		nl_dump(p, "via %s ",
+			nl_addr2str(nh->nh_gateway, buf, sizeof(buf)));
+
+	if (nh->ce_mask & NHO_ATTR_OIF) {
+		if (link_cache)
+			nl_dump(p, "dev %s ",
+				rtnl_link_i2name(link_cache, nh->nh_oif,
+						 buf, sizeof(buf)));
+		else
+			nl_dump(p, "dev %d ", nh->nh_oif);
+	}
+
+	if (nh->ce_mask & NHO_ATTR_BLACKHOLE)
+		nl_dump(p, "blackhole ");
+
+	if (nh->ce_mask & NHO_ATTR_FDB)
+		nl_dump(p, "fdb ");
+
+	if (nh->ce_mask & NHO_ATTR_PROTOCOL && nh->nh_protocol)
+		nl_dump(p, "proto %s ",
+			rtnl_route_proto2str(nh->nh_protocol, buf, sizeof(buf)));
+
+	if (nh->ce_mask & NHO_ATTR_FLAGS && nh->nh_flags)
+		nl_dump(p, "<%s>",
+			rtnl_route_nh_flags2str(nh->nh_flags, buf, sizeof(buf)));
+
+	nl_dump(p, "\n");
+
+	if (link_cache)
+		nl_cache_put(link_cache);
+}
+
+static void nh_dump_details(struct nl_object *o, struct nl_dump_params *p)
+{
+	struct rtnl_nh *nh = (struct rtnl_nh *) o;
+	int hz = nl_get_user_hz();
+
+	nh_dump_line(o, p);
+
+	if (!(nh->ce_mask & (NHO_ATTR_RES_BUCKETS | NHO_ATTR_RES_IDLE_TIMER |
+			     NHO_ATTR_RES_UNBALANCED_TIMER |
+			     NHO_ATTR_RES_UNBALANCED_TIME)))
+		return;
+
+	nl_dump_line(p, "    ");
+
+	if (nh->ce_mask & NHO_ATTR_RES_BUCKETS)
+		nl_dump(p, "buckets %u ", nh->nh_res_buckets);
+
+	if (nh->ce_mask & NHO_ATTR_RES_IDLE_TIMER)
+		nl_dump(p, "idle_timer %u ", nh->nh_res_idle_timer / hz);
+
+	if (nh->ce_mask & NHO_ATTR_RES_UNBALANCED_TIMER)
+		nl_dump(p, "unbalanced_timer %u ",
+			nh->nh_res_unbalanced_timer / hz);
+
+	if (nh->ce_mask & NHO_ATTR_RES_UNBALANCED_TIME)
+		nl_dump(p, "unbalanced_time %llu ",
+			(unsigned long long) nh->nh_res_unbalanced_time / hz);
+
+	nl_dump(p, "\n");
+}
+
+/* Nexthop identifiers are unique across all address families */
+static void nh_keygen(struct nl_object *obj, uint32_t *hashkey,
+		      uint32_t table_sz)
+{
+	struct rtnl_nh *nh = (struct rtnl_nh *) obj;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, nh->nh_id);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "nh %p key (id %u) hash 0x%x\n", nh, nh->nh_id, *hashkey);
+}
+
+static void nh_hash_attrs(struct nl_object *obj, uint64_t attrs,
+			  struct nl_hasher *h)
+{
+	struct rtnl_nh *nh = (struct rtnl_nh *) obj;
+
+	if (attrs & NHO_ATTR_ID)
+		nl_hasher_u32(h, nh->nh_id);
+	if (attrs & NHO_ATTR_FAMILY)
+		nl_hasher_u32(h, nh->nh_family);
+	if (attrs & NHO_ATTR_PROTOCOL)
+		nl_hasher_u32(h, nh->nh_protocol);
+	if (attrs & NHO_ATTR_OIF)
+		nl_hasher_u32(h, nh->nh_oif);
+	if (attrs & NHO_ATTR_GROUP_TYPE)
+		nl_hasher_u32(h, nh->nh_group_type);
+}
+
+static int nh_group_cmp(struct rtnl_nh *a, struct rtnl_nh *b)
+{
+	uint32_t i;
+
+	if (a->nh_group_size != b->nh_group_size)
+		return 1;
+
+	for (i = 0; i < a->nh_group_size; i++) {
+		if (a->nh_group[i].nhe_id != b->nh_group[i].nhe_id ||
+		    a->nh_group[i].nhe_weight != b->nh_group[i].nhe_weight)
+			return 1;
+	}
+
+	return 0;
+}
+
+static uint64_t nh_compare(struct nl_object *_a, struct nl_object *_b,
+			   uint64_t attrs, int flags)
+{
+	struct rtnl_nh *a = (struct rtnl_nh *) _a;
+	struct rtnl_nh *b = (struct rtnl_nh *) _b;
+	uint64_t diff = 0;
+
+#define NH_DIFF(ATTR, EXPR) ATTR_DIFF(attrs, NHO_ATTR_##ATTR, a, b, EXPR)
+
+	diff |= NH_DIFF(ID,		a->nh_id != b->nh_id);
+	diff |= NH_DIFF(FAMILY,		a->nh_family != b->nh_family);
+	diff |= NH_DIFF(SCOPE,		a->nh_scope != b->nh_scope);
+	diff |= NH_DIFF(PROTOCOL,	a->nh_protocol != b->nh_protocol);
+	diff |= NH_DIFF(OIF,		a->nh_oif != b->nh_oif);
+	diff |= NH_DIFF(GATEWAY,	nl_addr_cmp(a->nh_gateway,
+						    b->nh_gateway));
+	diff |= NH_DIFF(BLACKHOLE,	0);
+	diff |= NH_DIFF(FDB,		0);
+	diff |= NH_DIFF(GROUP,		nh_group_cmp(a, b));
+	diff |= NH_DIFF(GROUP_TYPE,	a->nh_group_type != b->nh_group_type);
+	diff |= NH_DIFF(RES_BUCKETS,	a->nh_res_buckets != b->nh_res_buckets);
+	diff |= NH_DIFF(RES_IDLE_TIMER,
+			a->nh_res_idle_timer != b->nh_res_idle_timer);
+	diff |= NH_DIFF(RES_UNBALANCED_TIMER,
+			a->nh_res_unbalanced_timer != b->nh_res_unbalanced_timer);
+
+	if (flags & LOOSE_COMPARISON)
+		diff |= NH_DIFF(FLAGS,
+				(a->nh_flags ^ b->nh_flags) & b->nh_flags);
+	else
+		diff |= NH_DIFF(FLAGS, a->nh_flags != b->nh_flags);
+
+#undef NH_DIFF
+
+	return diff;
+}
+
+static const struct trans_tbl nh_attrs[] = {
+	__ADD(NHO_ATTR_ID, id),
+	__ADD(NHO_ATTR_FAMILY, family),
+	__ADD(NHO_ATTR_SCOPE, scope),
+	__ADD(NHO_ATTR_PROTOCOL, protocol),
+	__ADD(NHO_ATTR_FLAGS, flags),
+	__ADD(NHO_ATTR_OIF, oif),
+	__ADD(NHO_ATTR_GATEWAY, gateway),
+	__ADD(NHO_ATTR_BLACKHOLE, blackhole),
+	__ADD(NHO_ATTR_FDB, fdb),
+	__ADD(NHO_ATTR_GROUP, group),
+	__ADD(NHO_ATTR_GROUP_TYPE, group_type),
+	__ADD(NHO_ATTR_RES_BUCKETS, res_buckets),
+	__ADD(NHO_ATTR_RES_IDLE_TIMER, res_idle_timer),
+	__ADD(NHO_ATTR_RES_UNBALANCED_TIMER, res_unbalanced_timer),
+	__ADD(NHO_ATTR_RES_UNBALANCED_TIME, res_unbalanced_time),
+};
+
+static char *nh_attrs2str(int attrs, char *buf, size_t len)
+{
+	return __flags2str(attrs, buf, len, nh_attrs, ARRAY_SIZE(nh_attrs));
+}
+
+/**
+ * @name Allocation/Freeing
+ * @{
+ */
+
+struct rtnl_nh *rtnl_nh_alloc(void)
+{
+	return (struct rtnl_nh *) nl_object_alloc(&nh_obj_ops);
+}
+
+void rtnl_nh_put(struct rtnl_nh *nh)
+{
+	nl_object_put((struct nl_object *) nh);
+}
+
+/** @} */
+
+/**
+ * @name Cache Management
+ * @{
+ */
+
+/**
+ * Build a nexthop cache including all nexthop objects in the kernel.
+ * @arg sk		Netlink socket.
+ * @arg family		Address family or AF_UNSPEC.
+ * @arg result		Pointer to store resulting cache.
+ *
+ * Allocates a new nexthop cache, initializes it properly and updates it
+ * to include all nexthop objects currently configured in the kernel.
+ * Nexthop groups have no address family and are only included if
+ * \a family is AF_UNSPEC.
+ *
+ * @return 0 on success or a negative error code.
+ */
+int rtnl_nh_alloc_cache(struct nl_sock *sk, int family,
+			struct nl_cache **result)
+{
+	struct nl_cache *cache;
+	int err;
+
+	if (!(cache = nl_cache_alloc(&rtnl_nh_ops)))
+		return -NLE_NOMEM;
+
+	cache->c_iarg1 = family;
+
+	if (sk && (err = nl_cache_refill(sk, cache)) < 0) {
+		nl_cache_free(cache);
+		return err;
+	}
+
+	*result = cache;
+	return 0;
+}
+
+/**
+ * Look up nexthop object by its identifier
+ * @arg cache		Nexthop cache
+ * @arg id		Nexthop identifier
+ *
+ * @attention The reference counter of the returned nexthop object will
+ *            be incremented. Use rtnl_nh_put() to release the reference.
+ *
+ * @return Nexthop object or NULL if no match was found.
+ */
+struct rtnl_nh *rtnl_nh_get(struct nl_cache *cache, uint32_t id)
+{
+	struct rtnl_nh *nh, *needle;
+
+	if (cache->c_ops != &rtnl_nh_ops)
+		return NULL;
+
+	if (!(needle = rtnl_nh_alloc()))
+		return NULL;
+
+	rtnl_nh_set_id(needle, id);
+	nh = (struct rtnl_nh *) nl_cache_search(cache, OBJ_CAST(needle));
+	rtnl_nh_put(needle);
+
+	return nh;
+}
+
+/** @} */
+
+/**
+ * @name Addition/Deletion
+ * @{
+ */
+
+static int build_nh_msg(struct rtnl_nh *tmpl, int cmd, int flags,
+			struct nl_msg **result)
+{
+	struct nl_msg *msg;
+	struct nhmsg nhm = {
+		.nh_family = tmpl->nh_family,
+		.nh_protocol = tmpl->nh_protocol,
+		.nh_flags = tmpl->nh_flags,
+	};
+	struct nlattr *res;
+	uint32_t i;
+
+	msg = nlmsg_alloc_simple(cmd, flags);
+	if (!msg)
+		return -NLE_NOMEM;
+
+	if (nlmsg_append(msg, &nhm, sizeof(nhm), NLMSG_ALIGNTO) < 0)
+		goto nla_put_failure;
+
+	if (tmpl->ce_mask & NHO_ATTR_ID)
+		NLA_PUT_U32(msg, NHA_ID, tmpl->nh_id);
+
+	if (cmd == RTM_DELNEXTHOP)
+		goto out;
+
+	if (tmpl->ce_mask & NHO_ATTR_GROUP) {
+		struct nexthop_grp *grp;
+		struct nlattr *attr;
+
+		attr = nla_reserve(msg, NHA_GROUP,
+				   tmpl->nh_group_size * sizeof(*grp));
+		if (!attr)
+			goto nla_put_failure;
+
+		grp = nla_data(attr);
+		for (i = 0; i < tmpl->nh_group_size; i++) {
+			grp[i].id = tmpl->nh_group[i].nhe_id;
+			grp[i].weight = tmpl->nh_group[i].nhe_weight - 1;
+		}
+	}
+
+	if (tmpl->ce_mask & NHO_ATTR_GROUP_TYPE)
+		NLA_PUT_U16(msg, NHA_GROUP_TYPE, tmpl->nh_group_type);
+
+	if (tmpl->ce_mask & (NHO_ATTR_RES_BUCKETS | NHO_ATTR_RES_IDLE_TIMER |
+			     NHO_ATTR_RES_UNBALANCED_TIMER)) {
+		if (!(res = nla_nest_start(msg, NHA_RES_GROUP)))
+			goto nla_put_failure;
+
+		if (tmpl->ce_mask & NHO_ATTR_RES_BUCKETS)
+			NLA_PUT_U16(msg, NHA_RES_GROUP_BUCKETS,
+				    tmpl->nh_res_buckets);
+
+		if (tmpl->ce_mask & NHO_ATTR_RES_IDLE_TIMER)
+			NLA_PUT_U32(msg, NHA_RES_GROUP_IDLE_TIMER,
+				    tmpl->nh_res_idle_timer);
+
+		if (tmpl->ce_mask & NHO_ATTR_RES_UNBALANCED_TIMER)
+			NLA_PUT_U32(msg, NHA_RES_GROUP_UNBALANCED_TIMER,
+				    tmpl->nh_res_unbalanced_timer);
+
+		nla_nest_end(msg, res);
+	}
+
+	if (tmpl->ce_mask & NHO_ATTR_BLACKHOLE)
+		NLA_PUT_FLAG(msg, NHA_BLACKHOLE);
+
+	if (tmpl->ce_mask & NHO_ATTR_FDB)
+		NLA_PUT_FLAG(msg, NHA_FDB);
+
+	if (tmpl->ce_mask & NHO_ATTR_OIF)
+		NLA_PUT_U32(msg, NHA_OIF, tmpl->nh_oif);
+
+	if (tmpl->ce_mask & NHO_ATTR_GATEWAY)
+		NLA_PUT_ADDR(msg, NHA_GATEWAY, tmpl->nh_gateway);
+
+out:
+	*result = msg;
+	return 0;
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -NLE_MSGSIZE;
+}
+
+/**
+ * Build netlink request message to add a new nexthop object
+ * @arg tmpl		template with data of new nexthop object
+ * @arg flags		additional netlink message flags
+ * @arg result		Result pointer
+ *
+ * Builds a new netlink message requesting the addition of a new nexthop
+ * object. If no identifier is set, the kernel assigns one. Use
+ * NLM_F_REPLACE to change an existing nexthop object, routes referring
+ * to it follow the change.
+ *
+ * @return 0 on success or a negative error code.
+ */
+int rtnl_nh_build_add_request(struct rtnl_nh *tmpl, int flags,
+			      struct nl_msg **result)
+{
+	return build_nh_msg(tmpl, RTM_NEWNEXTHOP, NLM_F_CREATE | flags,
+			    result);
+}
+
+/**
+ * Add a new nexthop object
+ * @arg sk		Netlink socket.
+ * @arg tmpl		template with requested changes
+ * @arg flags		additional netlink message flags
+ *
+ * Builds a netlink message by calling rtnl_nh_build_add_request(),
+ * sends the request to the kernel and waits for the next ACK to be
+ * received and thus blocks until the request has been fullfilled.
+ *
+ * @return 0 on sucess or a negative error if an error occured.
+ */
+int rtnl_nh_add(struct nl_sock *sk, struct rtnl_nh *tmpl, int flags)
+{
+	struct nl_msg *msg;
+	int err;
+
+	if ((err = rtnl_nh_build_add_request(tmpl, flags, &msg)) < 0)
+		return err;
+
+	err = nl_send_auto_complete(sk, msg);
+	nlmsg_free(msg);
+	if (err < 0)
+		return err;
+
+	return wait_for_ack(sk);
+}
+
+/**
+ * Build a netlink request message to delete a nexthop object
+ * @arg nh		nexthop object to delete
+ * @arg flags		additional netlink message flags
+ * @arg result		Result pointer
+ *
+ * Only the identifier of \a nh is used. The kernel deletes all routes
+ * referring to the nexthop object and removes it from all groups.
+ *
+ * @return 0 on success or a negative error code.
+ */
+int rtnl_nh_build_delete_request(struct rtnl_nh *nh, int flags,
+				 struct nl_msg **result)
+{
+	if (!(nh->ce_mask & NHO_ATTR_ID))
+		return -NLE_MISSING_ATTR;
+
+	return build_nh_msg(nh, RTM_DELNEXTHOP, flags, result);
+}
+
+/**
+ * Delete a nexthop object
+ * @arg sk		Netlink socket.
+ * @arg nh		nexthop object to delete
+ * @arg flags		additional netlink message flags
+ *
+ * Builds a netlink message by calling rtnl_nh_build_delete_request(),
+ * sends the request to the kernel and waits for the next ACK to be
+ * received and thus blocks until the request has been fullfilled.
+ *
+ * @return 0 on sucess or a negative error if an error occured.
+ */
+int rtnl_nh_delete(struct nl_sock *sk, struct rtnl_nh *nh, int flags)
+{
+	struct nl_msg *msg;
+	int err;
+
+	if ((err = rtnl_nh_build_delete_request(nh, flags, &msg)) < 0)
+		return err;
+
+	err = nl_send_auto_complete(sk, msg);
+	nlmsg_free(msg);
+	if (err < 0)
+		return err;
+
+	return wait_for_ack(sk);
+}
+
+/** @} */
+
+/**
+ * @name Attributes
+ * @{
+ */
+
+void rtnl_nh_set_id(struct rtnl_nh *nh, uint32_t id)
+{
+	nh->nh_id = id;
+	nh->ce_mask |= NHO_ATTR_ID;
+}
+
+uint32_t rtnl_nh_get_id(struct rtnl_nh *nh)
+{
+	return nh->nh_id;
+}
+
+void rtnl_nh_set_family(struct rtnl_nh *nh, int family)
+{
+	nh->nh_family = family;
+	nh->ce_mask |= NHO_ATTR_FAMILY;
+}
+
+int rtnl_nh_get_family(struct rtnl_nh *nh)
+{
+	if (nh->ce_mask & NHO_ATTR_FAMILY)
+		return nh->nh_family;
+	else
+		return AF_UNSPEC;
+}
+
+void rtnl_nh_set_protocol(struct rtnl_nh *nh, uint8_t protocol)
+{
+	nh->nh_protocol = protocol;
+	nh->ce_mask |= NHO_ATTR_PROTOCOL;
+}
+
+uint8_t rtnl_nh_get_protocol(struct rtnl_nh *nh)
+{
+	return nh->nh_protocol;
+}
+
+/**
+ * Set nexthop flags
+ * @arg nh		Nexthop object
+ * @arg flags		RTNH_F_* flags, e.g. RTNH_F_ONLINK
+ */
+void rtnl_nh_set_flags(struct rtnl_nh *nh, uint32_t flags)
+{
+	nh->nh_flags = flags;
+	nh->ce_mask |= NHO_ATTR_FLAGS;
+}
+
+uint32_t rtnl_nh_get_flags(struct rtnl_nh *nh)
+{
+	return nh->nh_flags;
+}
+
+void rtnl_nh_set_oif(struct rtnl_nh *nh, int ifindex)
+{
+	nh->nh_oif = ifindex;
+	nh->ce_mask |= NHO_ATTR_OIF;
+}
+
+int rtnl_nh_get_oif(struct rtnl_nh *nh)
+{
+	return nh->nh_oif;
+}
+
+/**
+ * Set gateway of nexthop object
+ * @arg nh		Nexthop object
+ * @arg addr		Gateway address or NULL
+ *
+ * The address family of \a addr must match the family of the nexthop
+ * object if one has been set.
+ *
+ * @return 0 on success or a negative error code.
+ */
+int rtnl_nh_set_gateway(struct rtnl_nh *nh, struct nl_addr *addr)
+{
+	if (addr && (nh->ce_mask & NHO_ATTR_FAMILY) &&
+	    nl_addr_get_family(addr) != nh->nh_family)
+		return -NLE_AF_MISMATCH;
+
+	if (nh->nh_gateway)
+		nl_addr_put(nh->nh_gateway);
+
+	if (addr) {
+		nh->nh_gateway = nl_addr_get(addr);
+		nh->ce_mask |= NHO_ATTR_GATEWAY;
+		if (!(nh->ce_mask & NHO_ATTR_FAMILY))
+			rtnl_nh_set_family(nh, nl_addr_get_family(addr));
+	} else {
+		nh->nh_gateway = NULL;
+		nh->ce_mask &= ~NHO_ATTR_GATEWAY;
+	}
+
+	return 0;
+}
+
+struct nl_addr *rtnl_nh_get_gateway(struct rtnl_nh *nh)
+{
+	return nh->nh_gateway;
+}
+
+void rtnl_nh_set_blackhole(struct rtnl_nh *nh, int blackhole)
+{
+	if (blackhole)
+		nh->ce_mask |= NHO_ATTR_BLACKHOLE;
+	else
+		nh->ce_mask &= ~NHO_ATTR_BLACKHOLE;
+}
+
+int rtnl_nh_get_blackhole(struct rtnl_nh *nh)
+{
+	return !!(nh->ce_mask & NHO_ATTR_BLACKHOLE);
+}
+
+void rtnl_nh_set_fdb(struct rtnl_nh *nh, int fdb)
+{
+	if (fdb)
+		nh->ce_mask |= NHO_ATTR_FDB;
+	else
+		nh->ce_mask &= ~NHO_ATTR_FDB;
+}
+
+int rtnl_nh_get_fdb(struct rtnl_nh *nh)
+{
+	return !!(nh->ce_mask & NHO_ATTR_FDB);
+}
+
+/** @} */
+
+/**
+ * @name Nexthop Groups
+ * @{
+ */
+
+/**
+ * Append member to nexthop group
+ * @arg nh		Nexthop object
+ * @arg id		Identifier of member nexthop object
+ * @arg weight		Relative weight from 1 to 256
+ *
+ * Turns \a nh into a nexthop group. A group has no address family,
+ * gateway or outgoing interface of its own.
+ *
+ * @return 0 on success or a negative error code.
+ */
+int rtnl_nh_add_group_entry(struct rtnl_nh *nh, uint32_t id,
+			    unsigned int weight)
+{
+	struct rtnl_nh_group_entry *group;
+
+	if (weight < 1 || weight > NH_GROUP_WEIGHT_MAX)
+		return -NLE_INVAL;
+
+	group = realloc(nh->nh_group,
+			(nh->nh_group_size + 1) * sizeof(*group));
+	if (!group)
+		return -NLE_NOMEM;
+
+	group[nh->nh_group_size].nhe_id = id;
+	group[nh->nh_group_size].nhe_weight = weight;
+
+	nh->nh_group = group;
+	nh->nh_group_size++;
+	nh->ce_mask |= NHO_ATTR_GROUP;
+
+	return 0;
+}
+
+/**
+ * Remove all members from nexthop group
+ * @arg nh		Nexthop object
+ */
+void rtnl_nh_clear_group(struct rtnl_nh *nh)
+{
+	free(nh->nh_group);
+	nh->nh_group = NULL;
+	nh->nh_group_size = 0;
+	nh->ce_mask &= ~NHO_ATTR_GROUP;
+}
+
+/**
+ * Return number of members of a nexthop group
+ * @arg nh		Nexthop object
+ *
+ * @return Number of members, 0 if \a nh is not a group.
+ */
+int rtnl_nh_get_group_size(struct rtnl_nh *nh)
+{
+	return nh->nh_group_size;
+}
+
+/**
+ * Return member of nexthop group
+ * @arg nh		Nexthop object
+ * @arg n		Index of member
+ * @arg id		Pointer to store member identifier or NULL
+ * @arg weight		Pointer to store weight of member or NULL
+ *
+ * @return 0 on success or -NLE_RANGE if \a n is out of range.
+ */
+int rtnl_nh_get_group_entry(struct rtnl_nh *nh, int n, uint32_t *id,
+			    unsigned int *weight)
+{
+	if (n < 0 || n >= nh->nh_group_size)
+		return -NLE_RANGE;
+
+	if (id)
+		*id = nh->nh_group[n].nhe_id;
+	if (weight)
+		*weight = nh->nh_group[n].nhe_weight;
+
+	return 0;
+}
+
+/**
+ * Set type of nexthop group
+ * @arg nh		Nexthop object
+ * @arg type		NEXTHOP_GRP_TYPE_MPATH or NEXTHOP_GRP_TYPE_RES
+ */
+void rtnl_nh_set_group_type(struct rtnl_nh *nh, int type)
+{
+	nh->nh_group_type = type;
+	nh->ce_mask |= NHO_ATTR_GROUP_TYPE;
+}
+
+/**
+ * Return type of nexthop group
+ * @arg nh		Nexthop object
+ *
+ * @return Group type or -NLE_MISSING_ATTR.
+ */
+int rtnl_nh_get_group_type(struct rtnl_nh *nh)
+{
+	if (!(nh->ce_mask & NHO_ATTR_GROUP_TYPE))
+		return -NLE_MISSING_ATTR;
+
+	return nh->nh_group_type;
+}
+
+/**
+ * Set number of hash buckets of a resilient nexthop group
+ * @arg nh		Nexthop object
+ * @arg buckets		Number of buckets
+ */
+void rtnl_nh_set_res_buckets(struct rtnl_nh *nh, uint16_t buckets)
+{
+	nh->nh_res_buckets = buckets;
+	nh->ce_mask |= NHO_ATTR_RES_BUCKETS;
+}
+
+int rtnl_nh_get_res_buckets(struct rtnl_nh *nh, uint16_t *buckets)
+{
+	if (!(nh->ce_mask & NHO_ATTR_RES_BUCKETS))
+		return -NLE_MISSING_ATTR;
+
+	*buckets = nh->nh_res_buckets;
+	return 0;
+}
+
+/**
+ * Set idle timer of a resilient nexthop group
+ * @arg nh		Nexthop object
+ * @arg secs		Seconds after which an idle bucket may be migrated
+ */
+void rtnl_nh_set_res_idle_timer(struct rtnl_nh *nh, uint32_t secs)
+{
+	nh->nh_res_idle_timer = secs * nl_get_user_hz();
+	nh->ce_mask |= NHO_ATTR_RES_IDLE_TIMER;
+}
+
+int rtnl_nh_get_res_idle_timer(struct rtnl_nh *nh, uint32_t *secs)
+{
+	if (!(nh->ce_mask & NHO_ATTR_RES_IDLE_TIMER))
+		return -NLE_MISSING_ATTR;
+
+	*secs = nh->nh_res_idle_timer / nl_get_user_hz();
+	return 0;
+}
+
+/**
+ * Set unbalanced timer of a resilient nexthop group
+ * @arg nh		Nexthop object
+ * @arg secs		Seconds after which busy buckets are migrated too
+ *
+ * If the group stays unbalanced longer than \a secs, buckets are
+ * migrated regardless of being idle. 0 disables the timer.
+ */
+void rtnl_nh_set_res_unbalanced_timer(struct rtnl_nh *nh, uint32_t secs)
+{
+	nh->nh_res_unbalanced_timer = secs * nl_get_user_hz();
+	nh->ce_mask |= NHO_ATTR_RES_UNBALANCED_TIMER;
+}
+
+int rtnl_nh_get_res_unbalanced_timer(struct rtnl_nh *nh, uint32_t *secs)
+{
+	if (!(nh->ce_mask & NHO_ATTR_RES_UNBALANCED_TIMER))
+		return -NLE_MISSING_ATTR;
+
+	*secs = nh->nh_res_unbalanced_timer / nl_get_user_hz();
+	return 0;
+}
+
+/**
+ * Return time a resilient nexthop group has been unbalanced
+ * @arg nh		Nexthop object
+ * @arg secs		Pointer to store number of seconds
+ *
+ * @return 0 on success or -NLE_MISSING_ATTR.
+ */
+int rtnl_nh_get_res_unbalanced_time(struct rtnl_nh *nh, uint64_t *secs)
+{
+	if (!(nh->ce_mask & NHO_ATTR_RES_UNBALANCED_TIME))
+		return -NLE_MISSING_ATTR;
+
+	*secs = nh->nh_res_unbalanced_time / nl_get_user_hz();
+	return 0;
+}
+
+/** @} */
+
+/**
+ * @name Group Type Translations
+ * @{
+ */
+
+static const struct trans_tbl nh_group_types[] = {
+	__ADD(NEXTHOP_GRP_TYPE_MPATH, mpath),
+	__ADD(NEXTHOP_GRP_TYPE_RES, resilient),
+};
+
+char *rtnl_nh_group_type2str(int type, char *buf, size_t len)
+{
+	return __type2str(type, buf, len, nh_group_types,
+			  ARRAY_SIZE(nh_group_types));
+}
+
+int rtnl_nh_str2group_type(const char *name)
+{
+	return __str2type(name, nh_group_types, ARRAY_SIZE(nh_group_types));
+}
+
+/** @} */
+
+static struct nl_object_ops nh_obj_ops = {
+	.oo_name		= "route/nh",
+	.oo_size		= sizeof(struct rtnl_nh),
+	.oo_free_data		= nh_free_data,
+	.oo_clone		= nh_clone,
+	.oo_dump = {
+	    [NL_DUMP_LINE]	= nh_dump_line,
+	    [NL_DUMP_DETAILS]	= nh_dump_details,
+	    [NL_DUMP_STATS]	= nh_dump_details,
+	},
+	.oo_compare		= nh_compare,
+	.oo_keygen		= nh_keygen,
+	.oo_hash_attrs		= nh_hash_attrs,
+	.oo_attrs2str		= nh_attrs2str,
+	.oo_id_attrs		= NHO_ATTR_ID,
+};
+
+static struct nl_af_group nh_groups[] = {
+	{ AF_UNSPEC,	RTNLGRP_NEXTHOP },
+	{ END_OF_GROUP_LIST },
+};
+
+static struct nl_cache_ops rtnl_nh_ops = {
+	.co_name		= "route/nh",
+	.co_hdrsize		= sizeof(struct nhmsg),
+	.co_msgtypes		= {
+					{ RTM_NEWNEXTHOP, NL_ACT_NEW, "new" },
+					{ RTM_DELNEXTHOP, NL_ACT_DEL, "del" },
+					{ RTM_GETNEXTHOP, NL_ACT_GET, "get" },
+					END_OF_MSGTYPES_LIST,
+				  },
+	.co_protocol		= NETLINK_ROUTE,
+	.co_request_update	= nh_request_update,
+	.co_msg_parser		= nh_msg_parser,
+	.co_obj_ops		= &nh_obj_ops,
+	.co_groups		= nh_groups,
+};
+
+static void __init nh_init(void)
+{
+	nl_cache_mngt_register(&rtnl_nh_ops);
+}
+
+static void __exit nh_exit(void)
+{
+	nl_cache_mngt_unregister(&rtnl_nh_ops);
+}
+
+/** @} */
@@ -591,7 +591,10 @@ static struct nl_object_ops qdisc_obj_ops = {
 	    [NL_DUMP_STATS]	= rtnl_tc_dump_stats,
 	},
 	.oo_compare		= rtnl_tc_compare,
-	.oo_id_attrs		= (TCA_ATTR_IFINDEX | TCA_ATTR_HANDLE),
+	.oo_keygen		= rtnl_tc_keygen,
+	.oo_hash_attrs		= rtnl_tc_hash_attrs,
+	.oo_id_attrs		= (TCA_ATTR_IFINDEX | TCA_ATTR_HANDLE |
+				   TCA_ATTR_PARENT),
 };
 
 static void __init qdisc_init(void)
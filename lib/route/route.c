@@ -18,6 +18,7 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
 #include <netlink/utils.h>
@@ -25,6 +26,7 @@
 #include <netlink/route/rtnl.h>
 #include <netlink/route/route.h>
 #include <netlink/route/link.h>
+#include <netlink/route/nexthop.h>
 
 static struct nl_cache_ops rtnl_route_ops;
 
@@ -48,11 +50,50 @@ static int route_request_update(struct nl_cache *c, struct nl_sock *h)
 	struct rtmsg rhdr = {
 		.rtm_family = c->c_iarg1,
 	};
+	struct rtnl_route *filter;
+	struct rtnl_nexthop *nh;
+	struct nl_msg *msg;
+	int err = -NLE_MSGSIZE;
 
 	if (c->c_iarg2 & ROUTE_CACHE_CONTENT)
 		rhdr.rtm_flags |= RTM_F_CLONED;
 
-	return nl_send_simple(h, RTM_GETROUTE, NLM_F_DUMP, &rhdr, sizeof(rhdr));
+	filter = (struct rtnl_route *) _nl_cache_dump_filter(c, h);
+	if (!filter)
+		return nl_send_simple(h, RTM_GETROUTE, NLM_F_DUMP, &rhdr,
+				      sizeof(rhdr));
+
+	/* The kernel filters by family, table, protocol, type and
+	 * outgoing interface, all other header fields must be zero. */
+	if (rhdr.rtm_family == AF_UNSPEC && (filter->ce_mask & ROUTE_ATTR_FAMILY))
+		rhdr.rtm_family = filter->rt_family;
+	if (filter->ce_mask & ROUTE_ATTR_PROTOCOL)
+		rhdr.rtm_protocol = filter->rt_protocol;
+	if (filter->ce_mask & ROUTE_ATTR_TYPE)
+		rhdr.rtm_type = filter->rt_type;
+
+	msg = nlmsg_alloc_simple(RTM_GETROUTE, NLM_F_DUMP);
+	if (!msg)
+		return -NLE_NOMEM;
+
+	if (nlmsg_append(msg, &rhdr, sizeof(rhdr), NLMSG_ALIGNTO) < 0)
+		goto nla_put_failure;
+
+	if (filter->ce_mask & ROUTE_ATTR_TABLE)
+		NLA_PUT_U32(msg, RTA_TABLE, filter->rt_table);
+
+	if (filter->rt_nr_nh == 1) {
+		nh = nl_list_first_entry(&filter->rt_nexthops,
+					 struct rtnl_nexthop, rtnh_list);
+		if (rtnl_route_nh_get_ifindex(nh) > 0)
+			NLA_PUT_U32(msg, RTA_OIF, rtnl_route_nh_get_ifindex(nh));
+	}
+
+	err = nl_send_auto(h, msg);
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return err;
 }
 
 /**
@@ -198,6 +239,477 @@ int rtnl_route_delete(struct nl_sock *sk, struct rtnl_route *route, int flags)
 
 /** @} */
 
+/**
+ * @name Prefix Lookup
+ * @{
+ */
+
+/*
+ * Routes of a cache are kept in one path compressed binary trie per
+ * family and table, built on the first rtnl_route_cache_lpm() call and
+ * maintained by the cache afterwards. Each node stands for a prefix,
+ * nodes without routes only join two subtrees.
+ */
+struct route_lpm_node
+{
+	struct route_lpm_node *	ln_child[2];
+	struct route_lpm_node *	ln_parent;
+	struct rtnl_route **	ln_routes;
+	unsigned int		ln_nroutes;
+	/* Route with the lowest priority */
+	struct rtnl_route *	ln_best;
+	unsigned int		ln_plen;
+	uint8_t			ln_key[16];
+};
+
+struct route_lpm_table
+{
+	struct route_lpm_table *lt_next;
+	struct route_lpm_node *	lt_root;
+	uint32_t		lt_table;
+	int			lt_family;
+};
+
+struct route_lpm
+{
+	struct route_lpm_table *rl_tables;
+};
+
+static inline int lpm_bit(const uint8_t *key, unsigned int bit)
+{
+	return (key[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
+
+/* Number of leading bits, at most max, both keys have in common */
+static unsigned int lpm_common(const uint8_t *a, const uint8_t *b,
+			       unsigned int max)
+{
+	unsigned int i, n = 0;
+	uint8_t x;
+
+	for (i = 0; n < max; i++, n += 8) {
+		if ((x = a[i] ^ b[i])) {
+			while (!(x & 0x80)) {
+				x <<= 1;
+				n++;
+			}
+			break;
+		}
+	}
+
+	return n < max ? n : max;
+}
+
+static unsigned int lpm_addr_bits(int family)
+{
+	switch (family) {
+	case AF_INET:
+		return 32;
+	case AF_INET6:
+		return 128;
+	default:
+		return 0;
+	}
+}
+
+/* Fills in the masked key of the route, returns 0 if it can't be indexed */
+static int lpm_route_key(struct rtnl_route *route, uint8_t *key,
+			 unsigned int *plen)
+{
+	unsigned int bits = lpm_addr_bits(route->rt_family);
+	struct nl_inline_addr *dst = &route->rt_dst;
+
+	if (!bits)
+		return 0;
+
+	/* Source specific routes don't match every destination */
+	if (nl_inline_addr_isset(&route->rt_src) &&
+	    nl_inline_addr_prefixlen(&route->rt_src))
+		return 0;
+
+	memset(key, 0, 16);
+	*plen = nl_inline_addr_isset(dst) ? nl_inline_addr_prefixlen(dst) : 0;
+	if (!*plen)
+		return 1;
+
+	if (*plen > bits || nl_inline_addr_len(dst) * 8 < *plen)
+		return 0;
+
+	memcpy(key, nl_inline_addr_binary(dst), (*plen + 7) / 8);
+	if (*plen & 7)
+		key[*plen >> 3] &= 0xff << (8 - (*plen & 7));
+
+	return 1;
+}
+
+static struct route_lpm_table *lpm_table_get(struct route_lpm *rl,
+					     uint32_t table, int family,
+					     int create)
+{
+	struct route_lpm_table *lt;
+
+	for (lt = rl->rl_tables; lt; lt = lt->lt_next)
+		if (lt->lt_table == table && lt->lt_family == family)
+			return lt;
+
+	if (!create || !(lt = calloc(1, sizeof(*lt))))
+		return NULL;
+
+	lt->lt_table = table;
+	lt->lt_family = family;
+	lt->lt_next = rl->rl_tables;
+	rl->rl_tables = lt;
+
+	return lt;
+}
+
+static struct route_lpm_node *lpm_node_alloc(const uint8_t *key,
+					     unsigned int plen)
+{
+	struct route_lpm_node *node;
+
+	if (!(node = calloc(1, sizeof(*node))))
+		return NULL;
+
+	memcpy(node->ln_key, key, sizeof(node->ln_key));
+	node->ln_plen = plen;
+
+	return node;
+}
+
+/* Puts node in the place of old below parent, old may be NULL */
+static void lpm_replace(struct route_lpm_table *lt,
+			struct route_lpm_node *parent,
+			struct route_lpm_node *old,
+			struct route_lpm_node *node)
+{
+	if (!parent)
+		lt->lt_root = node;
+	else if (parent->ln_child[0] == old)
+		parent->ln_child[0] = node;
+	else
+		parent->ln_child[1] = node;
+
+	if (node)
+		node->ln_parent = parent;
+}
+
+static struct route_lpm_node *lpm_insert_node(struct route_lpm_table *lt,
+					      const uint8_t *key,
+					      unsigned int plen)
+{
+	struct route_lpm_node *node = lt->lt_root, *parent = NULL, *new, *glue;
+	unsigned int cpl = 0;
+
+	while (node) {
+		cpl = lpm_common(node->ln_key, key,
+				 plen < node->ln_plen ? plen : node->ln_plen);
+		if (cpl < node->ln_plen)
+			break;
+		if (node->ln_plen == plen)
+			return node;
+
+		parent = node;
+		node = node->ln_child[lpm_bit(key, node->ln_plen)];
+	}
+
+	if (!(new = lpm_node_alloc(key, plen)))
+		return NULL;
+
+	if (!node) {
+		if (parent)
+			parent->ln_child[lpm_bit(key, parent->ln_plen)] = new;
+		else
+			lt->lt_root = new;
+		new->ln_parent = parent;
+	} else if (cpl == plen) {
+		/* New prefix covers the existing node */
+		lpm_replace(lt, parent, node, new);
+		new->ln_child[lpm_bit(node->ln_key, plen)] = node;
+		node->ln_parent = new;
+	} else {
+		/* Both diverge after cpl bits, join them with a glue node */
+		if (!(glue = lpm_node_alloc(key, cpl))) {
+			free(new);
+			return NULL;
+		}
+		memset(glue->ln_key + (cpl + 7) / 8, 0,
+		       sizeof(glue->ln_key) - (cpl + 7) / 8);
+		if (cpl & 7)
+			glue->ln_key[cpl >> 3] &= 0xff << (8 - (cpl & 7));
+
+		lpm_replace(lt, parent, node, glue);
+		glue->ln_child[lpm_bit(node->ln_key, cpl)] = node;
+		glue->ln_child[lpm_bit(key, cpl)] = new;
+		node->ln_parent = glue;
+		new->ln_parent = glue;
+	}
+
+	return new;
+}
+
+/* Frees a node without routes if it no longer joins two subtrees */
+static void lpm_prune(struct route_lpm_table *lt, struct route_lpm_node *node)
+{
+	struct route_lpm_node *parent, *child;
+
+	while (node && !node->ln_nroutes) {
+		if (node->ln_child[0] && node->ln_child[1])
+			return;
+
+		parent = node->ln_parent;
+		child = node->ln_child[0] ? node->ln_child[0]
+					  : node->ln_child[1];
+		lpm_replace(lt, parent, node, child);
+		free(node->ln_routes);
+		free(node);
+
+		/* A parent without routes may have been left with one child */
+		node = parent;
+	}
+}
+
+static void lpm_update_best(struct route_lpm_node *node)
+{
+	unsigned int i;
+
+	node->ln_best = NULL;
+	for (i = 0; i < node->ln_nroutes; i++)
+		if (!node->ln_best ||
+		    node->ln_routes[i]->rt_prio < node->ln_best->rt_prio)
+			node->ln_best = node->ln_routes[i];
+}
+
+static int lpm_add(struct route_lpm *rl, struct rtnl_route *route)
+{
+	struct route_lpm_table *lt;
+	struct route_lpm_node *node;
+	struct rtnl_route **routes;
+	uint8_t key[16];
+	unsigned int plen;
+
+	if (!lpm_route_key(route, key, &plen))
+		return 0;
+
+	if (!(lt = lpm_table_get(rl, route->rt_table, route->rt_family, 1)))
+		return -NLE_NOMEM;
+
+	if (!(node = lpm_insert_node(lt, key, plen)))
+		return -NLE_NOMEM;
+
+	routes = realloc(node->ln_routes,
+			 (node->ln_nroutes + 1) * sizeof(*routes));
+	if (!routes) {
+		lpm_prune(lt, node);
+		return -NLE_NOMEM;
+	}
+
+	routes[node->ln_nroutes++] = route;
+	node->ln_routes = routes;
+	lpm_update_best(node);
+
+	return 0;
+}
+
+static void lpm_del(struct route_lpm *rl, struct rtnl_route *route)
+{
+	struct route_lpm_table *lt;
+	struct route_lpm_node *node;
+	uint8_t key[16];
+	unsigned int i, plen;
+
+	if (!lpm_route_key(route, key, &plen))
+		return;
+
+	if (!(lt = lpm_table_get(rl, route->rt_table, route->rt_family, 0)))
+		return;
+
+	for (node = lt->lt_root; node; node = node->ln_child[lpm_bit(key, node->ln_plen)]) {
+		if (node->ln_plen >= plen)
+			break;
+	}
+
+	if (!node || node->ln_plen != plen ||
+	    lpm_common(node->ln_key, key, plen) != plen)
+		return;
+
+	for (i = 0; i < node->ln_nroutes; i++) {
+		if (node->ln_routes[i] == route) {
+			node->ln_routes[i] = node->ln_routes[--node->ln_nroutes];
+			break;
+		}
+	}
+
+	lpm_update_best(node);
+	lpm_prune(lt, node);
+}
+
+static void lpm_free_node(struct route_lpm_node *node)
+{
+	if (node) {
+		lpm_free_node(node->ln_child[0]);
+		lpm_free_node(node->ln_child[1]);
+		free(node->ln_routes);
+		free(node);
+	}
+}
+
+static void lpm_free(struct route_lpm *rl)
+{
+	struct route_lpm_table *lt;
+
+	while ((lt = rl->rl_tables)) {
+		rl->rl_tables = lt->lt_next;
+		lpm_free_node(lt->lt_root);
+		free(lt);
+	}
+
+	free(rl);
+}
+
+static void route_obj_added(struct nl_cache *cache, struct nl_object *obj)
+{
+	/* Out of memory drops the trie, the next lookup rebuilds it */
+	if (cache->c_priv && lpm_add(cache->c_priv, (struct rtnl_route *) obj) < 0) {
+		lpm_free(cache->c_priv);
+		cache->c_priv = NULL;
+	}
+}
+
+static void route_obj_removed(struct nl_cache *cache, struct nl_object *obj)
+{
+	if (cache->c_priv)
+		lpm_del(cache->c_priv, (struct rtnl_route *) obj);
+}
+
+static void route_free_priv(struct nl_cache *cache)
+{
+	if (cache->c_priv) {
+		lpm_free(cache->c_priv);
+		cache->c_priv = NULL;
+	}
+}
+
+static struct route_lpm *lpm_build(struct nl_cache *cache)
+{
+	struct route_lpm *rl;
+	struct rtnl_route *route;
+
+	if (!(rl = calloc(1, sizeof(*rl))))
+		return NULL;
+
+	nl_list_for_each_entry(route, &cache->c_items, ce_list) {
+		if (lpm_add(rl, route) < 0) {
+			lpm_free(rl);
+			return NULL;
+		}
+	}
+
+	return rl;
+}
+
+static int lpm_match(struct rtnl_route *route, uint32_t table, int family,
+		     const uint8_t *addr, unsigned int *plen)
+{
+	uint8_t key[16];
+
+	if (route->rt_table != table || route->rt_family != family)
+		return 0;
+
+	if (!lpm_route_key(route, key, plen))
+		return 0;
+
+	return lpm_common(key, addr, *plen) == *plen;
+}
+
+/* Linear scan if the trie could not be allocated */
+static struct rtnl_route *lpm_scan(struct nl_cache *cache, uint32_t table,
+				   int family, const uint8_t *addr)
+{
+	struct rtnl_route *route, *best = NULL;
+	unsigned int plen, best_plen = 0;
+
+	nl_list_for_each_entry(route, &cache->c_items, ce_list) {
+		if (!lpm_match(route, table, family, addr, &plen))
+			continue;
+
+		if (!best || plen > best_plen ||
+		    (plen == best_plen && route->rt_prio < best->rt_prio)) {
+			best = route;
+			best_plen = plen;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * Look up the route to a destination in a route cache
+ * @arg cache		Route cache
+ * @arg table		Routing table
+ * @arg addr		Destination address
+ *
+ * Finds the route of table \p table with the longest prefix covering
+ * \p addr, the one with the lowest priority if several routes share the
+ * prefix. Source specific routes are not considered. Unlike
+ * rtnl_route_lookup(), the kernel is not consulted, so neither policy
+ * routing rules nor the route type are taken into account.
+ *
+ * The first lookup indexes all routes of the cache in a prefix trie per
+ * table and family, which is kept up to date as the cache changes.
+ * Subsequent lookups take O(address length) time.
+ *
+ * @attention The reference counter of the returned route is incremented,
+ *            the caller must release it with rtnl_route_put().
+ *
+ * @return Route or NULL if no route covers the address.
+ */
+struct rtnl_route *rtnl_route_cache_lpm(struct nl_cache *cache, uint32_t table,
+					struct nl_addr *addr)
+{
+	struct route_lpm_table *lt;
+	struct route_lpm_node *node;
+	struct rtnl_route *best = NULL;
+	int family = nl_addr_get_family(addr);
+	unsigned int bits = lpm_addr_bits(family);
+	uint8_t key[16] = { 0 };
+
+	if (cache->c_ops != &rtnl_route_ops || !bits ||
+	    nl_addr_get_len(addr) != bits / 8)
+		return NULL;
+
+	memcpy(key, nl_addr_get_binary_addr(addr), bits / 8);
+
+	if (!cache->c_priv)
+		cache->c_priv = lpm_build(cache);
+
+	if (!cache->c_priv) {
+		best = lpm_scan(cache, table, family, key);
+		goto out;
+	}
+
+	if (!(lt = lpm_table_get(cache->c_priv, table, family, 0)))
+		return NULL;
+
+	for (node = lt->lt_root; node; ) {
+		if (lpm_common(node->ln_key, key, node->ln_plen) < node->ln_plen)
+			break;
+		if (node->ln_best)
+			best = node->ln_best;
+		if (node->ln_plen >= bits)
+			break;
+		node = node->ln_child[lpm_bit(key, node->ln_plen)];
+	}
+
+out:
+	if (best)
+		nl_object_get(OBJ_CAST(best));
+
+	return best;
+}
+
+/** @} */
+
 static struct nl_af_group route_groups[] = {
 	{ AF_INET,	RTNLGRP_IPV4_ROUTE },
 	{ AF_INET6,	RTNLGRP_IPV6_ROUTE },
@@ -219,6 +731,9 @@ static struct nl_cache_ops rtnl_route_ops = {
 	.co_groups		= route_groups,
 	.co_request_update	= route_request_update,
 	.co_msg_parser		= route_msg_parser,
+	.co_obj_added		= route_obj_added,
+	.co_obj_removed		= route_obj_removed,
+	.co_free_priv		= route_free_priv,
 	.co_obj_ops		= &route_obj_ops,
 };
 
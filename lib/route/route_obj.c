@@ -32,13 +32,15 @@
  */
 
 #include <netlink-private/netlink.h>
+#include <netlink-private/addr.h>
 #include <netlink-private/utils.h>
 #include <netlink-private/route/nexthop-encap.h>
+#include <netlink-private/route/nexthop.h>
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
 #include <netlink/utils.h>
 #include <netlink/data.h>
-#include <netlink/hashtable.h>
+#include <netlink-private/hash.h>
 #include <netlink/route/rtnl.h>
 #include <netlink/route/route.h>
 #include <netlink/route/link.h>
@@ -63,52 +65,34 @@ static void route_constructor(struct nl_object *c)
 static void route_free_data(struct nl_object *c)
 {
 	struct rtnl_route *r = (struct rtnl_route *) c;
-	struct rtnl_nexthop *nh, *tmp;
 
 	if (r == NULL)
 		return;
 
-	nl_addr_put(r->rt_dst);
-	nl_addr_put(r->rt_src);
-	nl_addr_put(r->rt_pref_src);
+	nl_inline_addr_release(&r->rt_dst);
+	nl_inline_addr_release(&r->rt_src);
+	nl_inline_addr_release(&r->rt_pref_src);
 
-	nl_list_for_each_entry_safe(nh, tmp, &r->rt_nexthops, rtnh_list) {
-		rtnl_route_remove_nexthop(r, nh);
-		rtnl_route_nh_free(nh);
-	}
+	rtnl_route_free_nexthops(r);
 }
 
 static int route_clone(struct nl_object *_dst, struct nl_object *_src)
 {
 	struct rtnl_route *dst = (struct rtnl_route *) _dst;
 	struct rtnl_route *src = (struct rtnl_route *) _src;
-	struct rtnl_nexthop *nh, *new;
-
-	if (src->rt_dst)
-		if (!(dst->rt_dst = nl_addr_clone(src->rt_dst)))
-			return -NLE_NOMEM;
-
-	if (src->rt_src)
-		if (!(dst->rt_src = nl_addr_clone(src->rt_src)))
-			return -NLE_NOMEM;
-
-	if (src->rt_pref_src)
-		if (!(dst->rt_pref_src = nl_addr_clone(src->rt_pref_src)))
-			return -NLE_NOMEM;
+	int err;
 
-	/* Will be inc'ed again while adding the nexthops of the source */
-	dst->rt_nr_nh = 0;
+	if ((err = nl_inline_addr_clone(&dst->rt_dst, &src->rt_dst)) < 0)
+		return err;
 
-	nl_init_list_head(&dst->rt_nexthops);
-	nl_list_for_each_entry(nh, &src->rt_nexthops, rtnh_list) {
-		new = rtnl_route_nh_clone(nh);
-		if (!new)
-			return -NLE_NOMEM;
+	if ((err = nl_inline_addr_clone(&dst->rt_src, &src->rt_src)) < 0)
+		return err;
 
-		rtnl_route_add_nexthop(dst, new);
-	}
+	if ((err = nl_inline_addr_clone(&dst->rt_pref_src,
+					&src->rt_pref_src)) < 0)
+		return err;
 
-	return 0;
+	return rtnl_route_clone_nexthops(dst, src);
 }
 
 void route_dump_line(struct nl_object *a, struct nl_dump_params *p)
@@ -126,10 +110,11 @@ void route_dump_line(struct nl_object *a, struct nl_dump_params *p)
 		nl_dump(p, "cache ");
 
 	if (!(r->ce_mask & ROUTE_ATTR_DST) ||
-	    nl_addr_get_len(r->rt_dst) == 0)
+	    nl_inline_addr_len(&r->rt_dst) == 0)
 		nl_dump(p, "default ");
 	else
-		nl_dump(p, "%s ", nl_addr2str(r->rt_dst, buf, sizeof(buf)));
+		nl_dump(p, "%s ",
+			nl_inline_addr2str(&r->rt_dst, buf, sizeof(buf)));
 
 	if (r->ce_mask & ROUTE_ATTR_TABLE && !cache)
 		nl_dump(p, "table %s ",
@@ -142,6 +127,9 @@ void route_dump_line(struct nl_object *a, struct nl_dump_params *p)
 	if (r->ce_mask & ROUTE_ATTR_TOS && r->rt_tos != 0)
 		nl_dump(p, "tos %#x ", r->rt_tos);
 
+	if (r->ce_mask & ROUTE_ATTR_NHID)
+		nl_dump(p, "nhid %u ", r->rt_nhid);
+
 	if (r->ce_mask & ROUTE_ATTR_MULTIPATH) {
 		struct rtnl_nexthop *nh;
 
@@ -202,7 +190,7 @@ void route_dump_details(struct nl_object *a, struct nl_dump_params *p)
 
 	if (r->ce_mask & ROUTE_ATTR_PREF_SRC)
 		nl_dump(p, "preferred-src %s ",
-			nl_addr2str(r->rt_pref_src, buf, sizeof(buf)));
+			nl_inline_addr2str(&r->rt_pref_src, buf, sizeof(buf)));
 
 	if (r->ce_mask & ROUTE_ATTR_SCOPE && r->rt_scope != RT_SCOPE_NOWHERE)
 		nl_dump(p, "scope %s ",
@@ -225,7 +213,8 @@ void route_dump_details(struct nl_object *a, struct nl_dump_params *p)
 	}
 
 	if (r->ce_mask & ROUTE_ATTR_SRC)
-		nl_dump(p, "src %s ", nl_addr2str(r->rt_src, buf, sizeof(buf)));
+		nl_dump(p, "src %s ",
+			nl_inline_addr2str(&r->rt_src, buf, sizeof(buf)));
 
 	if (r->ce_mask & ROUTE_ATTR_TTL_PROPAGATE) {
 		nl_dump(p, " ttl-propagate %s",
@@ -287,49 +276,48 @@ static void route_keygen(struct nl_object *obj, uint32_t *hashkey,
 			  uint32_t table_sz)
 {
 	struct rtnl_route *route = (struct rtnl_route *) obj;
-	unsigned int rkey_sz;
-	struct nl_addr *addr = NULL;
-	struct route_hash_key {
-		uint8_t		rt_family;
-		uint8_t		rt_tos;
-		uint32_t	rt_table;
-		uint32_t	rt_prio;
-		char 		rt_addr[0];
-	} __attribute__((packed)) *rkey;
+	struct nl_hasher h;
 #ifdef NL_DEBUG
 	char buf[INET6_ADDRSTRLEN+5];
 #endif
 
-	if (route->rt_dst)
-		addr = route->rt_dst;
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, route->rt_family);
+	nl_hasher_u32(&h, route->rt_tos);
+	nl_hasher_u32(&h, route->rt_table);
+	nl_hasher_u32(&h, route->rt_prio);
+	nl_inline_addr_hash(&h, &route->rt_dst);
 
-	rkey_sz = sizeof(*rkey);
-	if (addr)
-		rkey_sz += nl_addr_get_len(addr);
-	rkey = calloc(1, rkey_sz);
-	if (!rkey) {
-		NL_DBG(2, "Warning: calloc failed for %d bytes...\n", rkey_sz);
-		*hashkey = 0;
-		return;
-	}
-	rkey->rt_family = route->rt_family;
-	rkey->rt_tos = route->rt_tos;
-	rkey->rt_table = route->rt_table;
-	rkey->rt_prio = route->rt_prio;
-	if (addr)
-		memcpy(rkey->rt_addr, nl_addr_get_binary_addr(addr),
-			nl_addr_get_len(addr));
+	*hashkey = nl_hasher_final(&h) % table_sz;
 
-	*hashkey = nl_hash(rkey, rkey_sz, 0) % table_sz;
-
-	NL_DBG(5, "route %p key (fam %d tos %d table %d addr %s) keysz %d "
-		"hash 0x%x\n", route, rkey->rt_family, rkey->rt_tos,
-		rkey->rt_table, nl_addr2str(addr, buf, sizeof(buf)),
-		rkey_sz, *hashkey);
+	NL_DBG(5, "route %p key (fam %d tos %d table %d addr %s) hash 0x%x\n",
+		route, route->rt_family, route->rt_tos, route->rt_table,
+		nl_inline_addr2str(&route->rt_dst, buf, sizeof(buf)), *hashkey);
+}
 
-	free(rkey);
+static void route_hash_attrs(struct nl_object *obj, uint64_t attrs,
+			     struct nl_hasher *h)
+{
+	struct rtnl_route *route = (struct rtnl_route *) obj;
 
-	return;
+	if (attrs & ROUTE_ATTR_FAMILY)
+		nl_hasher_u32(h, route->rt_family);
+	if (attrs & ROUTE_ATTR_TOS)
+		nl_hasher_u32(h, route->rt_tos);
+	if (attrs & ROUTE_ATTR_TABLE)
+		nl_hasher_u32(h, route->rt_table);
+	if (attrs & ROUTE_ATTR_PROTOCOL)
+		nl_hasher_u32(h, route->rt_protocol);
+	if (attrs & ROUTE_ATTR_SCOPE)
+		nl_hasher_u32(h, route->rt_scope);
+	if (attrs & ROUTE_ATTR_TYPE)
+		nl_hasher_u32(h, route->rt_type);
+	if (attrs & ROUTE_ATTR_PRIO)
+		nl_hasher_u32(h, route->rt_prio);
+	if (attrs & ROUTE_ATTR_IIF)
+		nl_hasher_u32(h, route->rt_iif);
+	if (attrs & ROUTE_ATTR_NHID)
+		nl_hasher_u32(h, route->rt_nhid);
 }
 
 uint32_t route_id_attrs_get(struct nl_object *obj)
@@ -363,13 +351,14 @@ static uint64_t route_compare(struct nl_object *_a, struct nl_object *_b,
 	diff |= ROUTE_DIFF(SCOPE,	a->rt_scope != b->rt_scope);
 	diff |= ROUTE_DIFF(TYPE,	a->rt_type != b->rt_type);
 	diff |= ROUTE_DIFF(PRIO,	a->rt_prio != b->rt_prio);
-	diff |= ROUTE_DIFF(DST,		nl_addr_cmp(a->rt_dst, b->rt_dst));
-	diff |= ROUTE_DIFF(SRC,		nl_addr_cmp(a->rt_src, b->rt_src));
+	diff |= ROUTE_DIFF(DST,		nl_inline_addr_cmp(&a->rt_dst, &b->rt_dst));
+	diff |= ROUTE_DIFF(SRC,		nl_inline_addr_cmp(&a->rt_src, &b->rt_src));
 	diff |= ROUTE_DIFF(IIF,		a->rt_iif != b->rt_iif);
-	diff |= ROUTE_DIFF(PREF_SRC,	nl_addr_cmp(a->rt_pref_src,
-						    b->rt_pref_src));
+	diff |= ROUTE_DIFF(PREF_SRC,	nl_inline_addr_cmp(&a->rt_pref_src,
+							   &b->rt_pref_src));
 	diff |= ROUTE_DIFF(TTL_PROPAGATE,
 			   a->rt_ttl_propagate != b->rt_ttl_propagate);
+	diff |= ROUTE_DIFF(NHID,	a->rt_nhid != b->rt_nhid);
 
 	if (flags & LOOSE_COMPARISON) {
 		nl_list_for_each_entry(nh_b, &b->rt_nexthops, rtnh_list) {
@@ -451,15 +440,12 @@ nh_mismatch:
 #undef ROUTE_DIFF
 }
 
-static int route_update(struct nl_object *old_obj, struct nl_object *new_obj)
+static int route_update_attrs(struct nl_object *old_obj,
+			      struct nl_object *new_obj, uint64_t *attrs)
 {
 	struct rtnl_route *new_route = (struct rtnl_route *) new_obj;
 	struct rtnl_route *old_route = (struct rtnl_route *) old_obj;
 	struct rtnl_nexthop *new_nh;
-	int action = new_obj->ce_msgtype;
-#ifdef NL_DEBUG
-	char buf[INET6_ADDRSTRLEN+5];
-#endif
 
 	/*
 	 * ipv6 ECMP route notifications from the kernel come as
@@ -485,9 +471,44 @@ static int route_update(struct nl_object *old_obj, struct nl_object *new_obj)
 	 * filled or nothing at all
 	 */
 	new_nh = rtnl_route_nexthop_n(new_route, 0);
-	if (!new_nh || !rtnl_route_nh_get_gateway(new_nh))
+	if (!new_nh || !(new_nh->ce_mask & NH_ATTR_GATEWAY))
 		return -NLE_OPNOTSUPP;
 
+	switch (new_obj->ce_msgtype) {
+	case RTM_NEWROUTE:
+		*attrs = ROUTE_ATTR_MULTIPATH;
+		return 0;
+	case RTM_DELROUTE:
+		/*
+		 * Only take care of nexthop deletes and not
+		 * route deletes. So, if there is only one nexthop
+		 * quite likely we did not update it.
+		 */
+		if (rtnl_route_get_nnexthops(old_route) <= 1)
+			return -NLE_OPNOTSUPP;
+		*attrs = ROUTE_ATTR_MULTIPATH;
+		return 0;
+	default:
+		return -NLE_OPNOTSUPP;
+	}
+}
+
+static int route_update(struct nl_object *old_obj, struct nl_object *new_obj)
+{
+	struct rtnl_route *new_route = (struct rtnl_route *) new_obj;
+	struct rtnl_route *old_route = (struct rtnl_route *) old_obj;
+	struct rtnl_nexthop *new_nh;
+	int action = new_obj->ce_msgtype;
+	uint64_t attrs;
+#ifdef NL_DEBUG
+	char buf[INET6_ADDRSTRLEN+5];
+#endif
+
+	if (route_update_attrs(old_obj, new_obj, &attrs) < 0)
+		return -NLE_OPNOTSUPP;
+
+	new_nh = rtnl_route_nexthop_n(new_route, 0);
+
 	switch(action) {
 	case RTM_NEWROUTE : {
 		struct rtnl_nexthop *cloned_nh;
@@ -502,22 +523,13 @@ static int route_update(struct nl_object *old_obj, struct nl_object *new_obj)
 
 		NL_DBG(2, "Route obj %p updated. Added "
 			"nexthop %p via %s\n", old_route, cloned_nh,
-			nl_addr2str(cloned_nh->rtnh_gateway, buf,
+			nl_addr2str(rtnl_route_nh_get_gateway(cloned_nh), buf,
 					sizeof(buf)));
 	}
 		break;
 	case RTM_DELROUTE : {
 		struct rtnl_nexthop *old_nh;
 
-		/*
-		 * Only take care of nexthop deletes and not
-		 * route deletes. So, if there is only one nexthop
-		 * quite likely we did not update it. So dont do
-		 * anything and return
-		 */
-		if (rtnl_route_get_nnexthops(old_route) <= 1)
-			return -NLE_OPNOTSUPP;
-
 		/*
 		 * Find the next hop in old route and delete it
 		 */
@@ -530,8 +542,8 @@ static int route_update(struct nl_object *old_obj, struct nl_object *new_obj)
 				NL_DBG(2, "Route obj %p updated. Removed "
 					"nexthop %p via %s\n", old_route,
 					old_nh,
-					nl_addr2str(old_nh->rtnh_gateway, buf,
-					sizeof(buf)));
+					nl_addr2str(rtnl_route_nh_get_gateway(old_nh),
+					buf, sizeof(buf)));
 
 				rtnl_route_nh_free(old_nh);
 				break;
@@ -568,6 +580,7 @@ static const struct trans_tbl route_attrs[] = {
 	__ADD(ROUTE_ATTR_REALMS, realms),
 	__ADD(ROUTE_ATTR_CACHEINFO, cacheinfo),
 	__ADD(ROUTE_ATTR_TTL_PROPAGATE, ttl_propagate),
+	__ADD(ROUTE_ATTR_NHID, nhid),
 };
 
 char *route_attrs2str(int attrs, char *buf, size_t len)
@@ -687,11 +700,7 @@ int rtnl_route_set_dst(struct rtnl_route *route, struct nl_addr *addr)
 	} else
 		route->rt_family = addr->a_family;
 
-	if (route->rt_dst)
-		nl_addr_put(route->rt_dst);
-
-	nl_addr_get(addr);
-	route->rt_dst = addr;
+	nl_inline_addr_set(&route->rt_dst, addr);
 
 	route->ce_mask |= (ROUTE_ATTR_DST | ROUTE_ATTR_FAMILY);
 
@@ -700,7 +709,7 @@ int rtnl_route_set_dst(struct rtnl_route *route, struct nl_addr *addr)
 
 struct nl_addr *rtnl_route_get_dst(struct rtnl_route *route)
 {
-	return route->rt_dst;
+	return nl_inline_addr_get(&route->rt_dst);
 }
 
 int rtnl_route_set_src(struct rtnl_route *route, struct nl_addr *addr)
@@ -714,11 +723,7 @@ int rtnl_route_set_src(struct rtnl_route *route, struct nl_addr *addr)
 	} else
 		route->rt_family = addr->a_family;
 
-	if (route->rt_src)
-		nl_addr_put(route->rt_src);
-
-	nl_addr_get(addr);
-	route->rt_src = addr;
+	nl_inline_addr_set(&route->rt_src, addr);
 	route->ce_mask |= (ROUTE_ATTR_SRC | ROUTE_ATTR_FAMILY);
 
 	return 0;
@@ -726,7 +731,7 @@ int rtnl_route_set_src(struct rtnl_route *route, struct nl_addr *addr)
 
 struct nl_addr *rtnl_route_get_src(struct rtnl_route *route)
 {
-	return route->rt_src;
+	return nl_inline_addr_get(&route->rt_src);
 }
 
 int rtnl_route_set_type(struct rtnl_route *route, uint8_t type)
@@ -816,11 +821,7 @@ int rtnl_route_set_pref_src(struct rtnl_route *route, struct nl_addr *addr)
 	} else
 		route->rt_family = addr->a_family;
 
-	if (route->rt_pref_src)
-		nl_addr_put(route->rt_pref_src);
-
-	nl_addr_get(addr);
-	route->rt_pref_src = addr;
+	nl_inline_addr_set(&route->rt_pref_src, addr);
 	route->ce_mask |= (ROUTE_ATTR_PREF_SRC | ROUTE_ATTR_FAMILY);
 
 	return 0;
@@ -828,7 +829,7 @@ int rtnl_route_set_pref_src(struct rtnl_route *route, struct nl_addr *addr)
 
 struct nl_addr *rtnl_route_get_pref_src(struct rtnl_route *route)
 {
-	return route->rt_pref_src;
+	return nl_inline_addr_get(&route->rt_pref_src);
 }
 
 void rtnl_route_set_iif(struct rtnl_route *route, int ifindex)
@@ -849,14 +850,83 @@ void rtnl_route_add_nexthop(struct rtnl_route *route, struct rtnl_nexthop *nh)
 	route->ce_mask |= ROUTE_ATTR_MULTIPATH;
 }
 
+/* Adds a nexthop stored in the nexthop array of the route */
+static void route_add_inline_nexthop(struct rtnl_route *route,
+				     struct rtnl_nexthop *nh)
+{
+	if (route->rt_nh_inline == route->rt_nr_nh &&
+	    nh == &route->rt_nh_array->na_nh[route->rt_nh_inline])
+		route->rt_nh_inline++;
+
+	rtnl_route_add_nexthop(route, nh);
+}
+
+/**
+ * Remove nexthop from route
+ * @arg route		Route
+ * @arg nh		Nexthop
+ *
+ * The caller becomes responsible for freeing the nexthop with
+ * rtnl_route_nh_free(), or may add it to another route.
+ */
 void rtnl_route_remove_nexthop(struct rtnl_route *route, struct rtnl_nexthop *nh)
 {
 	if (route->ce_mask & ROUTE_ATTR_MULTIPATH) {
 		route->rt_nr_nh--;
 		nl_list_del(&nh->rtnh_list);
+		if (nh->rtnh_array)
+			route->rt_nh_inline = 0;
 	}
 }
 
+void rtnl_route_free_nexthops(struct rtnl_route *route)
+{
+	struct rtnl_nexthop *nh, *tmp;
+
+	nl_list_for_each_entry_safe(nh, tmp, &route->rt_nexthops, rtnh_list) {
+		rtnl_route_remove_nexthop(route, nh);
+		rtnl_route_nh_free(nh);
+	}
+
+	rtnl_route_nh_array_put(route->rt_nh_array);
+	route->rt_nh_array = NULL;
+}
+
+/* Copies the nexthops of src into a single array of dst */
+int rtnl_route_clone_nexthops(struct rtnl_route *dst, struct rtnl_route *src)
+{
+	struct rtnl_nexthop *nh, *new;
+	unsigned int n = 0;
+
+	dst->rt_nr_nh = 0;
+	dst->rt_nh_inline = 0;
+	dst->rt_nh_array = NULL;
+	nl_init_list_head(&dst->rt_nexthops);
+
+	nl_list_for_each_entry(nh, &src->rt_nexthops, rtnh_list)
+		n++;
+
+	if (!n)
+		return 0;
+
+	dst->rt_nh_array = rtnl_route_nh_array_alloc(n);
+	if (!dst->rt_nh_array)
+		return -NLE_NOMEM;
+
+	n = 0;
+	nl_list_for_each_entry(nh, &src->rt_nexthops, rtnh_list) {
+		new = rtnl_route_nh_array_init(dst->rt_nh_array, n++);
+		if (rtnl_route_nh_copy(new, nh) < 0) {
+			rtnl_route_nh_free(new);
+			return -NLE_NOMEM;
+		}
+
+		route_add_inline_nexthop(dst, new);
+	}
+
+	return 0;
+}
+
 struct nl_list_head *rtnl_route_get_nexthops(struct rtnl_route *route)
 {
 	if (route->ce_mask & ROUTE_ATTR_MULTIPATH)
@@ -891,6 +961,9 @@ struct rtnl_nexthop *rtnl_route_nexthop_n(struct rtnl_route *r, int n)
 	struct rtnl_nexthop *nh;
 	uint32_t i;
 
+	if (n >= 0 && n < r->rt_nh_inline)
+		return &r->rt_nh_array->na_nh[n];
+
 	if (r->ce_mask & ROUTE_ATTR_MULTIPATH && r->rt_nr_nh > n) {
 		i = 0;
 		nl_list_for_each_entry(nh, &r->rt_nexthops, rtnh_list) {
@@ -916,6 +989,34 @@ int rtnl_route_get_ttl_propagate(struct rtnl_route *route)
 	return route->rt_ttl_propagate;
 }
 
+/**
+ * Set nexthop object of route
+ * @arg route		Route
+ * @arg id		Identifier of nexthop object, see rtnl_nh_get_id()
+ *
+ * A route referring to a nexthop object is sent to the kernel without
+ * its own nexthops, the kernel rejects routes carrying both.
+ */
+void rtnl_route_set_nhid(struct rtnl_route *route, uint32_t id)
+{
+	route->rt_nhid = id;
+	route->ce_mask |= ROUTE_ATTR_NHID;
+}
+
+/**
+ * Return nexthop object of route
+ * @arg route		Route
+ *
+ * Routes received from the kernel that refer to a nexthop object carry
+ * a copy of its nexthops as well.
+ *
+ * @return Identifier of nexthop object or 0 if not set.
+ */
+uint32_t rtnl_route_get_nhid(struct rtnl_route *route)
+{
+	return route->rt_nhid;
+}
+
 /** @} */
 
 /**
@@ -947,6 +1048,10 @@ int rtnl_route_guess_scope(struct rtnl_route *route)
 	if (route->rt_family == RTNL_FAMILY_IPMR)
 		return RT_SCOPE_UNIVERSE;
 
+	/* The nexthop object may be replaced by one with a gateway */
+	if (route->ce_mask & ROUTE_ATTR_NHID)
+		return RT_SCOPE_UNIVERSE;
+
 	if (!nl_list_empty(&route->rt_nexthops)) {
 		struct rtnl_nexthop *nh;
 
@@ -955,7 +1060,7 @@ int rtnl_route_guess_scope(struct rtnl_route *route)
 		 * is not directly connected
 		 */
 		nl_list_for_each_entry(nh, &route->rt_nexthops, rtnh_list) {
-			if (nh->rtnh_gateway)
+			if (nh->ce_mask & NH_ATTR_GATEWAY)
 				return RT_SCOPE_UNIVERSE;
 		}
 	}
@@ -970,7 +1075,8 @@ static struct nl_addr *rtnl_route_parse_via(struct nlattr *nla)
 	int alen = nla_len(nla) - offsetof(struct rtvia, rtvia_addr);
 	struct rtvia *via = nla_data(nla);
 
-	return nl_addr_build(via->rtvia_family, via->rtvia_addr, alen);
+	return nl_addr_intern(nl_addr_build(via->rtvia_family,
+					    via->rtvia_addr, alen));
 }
 
 int rtnl_route_put_via(struct nl_msg *msg, struct nl_addr *addr)
@@ -1001,18 +1107,40 @@ static struct nla_policy route_policy[RTA_MAX+1] = {
 	[RTA_TTL_PROPAGATE] = { .type = NLA_U8 },
 	[RTA_ENCAP]	= { .type = NLA_NESTED },
 	[RTA_ENCAP_TYPE] = { .type = NLA_U16 },
+	[RTA_NH_ID]	= { .type = NLA_U32 },
 };
 
 int rtnl_route_parse_multipath(struct rtnl_route *route, struct nlattr *attr)
 {
 	struct rtnl_nexthop *nh = NULL;
+	struct rtnl_nh_array *array = NULL;
 	struct rtnexthop *rtnh = nla_data(attr);
 	size_t tlen = nla_len(attr);
+	unsigned int n = 0;
 	int err;
 
 	while (tlen >= sizeof(*rtnh) && tlen >= rtnh->rtnh_len) {
-		nh = rtnl_route_nh_alloc();
-		if (!nh)
+		n++;
+		tlen -= RTNH_ALIGN(rtnh->rtnh_len);
+		rtnh = RTNH_NEXT(rtnh);
+	}
+
+	/* All nexthops of a route received from the kernel share one array */
+	if (n && !route->rt_nh_array) {
+		array = rtnl_route_nh_array_alloc(n);
+		if (!array)
+			return -NLE_NOMEM;
+		route->rt_nh_array = array;
+	}
+	n = 0;
+
+	rtnh = nla_data(attr);
+	tlen = nla_len(attr);
+
+	while (tlen >= sizeof(*rtnh) && tlen >= rtnh->rtnh_len) {
+		if (array)
+			nh = rtnl_route_nh_array_init(array, n++);
+		else if (!(nh = rtnl_route_nh_alloc()))
 			return -NLE_NOMEM;
 
 		rtnl_route_nh_set_weight(nh, rtnh->rtnh_hops);
@@ -1030,17 +1158,11 @@ int rtnl_route_parse_multipath(struct rtnl_route *route, struct nlattr *attr)
 				goto errout;
 
 			if (ntb[RTA_GATEWAY]) {
-				struct nl_addr *addr;
-
-				addr = nl_addr_alloc_attr(ntb[RTA_GATEWAY],
-							  route->rt_family);
-				if (!addr) {
-					err = -NLE_NOMEM;
+				err = rtnl_route_nh_set_gateway_attr(nh,
+						ntb[RTA_GATEWAY],
+						route->rt_family);
+				if (err < 0)
 					goto errout;
-				}
-
-				rtnl_route_nh_set_gateway(nh, addr);
-				nl_addr_put(addr);
 			}
 
 			if (ntb[RTA_FLOW]) {
@@ -1053,8 +1175,9 @@ int rtnl_route_parse_multipath(struct rtnl_route *route, struct nlattr *attr)
 			if (ntb[RTA_NEWDST]) {
 				struct nl_addr *addr;
 
-				addr = nl_addr_alloc_attr(ntb[RTA_NEWDST],
-							  route->rt_family);
+				addr = nl_addr_intern(
+					nl_addr_alloc_attr(ntb[RTA_NEWDST],
+							   route->rt_family));
 				if (!addr)
 					goto errout;
 
@@ -1086,7 +1209,11 @@ int rtnl_route_parse_multipath(struct rtnl_route *route, struct nlattr *attr)
 			}
 		}
 
-		rtnl_route_add_nexthop(route, nh);
+		if (nh->rtnh_array)
+			route_add_inline_nexthop(route, nh);
+		else
+			rtnl_route_add_nexthop(route, nh);
+		nh = NULL;
 		tlen -= RTNH_ALIGN(rtnh->rtnh_len);
 		rtnh = RTNH_NEXT(rtnh);
 	}
@@ -1104,10 +1231,12 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 	struct rtmsg *rtm;
 	struct rtnl_route *route;
 	struct nlattr *tb[RTA_MAX + 1];
-	struct nl_addr *src = NULL, *dst = NULL, *addr;
-	struct rtnl_nexthop *old_nh = NULL;
+	struct nl_addr *addr;
+	struct rtnl_nexthop single, *old_nh = NULL;
 	int err, family;
 
+	rtnl_route_nh_init(&single);
+
 	route = rtnl_route_alloc();
 	if (!route)
 		goto errout_nomem;
@@ -1139,33 +1268,23 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 	if (family != AF_MPLS)
 		route->ce_mask |= ROUTE_ATTR_PRIO;
 
-	if (tb[RTA_DST]) {
-		if (!(dst = nl_addr_alloc_attr(tb[RTA_DST], family)))
-			goto errout_nomem;
-	} else {
-		if (!(dst = nl_addr_alloc(0)))
-			goto errout_nomem;
-		nl_addr_set_family(dst, rtm->rtm_family);
-	}
-
-	nl_addr_set_prefixlen(dst, rtm->rtm_dst_len);
-	err = rtnl_route_set_dst(route, dst);
+	err = nl_inline_addr_set_data(&route->rt_dst, family,
+				      tb[RTA_DST] ? nla_data(tb[RTA_DST]) : NULL,
+				      tb[RTA_DST] ? nla_len(tb[RTA_DST]) : 0,
+				      rtm->rtm_dst_len);
 	if (err < 0)
 		goto errout;
-
-	nl_addr_put(dst);
-
-	if (tb[RTA_SRC]) {
-		if (!(src = nl_addr_alloc_attr(tb[RTA_SRC], family)))
-			goto errout_nomem;
-	} else if (rtm->rtm_src_len)
-		if (!(src = nl_addr_alloc(0)))
-			goto errout_nomem;
-
-	if (src) {
-		nl_addr_set_prefixlen(src, rtm->rtm_src_len);
-		rtnl_route_set_src(route, src);
-		nl_addr_put(src);
+	route->ce_mask |= ROUTE_ATTR_DST;
+
+	/* Source routing is not supported for IPv4, see rtnl_route_set_src() */
+	if (tb[RTA_SRC] && family != AF_INET) {
+		err = nl_inline_addr_set_data(&route->rt_src, family,
+					      nla_data(tb[RTA_SRC]),
+					      nla_len(tb[RTA_SRC]),
+					      rtm->rtm_src_len);
+		if (err < 0)
+			goto errout;
+		route->ce_mask |= ROUTE_ATTR_SRC;
 	}
 
 	if (tb[RTA_TABLE])
@@ -1178,10 +1297,11 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 		rtnl_route_set_priority(route, nla_get_u32(tb[RTA_PRIORITY]));
 
 	if (tb[RTA_PREFSRC]) {
-		if (!(addr = nl_addr_alloc_attr(tb[RTA_PREFSRC], family)))
-			goto errout_nomem;
-		rtnl_route_set_pref_src(route, addr);
-		nl_addr_put(addr);
+		err = nl_inline_addr_set_attr(&route->rt_pref_src,
+					      tb[RTA_PREFSRC], family);
+		if (err < 0)
+			goto errout;
+		route->ce_mask |= ROUTE_ATTR_PREF_SRC;
 	}
 
 	if (tb[RTA_METRICS]) {
@@ -1214,26 +1334,22 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 	}
 
 	if (tb[RTA_OIF]) {
-		if (!old_nh && !(old_nh = rtnl_route_nh_alloc()))
-			goto errout_nomem;
+		old_nh = &single;
 
 		rtnl_route_nh_set_ifindex(old_nh, nla_get_u32(tb[RTA_OIF]));
 	}
 
 	if (tb[RTA_GATEWAY]) {
-		if (!old_nh && !(old_nh = rtnl_route_nh_alloc()))
-			goto errout_nomem;
+		old_nh = &single;
 
-		if (!(addr = nl_addr_alloc_attr(tb[RTA_GATEWAY], family)))
-			goto errout_nomem;
-
-		rtnl_route_nh_set_gateway(old_nh, addr);
-		nl_addr_put(addr);
+		err = rtnl_route_nh_set_gateway_attr(old_nh, tb[RTA_GATEWAY],
+						     family);
+		if (err < 0)
+			goto errout;
 	}
 
 	if (tb[RTA_FLOW]) {
-		if (!old_nh && !(old_nh = rtnl_route_nh_alloc()))
-			goto errout_nomem;
+		old_nh = &single;
 
 		rtnl_route_nh_set_realms(old_nh, nla_get_u32(tb[RTA_FLOW]));
 	}
@@ -1241,10 +1357,10 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 	if (tb[RTA_NEWDST]) {
 		struct nl_addr *addr;
 
-		if (!old_nh && !(old_nh = rtnl_route_nh_alloc()))
-			goto errout_nomem;
+		old_nh = &single;
 
-		addr = nl_addr_alloc_attr(tb[RTA_NEWDST], route->rt_family);
+		addr = nl_addr_intern(nl_addr_alloc_attr(tb[RTA_NEWDST],
+							 route->rt_family));
 		if (!addr)
 			goto errout_nomem;
 
@@ -1255,13 +1371,9 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 	}
 
 	if (tb[RTA_VIA]) {
-		int alen = nla_len(tb[RTA_VIA]) - offsetof(struct rtvia, rtvia_addr);
-		struct rtvia *via = nla_data(tb[RTA_VIA]);
+		old_nh = &single;
 
-		if (!old_nh && !(old_nh = rtnl_route_nh_alloc()))
-			goto errout_nomem;
-
-		addr = nl_addr_build(via->rtvia_family, via->rtvia_addr, alen);
+		addr = rtnl_route_parse_via(tb[RTA_VIA]);
 		if (!addr)
 			goto errout_nomem;
 
@@ -1276,9 +1388,11 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 					     nla_get_u8(tb[RTA_TTL_PROPAGATE]));
 	}
 
+	if (tb[RTA_NH_ID])
+		rtnl_route_set_nhid(route, nla_get_u32(tb[RTA_NH_ID]));
+
 	if (tb[RTA_ENCAP] && tb[RTA_ENCAP_TYPE]) {
-		if (!old_nh && !(old_nh = rtnl_route_nh_alloc()))
-			goto errout_nomem;
+		old_nh = &single;
 
 		err = nh_encap_parse_msg(tb[RTA_ENCAP],
 					 tb[RTA_ENCAP_TYPE], old_nh);
@@ -1292,7 +1406,17 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 			/* If no nexthops have been provided via RTA_MULTIPATH
 			 * we add it as regular nexthop to maintain backwards
 			 * compatibility */
-			rtnl_route_add_nexthop(route, old_nh);
+			struct rtnl_nexthop *nh;
+
+			if (!(route->rt_nh_array = rtnl_route_nh_array_alloc(1)))
+				goto errout_nomem;
+
+			/* Moves the attributes of single into the array */
+			nh = rtnl_route_nh_array_init(route->rt_nh_array, 0);
+			*nh = single;
+			nh->rtnh_array = route->rt_nh_array;
+			nl_init_list_head(&nh->rtnh_list);
+			route_add_inline_nexthop(route, nh);
 		} else {
 			/* Kernel supports new style nexthop configuration,
 			 * verify that it is a duplicate and discard nexthop. */
@@ -1310,7 +1434,7 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 				goto errout;
 			}
 
-			rtnl_route_nh_free(old_nh);
+			rtnl_route_nh_release(old_nh);
 		}
 		old_nh = NULL;
 	}
@@ -1320,7 +1444,7 @@ int rtnl_route_parse(struct nlmsghdr *nlh, struct rtnl_route **result)
 
 errout:
 	if (old_nh)
-		rtnl_route_nh_free(old_nh);
+		rtnl_route_nh_release(old_nh);
 	rtnl_route_put(route);
 	return err;
 
@@ -1343,17 +1467,18 @@ int rtnl_route_build_msg(struct nl_msg *msg, struct rtnl_route *route)
 		.rtm_flags = route->rt_flags,
 	};
 
-	if (route->rt_dst == NULL)
+	if (!nl_inline_addr_isset(&route->rt_dst))
 		return -NLE_MISSING_ATTR;
 
-	rtmsg.rtm_dst_len = nl_addr_get_prefixlen(route->rt_dst);
-	if (route->rt_src)
-		rtmsg.rtm_src_len = nl_addr_get_prefixlen(route->rt_src);
+	rtmsg.rtm_dst_len = nl_inline_addr_prefixlen(&route->rt_dst);
+	if (nl_inline_addr_isset(&route->rt_src))
+		rtmsg.rtm_src_len = nl_inline_addr_prefixlen(&route->rt_src);
 
 	if (!(route->ce_mask & ROUTE_ATTR_SCOPE))
 		rtmsg.rtm_scope = rtnl_route_guess_scope(route);
 
-	if (rtnl_route_get_nnexthops(route) == 1) {
+	if (!(route->ce_mask & ROUTE_ATTR_NHID) &&
+	    rtnl_route_get_nnexthops(route) == 1) {
 		struct rtnl_nexthop *nh;
 		nh = rtnl_route_nexthop_n(route, 0);
 		rtmsg.rtm_flags |= nh->rtnh_flags;
@@ -1369,17 +1494,20 @@ int rtnl_route_build_msg(struct nl_msg *msg, struct rtnl_route *route)
 	if (route->rt_family != AF_MPLS)
 		NLA_PUT_U32(msg, RTA_TABLE, route->rt_table);
 
-	if (nl_addr_get_len(route->rt_dst))
-		NLA_PUT_ADDR(msg, RTA_DST, route->rt_dst);
+	if (nl_inline_addr_len(&route->rt_dst) &&
+	    nl_inline_addr_put(msg, RTA_DST, &route->rt_dst) < 0)
+		goto nla_put_failure;
 
 	if (route->ce_mask & ROUTE_ATTR_PRIO)
 		NLA_PUT_U32(msg, RTA_PRIORITY, route->rt_prio);
 
-	if (route->ce_mask & ROUTE_ATTR_SRC)
-		NLA_PUT_ADDR(msg, RTA_SRC, route->rt_src);
+	if ((route->ce_mask & ROUTE_ATTR_SRC) &&
+	    nl_inline_addr_put(msg, RTA_SRC, &route->rt_src) < 0)
+		goto nla_put_failure;
 
-	if (route->ce_mask & ROUTE_ATTR_PREF_SRC)
-		NLA_PUT_ADDR(msg, RTA_PREFSRC, route->rt_pref_src);
+	if ((route->ce_mask & ROUTE_ATTR_PREF_SRC) &&
+	    nl_inline_addr_put(msg, RTA_PREFSRC, &route->rt_pref_src) < 0)
+		goto nla_put_failure;
 
 	if (route->ce_mask & ROUTE_ATTR_IIF)
 		NLA_PUT_U32(msg, RTA_IIF, route->rt_iif);
@@ -1402,12 +1530,14 @@ int rtnl_route_build_msg(struct nl_msg *msg, struct rtnl_route *route)
 		nla_nest_end(msg, metrics);
 	}
 
-	if (rtnl_route_get_nnexthops(route) == 1) {
+	if (route->ce_mask & ROUTE_ATTR_NHID)
+		NLA_PUT_U32(msg, RTA_NH_ID, route->rt_nhid);
+	else if (rtnl_route_get_nnexthops(route) == 1) {
 		struct rtnl_nexthop *nh;
 
 		nh = rtnl_route_nexthop_n(route, 0);
-		if (nh->rtnh_gateway)
-			NLA_PUT_ADDR(msg, RTA_GATEWAY, nh->rtnh_gateway);
+		if (rtnl_route_nh_put_gateway(msg, nh) < 0)
+			goto nla_put_failure;
 		if (nh->rtnh_ifindex)
 			NLA_PUT_U32(msg, RTA_OIF, nh->rtnh_ifindex);
 		if (nh->rtnh_realms)
@@ -1437,9 +1567,8 @@ int rtnl_route_build_msg(struct nl_msg *msg, struct rtnl_route *route)
 			rtnh->rtnh_hops = nh->rtnh_weight;
 			rtnh->rtnh_ifindex = nh->rtnh_ifindex;
 
-			if (nh->rtnh_gateway)
-				NLA_PUT_ADDR(msg, RTA_GATEWAY,
-					     nh->rtnh_gateway);
+			if (rtnl_route_nh_put_gateway(msg, nh) < 0)
+				goto nla_put_failure;
 
 			if (nh->rtnh_newdst)
 				NLA_PUT_ADDR(msg, RTA_NEWDST, nh->rtnh_newdst);
@@ -1482,7 +1611,9 @@ struct nl_object_ops route_obj_ops = {
 	},
 	.oo_compare		= route_compare,
 	.oo_keygen		= route_keygen,
+	.oo_hash_attrs		= route_hash_attrs,
 	.oo_update		= route_update,
+	.oo_update_attrs	= route_update_attrs,
 	.oo_attrs2str		= route_attrs2str,
 	.oo_id_attrs		= (ROUTE_ATTR_FAMILY | ROUTE_ATTR_TOS |
 				   ROUTE_ATTR_TABLE | ROUTE_ATTR_DST |
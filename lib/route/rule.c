@@ -20,6 +20,7 @@
 #include <netlink-private/netlink.h>
 #include <netlink/netlink.h>
 #include <netlink/utils.h>
+#include <netlink-private/hash.h>
 #include <netlink/route/rtnl.h>
 #include <netlink/route/rule.h>
 #include <inttypes.h>
@@ -317,6 +318,22 @@ static void rule_dump_stats(struct nl_object *obj, struct nl_dump_params *p)
 	rule_dump_details(obj, p);
 }
 
+static void rule_keygen(struct nl_object *obj, uint32_t *hashkey,
+			uint32_t table_sz)
+{
+	struct rtnl_rule *rule = (struct rtnl_rule *) obj;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, rule->r_family);
+	nl_hasher_u32(&h, rule->r_prio);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "rule %p key (fam %d prio %d) hash 0x%x\n",
+	       rule, rule->r_family, rule->r_prio, *hashkey);
+}
+
 static uint64_t rule_compare(struct nl_object *_a, struct nl_object *_b,
 			     uint64_t attrs, int flags)
 {
@@ -959,6 +976,8 @@ static struct nl_object_ops rule_obj_ops = {
 	    [NL_DUMP_STATS]	= rule_dump_stats,
 	},
 	.oo_compare		= rule_compare,
+	.oo_keygen		= rule_keygen,
+	.oo_keygen_attrs	= RULE_ATTR_FAMILY | RULE_ATTR_PRIO,
 	.oo_attrs2str		= rule_attrs2str,
 	.oo_id_attrs		= ~0,
 };
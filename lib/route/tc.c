@@ -20,6 +20,7 @@
 #include <netlink-private/tc.h>
 #include <netlink/netlink.h>
 #include <netlink/utils.h>
+#include <netlink-private/hash.h>
 #include <netlink/route/rtnl.h>
 #include <netlink/route/link.h>
 #include <netlink/route/tc.h>
@@ -981,6 +982,37 @@ void rtnl_tc_dump_stats(struct nl_object *obj, struct nl_dump_params *p)
 	             tc->tc_stats[RTNL_TC_RATE_PPS]);
 }
 
+void rtnl_tc_keygen(struct nl_object *obj, uint32_t *hashkey,
+		    uint32_t table_sz)
+{
+	struct rtnl_tc *tc = TC_CAST(obj);
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, tc->tc_ifindex);
+	nl_hasher_u32(&h, tc->tc_handle);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "tc %p key (dev %d handle 0x%x) hash 0x%x\n",
+	       tc, tc->tc_ifindex, tc->tc_handle, *hashkey);
+}
+
+void rtnl_tc_hash_attrs(struct nl_object *obj, uint64_t attrs,
+			struct nl_hasher *h)
+{
+	struct rtnl_tc *tc = TC_CAST(obj);
+
+	if (attrs & TCA_ATTR_HANDLE)
+		nl_hasher_u32(h, tc->tc_handle);
+	if (attrs & TCA_ATTR_PARENT)
+		nl_hasher_u32(h, tc->tc_parent);
+	if (attrs & TCA_ATTR_IFINDEX)
+		nl_hasher_u32(h, tc->tc_ifindex);
+	if (attrs & TCA_ATTR_KIND)
+		nl_hasher_str(h, tc->tc_kind);
+}
+
 uint64_t rtnl_tc_compare(struct nl_object *aobj, struct nl_object *bobj,
 			 uint64_t attrs, int flags)
 {
@@ -178,6 +178,48 @@ void _nl_socket_used_ports_set(uint32_t *used_ports, uint32_t port)
  * @{
  */
 
+static void recvq_free(struct nl_recvq *q)
+{
+	unsigned int i;
+
+	for (i = 0; i < q->rq_size; i++)
+		_nl_recvbuf_put(q->rq_entries[i].re_buf);
+
+	free(q->rq_entries);
+	free(q->rq_mmsg);
+	free(q->rq_iov);
+	memset(q, 0, sizeof(*q));
+}
+
+/* Drop datagrams read in batch mode but not yet processed */
+void _nl_socket_recvq_flush(struct nl_sock *sk)
+{
+	sk->s_recvq.rq_count = 0;
+	sk->s_recvq.rq_next = 0;
+}
+
+/*
+ * Drop all datagrams queued on the socket without blocking, including
+ * those read in batch mode. Returns the number of datagrams dropped.
+ */
+int _nl_socket_discard(struct nl_sock *sk)
+{
+	int n = sk->s_recvq.rq_count - sk->s_recvq.rq_next;
+
+	_nl_socket_recvq_flush(sk);
+
+	for (;;) {
+		if (recv(sk->s_fd, NULL, 0, MSG_DONTWAIT | MSG_TRUNC) >= 0)
+			n++;
+		else if (errno != EINTR && errno != ENOBUFS)
+			break;
+	}
+
+	NL_DBG(3, "Discarded %d datagrams queued on socket %p\n", n, sk);
+
+	return n;
+}
+
 static struct nl_sock *__alloc_socket(struct nl_cb *cb)
 {
 	struct nl_sock *sk;
@@ -252,6 +294,9 @@ void nl_socket_free(struct nl_sock *sk)
 	if (!(sk->s_flags & NL_OWN_PORT))
 		release_local_port(sk->s_local.nl_pid);
 
+	recvq_free(&sk->s_recvq);
+	_nl_recvbuf_put(sk->s_rbuf);
+	_nl_socket_requests_free(sk);
 	nl_cb_put(sk->s_cb);
 	free(sk);
 }
@@ -737,6 +782,117 @@ void nl_socket_disable_msg_peek(struct nl_sock *sk)
 	sk->s_flags &= ~NL_MSG_PEEK;
 }
 
+/**
+ * Set number of datagrams to read per system call
+ * @arg sk		Netlink socket.
+ * @arg n		Maximum number of datagrams to read at once.
+ *
+ * If \c n is greater than 1, nl_recvmsgs() reads up to \c n datagrams
+ * with a single recvmmsg() system call whenever it runs out of data. The
+ * datagrams are then processed one after another through the callbacks
+ * of the socket, in the order they were received, and nl_recvmsgs() only
+ * returns once all of them have been processed. Datagrams read but not
+ * yet processed, e.g. because a callback returned NL_STOP or an error
+ * occurred, are kept with the socket and processed by the next call to
+ * nl_recvmsgs().
+ *
+ * Setting \c n to 0 or 1 restores the default of reading a single
+ * datagram per system call.
+ *
+ * @note Batched reads can't use MSG_PEEK to determine the size of the
+ *       next datagram. Each of the \c n buffers is allocated with the
+ *       message buffer size (see nl_socket_set_msg_buf_size()) and grows
+ *       after a datagram had to be discarded due to truncation. The loss
+ *       is reported by nl_recvmsgs() returning -NLE_MSG_TRUNC after the
+ *       other datagrams of the batch have been processed.
+ * @note Datagrams kept with the socket do not make its file descriptor
+ *       readable. After nl_recvmsgs() stopped early, call it again
+ *       before waiting for the socket with poll() or select().
+ * @note Credentials are not received in batch mode. If credential
+ *       passing is enabled, datagrams are read one at a time.
+ *
+ * @return 0 on success or a negative error code.
+ * @retval -NLE_RANGE \c n exceeds NL_RECV_BATCH_MAX
+ * @retval -NLE_BUSY Datagrams of a previous batch are still pending
+ * @retval -NLE_OPNOTSUPP recvmmsg() is not available
+ */
+int nl_socket_set_recv_batch(struct nl_sock *sk, unsigned int n)
+{
+#ifdef HAVE_RECVMMSG
+	struct nl_recvq *q = &sk->s_recvq;
+	size_t bufsize;
+
+	if (n > NL_RECV_BATCH_MAX)
+		return -NLE_RANGE;
+
+	if (q->rq_next < q->rq_count)
+		return -NLE_BUSY;
+
+	bufsize = q->rq_bufsize;
+	recvq_free(q);
+
+	if (n <= 1)
+		return 0;
+
+	q->rq_entries = calloc(n, sizeof(*q->rq_entries));
+	q->rq_mmsg = calloc(n, sizeof(*q->rq_mmsg));
+	q->rq_iov = calloc(n, sizeof(*q->rq_iov));
+	if (!q->rq_entries || !q->rq_mmsg || !q->rq_iov) {
+		recvq_free(q);
+		return -NLE_NOMEM;
+	}
+
+	q->rq_size = n;
+	q->rq_bufsize = bufsize;
+
+	return 0;
+#else
+	return n > 1 ? -NLE_OPNOTSUPP : 0;
+#endif
+}
+
+/**
+ * Get number of datagrams read per system call
+ * @arg sk		Netlink socket.
+ *
+ * @see nl_socket_set_recv_batch()
+ * @return Maximum number of datagrams read at once.
+ */
+unsigned int nl_socket_get_recv_batch(const struct nl_sock *sk)
+{
+	return sk->s_recvq.rq_size ? sk->s_recvq.rq_size : 1;
+}
+
+/**
+ * Enable zero-copy delivery of received messages
+ * @arg sk		Netlink socket.
+ *
+ * By default, every netlink message contained in a received datagram is
+ * copied into a newly allocated message before it is handed to the
+ * callbacks. If zero-copy delivery is enabled, the messages passed to the
+ * callbacks reference the receive buffer directly instead. The receive
+ * buffer is kept around until the last message referencing it has been
+ * released with nlmsg_free().
+ *
+ * @note Messages received in zero-copy mode can't grow beyond their
+ *       received size without calling nlmsg_expand() first, which
+ *       detaches the message from the receive buffer.
+ */
+void nl_socket_enable_msg_zerocopy(struct nl_sock *sk)
+{
+	sk->s_flags |= NL_MSG_ZEROCOPY;
+}
+
+/**
+ * Disable zero-copy delivery of received messages (default)
+ * @arg sk		Netlink socket.
+ * @see nl_socket_enable_msg_zerocopy()
+ */
+void nl_socket_disable_msg_zerocopy(struct nl_sock *sk)
+{
+	sk->s_flags &= ~NL_MSG_ZEROCOPY;
+}
+
 /** @} */
 
 /**
@@ -865,6 +1021,11 @@ int nl_socket_set_buffer_size(struct nl_sock *sk, int rxbuf, int txbuf)
  * nl_socket_enable_msg_peek() or sets the message buffer size to a positive value.
  * See capability NL_CAPABILITY_NL_RECVMSGS_PEEK_BY_DEFAULT for that.
  *
+ * nl_recvmsgs() reads into a receive buffer kept with the socket which is
+ * reused across calls. The buffer starts out with the default message
+ * buffer size and grows to the size of the largest message received, so
+ * large messages only cause the buffer to be enlarged once.
+ *
  * @return 0 on success or a negative error code.
  */
 int nl_socket_set_msg_buf_size(struct nl_sock *sk, size_t bufsize)
@@ -940,6 +1101,101 @@ int nl_socket_recv_pktinfo(struct nl_sock *sk, int state)
 	return 0;
 }
 
+/**
+ * Enable/disable capped ACK and error messages
+ * @arg sk		Netlink socket.
+ * @arg state		New state (0 - disabled, 1 - enabled)
+ *
+ * By default, the kernel includes the complete original request in every
+ * error message. If enabled, only the header of the original request is
+ * included, this reduces the size of error messages of large requests
+ * considerably.
+ *
+ * @return 0 on success or a negative error code
+ */
+int nl_socket_set_cap_ack(struct nl_sock *sk, int state)
+{
+	int err;
+
+	if (sk->s_fd == -1)
+		return -NLE_BAD_SOCK;
+
+	err = setsockopt(sk->s_fd, SOL_NETLINK, NETLINK_CAP_ACK,
+			 &state, sizeof(state));
+	if (err < 0) {
+		NL_DBG(4, "nl_socket_set_cap_ack(%p): setsockopt() failed with %d (%s)\n",
+			sk, errno, nl_strerror_l(errno));
+		return -nl_syserr2nlerr(errno);
+	}
+
+	return 0;
+}
+
+/**
+ * Enable/disable extended ACK reporting
+ * @arg sk		Netlink socket.
+ * @arg state		New state (0 - disabled, 1 - enabled)
+ *
+ * If enabled, the kernel appends additional information to ACK and error
+ * messages, such as a human readable error message and the offset of
+ * the attribute causing the error. The information can be retrieved
+ * with nlmsg_ext_ack_msg() and nlmsg_ext_ack_offset().
+ *
+ * @return 0 on success or a negative error code
+ */
+int nl_socket_set_ext_ack(struct nl_sock *sk, int state)
+{
+	int err;
+
+	if (sk->s_fd == -1)
+		return -NLE_BAD_SOCK;
+
+	err = setsockopt(sk->s_fd, SOL_NETLINK, NETLINK_EXT_ACK,
+			 &state, sizeof(state));
+	if (err < 0) {
+		NL_DBG(4, "nl_socket_set_ext_ack(%p): setsockopt() failed with %d (%s)\n",
+			sk, errno, nl_strerror_l(errno));
+		return -nl_syserr2nlerr(errno);
+	}
+
+	return 0;
+}
+
+/**
+ * Enable/disable strict checking of requests
+ * @arg sk		Netlink socket.
+ * @arg state		New state (0 - disabled, 1 - enabled)
+ *
+ * If enabled, the kernel validates the headers and attributes of dump
+ * requests strictly and honours the filter attributes found in them.
+ * Caches refilled through this socket pass their dump filter on to the
+ * kernel (see nl_cache_set_dump_filter()).
+ *
+ * @return 0 on success or a negative error code
+ */
+int nl_socket_set_strict_chk(struct nl_sock *sk, int state)
+{
+	int err;
+
+	if (sk->s_fd == -1)
+		return -NLE_BAD_SOCK;
+
+	err = setsockopt(sk->s_fd, SOL_NETLINK, NETLINK_GET_STRICT_CHK,
+			 &state, sizeof(state));
+	if (err < 0) {
+		NL_DBG(4, "nl_socket_set_strict_chk(%p): setsockopt() failed with %d (%s)\n",
+			sk, errno, nl_strerror_l(errno));
+		return -nl_syserr2nlerr(errno);
+	}
+
+	if (state)
+		sk->s_flags |= NL_SOCK_STRICT_CHK;
+	else
+		sk->s_flags &= ~NL_SOCK_STRICT_CHK;
+
+	return 0;
+}
+
 /** @} */
 
 /** @} */
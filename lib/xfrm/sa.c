@@ -43,6 +43,7 @@
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
 #include <netlink/object.h>
+#include <netlink-private/hash.h>
 #include <netlink/xfrm/sa.h>
 #include <netlink/xfrm/selector.h>
 #include <netlink/xfrm/lifetime.h>
@@ -212,6 +213,23 @@ static int xfrm_sa_clone(struct nl_object *_dst, struct nl_object *_src)
 	return 0;
 }
 
+static void xfrm_sa_keygen(struct nl_object *obj, uint32_t *hashkey,
+			   uint32_t table_sz)
+{
+	struct xfrmnl_sa *sa = (struct xfrmnl_sa *) obj;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, sa->id.spi);
+	nl_hasher_u32(&h, sa->id.proto);
+	nl_hasher_addr(&h, sa->id.daddr);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "sa %p key (spi 0x%x proto %d) hash 0x%x\n",
+	       sa, sa->id.spi, sa->id.proto, *hashkey);
+}
+
 static uint64_t xfrm_sa_compare(struct nl_object *_a, struct nl_object *_b,
 				uint64_t attrs, int flags)
 {
@@ -2186,6 +2204,7 @@ static struct nl_object_ops xfrm_sa_obj_ops = {
 	                        [NL_DUMP_STATS]     =   xfrm_sa_dump_stats,
 	                    },
 	.oo_compare     =   xfrm_sa_compare,
+	.oo_keygen      =   xfrm_sa_keygen,
 	.oo_attrs2str   =   xfrm_sa_attrs2str,
 	.oo_id_attrs    =   (XFRM_SA_ATTR_DADDR | XFRM_SA_ATTR_SPI | XFRM_SA_ATTR_PROTO),
 };
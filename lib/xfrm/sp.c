@@ -43,6 +43,7 @@
 #include <netlink/netlink.h>
 #include <netlink/cache.h>
 #include <netlink/object.h>
+#include <netlink-private/hash.h>
 #include <netlink/xfrm/selector.h>
 #include <netlink/xfrm/lifetime.h>
 #include <netlink/xfrm/template.h>
@@ -139,6 +140,22 @@ static int xfrm_sp_clone(struct nl_object *_dst, struct nl_object *_src)
 	return 0;
 }
 
+static void xfrm_sp_keygen(struct nl_object *obj, uint32_t *hashkey,
+			   uint32_t table_sz)
+{
+	struct xfrmnl_sp *sp = (struct xfrmnl_sp *) obj;
+	struct nl_hasher h;
+
+	nl_hasher_init(&h, 0);
+	nl_hasher_u32(&h, sp->index);
+	nl_hasher_u32(&h, sp->dir);
+
+	*hashkey = nl_hasher_final(&h) % table_sz;
+
+	NL_DBG(5, "sp %p key (index %u dir %d) hash 0x%x\n",
+	       sp, sp->index, sp->dir, *hashkey);
+}
+
 static uint64_t xfrm_sp_compare(struct nl_object *_a, struct nl_object *_b,
 				uint64_t attrs, int flags)
 {
@@ -1392,6 +1409,7 @@ static struct nl_object_ops xfrm_sp_obj_ops = {
 	                        [NL_DUMP_STATS]     =   xfrm_sp_dump_stats,
 	                    },
 	.oo_compare     =   xfrm_sp_compare,
+	.oo_keygen      =   xfrm_sp_keygen,
 	.oo_attrs2str   =   xfrm_sp_attrs2str,
 	.oo_id_attrs    =   (XFRM_SP_ATTR_SEL | XFRM_SP_ATTR_INDEX | XFRM_SP_ATTR_DIR),
 };
@@ -10,6 +10,8 @@
  */
 
 #include <check.h>
+#include <pthread.h>
+#include <netlink-private/addr.h>
 #include <netlink/addr.h>
 
 #include "util.h"
@@ -198,6 +200,137 @@ START_TEST(addr_info)
 }
 END_TEST
 
+START_TEST(addr_intern)
+{
+	struct nl_addr *addrs[300], *addr, *dup;
+	uint32_t v;
+	int i;
+
+	addr = nl_addr_build(AF_INET, "\x7f\0\0\1", 4);
+	fail_if(nl_addr_intern(addr) != addr,
+		"Interning should be a no-op while disabled");
+	fail_if(nl_addr_interned(addr),
+		"Address should not be interned while disabled");
+	nl_addr_put(addr);
+
+	nl_addr_intern_enable(1);
+
+	for (i = 0; i < 300; i++) {
+		v = i;
+		addrs[i] = nl_addr_intern(nl_addr_build(AF_INET, &v, 4));
+		fail_if(!nl_addr_interned(addrs[i]),
+			"Address %d should be interned", i);
+	}
+
+	for (i = 0; i < 300; i++) {
+		v = i;
+		dup = nl_addr_intern(nl_addr_build(AF_INET, &v, 4));
+		fail_if(dup != addrs[i],
+			"Equal address %d should be shared", i);
+		nl_addr_put(dup);
+	}
+
+	fail_if(nl_addr_set_binary_addr(addrs[0], &v, 4) != -NLE_IMMUTABLE,
+		"Interned address should be immutable");
+
+	/* Ignored, the pool would otherwise lose track of the address */
+	nl_addr_set_family(addrs[0], AF_INET6);
+	nl_addr_set_prefixlen(addrs[0], 8);
+	fail_if(nl_addr_get_family(addrs[0]) != AF_INET,
+		"Family of interned address should not change");
+	fail_if(nl_addr_get_prefixlen(addrs[0]) != 32,
+		"Prefix length of interned address should not change");
+
+	/* Removal must keep the remaining probe sequences intact */
+	for (i = 0; i < 300; i += 2)
+		nl_addr_put(addrs[i]);
+
+	for (i = 1; i < 300; i += 2) {
+		v = i;
+		dup = nl_addr_intern(nl_addr_build(AF_INET, &v, 4));
+		fail_if(dup != addrs[i],
+			"Equal address %d should still be shared", i);
+		nl_addr_put(dup);
+		nl_addr_put(addrs[i]);
+	}
+
+	v = 0;
+	addr = nl_addr_build(AF_INET, &v, 4);
+	nl_addr_set_prefixlen(addr, 8);
+	dup = nl_addr_intern(nl_addr_build(AF_INET, &v, 4));
+	fail_if(nl_addr_intern(addr) == dup,
+		"Addresses with different prefix length should not be shared");
+	nl_addr_put(addr);
+	nl_addr_put(dup);
+
+	nl_addr_intern_enable(0);
+}
+END_TEST
+
+#define TEST_NTHREADS	4
+
+static void *inline_get_thread(void *arg)
+{
+	return nl_inline_addr_get(arg);
+}
+
+START_TEST(addr_inline)
+{
+	static const unsigned char mac[6] = { 2, 0, 0, 0, 0, 1 };
+	unsigned char buf[20] = { 0 };
+	struct nl_inline_addr ia = { 0 }, copy = { 0 };
+	struct nl_addr *addr, *res[TEST_NTHREADS];
+	pthread_t threads[TEST_NTHREADS];
+	int i;
+
+	fail_if(nl_inline_addr_set_data(&ia, AF_LLC, mac, sizeof(mac), 48) < 0,
+		"Unable to store address");
+	fail_if(ia.ia_addr, "Short address should be stored inline");
+
+	addr = nl_inline_addr_get(&ia);
+	fail_if(!addr, "Unable to get address");
+	fail_if(nl_inline_addr_get(&ia) != addr,
+		"Getter should return the same address");
+	fail_if(nl_addr_get_len(addr) != sizeof(mac) ||
+		memcmp(nl_addr_get_binary_addr(addr), mac, sizeof(mac)),
+		"Built address differs");
+
+	fail_if(nl_inline_addr_clone(&copy, &ia) < 0, "Unable to clone");
+	fail_if(copy.ia_addr, "Clone should be stored inline");
+	fail_if(nl_inline_addr_cmp(&copy, &ia),
+		"Inline and built address should compare equal");
+	fail_if(nl_inline_addr_cmp_addr(&copy, addr),
+		"Inline address should compare equal to struct nl_addr");
+
+	/* Concurrent getters must agree on a single address */
+	for (i = 0; i < TEST_NTHREADS; i++)
+		fail_if(pthread_create(&threads[i], NULL, inline_get_thread,
+				       &copy), "Unable to create thread");
+	for (i = 0; i < TEST_NTHREADS; i++) {
+		pthread_join(threads[i], (void **) &res[i]);
+		fail_if(!res[i] || res[i] != res[0],
+			"Getters returned different addresses");
+	}
+	fail_if(!copy.ia_inline, "Inline bytes should be kept");
+
+	nl_inline_addr_release(&copy);
+	nl_inline_addr_release(&ia);
+
+	fail_if(nl_inline_addr_set_data(&ia, AF_UNSPEC, buf, sizeof(buf),
+					8 * sizeof(buf)) < 0,
+		"Unable to store address");
+	fail_if(!ia.ia_addr, "Long address should be allocated");
+	nl_inline_addr_release(&ia);
+
+	addr = nl_addr_build(AF_INET, "\x7f\0\0\1", 4);
+	nl_inline_addr_set(&ia, addr);
+	fail_if(nl_inline_addr_get(&ia) != addr,
+		"Address set should be returned as is");
+	nl_inline_addr_release(&ia);
+	nl_addr_put(addr);
+}
+END_TEST
+
 Suite *make_nl_addr_suite(void)
 {
 	Suite *suite = suite_create("Abstract addresses");
@@ -208,6 +341,8 @@ Suite *make_nl_addr_suite(void)
 	tcase_add_test(tc_addr, addr_parse4);
 	tcase_add_test(tc_addr, addr_parse6);
 	tcase_add_test(tc_addr, addr_info);
+	tcase_add_test(tc_addr, addr_intern);
+	tcase_add_test(tc_addr, addr_inline);
 	suite_add_tcase(suite, tc_addr);
 
 	return suite;
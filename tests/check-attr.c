@@ -77,6 +77,44 @@ START_TEST(msg_construct)
 }
 END_TEST
 
+START_TEST(msg_recycle)
+{
+	struct nl_msg *msg;
+	struct nlattr *a;
+	unsigned char *p;
+	void *buf;
+	int i;
+
+	msg = nlmsg_alloc_size(256);
+	fail_if(!msg, "Unable to allocate netlink message");
+	p = nlmsg_reserve(msg, 64, NLMSG_ALIGNTO);
+	fail_if(!p, "Unable to reserve room");
+	memset(p, 0xff, 64);
+	buf = nlmsg_hdr(msg);
+	nlmsg_free(msg);
+
+	msg = nlmsg_alloc_size(256);
+	fail_if(!msg, "Unable to allocate netlink message");
+	fail_if(nlmsg_hdr(msg) != buf,
+		"Payload buffer of the same size class should be reused");
+	fail_if(nlmsg_datalen(nlmsg_hdr(msg)) != 0,
+		"Recycled message should be empty");
+
+	p = nlmsg_reserve(msg, 16, NLMSG_ALIGNTO);
+	fail_if(!p, "Unable to reserve room");
+	for (i = 0; i < 16; i++)
+		fail_if(p[i] != 0, "Reserved room should be zeroed");
+
+	a = nla_reserve(msg, 1, 24);
+	fail_if(!a, "Unable to reserve attribute");
+	p = nla_data(a);
+	for (i = 0; i < 24; i++)
+		fail_if(p[i] != 0, "Reserved attribute should be zeroed");
+
+	nlmsg_free(msg);
+}
+END_TEST
+
 Suite *make_nl_attr_suite(void)
 {
 	Suite *suite = suite_create("Netlink attributes");
@@ -84,6 +122,7 @@ Suite *make_nl_attr_suite(void)
 	TCase *nl_attr = tcase_create("Core");
 	tcase_add_test(nl_attr, attr_size);
 	tcase_add_test(nl_attr, msg_construct);
+	tcase_add_test(nl_attr, msg_recycle);
 	suite_add_tcase(suite, nl_attr);
 
 	return suite;
@@ -0,0 +1,476 @@
+/*
+ * tests/check-cache-mngr.c	Cache manager unit tests
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+#include <check.h>
+#include <netlink-private/types.h>
+#include <netlink/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/cache.h>
+#include <netlink/route/netconf.h>
+#include <linux/neighbour.h>
+#include <linux/netconf.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <limits.h>
+
+#include "util.h"
+
+/* Not used by the kernel, so real notifications do not interfere */
+#define TEST_IFINDEX	4242
+
+#define TEST_MAX_EVENTS	64
+
+struct event {
+	int			action;
+	struct nl_object *	old;
+	struct nl_object *	new;
+	uint64_t		diff;
+};
+
+/* Manager on NETLINK_ROUTE with a netconf cache and an injecting socket */
+struct mngr_test {
+	struct nl_cache_mngr *	mngr;
+	struct nl_cache *	cache;
+	struct nl_sock *	sk;
+	struct nl_sock *	tx;
+	struct event		events[TEST_MAX_EVENTS];
+	int			nevents;
+};
+
+/* Makes the next read of the event socket report lost notifications */
+static int inject_overrun;
+
+static int overrun_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+			unsigned char **buf, struct ucred **creds)
+{
+	if (inject_overrun) {
+		inject_overrun = 0;
+		sk->s_flags |= NL_SOCK_OVERRUN;
+		return -NLE_NOMEM;
+	}
+
+	return nl_recv(sk, nla, buf, creds);
+}
+
+static void record_change(struct nl_cache *cache, struct nl_object *old,
+			  struct nl_object *new, uint64_t diff, int action,
+			  void *arg)
+{
+	struct mngr_test *t = arg;
+	struct event *ev;
+
+	if (t->nevents < TEST_MAX_EVENTS) {
+		ev = &t->events[t->nevents++];
+		ev->action = action;
+		ev->diff = diff;
+		if ((ev->old = old))
+			nl_object_get(old);
+		if ((ev->new = new))
+			nl_object_get(new);
+	}
+}
+
+static void clear_events(struct mngr_test *t)
+{
+	int i;
+
+	for (i = 0; i < t->nevents; i++) {
+		nl_object_put(t->events[i].old);
+		nl_object_put(t->events[i].new);
+	}
+	t->nevents = 0;
+}
+
+static void mngr_test_init(struct mngr_test *t)
+{
+	struct sockaddr_nl local;
+	socklen_t len = sizeof(local);
+	struct nl_cb *cb;
+	int err;
+
+	memset(t, 0, sizeof(*t));
+
+	t->sk = nl_socket_alloc();
+	fail_if(!t->sk, "Unable to allocate socket");
+	cb = nl_socket_get_cb(t->sk);
+	nl_cb_overwrite_recv(cb, overrun_recv);
+	nl_cb_put(cb);
+
+	err = nl_cache_mngr_alloc(t->sk, NETLINK_ROUTE, 0, &t->mngr);
+	nl_fail_if(err < 0, err, "Unable to allocate cache manager");
+
+	err = nl_cache_alloc_name("route/netconf", &t->cache);
+	nl_fail_if(err < 0, err, "Unable to allocate netconf cache");
+
+	err = nl_cache_mngr_add_cache_v2(t->mngr, t->cache, record_change, t);
+	nl_fail_if(err < 0, err, "Unable to add cache to manager");
+
+	/* Unicast notifications straight to the event socket */
+	fail_if(getsockname(nl_cache_mngr_get_fd(t->mngr),
+			    (struct sockaddr *) &local, &len) < 0,
+		"Unable to get address of event socket");
+
+	t->tx = nl_socket_alloc();
+	fail_if(!t->tx, "Unable to allocate socket");
+	err = nl_connect(t->tx, NETLINK_ROUTE);
+	nl_fail_if(err < 0, err, "Unable to connect socket");
+	nl_socket_disable_auto_ack(t->tx);
+	nl_socket_set_peer_port(t->tx, local.nl_pid);
+}
+
+static void mngr_test_free(struct mngr_test *t)
+{
+	clear_events(t);
+	nl_socket_free(t->tx);
+	nl_cache_mngr_free(t->mngr);
+	nl_socket_free(t->sk);
+}
+
+/* Builds a notification, negative values are left out */
+static struct nl_msg *netconf_msg(int forwarding, int rp_filter)
+{
+	struct netconfmsg ncm = { .ncm_family = AF_INET };
+	struct nl_msg *msg;
+
+	msg = nlmsg_alloc_simple(RTM_NEWNETCONF, 0);
+	fail_if(!msg, "Unable to allocate message");
+
+	fail_if(nlmsg_append(msg, &ncm, sizeof(ncm), NLMSG_ALIGNTO) < 0 ||
+		nla_put_s32(msg, NETCONFA_IFINDEX, TEST_IFINDEX) < 0 ||
+		(forwarding >= 0 &&
+		 nla_put_s32(msg, NETCONFA_FORWARDING, forwarding) < 0) ||
+		(rp_filter >= 0 &&
+		 nla_put_s32(msg, NETCONFA_RP_FILTER, rp_filter) < 0),
+		"Unable to build netconf message");
+
+	return msg;
+}
+
+/* Injects a notification into the event socket */
+static void send_netconf(struct mngr_test *t, int forwarding, int rp_filter)
+{
+	struct nl_msg *msg = netconf_msg(forwarding, rp_filter);
+	int err;
+
+	err = nl_send_auto(t->tx, msg);
+	nl_fail_if(err < 0, err, "Unable to send notification");
+	nlmsg_free(msg);
+}
+
+static void process(struct mngr_test *t)
+{
+	int err;
+
+	err = nl_cache_mngr_data_ready(t->mngr);
+	nl_fail_if(err < 0, err, "Unable to process notifications");
+}
+
+static int netconf_val(struct nl_object *obj,
+		       int (*get)(struct rtnl_netconf *, int *))
+{
+	int val = -1;
+
+	if (get((struct rtnl_netconf *) obj, &val) < 0)
+		return -1;
+
+	return val;
+}
+
+START_TEST(coalesce_merged)
+{
+	struct rtnl_netconf *cached;
+	struct mngr_test t;
+	struct event *ev;
+	int err;
+
+	mngr_test_init(&t);
+
+	err = nl_cache_mngr_set_coalesce(t.mngr, t.cache, 0, 100);
+	nl_fail_if(err < 0, err, "Unable to enable coalescing");
+
+	send_netconf(&t, 1, 1);
+	process(&t);
+	fail_if(t.nevents != 0, "Events should be held back");
+	fail_if(nl_cache_mngr_flush(t.mngr) != 1, "One event expected");
+	fail_if(t.nevents != 1 || t.events[0].action != NL_ACT_NEW,
+		"Entry should be reported as new");
+	clear_events(&t);
+
+	/* Each notification only carries one of the values */
+	send_netconf(&t, 0, -1);
+	send_netconf(&t, -1, 2);
+	process(&t);
+	fail_if(nl_cache_mngr_flush(t.mngr) != 1,
+		"Changes should be coalesced into one event");
+
+	cached = rtnl_netconf_get_by_idx(t.cache, AF_INET, TEST_IFINDEX);
+	fail_if(!cached, "Entry should be cached");
+
+	ev = &t.events[0];
+	fail_if(ev->action != NL_ACT_CHANGE, "Change expected");
+	fail_if(ev->new != (struct nl_object *) cached,
+		"Cached object should be reported");
+	fail_if(netconf_val(ev->new, rtnl_netconf_get_forwarding) != 0 ||
+		netconf_val(ev->new, rtnl_netconf_get_rp_filter) != 2,
+		"Reported object should carry both changes");
+	fail_if(netconf_val(ev->old, rtnl_netconf_get_forwarding) != 1 ||
+		netconf_val(ev->old, rtnl_netconf_get_rp_filter) != 1,
+		"Old object should carry the state before the window");
+	fail_if(ev->diff != nl_object_diff64(ev->old, ev->new),
+		"Both attributes should be reported as changed");
+
+	rtnl_netconf_put(cached);
+	mngr_test_free(&t);
+}
+END_TEST
+
+START_TEST(coalesce_unhashed)
+{
+	struct nl_cache_mngr *mngr;
+	struct nl_cache *cache;
+	int err;
+
+	err = nl_cache_mngr_alloc(NULL, NETLINK_ROUTE, 0, &mngr);
+	nl_fail_if(err < 0, err, "Unable to allocate cache manager");
+
+	/* Multicast database entries provide no hash key */
+	err = nl_cache_alloc_name("route/mdb", &cache);
+	nl_fail_if(err < 0, err, "Unable to allocate mdb cache");
+	err = nl_cache_mngr_add_cache(mngr, cache, NULL, NULL);
+	nl_fail_if(err < 0, err, "Unable to add cache to manager");
+
+	err = nl_cache_mngr_set_coalesce(mngr, cache, 10, 0);
+	fail_if(err != -NLE_OPNOTSUPP,
+		"Coalescing should require a hash key");
+	err = nl_cache_mngr_set_coalesce(mngr, cache, 0, 0);
+	nl_fail_if(err < 0, err, "Disabling coalescing should succeed");
+
+	nl_cache_mngr_free(mngr);
+}
+END_TEST
+
+/* Number of events reported for the injected entry */
+static int test_events(struct mngr_test *t)
+{
+	struct nl_object *obj;
+	int i, ifindex, n = 0;
+
+	for (i = 0; i < t->nevents; i++) {
+		obj = t->events[i].new ? t->events[i].new : t->events[i].old;
+		if (rtnl_netconf_get_ifindex((struct rtnl_netconf *) obj,
+					     &ifindex) == 0 &&
+		    ifindex == TEST_IFINDEX)
+			n++;
+	}
+
+	return n;
+}
+
+/* Processes notifications until n events were reported or a timeout */
+static void wait_events(struct mngr_test *t, int n)
+{
+	struct pollfd fds = { .events = POLLIN };
+	int i;
+
+	for (i = 0; i < 100 && test_events(t) < n; i++) {
+		fds.fd = nl_cache_mngr_get_fd(t->mngr);
+		if (poll(&fds, 1, 100) > 0)
+			process(t);
+	}
+}
+
+START_TEST(overrun_discard)
+{
+	struct rtnl_netconf *nc;
+	struct mngr_test t;
+
+	mngr_test_init(&t);
+
+	/* Lost notifications are reported before the queued ones are read */
+	send_netconf(&t, 1, 1);
+	send_netconf(&t, 0, 1);
+	inject_overrun = 1;
+	process(&t);
+	fail_if(inject_overrun, "Overrun was not seen");
+
+	/* The entry only exists in notifications sent before the overrun */
+	nc = rtnl_netconf_get_by_idx(t.cache, AF_INET, TEST_IFINDEX);
+	fail_if(nc != NULL, "Queued notifications should be discarded");
+	fail_if(test_events(&t), "Discarded notifications were reported");
+	clear_events(&t);
+
+	send_netconf(&t, 1, 1);
+	process(&t);
+	fail_if(!test_events(&t),
+		"Notifications after the resync should be processed");
+
+	mngr_test_free(&t);
+}
+END_TEST
+
+START_TEST(dispatch)
+{
+	struct rtnl_netconf *nc;
+	struct nl_cache *mdb;
+	struct nl_msg *msg;
+	struct mngr_test t;
+	int err;
+
+	mngr_test_init(&t);
+
+	/* Added after the netconf cache */
+	err = nl_cache_alloc_name("route/mdb", &mdb);
+	nl_fail_if(err < 0, err, "Unable to allocate mdb cache");
+	err = nl_cache_mngr_add_cache(t.mngr, mdb, NULL, NULL);
+	nl_fail_if(err < 0, err, "Unable to add cache to manager");
+
+	send_netconf(&t, 1, 1);
+	process(&t);
+	fail_if(test_events(&t) != 1, "Notification should be dispatched");
+	nc = rtnl_netconf_get_by_idx(t.cache, AF_INET, TEST_IFINDEX);
+	fail_if(!nc, "Entry should be added to the netconf cache");
+	rtnl_netconf_put(nc);
+
+	/* Message types of caches not managed are skipped */
+	msg = nlmsg_alloc_simple(RTM_NEWNEIGH, 0);
+	fail_if(!msg || nlmsg_reserve(msg, sizeof(struct ndmsg),
+				      NLMSG_ALIGNTO) == NULL,
+		"Unable to build message");
+	err = nl_send_auto(t.tx, msg);
+	nl_fail_if(err < 0, err, "Unable to send message");
+	nlmsg_free(msg);
+	process(&t);
+	fail_if(t.nevents != 1, "Unmanaged message type was dispatched");
+
+	mngr_test_free(&t);
+}
+END_TEST
+
+START_TEST(thread_ring)
+{
+	struct rtnl_netconf *nc;
+	struct mngr_test t;
+	int i, err, val = -1;
+
+	mngr_test_init(&t);
+
+	fail_if(nl_cache_mngr_start_thread(t.mngr, UINT_MAX) != -NLE_INVAL,
+		"Oversized queue should be rejected");
+
+	/* A small ring makes the thread wait for the application */
+	err = nl_cache_mngr_start_thread(t.mngr, 4);
+	nl_fail_if(err < 0, err, "Unable to start thread");
+	fail_if(nl_cache_mngr_start_thread(t.mngr, 4) != -NLE_EXIST,
+		"Thread should only be started once");
+	fail_if(nl_cache_mngr_add(t.mngr, "route/link", NULL, NULL, NULL) !=
+		-NLE_BUSY, "Caches should not be added while running");
+
+	for (i = 0; i < 20; i++)
+		send_netconf(&t, i & 1, 1);
+	wait_events(&t, 20);
+	fail_if(test_events(&t) != 20, "All notifications should be reported");
+
+	nc = rtnl_netconf_get_by_idx(t.cache, AF_INET, TEST_IFINDEX);
+	fail_if(!nc, "Entry should be cached");
+	rtnl_netconf_get_forwarding(nc, &val);
+	fail_if(val != 1, "Latest notification should be applied last");
+	rtnl_netconf_put(nc);
+
+	nl_cache_mngr_stop_thread(t.mngr);
+	mngr_test_free(&t);
+}
+END_TEST
+
+START_TEST(thread_stop_drain)
+{
+	struct mngr_test t;
+	int i, err;
+
+	mngr_test_init(&t);
+
+	err = nl_cache_mngr_start_thread(t.mngr, 4);
+	nl_fail_if(err < 0, err, "Unable to start thread");
+
+	for (i = 0; i < 10; i++)
+		send_netconf(&t, i & 1, 1);
+
+	/* Whatever the thread read is delivered, the rest stays queued */
+	nl_cache_mngr_stop_thread(t.mngr);
+	fail_if(nl_cache_mngr_get_fd(t.mngr) != nl_socket_get_fd(t.sk),
+		"Manager should read from its socket again");
+
+	process(&t);
+	fail_if(test_events(&t) != 10, "All notifications should be reported");
+
+	mngr_test_free(&t);
+}
+END_TEST
+
+START_TEST(thread_overrun)
+{
+	struct pollfd fds = { .events = POLLIN };
+	struct rtnl_netconf *nc;
+	struct mngr_test t;
+	int err;
+
+	mngr_test_init(&t);
+
+	send_netconf(&t, 1, 1);
+	send_netconf(&t, 0, 1);
+	inject_overrun = 1;
+
+	err = nl_cache_mngr_start_thread(t.mngr, 0);
+	nl_fail_if(err < 0, err, "Unable to start thread");
+
+	/* The overrun is the first thing the thread queues */
+	fds.fd = nl_cache_mngr_get_fd(t.mngr);
+	fail_if(poll(&fds, 1, 1000) != 1, "Overrun should be queued");
+	process(&t);
+	fail_if(inject_overrun, "Overrun was not seen");
+	nc = rtnl_netconf_get_by_idx(t.cache, AF_INET, TEST_IFINDEX);
+	fail_if(nc != NULL, "Queued notifications should be discarded");
+	fail_if(test_events(&t), "Discarded notifications were reported");
+
+	/* The thread reads again once the caches are resynced */
+	send_netconf(&t, 1, 1);
+	wait_events(&t, 1);
+	fail_if(test_events(&t) != 1,
+		"Notifications after the resync should be processed");
+
+	nl_cache_mngr_stop_thread(t.mngr);
+	mngr_test_free(&t);
+}
+END_TEST
+
+Suite *make_nl_cache_mngr_suite(void)
+{
+	Suite *suite = suite_create("Cache manager");
+
+	TCase *tc_coalesce = tcase_create("Coalescing");
+	tcase_add_test(tc_coalesce, coalesce_merged);
+	tcase_add_test(tc_coalesce, coalesce_unhashed);
+	suite_add_tcase(suite, tc_coalesce);
+
+	TCase *tc_overrun = tcase_create("Overrun");
+	tcase_add_test(tc_overrun, overrun_discard);
+	suite_add_tcase(suite, tc_overrun);
+
+	TCase *tc_dispatch = tcase_create("Dispatch");
+	tcase_add_test(tc_dispatch, dispatch);
+	suite_add_tcase(suite, tc_dispatch);
+
+	TCase *tc_thread = tcase_create("Thread");
+	tcase_add_test(tc_thread, thread_ring);
+	tcase_add_test(tc_thread, thread_stop_drain);
+	tcase_add_test(tc_thread, thread_overrun);
+	suite_add_tcase(suite, tc_thread);
+
+	return suite;
+}
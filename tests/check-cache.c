@@ -0,0 +1,990 @@
+/*
+ * tests/check-cache.c		Cache and hashtable unit tests
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+#include <check.h>
+#include <netlink-private/types.h>
+#include <netlink-private/cache-api.h>
+#include <netlink-private/hashtable.h>
+#include <netlink-private/route/nexthop.h>
+#include <netlink/netlink.h>
+#include <netlink/object.h>
+#include <netlink/hashtable.h>
+#include <netlink/cache.h>
+#include <netlink/route/link.h>
+#include <netlink/route/neighbour.h>
+#include <netlink/route/route.h>
+#include <netlink/route/nexthop.h>
+#include <netlink/route/rule.h>
+#include <netlink/route/nh.h>
+#include <netlink/route/classifier.h>
+#include <netlink/route/netconf.h>
+#include <linux/if_ether.h>
+#include <linux/netconf.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "util.h"
+
+#define TEST_NLINKS	5000
+
+START_TEST(hashtable_resize)
+{
+	struct rtnl_link *links[TEST_NLINKS];
+	nl_hash_table_t *ht;
+	int i, pos, err;
+
+	ht = nl_hash_table_alloc(0);
+	fail_if(!ht, "Unable to allocate hashtable");
+	fail_if(ht->size != 0 || ht->nodes,
+		"Public head of the hashtable should be empty");
+	fail_if(nl_hash_table_priv(ht)->size != NL_MIN_HASH_ENTRIES,
+		"Empty hashtable should start with %d buckets",
+		NL_MIN_HASH_ENTRIES);
+
+	for (i = 0; i < TEST_NLINKS; i++) {
+		links[i] = rtnl_link_alloc();
+		fail_if(!links[i], "Unable to allocate link");
+		rtnl_link_set_ifindex(links[i], i + 1);
+		rtnl_link_set_family(links[i], AF_UNSPEC);
+
+		err = nl_hash_table_add(ht, OBJ_CAST(links[i]));
+		nl_fail_if(err < 0, err, "Unable to add link");
+
+		/* Lookups must not move entries of a pending resize */
+		pos = nl_hash_table_priv(ht)->rehash_pos;
+		fail_if(nl_hash_table_lookup(ht, OBJ_CAST(links[0])) !=
+			OBJ_CAST(links[0]), "Link 1 not found");
+		fail_if(nl_hash_table_priv(ht)->rehash_pos != pos,
+			"Lookup modified the hashtable");
+	}
+
+	fail_if(nl_hash_table_priv(ht)->size < TEST_NLINKS / 2,
+		"Hashtable of %d entries only has %d buckets",
+		TEST_NLINKS, nl_hash_table_priv(ht)->size);
+
+	for (i = 0; i < TEST_NLINKS; i++) {
+		fail_if(nl_hash_table_lookup(ht, OBJ_CAST(links[i])) !=
+			OBJ_CAST(links[i]), "Link %d not found", i + 1);
+		fail_if(nl_hash_table_add(ht, OBJ_CAST(links[i])) != -NLE_EXIST,
+			"Duplicate link %d accepted", i + 1);
+	}
+
+	for (i = 0; i < TEST_NLINKS; i++) {
+		err = nl_hash_table_del(ht, OBJ_CAST(links[i]));
+		nl_fail_if(err < 0, err, "Unable to delete link");
+		fail_if(nl_hash_table_lookup(ht, OBJ_CAST(links[i])),
+			"Deleted link %d still found", i + 1);
+	}
+
+	fail_if(nl_hash_table_priv(ht)->count != 0,
+		"Hashtable should be empty");
+	fail_if(nl_hash_table_priv(ht)->size > NL_MIN_HASH_ENTRIES * 2,
+		"Empty hashtable still has %d buckets",
+		nl_hash_table_priv(ht)->size);
+
+	nl_hash_table_free(ht);
+
+	for (i = 0; i < TEST_NLINKS; i++)
+		rtnl_link_put(links[i]);
+}
+END_TEST
+
+START_TEST(hashtable_cls_identity)
+{
+	struct rtnl_cls *cls[2];
+	nl_hash_table_t *ht;
+	int i, err;
+
+	ht = nl_hash_table_alloc(0);
+	fail_if(!ht, "Unable to allocate hashtable");
+
+	/* Same device, parent and handle, told apart by priority */
+	for (i = 0; i < 2; i++) {
+		cls[i] = rtnl_cls_alloc();
+		fail_if(!cls[i], "Unable to allocate classifier");
+		rtnl_tc_set_ifindex(TC_CAST(cls[i]), 1);
+		rtnl_tc_set_parent(TC_CAST(cls[i]), TC_H_ROOT);
+		rtnl_tc_set_handle(TC_CAST(cls[i]), 0x800);
+		rtnl_cls_set_protocol(cls[i], ETH_P_IP);
+		rtnl_cls_set_prio(cls[i], i + 1);
+
+		err = nl_hash_table_add(ht, OBJ_CAST(cls[i]));
+		nl_fail_if(err < 0, err, "Unable to add classifier");
+	}
+
+	for (i = 0; i < 2; i++)
+		fail_if(nl_hash_table_lookup(ht, OBJ_CAST(cls[i])) !=
+			OBJ_CAST(cls[i]), "Classifier %d not found", i);
+
+	nl_hash_table_free(ht);
+	rtnl_cls_put(cls[0]);
+	rtnl_cls_put(cls[1]);
+}
+END_TEST
+
+START_TEST(cache_search_partial)
+{
+	struct rtnl_rule *rule, *needle;
+	struct nl_object *obj;
+	struct nl_cache *cache;
+	int i, err;
+
+	err = nl_cache_alloc_name("route/rule", &cache);
+	nl_fail_if(err < 0, err, "Unable to allocate rule cache");
+
+	for (i = 0; i < 100; i++) {
+		rule = rtnl_rule_alloc();
+		fail_if(!rule, "Unable to allocate rule");
+		rtnl_rule_set_family(rule, AF_INET);
+		rtnl_rule_set_prio(rule, i);
+		rtnl_rule_set_table(rule, 1000 + i);
+
+		err = nl_cache_add(cache, OBJ_CAST(rule));
+		nl_fail_if(err < 0, err, "Unable to add rule");
+		rtnl_rule_put(rule);
+	}
+
+	/* Priority is hashed, a needle without it must still match */
+	needle = rtnl_rule_alloc();
+	fail_if(!needle, "Unable to allocate rule");
+	rtnl_rule_set_family(needle, AF_INET);
+	rtnl_rule_set_table(needle, 1042);
+
+	obj = nl_cache_search(cache, OBJ_CAST(needle));
+	fail_if(!obj, "Rule without priority in needle not found");
+	fail_if(rtnl_rule_get_prio((struct rtnl_rule *) obj) != 42,
+		"Wrong rule found");
+	nl_object_put(obj);
+
+	rtnl_rule_set_prio(needle, 42);
+	obj = nl_cache_search(cache, OBJ_CAST(needle));
+	fail_if(!obj, "Rule not found by hash lookup");
+	nl_object_put(obj);
+
+	rtnl_rule_set_prio(needle, 43);
+	fail_if(nl_cache_search(cache, OBJ_CAST(needle)),
+		"Rule of different priority matched");
+
+	rtnl_rule_put(needle);
+	nl_cache_free(cache);
+}
+END_TEST
+
+#define TEST_NNEIGHS	1000
+#define TEST_NDEVS	10
+
+static void count_cb(struct nl_object *obj, void *arg)
+{
+	int *count = arg;
+
+	fail_if(rtnl_neigh_get_ifindex((struct rtnl_neigh *) obj) != 3,
+		"Neighbour of wrong device matched filter");
+	(*count)++;
+}
+
+static struct rtnl_neigh *alloc_neigh(int i)
+{
+	struct rtnl_neigh *neigh;
+	struct nl_addr *dst;
+	uint32_t ip = htonl(0x0a000000 + i);
+
+	neigh = rtnl_neigh_alloc();
+	fail_if(!neigh, "Unable to allocate neighbour");
+	dst = nl_addr_build(AF_INET, &ip, sizeof(ip));
+	fail_if(!dst, "Unable to allocate address");
+
+	rtnl_neigh_set_family(neigh, AF_INET);
+	rtnl_neigh_set_ifindex(neigh, i % TEST_NDEVS);
+	rtnl_neigh_set_dst(neigh, dst);
+	nl_addr_put(dst);
+
+	return neigh;
+}
+
+static struct rtnl_link *add_link(struct nl_cache *cache, int ifindex,
+				  int family, const char *name)
+{
+	struct rtnl_link *link;
+	int err;
+
+	link = rtnl_link_alloc();
+	fail_if(!link, "Unable to allocate link");
+	rtnl_link_set_ifindex(link, ifindex);
+	rtnl_link_set_family(link, family);
+	rtnl_link_set_name(link, name);
+
+	err = nl_cache_add(cache, OBJ_CAST(link));
+	nl_fail_if(err < 0, err, "Unable to add link");
+	rtnl_link_put(link);
+
+	return link;
+}
+
+static void check_link(struct nl_cache *cache, int ifindex,
+		       const char *name, struct rtnl_link *expected)
+{
+	struct rtnl_link *link;
+
+	link = rtnl_link_get(cache, ifindex);
+	fail_if(link != expected, "Wrong link for ifindex %d", ifindex);
+	rtnl_link_put(link);
+
+	link = rtnl_link_get_by_name(cache, name);
+	fail_if(link != expected, "Wrong link for name %s", name);
+	rtnl_link_put(link);
+}
+
+START_TEST(link_index)
+{
+	struct rtnl_link *links[TEST_NDEVS * 10], *bridge, *big;
+	struct nl_cache *cache;
+	char name[IFNAMSIZ];
+	int i, err;
+
+	err = nl_cache_alloc_name("route/link", &cache);
+	nl_fail_if(err < 0, err, "Unable to allocate link cache");
+
+	for (i = 0; i < TEST_NDEVS * 10; i++) {
+		snprintf(name, sizeof(name), "dev%d", i + 1);
+		links[i] = add_link(cache, i + 1, AF_UNSPEC, name);
+	}
+
+	/* Same ifindex in another family, first link in cache order wins */
+	bridge = add_link(cache, 5, AF_BRIDGE, "br5");
+	/* Too large for the ifindex array */
+	big = add_link(cache, 1 << 24, AF_UNSPEC, "big");
+
+	for (i = 0; i < TEST_NDEVS * 10; i++) {
+		snprintf(name, sizeof(name), "dev%d", i + 1);
+		check_link(cache, i + 1, name, links[i]);
+	}
+	check_link(cache, 1 << 24, "big", big);
+	fail_if(rtnl_link_get(cache, 1 << 23), "Unknown ifindex found");
+	fail_if(rtnl_link_get_by_name(cache, "dev0"), "Unknown name found");
+
+	nl_cache_remove(OBJ_CAST(links[4]));
+	check_link(cache, 5, "br5", bridge);
+	fail_if(rtnl_link_get_by_name(cache, "dev5"), "Removed link found");
+
+	/* Renaming a cached link moves it in the name index */
+	rtnl_link_set_name(links[6], "renamed");
+	check_link(cache, 7, "renamed", links[6]);
+	fail_if(rtnl_link_get_by_name(cache, "dev7"),
+		"Link found by its old name");
+
+	/* Changing the ifindex of a cached link moves it in the ifindex
+	 * index, also onto an ifindex already taken */
+	rtnl_link_set_ifindex(links[7], TEST_NDEVS * 10 + 1);
+	check_link(cache, TEST_NDEVS * 10 + 1, "dev8", links[7]);
+	fail_if(rtnl_link_get(cache, 8), "Link found by its old ifindex");
+	fail_if(nl_cache_search(cache, OBJ_CAST(links[7])) != OBJ_CAST(links[7]),
+		"Link not found by its new hash key");
+	rtnl_link_put(links[7]);
+
+	rtnl_link_set_ifindex(links[8], 10);
+	check_link(cache, 10, "dev10", links[9]);
+	fail_if(rtnl_link_get(cache, 9), "Link found by its old ifindex");
+
+	nl_cache_remove(OBJ_CAST(links[7]));
+	fail_if(rtnl_link_get(cache, TEST_NDEVS * 10 + 1), "Removed link found");
+	nl_cache_remove(OBJ_CAST(links[9]));
+	check_link(cache, 10, "dev9", links[8]);
+	nl_cache_remove(OBJ_CAST(links[8]));
+	fail_if(rtnl_link_get(cache, 9), "Link found by its old ifindex");
+	fail_if(rtnl_link_get(cache, 10), "Removed link found");
+
+	nl_cache_remove(OBJ_CAST(big));
+	fail_if(rtnl_link_get(cache, 1 << 24), "Removed link found");
+
+	nl_cache_free(cache);
+}
+END_TEST
+
+START_TEST(cache_index)
+{
+	struct rtnl_neigh *neigh, *filter;
+	struct nl_object *obj;
+	struct nl_cache *cache;
+	uint64_t attrs;
+	int i, count, err;
+
+	err = nl_cache_alloc_name("route/neigh", &cache);
+	nl_fail_if(err < 0, err, "Unable to allocate neighbour cache");
+
+	filter = rtnl_neigh_alloc();
+	fail_if(!filter, "Unable to allocate filter");
+	rtnl_neigh_set_ifindex(filter, 3);
+
+	/* Half of the objects exist before the index is added */
+	for (i = 0; i < TEST_NNEIGHS; i++) {
+		if (i == TEST_NNEIGHS / 2) {
+			attrs = nl_object_get_attrs(OBJ_CAST(filter));
+			err = nl_cache_add_index(cache, attrs);
+			nl_fail_if(err < 0, err, "Unable to add index");
+			fail_if(nl_cache_add_index(cache, attrs) != -NLE_EXIST,
+				"Duplicate index accepted");
+		}
+
+		neigh = alloc_neigh(i);
+		err = nl_cache_add(cache, OBJ_CAST(neigh));
+		nl_fail_if(err < 0, err, "Unable to add neighbour");
+		rtnl_neigh_put(neigh);
+	}
+
+	count = 0;
+	nl_cache_foreach_filter(cache, OBJ_CAST(filter), count_cb, &count);
+	fail_if(count != TEST_NNEIGHS / TEST_NDEVS,
+		"Found %d neighbours of device 3", count);
+
+	/* Remove every other neighbour of device 3 */
+	for (i = 3; i < TEST_NNEIGHS; i += 2 * TEST_NDEVS) {
+		neigh = alloc_neigh(i);
+		obj = nl_cache_search(cache, OBJ_CAST(neigh));
+		fail_if(!obj, "Neighbour %d not found", i);
+		nl_cache_remove(obj);
+		nl_object_put(obj);
+		rtnl_neigh_put(neigh);
+	}
+
+	count = 0;
+	nl_cache_foreach_filter(cache, OBJ_CAST(filter), count_cb, &count);
+	fail_if(count != TEST_NNEIGHS / TEST_NDEVS / 2,
+		"Found %d neighbours of device 3 after removal", count);
+
+	obj = nl_cache_find(cache, OBJ_CAST(filter));
+	fail_if(!obj, "No neighbour of device 3 found");
+	fail_if(rtnl_neigh_get_ifindex((struct rtnl_neigh *) obj) != 3,
+		"Found neighbour of wrong device");
+	nl_object_put(obj);
+
+	rtnl_neigh_set_ifindex(filter, TEST_NDEVS);
+	fail_if(nl_cache_find(cache, OBJ_CAST(filter)),
+		"Found neighbour of unknown device");
+
+	rtnl_neigh_put(filter);
+	nl_cache_free(cache);
+}
+END_TEST
+
+static struct rtnl_route *add_route(struct nl_cache *cache, const char *dst,
+				    uint32_t table, uint32_t prio)
+{
+	struct rtnl_route *route;
+	struct nl_addr *addr;
+	int err;
+
+	route = rtnl_route_alloc();
+	fail_if(!route, "Unable to allocate route");
+	err = nl_addr_parse(dst, AF_INET, &addr);
+	nl_fail_if(err < 0, err, "Unable to parse address");
+
+	rtnl_route_set_family(route, AF_INET);
+	rtnl_route_set_table(route, table);
+	rtnl_route_set_dst(route, addr);
+	rtnl_route_set_priority(route, prio);
+	nl_addr_put(addr);
+
+	err = nl_cache_add(cache, OBJ_CAST(route));
+	nl_fail_if(err < 0, err, "Unable to add route");
+
+	return route;
+}
+
+static struct rtnl_route *lpm(struct nl_cache *cache, uint32_t table,
+			      const char *dst)
+{
+	struct rtnl_route *route;
+	struct nl_addr *addr;
+	int err;
+
+	err = nl_addr_parse(dst, AF_INET, &addr);
+	nl_fail_if(err < 0, err, "Unable to parse address");
+
+	route = rtnl_route_cache_lpm(cache, table, addr);
+	nl_addr_put(addr);
+
+	/* The cache still holds a reference */
+	if (route)
+		rtnl_route_put(route);
+
+	return route;
+}
+
+START_TEST(route_lpm)
+{
+	struct rtnl_route *def, *net8, *net16, *net16_pref, *net24;
+	struct nl_cache *cache;
+	int err;
+
+	err = nl_cache_alloc_name("route/route", &cache);
+	nl_fail_if(err < 0, err, "Unable to allocate route cache");
+
+	def = add_route(cache, "default", RT_TABLE_MAIN, 0);
+	net16 = add_route(cache, "10.1.0.0/16", RT_TABLE_MAIN, 20);
+	net24 = add_route(cache, "10.1.2.0/24", 100, 0);
+
+	fail_if(lpm(cache, RT_TABLE_MAIN, "10.1.2.3") != net16,
+		"10.1.2.3 should use 10.1.0.0/16");
+	fail_if(lpm(cache, 100, "10.1.2.3") != net24,
+		"10.1.2.3 should use 10.1.2.0/24 in table 100");
+	fail_if(lpm(cache, 100, "10.1.3.1"),
+		"Table 100 has no route to 10.1.3.1");
+
+	/* Routes added after the first lookup */
+	net8 = add_route(cache, "10.0.0.0/8", RT_TABLE_MAIN, 0);
+	net16_pref = add_route(cache, "10.1.0.0/16", RT_TABLE_MAIN, 10);
+
+	fail_if(lpm(cache, RT_TABLE_MAIN, "10.1.2.3") != net16_pref,
+		"10.1.2.3 should use 10.1.0.0/16 with the lowest priority");
+	fail_if(lpm(cache, RT_TABLE_MAIN, "10.2.0.1") != net8,
+		"10.2.0.1 should use 10.0.0.0/8");
+	fail_if(lpm(cache, RT_TABLE_MAIN, "192.0.2.1") != def,
+		"192.0.2.1 should use the default route");
+
+	nl_cache_remove(OBJ_CAST(net16_pref));
+	fail_if(lpm(cache, RT_TABLE_MAIN, "10.1.2.3") != net16,
+		"10.1.2.3 should fall back to the other 10.1.0.0/16");
+	nl_cache_remove(OBJ_CAST(net16));
+	fail_if(lpm(cache, RT_TABLE_MAIN, "10.1.2.3") != net8,
+		"10.1.2.3 should fall back to 10.0.0.0/8");
+
+	rtnl_route_put(def);
+	rtnl_route_put(net8);
+	rtnl_route_put(net16);
+	rtnl_route_put(net16_pref);
+	rtnl_route_put(net24);
+	nl_cache_free(cache);
+}
+END_TEST
+
+#define TEST_NNEXTHOPS	3
+#define TEST_NH_ATTRS	(NH_ATTR_IFINDEX | NH_ATTR_GATEWAY | NH_ATTR_WEIGHT)
+
+static struct rtnl_route *alloc_multipath_route(void)
+{
+	struct rtnl_route *route;
+	struct rtnl_nexthop *nh;
+	struct nl_addr *addr;
+	char buf[32];
+	int i, err;
+
+	route = rtnl_route_alloc();
+	fail_if(!route, "Unable to allocate route");
+	err = nl_addr_parse("10.2.0.0/16", AF_INET, &addr);
+	nl_fail_if(err < 0, err, "Unable to parse address");
+	rtnl_route_set_family(route, AF_INET);
+	rtnl_route_set_table(route, RT_TABLE_MAIN);
+	rtnl_route_set_dst(route, addr);
+	nl_addr_put(addr);
+
+	for (i = 0; i < TEST_NNEXTHOPS; i++) {
+		nh = rtnl_route_nh_alloc();
+		fail_if(!nh, "Unable to allocate nexthop");
+		snprintf(buf, sizeof(buf), "192.0.2.%d", i + 1);
+		err = nl_addr_parse(buf, AF_INET, &addr);
+		nl_fail_if(err < 0, err, "Unable to parse address");
+
+		rtnl_route_nh_set_ifindex(nh, i + 1);
+		rtnl_route_nh_set_weight(nh, i);
+		rtnl_route_nh_set_gateway(nh, addr);
+		fail_if(rtnl_route_nh_get_gateway(nh) != addr,
+			"Gateway should be the address set");
+		nl_addr_put(addr);
+
+		rtnl_route_add_nexthop(route, nh);
+	}
+
+	return route;
+}
+
+/* Round trip through a RTM_NEWROUTE message */
+static struct rtnl_route *reparse_route(struct rtnl_route *route)
+{
+	struct rtnl_route *parsed;
+	struct nl_msg *msg;
+	int err;
+
+	err = rtnl_route_build_add_request(route, 0, &msg);
+	nl_fail_if(err < 0, err, "Unable to build route message");
+	err = rtnl_route_parse(nlmsg_hdr(msg), &parsed);
+	nl_fail_if(err < 0, err, "Unable to parse route message");
+	nlmsg_free(msg);
+
+	return parsed;
+}
+
+START_TEST(route_nexthops)
+{
+	struct rtnl_route *route, *parsed, *clone, *other;
+	struct rtnl_nexthop *nh;
+	char buf[32];
+	int i;
+
+	route = alloc_multipath_route();
+	parsed = reparse_route(route);
+
+	fail_if(rtnl_route_get_nnexthops(parsed) != TEST_NNEXTHOPS,
+		"Parsed route should have %d nexthops", TEST_NNEXTHOPS);
+	for (i = 0; i < TEST_NNEXTHOPS; i++) {
+		fail_if(rtnl_route_nh_compare(rtnl_route_nexthop_n(route, i),
+					      rtnl_route_nexthop_n(parsed, i),
+					      TEST_NH_ATTRS, 0),
+			"Parsed nexthop %d differs", i);
+	}
+
+	clone = (struct rtnl_route *) nl_object_clone(OBJ_CAST(parsed));
+	fail_if(!clone, "Unable to clone route");
+	fail_if(nl_object_diff(OBJ_CAST(parsed), OBJ_CAST(clone)),
+		"Clone should not differ");
+	rtnl_route_nh_set_ifindex(rtnl_route_nexthop_n(clone, 1), 42);
+	fail_if(!nl_object_diff(OBJ_CAST(parsed), OBJ_CAST(clone)),
+		"Clone with a different nexthop should differ");
+	rtnl_route_put(clone);
+
+	/* A parsed nexthop outlives its route once removed from it */
+	nh = rtnl_route_nexthop_n(parsed, 1);
+	rtnl_route_remove_nexthop(parsed, nh);
+	fail_if(rtnl_route_nh_get_ifindex(rtnl_route_nexthop_n(parsed, 1)) != 3,
+		"Nexthops should move up after a removal");
+
+	other = rtnl_route_alloc();
+	fail_if(!other, "Unable to allocate route");
+	rtnl_route_add_nexthop(other, nh);
+	rtnl_route_put(parsed);
+
+	fail_if(rtnl_route_nexthop_n(other, 0) != nh, "Nexthop not added");
+	fail_if(rtnl_route_nh_get_ifindex(nh) != 2, "Nexthop was modified");
+	nl_addr2str(rtnl_route_nh_get_gateway(nh), buf, sizeof(buf));
+	fail_if(strcmp(buf, "192.0.2.2/32"), "Gateway should be kept");
+
+	rtnl_route_put(other);
+	rtnl_route_put(route);
+}
+END_TEST
+
+START_TEST(nh_group_parse)
+{
+	struct nl_cache *cache;
+	struct rtnl_nh *nh, *res;
+	struct nl_msg *msg;
+	unsigned int weight;
+	uint32_t id;
+
+	nl_fail_if(nl_cache_alloc_name("route/nh", &cache) < 0,
+		   NLE_NOMEM, "Unable to allocate nexthop cache");
+
+	nh = rtnl_nh_alloc();
+	rtnl_nh_set_id(nh, 100);
+	fail_if(rtnl_nh_add_group_entry(nh, 1, 0) != -NLE_INVAL,
+		"Weight 0 should be rejected");
+	fail_if(rtnl_nh_add_group_entry(nh, 1, 1) < 0 ||
+		rtnl_nh_add_group_entry(nh, 2, 256) < 0,
+		"Unable to add group members");
+	rtnl_nh_set_group_type(nh, 1);
+	rtnl_nh_set_res_buckets(nh, 64);
+
+	fail_if(rtnl_nh_build_add_request(nh, 0, &msg) < 0,
+		"Unable to build request");
+	fail_if(nl_cache_parse_and_add(cache, msg) < 0,
+		"Unable to parse request");
+	nlmsg_free(msg);
+
+	res = rtnl_nh_get(cache, 100);
+	fail_if(!res, "Nexthop group not found by id");
+	fail_if(!nl_object_match_filter(OBJ_CAST(res), OBJ_CAST(nh)),
+		"Parsed nexthop group differs");
+	fail_if(rtnl_nh_get_group_size(res) != 2 ||
+		rtnl_nh_get_group_entry(res, 1, &id, &weight) < 0 ||
+		id != 2 || weight != 256,
+		"Group member was not preserved");
+	fail_if(rtnl_nh_get_group_entry(res, 2, NULL, NULL) != -NLE_RANGE,
+		"Out of range member should fail");
+
+	rtnl_nh_put(res);
+	rtnl_nh_put(nh);
+	nl_cache_free(cache);
+}
+END_TEST
+
+static struct nl_cache_ops dup_link_ops = {
+	.co_name		= "test/link",
+	.co_protocol		= NETLINK_ROUTE,
+	.co_msgtypes		= {
+		{ RTM_NEWLINK, NL_ACT_NEW, "new" },
+		END_OF_MSGTYPES_LIST,
+	},
+};
+
+static struct nl_cache_ops unresolved_ops = {
+	.co_name		= "test/genl",
+	.co_protocol		= NETLINK_GENERIC,
+	.co_msgtypes		= {
+		{ 0x7ff0, NL_ACT_UNSPEC, "test" },
+		END_OF_MSGTYPES_LIST,
+	},
+};
+
+static void check_associate(struct nl_cache_ops *ops, void *arg)
+{
+	struct nl_cache_ops *res;
+	int i;
+
+	for (i = 0; ops->co_msgtypes[i].mt_id >= 0; i++) {
+		res = nl_cache_ops_associate(ops->co_protocol,
+					     ops->co_msgtypes[i].mt_id);
+		fail_if(!res || res->co_protocol != ops->co_protocol ||
+			!nl_msgtype_lookup(res, ops->co_msgtypes[i].mt_id),
+			"Message type %d of %s not associated",
+			ops->co_msgtypes[i].mt_id, ops->co_name);
+	}
+}
+
+START_TEST(cache_ops_associate)
+{
+	struct nl_cache_ops *link_ops, *newlink, *dellink;
+
+	nl_cache_ops_foreach(check_associate, NULL);
+
+	link_ops = nl_cache_ops_lookup("route/link");
+	fail_if(!link_ops, "route/link not registered");
+	dup_link_ops.co_obj_ops = link_ops->co_obj_ops;
+
+	newlink = nl_cache_ops_associate(NETLINK_ROUTE, RTM_NEWLINK);
+	dellink = nl_cache_ops_associate(NETLINK_ROUTE, RTM_DELLINK);
+	fail_if(!newlink || !dellink, "Link message types not associated");
+	fail_if(nl_cache_ops_associate(NETLINK_ROUTE, 0xfff) != NULL,
+		"Unknown message type should not be associated");
+	fail_if(nl_cache_ops_associate(NETLINK_GENERIC, RTM_NEWLINK) ==
+		newlink, "Protocol should be part of the association");
+
+	/* Latest registration takes precedence, as with the list walk */
+	fail_if(nl_cache_mngt_register(&dup_link_ops) < 0,
+		"Unable to register cache operations");
+	fail_if(nl_cache_ops_associate(NETLINK_ROUTE, RTM_NEWLINK) !=
+		&dup_link_ops, "RTM_NEWLINK should map to latest registration");
+	fail_if(nl_cache_ops_associate(NETLINK_ROUTE, RTM_DELLINK) != dellink,
+		"RTM_DELLINK association should be unchanged");
+
+	fail_if(nl_cache_mngt_unregister(&dup_link_ops) < 0,
+		"Unable to unregister cache operations");
+	fail_if(nl_cache_ops_associate(NETLINK_ROUTE, RTM_NEWLINK) != newlink,
+		"RTM_NEWLINK association should be restored");
+}
+END_TEST
+
+START_TEST(cache_ops_resolve)
+{
+	struct nl_cache_ops *link_ops;
+
+	link_ops = nl_cache_ops_lookup("route/link");
+	fail_if(!link_ops, "route/link not registered");
+	unresolved_ops.co_obj_ops = link_ops->co_obj_ops;
+
+	fail_if(nl_cache_mngt_register(&unresolved_ops) < 0,
+		"Unable to register cache operations");
+	fail_if(nl_cache_ops_associate(NETLINK_GENERIC, 0x7ff0) !=
+		&unresolved_ops, "Message type should be associated");
+
+	/* As done by genl_resolve_id() after registration */
+	unresolved_ops.co_msgtypes[0].mt_id = 0x7ff1;
+	fail_if(nl_cache_ops_associate(NETLINK_GENERIC, 0x7ff1) !=
+		&unresolved_ops, "Resolved message type should be associated");
+
+	fail_if(nl_cache_mngt_unregister(&unresolved_ops) < 0,
+		"Unable to unregister cache operations");
+	fail_if(nl_cache_ops_associate(NETLINK_GENERIC, 0x7ff1) != NULL,
+		"Message type should not be associated after unregistering");
+}
+END_TEST
+
+static void include_obj_cb(struct nl_object *obj, void *arg)
+{
+	struct nl_cache *cache = arg;
+
+	nl_cache_include(cache, obj, NULL, NULL);
+}
+
+static struct nl_msg *netconf_msg(int ifindex, int forwarding)
+{
+	struct netconfmsg ncm = { .ncm_family = AF_INET };
+	struct nl_msg *msg;
+
+	msg = nlmsg_alloc_simple(RTM_NEWNETCONF, 0);
+	fail_if(!msg, "Unable to allocate message");
+	nlmsg_set_proto(msg, NETLINK_ROUTE);
+
+	fail_if(nlmsg_append(msg, &ncm, sizeof(ncm), NLMSG_ALIGNTO) < 0 ||
+		nla_put_s32(msg, NETCONFA_IFINDEX, ifindex) < 0 ||
+		(forwarding >= 0 &&
+		 nla_put_s32(msg, NETCONFA_FORWARDING, forwarding) < 0),
+		"Unable to build netconf message");
+
+	return msg;
+}
+
+static int netconf_forwarding(struct nl_cache *cache, int ifindex,
+			      struct rtnl_netconf **nc)
+{
+	int val = -1;
+
+	*nc = rtnl_netconf_get_by_idx(cache, AF_INET, ifindex);
+	fail_if(!*nc, "Netconf entry %d not cached", ifindex);
+	rtnl_netconf_put(*nc);
+	rtnl_netconf_get_forwarding(*nc, &val);
+
+	return val;
+}
+
+static void netconf_include(struct nl_cache *cache, int ifindex,
+			    int forwarding)
+{
+	struct nl_msg *msg = netconf_msg(ifindex, forwarding);
+	int err;
+
+	err = nl_msg_parse(msg, include_obj_cb, cache);
+	nl_fail_if(err < 0, err, "Unable to parse netconf message");
+	nlmsg_free(msg);
+}
+
+START_TEST(netconf_merge)
+{
+	struct rtnl_netconf *nc, *merged;
+	struct nl_cache *cache;
+	int err;
+
+	err = nl_cache_alloc_name("route/netconf", &cache);
+	nl_fail_if(err < 0, err, "Unable to allocate netconf cache");
+
+	netconf_include(cache, 2, 1);
+	fail_if(nl_cache_nitems(cache) != 1, "Netconf entry not added");
+	fail_if(netconf_forwarding(cache, 2, &nc) != 1,
+		"Forwarding should be set");
+
+	/* A notification without values merges as a no-op */
+	netconf_include(cache, 2, -1);
+	fail_if(nl_cache_nitems(cache) != 1,
+		"Netconf entry should not be duplicated");
+	fail_if(netconf_forwarding(cache, 2, &merged) != 1,
+		"Forwarding should survive an empty notification");
+	fail_if(merged != nc, "Empty notification replaced the entry");
+
+	netconf_include(cache, 2, 0);
+	fail_if(netconf_forwarding(cache, 2, &merged) != 0,
+		"Forwarding should be updated");
+	fail_if(merged != nc, "Notification replaced the entry");
+
+	nl_cache_free(cache);
+}
+END_TEST
+
+#define TEST_FILTER_TABLE	100
+#define TEST_FILTER_IFINDEX	7
+
+/* Last request sent through the socket */
+static unsigned char filter_req[256];
+
+static int filter_send(struct nl_sock *sk, struct nl_msg *msg)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+
+	fail_if(nlh->nlmsg_len > sizeof(filter_req), "Request too large");
+	memcpy(filter_req, nlh, nlh->nlmsg_len);
+
+	return nlh->nlmsg_len;
+}
+
+static struct rtnl_route *filter_route(uint32_t table)
+{
+	struct rtnl_route *route;
+	struct rtnl_nexthop *nh;
+	struct nl_addr *dst;
+
+	route = rtnl_route_alloc();
+	fail_if(!route, "Unable to allocate route");
+	fail_if(nl_addr_parse("10.0.0.0/24", AF_INET, &dst) < 0,
+		"Unable to parse address");
+	rtnl_route_set_dst(route, dst);
+	nl_addr_put(dst);
+	rtnl_route_set_table(route, table);
+	rtnl_route_set_protocol(route, RTPROT_STATIC);
+
+	nh = rtnl_route_nh_alloc();
+	fail_if(!nh, "Unable to allocate nexthop");
+	rtnl_route_nh_set_ifindex(nh, TEST_FILTER_IFINDEX);
+	rtnl_route_add_nexthop(route, nh);
+
+	return route;
+}
+
+/*
+ * Fake dump answering a full route dump with one route in the table of
+ * the filter and one route in another table.
+ */
+static int filter_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+		       unsigned char **buf, struct ucred **creds)
+{
+	uint32_t tables[] = { TEST_FILTER_TABLE, TEST_FILTER_TABLE + 1 };
+	struct nlmsghdr *nlh;
+	unsigned char *data;
+	int i, len = 0;
+
+	data = calloc(1, getpagesize());
+	fail_if(!data, "Unable to allocate dump");
+
+	for (i = 0; i < 2; i++) {
+		struct rtnl_route *route = filter_route(tables[i]);
+		struct nl_msg *msg;
+
+		fail_if(rtnl_route_build_add_request(route, 0, &msg) < 0,
+			"Unable to build route message");
+		nlh = nlmsg_hdr(msg);
+		nlh->nlmsg_type = RTM_NEWROUTE;
+		nlh->nlmsg_flags = NLM_F_MULTI;
+		memcpy(data + len, nlh, nlh->nlmsg_len);
+		len += NLMSG_ALIGN(nlh->nlmsg_len);
+		nlmsg_free(msg);
+		rtnl_route_put(route);
+	}
+
+	nlh = (struct nlmsghdr *) (data + len);
+	nlh->nlmsg_len = NLMSG_LENGTH(sizeof(int));
+	nlh->nlmsg_type = NLMSG_DONE;
+	nlh->nlmsg_flags = NLM_F_MULTI;
+	len += NLMSG_ALIGN(nlh->nlmsg_len);
+
+	*buf = data;
+
+	return len;
+}
+
+START_TEST(dump_filter_request)
+{
+	struct nlmsghdr *nlh = (struct nlmsghdr *) filter_req;
+	struct nlattr *tb[RTA_MAX + 1];
+	struct rtnl_route *filter;
+	struct nl_cache *cache;
+	struct nl_sock *sk;
+	struct rtmsg *rtm;
+	struct nl_cb *cb;
+	int err, fd, nlfd;
+
+	sk = nl_socket_alloc();
+	fail_if(!sk, "Unable to allocate socket");
+	err = nl_connect(sk, NETLINK_ROUTE);
+	nl_fail_if(err < 0, err, "Unable to connect socket");
+	nl_socket_disable_seq_check(sk);
+
+	cb = nl_socket_get_cb(sk);
+	nl_cb_overwrite_send(cb, filter_send);
+	nl_cb_overwrite_recv(cb, filter_recv);
+	nl_cb_put(cb);
+
+	err = nl_cache_alloc_name("route/route", &cache);
+	nl_fail_if(err < 0, err, "Unable to allocate route cache");
+
+	filter = filter_route(TEST_FILTER_TABLE);
+	rtnl_route_set_family(filter, AF_INET);
+	nl_cache_set_dump_filter(cache, OBJ_CAST(filter));
+
+	/* With strict checking, the filter is passed on to the kernel */
+	err = nl_socket_set_strict_chk(sk, 1);
+	nl_fail_if(err < 0, err, "Unable to enable strict checking");
+	err = cache->c_ops->co_request_update(cache, sk);
+	nl_fail_if(err < 0, err, "Unable to send dump request");
+
+	fail_if(nlh->nlmsg_type != RTM_GETROUTE ||
+		!(nlh->nlmsg_flags & NLM_F_DUMP), "Not a route dump request");
+	err = nlmsg_parse(nlh, sizeof(*rtm), tb, RTA_MAX, NULL);
+	nl_fail_if(err < 0, err, "Unable to parse dump request");
+	rtm = nlmsg_data(nlh);
+	fail_if(rtm->rtm_family != AF_INET, "Family not filtered");
+	fail_if(rtm->rtm_protocol != RTPROT_STATIC, "Protocol not filtered");
+	fail_if(rtm->rtm_dst_len || rtm->rtm_src_len || rtm->rtm_tos ||
+		rtm->rtm_scope, "Header fields must be zero");
+	fail_if(!tb[RTA_TABLE] || nla_get_u32(tb[RTA_TABLE]) != TEST_FILTER_TABLE,
+		"Table not filtered");
+	fail_if(!tb[RTA_OIF] || nla_get_u32(tb[RTA_OIF]) != TEST_FILTER_IFINDEX,
+		"Outgoing interface not filtered");
+	fail_if(tb[RTA_DST] != NULL, "Unsupported filter attribute sent");
+
+	err = nl_socket_set_strict_chk(sk, 0);
+	nl_fail_if(err < 0, err, "Unable to disable strict checking");
+
+	/* Simulate a kernel rejecting NETLINK_GET_STRICT_CHK */
+	fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+	fail_if(fd < 0, "Unable to create socket");
+	nlfd = sk->s_fd;
+	sk->s_fd = fd;
+	fail_if(nl_socket_set_strict_chk(sk, 1) >= 0,
+		"Rejected strict checking reported as enabled");
+	sk->s_fd = nlfd;
+	close(fd);
+
+	/* so a full dump is requested and filtered in user space */
+	err = nl_cache_refill(sk, cache);
+	nl_fail_if(err < 0, err, "Unable to refill cache");
+
+	fail_if(nlh->nlmsg_type != RTM_GETROUTE ||
+		!(nlh->nlmsg_flags & NLM_F_DUMP), "Not a route dump request");
+	fail_if(nlh->nlmsg_len != nlmsg_total_size(sizeof(*rtm)),
+		"Filter attributes sent without strict checking");
+	rtm = nlmsg_data(nlh);
+	fail_if(rtm->rtm_family || rtm->rtm_protocol,
+		"Filter header fields sent without strict checking");
+
+	fail_if(nl_cache_nitems(cache) != 1,
+		"Expected 1 route matching the filter, got %d",
+		nl_cache_nitems(cache));
+	fail_if(rtnl_route_get_table((struct rtnl_route *) nl_cache_get_first(cache)) !=
+		TEST_FILTER_TABLE, "Route not matching the filter cached");
+
+	rtnl_route_put(filter);
+	nl_cache_free(cache);
+	nl_socket_free(sk);
+}
+END_TEST
+
+Suite *make_nl_cache_suite(void)
+{
+	Suite *suite = suite_create("Caches");
+
+	TCase *tc_hash = tcase_create("Hashtable");
+	tcase_add_test(tc_hash, hashtable_resize);
+	tcase_add_test(tc_hash, hashtable_cls_identity);
+	tcase_add_test(tc_hash, cache_search_partial);
+	suite_add_tcase(suite, tc_hash);
+
+	TCase *tc_ops = tcase_create("Cache operations");
+	tcase_add_test(tc_ops, cache_ops_associate);
+	tcase_add_test(tc_ops, cache_ops_resolve);
+	suite_add_tcase(suite, tc_ops);
+
+	TCase *tc_index = tcase_create("Index");
+	tcase_add_test(tc_index, cache_index);
+	tcase_add_test(tc_index, link_index);
+	tcase_add_test(tc_index, route_lpm);
+	suite_add_tcase(suite, tc_index);
+
+	TCase *tc_nh = tcase_create("Nexthop objects");
+	tcase_add_test(tc_nh, nh_group_parse);
+	tcase_add_test(tc_nh, route_nexthops);
+	suite_add_tcase(suite, tc_nh);
+
+	TCase *tc_update = tcase_create("Updates");
+	tcase_add_test(tc_update, netconf_merge);
+	suite_add_tcase(suite, tc_update);
+
+	TCase *tc_filter = tcase_create("Dump filter");
+	tcase_add_test(tc_filter, dump_filter_request);
+	suite_add_tcase(suite, tc_filter);
+
+	return suite;
+}
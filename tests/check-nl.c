@@ -0,0 +1,779 @@
+/*
+ * tests/check-nl.c		Netlink send/receive unit tests
+ *
+ *	This library is free software; you can redistribute it and/or
+ *	modify it under the terms of the GNU Lesser General Public
+ *	License as published by the Free Software Foundation version 2.1
+ *	of the License.
+ */
+
+#include <check.h>
+#include <netlink-private/types.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netlink/netlink.h>
+#include <netlink/socket.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+
+#include "util.h"
+
+#define TEST_MSGTYPE	(NLMSG_MIN_TYPE + 1)
+#define TEST_NMSGS	4
+
+/*
+ * Fake receive function handing out a single datagram carrying
+ * TEST_NMSGS messages, each with a single u32 attribute.
+ */
+static int fake_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+		     unsigned char **buf, struct ucred **creds)
+{
+	unsigned char *data;
+	size_t len = 0;
+	int i;
+
+	data = calloc(TEST_NMSGS, getpagesize());
+	if (!data)
+		return -NLE_NOMEM;
+
+	for (i = 0; i < TEST_NMSGS; i++) {
+		struct nl_msg *msg;
+		struct nlmsghdr *nlh;
+
+		msg = nlmsg_alloc_simple(TEST_MSGTYPE, 0);
+		nla_put_u32(msg, 1, i);
+		nlh = nlmsg_hdr(msg);
+		memcpy(data + len, nlh, nlh->nlmsg_len);
+		len += NLMSG_ALIGN(nlh->nlmsg_len);
+		nlmsg_free(msg);
+	}
+
+	*buf = data;
+
+	return len;
+}
+
+struct collect {
+	struct nl_msg *msgs[TEST_NMSGS];
+	int nmsgs;
+};
+
+static int collect_valid(struct nl_msg *msg, void *arg)
+{
+	struct collect *c = arg;
+
+	if (c->nmsgs < TEST_NMSGS) {
+		nlmsg_get(msg);
+		c->msgs[c->nmsgs++] = msg;
+	}
+
+	return NL_OK;
+}
+
+static struct nl_sock *alloc_fake_socket(struct collect *c)
+{
+	struct nl_sock *sk;
+	struct nl_cb *cb;
+
+	sk = nl_socket_alloc();
+	fail_if(sk == NULL, "Unable to allocate socket");
+
+	nl_socket_disable_seq_check(sk);
+	nl_socket_modify_cb(sk, NL_CB_VALID, NL_CB_CUSTOM, collect_valid, c);
+
+	cb = nl_socket_get_cb(sk);
+	nl_cb_overwrite_recv(cb, fake_recv);
+	nl_cb_put(cb);
+
+	return sk;
+}
+
+static void check_collected(struct collect *c)
+{
+	int i;
+
+	fail_if(c->nmsgs != TEST_NMSGS,
+		"Expected %d messages, got %d", TEST_NMSGS, c->nmsgs);
+
+	for (i = 0; i < c->nmsgs; i++) {
+		struct nlmsghdr *nlh = nlmsg_hdr(c->msgs[i]);
+		struct nlattr *a;
+
+		fail_if(nlh->nlmsg_type != TEST_MSGTYPE,
+			"Unexpected message type %d", nlh->nlmsg_type);
+
+		a = nlmsg_find_attr(nlh, 0, 1);
+		fail_if(a == NULL, "Attribute missing in message %d", i);
+		fail_if(nla_get_u32(a) != i,
+			"Attribute of message %d carries wrong value", i);
+	}
+}
+
+START_TEST(recv_copy)
+{
+	struct collect c = { .nmsgs = 0 };
+	struct nl_sock *sk;
+	int i;
+
+	sk = alloc_fake_socket(&c);
+
+	fail_if(nl_recvmsgs_default(sk) != 0,
+		"Receiving messages should succeed");
+
+	check_collected(&c);
+
+	for (i = 0; i < c.nmsgs; i++)
+		nlmsg_free(c.msgs[i]);
+
+	nl_socket_free(sk);
+}
+END_TEST
+
+START_TEST(recv_zerocopy)
+{
+	struct collect c = { .nmsgs = 0 };
+	struct nl_sock *sk;
+	char *base;
+	int i;
+
+	sk = alloc_fake_socket(&c);
+	nl_socket_enable_msg_zerocopy(sk);
+
+	fail_if(nl_recvmsgs_default(sk) != 0,
+		"Receiving messages should succeed");
+
+	/* messages must outlive the receive call */
+	check_collected(&c);
+
+	/* all messages reference the same receive buffer */
+	base = (char *) nlmsg_hdr(c.msgs[0]);
+	for (i = 1; i < c.nmsgs; i++) {
+		base += NLMSG_ALIGN(nlmsg_hdr(c.msgs[i - 1])->nlmsg_len);
+		fail_if((char *) nlmsg_hdr(c.msgs[i]) != base,
+			"Message %d does not point into the receive buffer", i);
+	}
+
+	/* expanding a message detaches it from the receive buffer */
+	fail_if(nlmsg_expand(c.msgs[0], getpagesize()) != 0,
+		"Expanding a received message should succeed");
+	fail_if(nla_put_u32(c.msgs[0], 2, 42) != 0,
+		"Adding an attribute to an expanded message should succeed");
+	fail_if(nla_get_u32(nlmsg_find_attr(nlmsg_hdr(c.msgs[1]), 0, 1)) != 1,
+		"Expanding a message must not touch the other messages");
+
+	for (i = 0; i < c.nmsgs; i++)
+		nlmsg_free(c.msgs[i]);
+
+	nl_socket_free(sk);
+}
+END_TEST
+
+#define TEST_SOCK_MAXMSGS	8
+
+struct sock_pair {
+	struct nl_sock *rx;
+	struct nl_sock *tx;
+	int types[TEST_SOCK_MAXMSGS];
+	int ntypes;
+};
+
+static int record_type(struct nl_msg *msg, void *arg)
+{
+	struct sock_pair *p = arg;
+
+	fail_if(p->ntypes >= TEST_SOCK_MAXMSGS, "Too many messages received");
+	p->types[p->ntypes++] = nlmsg_hdr(msg)->nlmsg_type - TEST_MSGTYPE;
+
+	return NL_OK;
+}
+
+/*
+ * Connects a receiving socket recording the types of all valid messages
+ * and a sending socket addressing it.
+ */
+static void sock_pair_init(struct sock_pair *p)
+{
+	memset(p, 0, sizeof(*p));
+
+	p->rx = nl_socket_alloc();
+	p->tx = nl_socket_alloc();
+	fail_if(p->rx == NULL || p->tx == NULL, "Unable to allocate socket");
+	fail_if(nl_connect(p->rx, NETLINK_ROUTE) < 0, "Unable to connect socket");
+	fail_if(nl_connect(p->tx, NETLINK_ROUTE) < 0, "Unable to connect socket");
+
+	nl_socket_disable_seq_check(p->rx);
+	nl_socket_set_nonblocking(p->rx);
+	nl_socket_modify_cb(p->rx, NL_CB_VALID, NL_CB_CUSTOM, record_type, p);
+
+	nl_socket_disable_auto_ack(p->tx);
+	nl_socket_set_peer_port(p->tx, nl_socket_get_local_port(p->rx));
+}
+
+static void sock_pair_free(struct sock_pair *p)
+{
+	nl_socket_free(p->tx);
+	nl_socket_free(p->rx);
+}
+
+/* Sends a message of type TEST_MSGTYPE + idx carrying len bytes payload */
+static void sock_pair_send(struct sock_pair *p, int idx, size_t len)
+{
+	struct nl_msg *msg;
+	void *data;
+
+	msg = nlmsg_alloc_size(nlmsg_total_size(len));
+	fail_if(msg == NULL, "Unable to allocate message");
+	fail_if(nlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, TEST_MSGTYPE + idx,
+			  len, 0) == NULL, "Unable to construct message");
+
+	data = nlmsg_data(nlmsg_hdr(msg));
+	memset(data, 0, len);
+
+	fail_if(nl_send_auto(p->tx, msg) < 0, "Unable to send message");
+	nlmsg_free(msg);
+}
+
+#define TEST_BATCH_BUFSIZE	1024
+
+START_TEST(recv_batch_truncated)
+{
+	struct sock_pair p;
+	struct nl_cb *cb;
+	int err;
+
+	sock_pair_init(&p);
+	cb = nl_socket_get_cb(p.rx);
+	nl_socket_set_msg_buf_size(p.rx, TEST_BATCH_BUFSIZE);
+
+	err = nl_socket_set_recv_batch(p.rx, TEST_SOCK_MAXMSGS);
+	if (err == -NLE_OPNOTSUPP)
+		goto out;
+	fail_if(err < 0, "Unable to enable batched receiving");
+
+	sock_pair_send(&p, 0, 64);
+	sock_pair_send(&p, 1, 2 * TEST_BATCH_BUFSIZE);
+	sock_pair_send(&p, 2, 64);
+	sock_pair_send(&p, 3, 64);
+
+	/* The truncated datagram is lost but does not abort the batch */
+	fail_if(nl_recvmsgs_report(p.rx, cb) != -NLE_MSG_TRUNC,
+		"Truncation not reported");
+	fail_if(p.ntypes != 3 || p.types[0] != 0 || p.types[1] != 2 ||
+		p.types[2] != 3, "Datagrams of the batch not processed");
+
+	/* Nothing is left queued in user space */
+	fail_if(nl_recvmsgs_report(p.rx, cb) != -NLE_AGAIN,
+		"Datagrams left queued after receiving");
+
+	/* The buffers have grown to the size of the truncated datagram */
+	sock_pair_send(&p, 4, 2 * TEST_BATCH_BUFSIZE);
+	fail_if(nl_recvmsgs_report(p.rx, cb) != 1,
+		"Large datagram not received after growing the buffers");
+	fail_if(p.ntypes != 4 || p.types[3] != 4, "Large message not processed");
+
+out:
+	nl_cb_put(cb);
+	sock_pair_free(&p);
+}
+END_TEST
+
+static int hold_msg(struct nl_msg *msg, void *arg)
+{
+	struct nl_msg **held = arg;
+
+	nlmsg_free(*held);
+	nlmsg_get(msg);
+	*held = msg;
+
+	return NL_OK;
+}
+
+START_TEST(recv_buffer_reuse)
+{
+	struct nl_msg *held = NULL, *first;
+	struct nl_recvbuf *rb;
+	struct sock_pair p;
+	struct nl_cb *cb;
+	unsigned char *data;
+	size_t size;
+
+	sock_pair_init(&p);
+	nl_socket_set_msg_buf_size(p.rx, TEST_BATCH_BUFSIZE);
+	nl_socket_enable_msg_peek(p.rx);
+	cb = nl_socket_get_cb(p.rx);
+
+	sock_pair_send(&p, 0, 64);
+	fail_if(nl_recvmsgs_report(p.rx, cb) != 1, "Message not received");
+	rb = p.rx->s_rbuf;
+	fail_if(rb == NULL || rb->rb_refcnt != 1,
+		"Receive buffer not kept with the socket");
+	data = rb->rb_data;
+
+	/* The buffer is reused for the next datagram */
+	sock_pair_send(&p, 1, 64);
+	fail_if(nl_recvmsgs_report(p.rx, cb) != 1, "Message not received");
+	fail_if(p.rx->s_rbuf != rb || rb->rb_data != data,
+		"Receive buffer not reused");
+
+	/* and grows to hold a larger datagram */
+	sock_pair_send(&p, 2, 2 * TEST_BATCH_BUFSIZE);
+	fail_if(nl_recvmsgs_report(p.rx, cb) != 1,
+		"Large message not received");
+	fail_if(p.rx->s_rbuf != rb, "Unreferenced receive buffer replaced");
+	fail_if(rb->rb_size < nlmsg_total_size(2 * TEST_BATCH_BUFSIZE),
+		"Receive buffer did not grow");
+	size = rb->rb_size;
+
+	/* A message received in zero-copy mode references the buffer */
+	nl_socket_enable_msg_zerocopy(p.rx);
+	nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, hold_msg, &held);
+
+	sock_pair_send(&p, 3, 64);
+	fail_if(nl_recvmsgs_report(p.rx, cb) != 1, "Message not received");
+	fail_if(held == NULL, "Message not held");
+	fail_if((unsigned char *) nlmsg_hdr(held) != rb->rb_data,
+		"Zero-copy message does not point into the receive buffer");
+	fail_if(rb->rb_refcnt != 2, "Held message does not reference buffer");
+	first = held;
+	held = NULL;
+
+	/* The next datagram is read into a replacement of the same size */
+	sock_pair_send(&p, 4, 64);
+	fail_if(nl_recvmsgs_report(p.rx, cb) != 1, "Message not received");
+	fail_if(p.rx->s_rbuf == rb, "Referenced receive buffer reused");
+	fail_if(p.rx->s_rbuf->rb_size != size,
+		"Replacement buffer does not inherit the size");
+	fail_if(rb->rb_refcnt != 1, "Buffer still referenced by the socket");
+
+	/* while the held message remains valid */
+	fail_if((unsigned char *) nlmsg_hdr(first) != rb->rb_data,
+		"Held message moved");
+	fail_if(nlmsg_hdr(first)->nlmsg_type != TEST_MSGTYPE + 3,
+		"Held message overwritten");
+	fail_if(nlmsg_hdr(held)->nlmsg_type != TEST_MSGTYPE + 4,
+		"Message received into the replacement buffer corrupted");
+
+	nlmsg_free(first);
+	nlmsg_free(held);
+	nl_cb_put(cb);
+	sock_pair_free(&p);
+}
+END_TEST
+
+#define TEST_PIPE_NMSGS		10
+#define TEST_PIPE_WINDOW	4
+#define TEST_PIPE_FAIL		2
+
+/* Requests sent but not yet acknowledged by fake_ack_recv() */
+static struct {
+	struct nlmsghdr	reqs[TEST_PIPE_NMSGS];
+	int		nreqs;
+	int		max_inflight;
+} pipe_state;
+
+static int fake_req_send(struct nl_sock *sk, struct nl_msg *msg)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+
+	fail_if(!(nlh->nlmsg_flags & NLM_F_ACK),
+		"Pipelined request without ACK flag");
+	fail_if(pipe_state.nreqs >= TEST_PIPE_NMSGS, "Too many requests");
+
+	pipe_state.reqs[pipe_state.nreqs++] = *nlh;
+	if (pipe_state.nreqs > pipe_state.max_inflight)
+		pipe_state.max_inflight = pipe_state.nreqs;
+
+	return nlh->nlmsg_len;
+}
+
+/*
+ * Fake receive function acknowledging all outstanding requests in
+ * reverse order within a single datagram. The request carrying the
+ * attribute value TEST_PIPE_FAIL is answered with an error.
+ */
+static int fake_ack_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+			 unsigned char **buf, struct ucred **creds)
+{
+	size_t size = nlmsg_total_size(sizeof(struct nlmsgerr));
+	unsigned char *data;
+	int i, len = 0;
+
+	if (pipe_state.nreqs == 0)
+		return 0;
+
+	data = calloc(TEST_PIPE_NMSGS, size);
+	if (!data)
+		return -NLE_NOMEM;
+
+	for (i = pipe_state.nreqs - 1; i >= 0; i--) {
+		struct nlmsghdr *nlh = (struct nlmsghdr *) (data + len);
+		struct nlmsgerr *e = nlmsg_data(nlh);
+
+		nlh->nlmsg_len = nlmsg_size(sizeof(*e));
+		nlh->nlmsg_type = NLMSG_ERROR;
+		nlh->nlmsg_seq = pipe_state.reqs[i].nlmsg_seq;
+		e->msg = pipe_state.reqs[i];
+		if (pipe_state.reqs[i].nlmsg_type == TEST_MSGTYPE + TEST_PIPE_FAIL)
+			e->error = -EEXIST;
+
+		len += size;
+	}
+
+	pipe_state.nreqs = 0;
+	*buf = data;
+
+	return len;
+}
+
+START_TEST(send_pipelined)
+{
+	struct nl_msg *msgs[TEST_PIPE_NMSGS];
+	int results[TEST_PIPE_NMSGS];
+	struct nl_sock *sk;
+	struct nl_cb *cb;
+	int i;
+
+	memset(&pipe_state, 0, sizeof(pipe_state));
+
+	sk = nl_socket_alloc();
+	fail_if(sk == NULL, "Unable to allocate socket");
+
+	cb = nl_socket_get_cb(sk);
+	nl_cb_overwrite_send(cb, fake_req_send);
+	nl_cb_overwrite_recv(cb, fake_ack_recv);
+	nl_cb_put(cb);
+
+	for (i = 0; i < TEST_PIPE_NMSGS; i++) {
+		msgs[i] = nlmsg_alloc_simple(TEST_MSGTYPE + i, 0);
+		fail_if(msgs[i] == NULL, "Unable to allocate message");
+	}
+
+	fail_if(nl_send_pipelined(sk, msgs, TEST_PIPE_NMSGS,
+				  TEST_PIPE_WINDOW, results) != 1,
+		"Exactly one request should have failed");
+
+	fail_if(pipe_state.max_inflight > TEST_PIPE_WINDOW,
+		"%d requests in flight exceed window of %d",
+		pipe_state.max_inflight, TEST_PIPE_WINDOW);
+
+	for (i = 0; i < TEST_PIPE_NMSGS; i++) {
+		if (i == TEST_PIPE_FAIL)
+			fail_if(results[i] != -NLE_EXIST,
+				"Request %d should have failed, got %d",
+				i, results[i]);
+		else
+			fail_if(results[i] != 0,
+				"Request %d should have succeeded, got %d",
+				i, results[i]);
+
+		nlmsg_free(msgs[i]);
+	}
+
+	nl_socket_free(sk);
+}
+END_TEST
+
+#define TEST_BATCH_NMSGS	12
+#define TEST_BATCH_PAYLOAD	1501
+#define TEST_BATCH_SKIP		2
+#define TEST_BATCH_STOP		9
+
+static int batch_out_ret;
+
+/*
+ * Leaves out message TEST_BATCH_SKIP and returns batch_out_ret for
+ * message TEST_BATCH_STOP.
+ */
+static int batch_msg_out(struct nl_msg *msg, void *arg)
+{
+	int idx = nlmsg_hdr(msg)->nlmsg_type - TEST_MSGTYPE;
+
+	if (idx == TEST_BATCH_SKIP)
+		return NL_SKIP;
+	else if (idx == TEST_BATCH_STOP)
+		return batch_out_ret;
+
+	return NL_OK;
+}
+
+/*
+ * Drains all datagrams queued on the receiving socket. Verifies that no
+ * datagram exceeds maxlen and that the messages carry the indices
+ * [from, to) in order, except for TEST_BATCH_SKIP. Returns the number
+ * of datagrams received.
+ */
+static int batch_receive(int fd, size_t maxlen, int from, int to)
+{
+	static unsigned char buf[65536];
+	int n, ndgrams = 0, next = from;
+
+	while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+		struct nlmsghdr *nlh = (struct nlmsghdr *) buf;
+		int len = n;
+
+		fail_if((size_t) n > maxlen,
+			"Datagram of %d bytes exceeds limit of %zu", n, maxlen);
+
+		for (; nlmsg_ok(nlh, len); nlh = nlmsg_next(nlh, &len)) {
+			if (next == TEST_BATCH_SKIP)
+				next++;
+
+			fail_if(nlh->nlmsg_type != TEST_MSGTYPE + next,
+				"Expected message %d, got %d", next,
+				nlh->nlmsg_type - TEST_MSGTYPE);
+			next++;
+		}
+
+		fail_if(len != 0, "Trailing data in datagram");
+		ndgrams++;
+	}
+
+	fail_if(next != to, "Expected messages up to %d, got %d", to, next);
+
+	return ndgrams;
+}
+
+START_TEST(send_batch)
+{
+	static char payload[TEST_BATCH_PAYLOAD];
+	struct nl_msg_batch *batch;
+	struct nl_sock *sk, *rx;
+	socklen_t optlen = sizeof(int);
+	size_t maxlen, len;
+	int i, sndbuf, per_dgram;
+
+	sk = nl_socket_alloc();
+	rx = nl_socket_alloc();
+	fail_if(sk == NULL || rx == NULL, "Unable to allocate socket");
+	fail_if(nl_connect(sk, NETLINK_ROUTE) < 0, "Unable to connect socket");
+	fail_if(nl_connect(rx, NETLINK_ROUTE) < 0, "Unable to connect socket");
+
+	/* A small send buffer forces the batch to be split */
+	fail_if(nl_socket_set_buffer_size(sk, 0, 4096) < 0,
+		"Unable to set send buffer size");
+	fail_if(getsockopt(nl_socket_get_fd(sk), SOL_SOCKET, SO_SNDBUF,
+			   &sndbuf, &optlen) < 0, "Unable to get send buffer");
+	maxlen = sndbuf - 32;
+
+	nl_socket_set_peer_port(sk, nl_socket_get_local_port(rx));
+	nl_socket_modify_cb(sk, NL_CB_MSG_OUT, NL_CB_CUSTOM,
+			    batch_msg_out, NULL);
+
+	batch = nl_msg_batch_alloc();
+	fail_if(batch == NULL, "Unable to allocate batch");
+
+	for (i = 0; i < TEST_BATCH_NMSGS; i++) {
+		struct nl_msg *msg;
+
+		msg = nlmsg_alloc_simple(TEST_MSGTYPE + i, 0);
+		fail_if(msg == NULL, "Unable to allocate message");
+		/* Unaligned length, requires padding between messages */
+		fail_if(nlmsg_append(msg, payload, sizeof(payload), 0) < 0,
+			"Unable to append payload");
+		fail_if(nl_msg_batch_add(sk, batch, msg) < 0,
+			"Unable to add message to batch");
+		len = NLMSG_ALIGN(nlmsg_hdr(msg)->nlmsg_len);
+		nlmsg_free(msg);
+	}
+
+	per_dgram = maxlen / len;
+	fail_if(per_dgram < 2, "Send buffer too small to pack messages");
+
+	/* A negative error aborts before anything is transmitted */
+	batch_out_ret = -NLE_INVAL;
+	fail_if(nl_send_batch(sk, batch) != -NLE_INVAL,
+		"Error of MSG_OUT callback not returned");
+	fail_if(nl_msg_batch_count(batch) != TEST_BATCH_NMSGS,
+		"Batch modified despite error");
+	fail_if(batch_receive(nl_socket_get_fd(rx), maxlen, 0, 0) != 0,
+		"Messages transmitted despite error");
+
+	/* NL_STOP transmits the preceding messages minus the skipped one */
+	batch_out_ret = NL_STOP;
+	fail_if(nl_send_batch(sk, batch) != TEST_BATCH_STOP - 1,
+		"Unexpected number of messages transmitted");
+	fail_if(nl_msg_batch_count(batch) != TEST_BATCH_NMSGS - TEST_BATCH_STOP,
+		"Stopped messages not left in batch");
+	fail_if(batch_receive(nl_socket_get_fd(rx), maxlen, 0, TEST_BATCH_STOP) !=
+		(TEST_BATCH_STOP - 1 + per_dgram - 1) / per_dgram,
+		"Messages not packed into the minimum number of datagrams");
+
+	batch_out_ret = NL_OK;
+	fail_if(nl_send_batch(sk, batch) != TEST_BATCH_NMSGS - TEST_BATCH_STOP,
+		"Remaining messages not transmitted");
+	fail_if(nl_msg_batch_count(batch) != 0, "Batch not empty");
+	batch_receive(nl_socket_get_fd(rx), maxlen, TEST_BATCH_STOP,
+		      TEST_BATCH_NMSGS);
+
+	nl_msg_batch_free(batch);
+	nl_socket_free(rx);
+	nl_socket_free(sk);
+}
+END_TEST
+
+#define TEST_REQ_NMSGS		4
+#define TEST_REQ_CANCEL		3
+
+static void request_done(struct nl_request *req, int error, void *arg)
+{
+	int *result = arg;
+
+	fail_if(*result != 1, "Request completed more than once");
+	*result = error;
+}
+
+START_TEST(request_async)
+{
+	struct nl_request *reqs[TEST_REQ_NMSGS];
+	int results[TEST_REQ_NMSGS];
+	struct nl_sock *sk;
+	struct nl_cb *cb;
+	int i;
+
+	memset(&pipe_state, 0, sizeof(pipe_state));
+
+	sk = nl_socket_alloc();
+	fail_if(sk == NULL, "Unable to allocate socket");
+
+	cb = nl_socket_get_cb(sk);
+	nl_cb_overwrite_send(cb, fake_req_send);
+	nl_cb_overwrite_recv(cb, fake_ack_recv);
+	nl_cb_put(cb);
+
+	for (i = 0; i < TEST_REQ_NMSGS; i++) {
+		struct nl_msg *msg;
+
+		msg = nlmsg_alloc_simple(TEST_MSGTYPE + i, 0);
+		fail_if(msg == NULL, "Unable to allocate message");
+
+		results[i] = 1;
+		fail_if(nl_request_submit(sk, msg, NULL, request_done,
+					  &results[i], &reqs[i]) != 0,
+			"Submitting request %d should succeed", i);
+		nlmsg_free(msg);
+	}
+
+	fail_if(nl_request_pending(sk) != TEST_REQ_NMSGS,
+		"All requests should be pending");
+
+	nl_request_cancel(sk, reqs[TEST_REQ_CANCEL]);
+
+	fail_if(nl_process_ready(sk) != TEST_REQ_NMSGS,
+		"All replies should have been processed");
+	fail_if(nl_request_pending(sk) != 0,
+		"No request should be pending anymore");
+
+	for (i = 0; i < TEST_REQ_NMSGS; i++) {
+		if (i == TEST_REQ_CANCEL)
+			fail_if(results[i] != 1,
+				"Cancelled request must not complete");
+		else if (i == TEST_PIPE_FAIL)
+			fail_if(results[i] != -NLE_EXIST,
+				"Request %d should have failed, got %d",
+				i, results[i]);
+		else
+			fail_if(results[i] != 0,
+				"Request %d should have succeeded, got %d",
+				i, results[i]);
+	}
+
+	nl_socket_free(sk);
+}
+END_TEST
+
+/*
+ * Build an error message in reply to req carrying extended ACK attributes
+ * pointing at the attribute at offset off of the request.
+ */
+static struct nl_msg *build_ext_ack(struct nl_msg *req, int capped, int off)
+{
+	struct nlmsghdr *nlh = nlmsg_hdr(req);
+	struct nl_msg *msg;
+	struct nlmsgerr e = { .error = -EINVAL, .msg = *nlh };
+	int flags = NLM_F_ACK_TLVS | (capped ? NLM_F_CAPPED : 0);
+
+	msg = nlmsg_alloc_simple(NLMSG_ERROR, flags);
+	fail_if(msg == NULL, "Unable to allocate message");
+
+	fail_if(nlmsg_append(msg, &e, sizeof(e), NLMSG_ALIGNTO) < 0,
+		"Unable to append error header");
+	if (!capped)
+		fail_if(nlmsg_append(msg, nlmsg_data(nlh), nlmsg_datalen(nlh),
+				     NLMSG_ALIGNTO) < 0,
+			"Unable to append original request");
+
+	nla_put_string(msg, NLMSGERR_ATTR_MSG, "Invalid value");
+	nla_put_u32(msg, NLMSGERR_ATTR_OFFS, off);
+
+	return msg;
+}
+
+START_TEST(ext_ack)
+{
+	struct nl_msg *req, *msg;
+	struct nlmsgerr *e;
+	struct nlattr *a;
+	int off;
+
+	req = nlmsg_alloc_simple(TEST_MSGTYPE, NLM_F_REQUEST);
+	fail_if(req == NULL, "Unable to allocate message");
+	nla_put_u32(req, 1, 1);
+	nla_put_u32(req, 2, 2);
+
+	a = nlmsg_find_attr(nlmsg_hdr(req), 0, 2);
+	off = (char *) a - (char *) nlmsg_hdr(req);
+
+	msg = build_ext_ack(req, 0, off);
+	e = nlmsg_data(nlmsg_hdr(msg));
+
+	fail_if(nlmsg_ext_ack_msg(e) == NULL ||
+		strcmp(nlmsg_ext_ack_msg(e), "Invalid value"),
+		"Extended ACK message not found");
+	fail_if(nlmsg_ext_ack_offset(e) != off,
+		"Extended ACK offset is %d, expected %d",
+		nlmsg_ext_ack_offset(e), off);
+
+	a = nlmsg_ext_ack_attr(e);
+	fail_if(a == NULL || nla_type(a) != 2 || nla_get_u32(a) != 2,
+		"Invalid attribute not found in original request");
+	nlmsg_free(msg);
+
+	msg = build_ext_ack(req, 1, off);
+	e = nlmsg_data(nlmsg_hdr(msg));
+
+	fail_if(nlmsg_ext_ack_msg(e) == NULL,
+		"Extended ACK message not found in capped ACK");
+	fail_if(nlmsg_ext_ack_offset(e) != off,
+		"Extended ACK offset not found in capped ACK");
+	fail_if(nlmsg_ext_ack_attr(e) != NULL,
+		"Capped ACK does not include the original request");
+	nlmsg_free(msg);
+
+	nlmsg_free(req);
+}
+END_TEST
+
+Suite *make_nl_suite(void)
+{
+	Suite *suite = suite_create("Send & Receive");
+
+	TCase *tc_recv = tcase_create("Receive");
+	tcase_add_test(tc_recv, recv_copy);
+	tcase_add_test(tc_recv, recv_zerocopy);
+	tcase_add_test(tc_recv, recv_buffer_reuse);
+	tcase_add_test(tc_recv, recv_batch_truncated);
+	suite_add_tcase(suite, tc_recv);
+
+	TCase *tc_send = tcase_create("Send");
+	tcase_add_test(tc_send, send_batch);
+	tcase_add_test(tc_send, send_pipelined);
+	tcase_add_test(tc_send, request_async);
+	suite_add_tcase(suite, tc_send);
+
+	TCase *tc_ack = tcase_create("Extended ACK");
+	tcase_add_test(tc_ack, ext_ack);
+	suite_add_tcase(suite, tc_ack);
+
+	return suite;
+}
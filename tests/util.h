@@ -5,6 +5,9 @@
 		(error), nl_geterror(error), (message))
 
 Suite *make_nl_attr_suite(void);
+Suite *make_nl_cache_suite(void);
+Suite *make_nl_cache_mngr_suite(void);
 Suite *make_nl_addr_suite(void);
 Suite *make_nl_ematch_tree_clone_suite(void);
+Suite *make_nl_suite(void);
 